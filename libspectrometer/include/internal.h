@@ -7,6 +7,12 @@
 
 #include <stdint.h>
 
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
 #define USBD_VID                     0xE220
 #define USBD_PID                     0x0100
 
@@ -21,16 +27,85 @@
 #define STANDARD_TIMEOUT_MILLISECONDS 100
 #define ERASE_FLASH_TIMEOUT_MILLISECONDS 5000
 
+#define LATENCY_WINDOW 32                        //samples weighted equally before the estimate becomes a moving average
+#define LATENCY_MIN_SAMPLES 8                    //the fixed timeouts apply until the estimate has this many samples
+#define LATENCY_DEVIATION_FACTOR 6.0f
+#define LATENCY_MIN_TIMEOUT_MILLISECONDS 10
+
 #define PACKET_SIZE 64
 #define EXTENDED_PACKET_SIZE 1 + PACKET_SIZE //bytes
 #define MAX_PACKETS_IN_FRAME 124
+#define FRAME_MAX_RETRANSMISSIONS 8              //requests for missing packets before a frame read fails
 #define REMAINING_PACKETS_ERROR 250
 #define NUM_OF_PIXELS_IN_PACKET 30
 #define MAX_READ_FLASH_PACKETS 100
 #define MAX_FLASH_WRITE_PAYLOAD 58
+#define MAX_NUM_OF_PIXELS_IN_FRAME (MAX_PACKETS_IN_FRAME * NUM_OF_PIXELS_IN_PACKET)
+#define DEVICE_MEMORY_SIZE_IN_PIXELS (137 * 3694)    //137 full spectra
+#define DEVICE_MAX_FRAMES_IN_MEMORY 0xFFFE           //frame indices are 16 bit, 0xFFFF is the averaged frame
+#define NUM_OF_LEADING_ELEMENTS 32
+#define NUM_OF_TRAILING_ELEMENTS 14
+#define NUM_OF_IMAGE_ELEMENTS 3648             //full element range without reduction
+
+#define DARK_REFERENCE_FIRST_ELEMENT 16        //light shielded elements among the leading ones
+#define DARK_REFERENCE_NUM_OF_ELEMENTS 13
+#define DARK_REFERENCE_TRIM 3                  //lowest and highest values left out of the mean
+
+#define BINNING_NO_BIN 0xFFFF
+
+#define HOST_TRIGGER_MAX_FRAMES 4096             //pre- or post-trigger frames
+
+#define SATURATION_LEVEL 0xFFFF                  //full scale of the converter
+#define AUTO_EXPOSURE_MIN_SIGNAL 64              //maxima closer to the dark level are taken for noise
+#define AUTO_EXPOSURE_MAX_GROWTH 8               //largest change of the exposure in one step
+#define EXPOSURE_MIN_POLL_INTERVAL_MICROSECONDS 200
+#define EXPOSURE_MAX_POLL_INTERVAL_MICROSECONDS 5000
+#define HDR_MAX_EXPOSURES 16
+
+#define STATUS_IN_PROGRESS 1
+#define STATUS_MEMORY_FULL 2
+
+#define DRAIN_MIN_POLL_INTERVAL_MICROSECONDS 200
+#define DRAIN_MAX_POLL_INTERVAL_MICROSECONDS 10000
+
+#define AVERAGED_FRAME_NOT_READY 0
+#define AVERAGED_FRAME_READY 1
+#define AVERAGED_FRAME_READY_WITH_LOST 2
+
+#define AVERAGING_POLLS_PER_PERIOD 20
+#define AVERAGING_MIN_POLL_INTERVAL_MICROSECONDS 200
+#define AVERAGING_MAX_POLL_INTERVAL_MICROSECONDS 5000
+#define AVERAGING_EARLY_WAKEUP_NANOSECONDS 2000000ULL
+
+#define CAPTURE_FILE_MAGIC "ASQCAPT"
+#define CAPTURE_COMPRESSED_FILE_MAGIC "ASQCAPZ"
+#define CAPTURE_FILE_VERSION 1
+#define CAPTURE_FILE_HEADER_SIZE 4096
+#define CAPTURE_RECORD_ALIGNMENT 64
+
+#define CODEC_VERSION 1
+#define CODEC_HEADER_SIZE 4
+#define CODEC_BLOCK_SIZE 128
+#define CODEC_LANES 8
+#define CODEC_ROWS (CODEC_BLOCK_SIZE / CODEC_LANES)
+#define CODEC_FLAG_REFERENCE 0x01
+#define CODEC_INTER_BLOCK 0x80
+#define CODEC_WIDTH_MASK 0x1F
+
+#define FRAME_RING_MAGIC "ASQRING"
+#define FRAME_RING_VERSION 1
+#define FRAME_RING_HEADER_SIZE 4096
+#define FRAME_RING_MAX_NAME_LENGTH 255
+#define FRAME_RING_POLL_INTERVAL_MICROSECONDS 200
 
 #define ZERO_REPORT_ID 0
 
+#define GROUP_RELEASE_SPIN_LIMIT 100000000
+
+#define FRAME_PROCESSOR_MAX_THREADS 256
+#define FRAME_PROCESSOR_MAX_KERNELS 16
+#define FRAME_PROCESSOR_MAX_DEVICES 64
+
 #define STATUS_REQUEST 1
 #define SET_EXPOSURE_REQUEST 2
 #define SET_ACQUISITION_PARAMETERS_REQUEST 3
@@ -80,10 +155,197 @@ typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
 
+typedef enum GroupTriggerMode_t {GROUP_TRIGGER_SEQUENTIAL, GROUP_TRIGGER_BARRIER} GroupTriggerMode_t;
+typedef enum DrainPolicy_t {DRAIN_DROP_OLDEST, DRAIN_DROP_NEWEST, DRAIN_STALL_DEVICE} DrainPolicy_t;
+typedef enum DarkCorrectionMode_t {DARK_CORRECTION_DISABLED, DARK_CORRECTION_ENABLED} DarkCorrectionMode_t;
+typedef enum BinningMode_t {BINNING_MEAN, BINNING_SUM} BinningMode_t;
+typedef enum PeakRefinementMode_t {PEAK_REFINEMENT_PARABOLIC, PEAK_REFINEMENT_GAUSSIAN} PeakRefinementMode_t;
+typedef enum HostTriggerCondition_t {HOST_TRIGGER_ANY_ABOVE, HOST_TRIGGER_ALL_ABOVE, HOST_TRIGGER_ANY_BELOW, HOST_TRIGGER_ALL_BELOW} HostTriggerCondition_t;
+typedef enum CaptureRecordState_t {CAPTURE_RECORD_PENDING, CAPTURE_RECORD_COMPLETE, CAPTURE_RECORD_FAILED} CaptureRecordState_t;
+typedef enum AsyncOperationKind_t {ASYNC_OPERATION_NONE, ASYNC_STATUS_READ, ASYNC_FRAME_READ, ASYNC_FLASH_READ} AsyncOperationKind_t;
+typedef enum LatencyClass_t {LATENCY_COMMAND, LATENCY_FRAME_FIRST_PACKET, LATENCY_FRAME_PACKET, LATENCY_READ_FLASH_PACKET, LATENCY_WRITE_FLASH, LATENCY_ERASE_FLASH, LATENCY_STATUS, NUM_OF_LATENCY_CLASSES} LatencyClass_t;
+
+struct FrameMetadata_t;
+typedef void (*FrameRangeHook_t)(void *hookState, const uint16_t *framePixels, uint32_t firstPixel, uint32_t endPixel);
+
+#if defined(_WIN32)
+    typedef HANDLE Thread_t;
+    typedef CRITICAL_SECTION Mutex_t;
+    typedef CONDITION_VARIABLE Condition_t;
+
+    typedef LPTHREAD_START_ROUTINE ThreadFunction_t;
+    #define THREAD_FUNCTION(name, argument) DWORD WINAPI name(LPVOID argument)
+    #define THREAD_RETURN return 0
+
+    #define ATOMIC_LOAD(ptr) InterlockedCompareExchange((volatile LONG*)(ptr), 0, 0)
+    #define ATOMIC_STORE(ptr, value) InterlockedExchange((volatile LONG*)(ptr), (LONG)(value))
+    #define ATOMIC_INCREMENT(ptr) InterlockedIncrement((volatile LONG*)(ptr))
+    #define ATOMIC_DECREMENT(ptr) InterlockedDecrement((volatile LONG*)(ptr))
+    #define ATOMIC_COMPARE_EXCHANGE(ptr, expected, desired) \
+        (InterlockedCompareExchange((volatile LONG*)(ptr), (LONG)(desired), (LONG)(expected)) == (LONG)(expected))
+    #define CPU_RELAX() YieldProcessor()
+    #define MEMORY_BARRIER() MemoryBarrier()
+#else
+    typedef pthread_t Thread_t;
+    typedef pthread_mutex_t Mutex_t;
+    typedef pthread_cond_t Condition_t;
+
+    typedef void *(*ThreadFunction_t)(void *);
+    #define THREAD_FUNCTION(name, argument) void *name(void *argument)
+    #define THREAD_RETURN return NULL
+
+    #define ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+    #define ATOMIC_STORE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+    #define ATOMIC_INCREMENT(ptr) __atomic_add_fetch((ptr), 1, __ATOMIC_ACQ_REL)
+    #define ATOMIC_DECREMENT(ptr) __atomic_sub_fetch((ptr), 1, __ATOMIC_ACQ_REL)
+    #define ATOMIC_COMPARE_EXCHANGE(ptr, expected, desired) __sync_bool_compare_and_swap((ptr), (expected), (desired))
+    #define MEMORY_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+    #if defined(__x86_64__) || defined(__i386__)
+        #define CPU_RELAX() __builtin_ia32_pause()
+    #else
+        #define CPU_RELAX() do {} while (0)
+    #endif
+#endif
+
+typedef void (*LastPacketDecoder_t)(uint16_t *pixels, const uint8_t *payload, uint32_t numOfPixels);
+
+/* How a frame of numOfPixelsInFrame elements is split into packets, selected when the frame format is set or read back */
+typedef struct FrameLayout_t {
+    uint16_t numOfPixelsInFrame;
+    uint32_t numOfPackets;
+    uint32_t numOfPixelsInLastPacket;
+    LastPacketDecoder_t decodeLastPacket;
+    uint16_t numOfStartElement;
+    uint8_t reductionMode;
+    bool darkReference;         //the frame covers the whole sensor, its leading elements hold the shielded ones
+} FrameLayout_t;
+
+/* State of one frame transfer, packets may arrive in any order and more than once */
+typedef struct FrameTransfer_t {
+    uint16_t *framePixels;
+    uint16_t numOfPixelsInFrame;
+    uint16_t numOfFrame;
+    uint8_t numOfPackets;
+    const FrameLayout_t *frameLayout;
+    bool packetReceived[MAX_PACKETS_IN_FRAME];
+    uint8_t numOfPacketsReceived;
+
+    /* The request in flight, for numOfRequestedPackets packets from firstRequestedPacket */
+    uint8_t firstRequestedPacket;
+    uint8_t numOfRequestedPackets;
+    uint32_t numOfReadsInRequest;
+    uint32_t numOfDiscardedInRequest;
+    uint32_t numOfRetransmissions;
+    int failure;
+
+    /* The packets before numOfFinishedPackets arrived, their elements up to numOfFinishedPixels are corrected and passed to the hook */
+    uint8_t numOfFinishedPackets;
+    uint32_t numOfFinishedPixels;
+    bool darkLevelKnown;
+    uint16_t darkLevel;
+    uint16_t maxPixel;
+    uint16_t numOfSaturatedPixels;
+
+    FrameRangeHook_t rangeHook;
+    void *hookState;
+
+    uint64_t requestTimestamp;
+    uint64_t firstPacketTimestamp;
+    uint64_t lastPacketTimestamp;
+} FrameTransfer_t;
+
+typedef enum FrameTransferStep_t {FRAME_TRANSFER_RECEIVING, FRAME_TRANSFER_REQUEST_ENDED} FrameTransferStep_t;
+
+/* Operation started by one of the begin...() functions, advanced by the matching continue...() function */
+typedef struct AsyncOperation_t {
+    uint8_t kind;                       //AsyncOperationKind_t
+    uint64_t lastActivityTimestamp;     //request written or reply received, the reply timeout runs from here
+
+    uint8_t *statusFlags;
+    uint16_t *framesInMemory;
+
+    FrameTransfer_t frameTransfer;
+    struct FrameMetadata_t *frameMetadata;
+
+    uint8_t *flashBuffer;
+    uint32_t flashOffset;
+    uint32_t numOfFlashBytes;
+    uint32_t numOfFlashBytesReceived;
+    uint32_t numOfFlashPacketsToRequest;
+    uint32_t flashRequestOffset;        //from flashOffset, of the request in flight
+    uint8_t numOfFlashPacketsRequested;
+    uint8_t numOfFlashPacketsReceived;
+} AsyncOperation_t;
+
+typedef struct FrameTransferCounters_t {
+    uint64_t framesRecovered;
+    uint64_t framesFailed;
+    uint64_t packetsRetransmitted;
+    uint64_t packetsDiscarded;
+} FrameTransferCounters_t;
+
+typedef struct StatusCache_t {
+    bool statusKnown;           //dropped by every command but the status request and by frame reads
+    bool framesInMemoryKnown;   //kept over frame reads outside frame averaging mode
+    uint8_t statusFlags;
+    uint16_t framesInMemory;
+    uint64_t requestTimestamp;
+    uint32_t timeToLive;        //milliseconds, 0 - only status requests waiting on each other are merged
+} StatusCache_t;
+
+/* Running mean and variance of the time a reply takes, in microseconds */
+typedef struct LatencyEstimate_t {
+    uint32_t numOfSamples;
+    uint32_t numOfTimeouts;
+    float mean;
+    float variance;
+    uint32_t timeoutOverride;   //milliseconds, 0 - derived from the estimate
+} LatencyEstimate_t;
+
 typedef struct DeviceContext_t {
     hid_device*  handle;
     uint16_t numOfPixelsInFrame;
     char* serial;
+    FrameLayout_t frameLayout;
+
+    /* Acquisition parameters as last set or read back, used to describe frames */
+    bool acquisitionParametersKnown;
+    uint16_t numOfScans;
+    uint16_t numOfBlankScans;
+    uint8_t scanMode;
+    uint32_t timeOfExposure;
+
+    uint64_t lastTriggerTimestamp;
+    uint32_t frameSequenceNumber;
+    FrameTransferCounters_t frameTransferCounters;
+    StatusCache_t statusCache;
+
+    /* Bumped whenever the frames in memory may have changed, the frame cache keeps only frames of the current one */
+    uint32_t memoryGeneration;
+
+    /* Applied to every frame while it is decoded */
+    uint8_t darkCorrectionMode;
+    uint16_t darkPedestal;
+
+    /* Recursive, held for a whole request/reply transaction */
+    Mutex_t mutex;
+
+    /* One per LatencyClass_t, updated under the mutex */
+    LatencyEstimate_t latencyEstimates[NUM_OF_LATENCY_CLASSES];
+
+    /* At most one at a time, the blocking functions fail with INVALID_STATE_ERROR while it is pending */
+    AsyncOperation_t asyncOperation;
+
+    /* Second reader of the hidraw node, readable whenever a report comes, see getPollFd() */
+    bool pollFdOpen;
+    int pollFd;
+
+    struct DrainEngine_t *drainEngine;
+    struct AveragingState_t *averagingState;
+    struct FrameCache_t *frameCache;
+
+    /* Fed with every frame drained, see attachFrameProcessor() */
+    struct FrameProcessor_t *frameProcessor;
 } DeviceContext_t;
 
 #ifndef DEVICE_INFO
@@ -96,15 +358,117 @@ typedef struct DeviceInfo_t{
 
 extern const DeviceContext_t NULL_DEVICE_CONTEXT;
 
+struct DeviceGroup_t;
+
+typedef struct GroupMember_t {
+    struct DeviceGroup_t *group;
+    uintptr_t *deviceContextPtr;
+    unsigned char report[EXTENDED_PACKET_SIZE];
+    uint64_t writeStartTimestamp;
+    uint64_t writeEndTimestamp;
+    int result;
+    Thread_t thread;
+    bool threadStarted;
+} GroupMember_t;
+
+typedef struct DeviceGroup_t {
+    GroupMember_t *members;
+    uint32_t numOfDevices;
+    uint8_t triggerMode;
+
+    /* Barrier mode: workers sleep on armCondition, then spin on releaseGeneration */
+    Mutex_t mutex;
+    Condition_t armCondition;
+    volatile uint32_t armGeneration;
+    volatile uint32_t releaseGeneration;
+    volatile uint32_t numOfReadyWorkers;
+    volatile uint32_t numOfPendingWorkers;
+    volatile uint32_t stopRequested;
+
+    uint64_t lastSkewNanoseconds;
+    uint64_t maxSkewNanoseconds;
+    uint32_t numOfTriggers;
+} DeviceGroup_t;
+
 int connectToDeviceBySerial(const char * const serialNumber,  uintptr_t* deviceContextPtr);
 
 int _verifyDeviceContextByPtr(const uintptr_t* const deviceContextPtr);
 
 int _reconnect(uintptr_t* deviceContextPtr);
+int _openHandle(DeviceContext_t *deviceContext);
 void _recursiveClearing(DeviceInfo_t * const devices);
 int _tryWrite(unsigned char* const report, uintptr_t* deviceContextPtr);
-int _tryRead(unsigned char * const report, unsigned char correctAnswer, uint16_t timeout, uintptr_t* deviceContextPtr);
+int _tryRead(unsigned char * const report, unsigned char correctAnswer, uint8_t latencyClass, uintptr_t* deviceContextPtr);
 int _writeOnlyFunction(unsigned char * const report, uintptr_t* deviceContextPtr);
-int _writeReadFunction(unsigned char* const report, uint8_t correctReply, uint16_t timeout, uintptr_t* deviceContextPtr);
+int _writeReadFunction(unsigned char* const report, uint8_t correctReply, uint8_t latencyClass, uintptr_t* deviceContextPtr);
+
+/* hid_read_timeout() with the timeout of the latency class, the time of every reply goes into its estimate */
+int _timedRead(DeviceContext_t *deviceContext, unsigned char *report, uint8_t latencyClass);
+uint32_t _getReadTimeout(const DeviceContext_t *deviceContext, uint8_t latencyClass);
+
+void _freeAveragingState(DeviceContext_t *deviceContext);
+
+/* Called with the mutex held; _shouldCacheFrame() before the read, _cacheFrame() with the memory generation seen then */
+bool _lookupCachedFrame(DeviceContext_t *deviceContext, uint16_t numOfFrame, uint16_t *framePixelsBuffer, struct FrameMetadata_t *metadata);
+bool _shouldCacheFrame(const DeviceContext_t *deviceContext, uint16_t numOfFrame);
+void _cacheFrame(DeviceContext_t *deviceContext, uint16_t numOfFrame, const uint16_t *framePixels, const struct FrameMetadata_t *metadata, uint32_t memoryGeneration);
+void _freeFrameCache(DeviceContext_t *deviceContext);
+
+/* Submits the frame to the processor attached to the device, if any; takes the mutex of the device */
+void _feedFrameProcessor(const uint16_t *framePixels, const struct FrameMetadata_t *metadata, uintptr_t *deviceContextPtr);
+
+/* Frame transfer steps shared by the blocking and the non-blocking reads, called with the mutex held.
+   After every FRAME_TRANSFER_REQUEST_ENDED, or a failed read with failure set, _endFrameRequest() requests the missing packets
+   or tells the frame is complete. */
+int _beginFrameTransfer(FrameTransfer_t *transfer, uint16_t *framePixelsBuffer, uint16_t numOfFrame, FrameRangeHook_t rangeHook, void *hookState, uintptr_t* deviceContextPtr);
+FrameTransferStep_t _handleFramePacket(FrameTransfer_t *transfer, DeviceContext_t *deviceContext, const uint8_t *report);
+int _endFrameRequest(FrameTransfer_t *transfer, uintptr_t* deviceContextPtr, bool *complete);
+void _finishFrameTransfer(FrameTransfer_t *transfer, DeviceContext_t *deviceContext, struct FrameMetadata_t *metadata);
+void _flushReports(DeviceContext_t *deviceContext);
+
+/* Status replies are kept to answer getStatus() calls, see setStatusCacheTime(). _getStatus() with fromCache
+   false only takes a reply to a request written after the call, for the functions waiting on the device.
+   _invalidateDeviceState() is called before every request that may change the status or the frame memory, and
+   before frame reads; unless it is a frame read, it also bumps the memory generation. */
+int _getStatus(uint8_t *statusFlags, uint16_t *framesInMemory, bool fromCache, uintptr_t* deviceContextPtr);
+void _storeStatus(DeviceContext_t *deviceContext, uint8_t statusFlags, uint16_t framesInMemory, uint64_t requestTimestamp);
+void _invalidateDeviceState(DeviceContext_t *deviceContext, bool frameRead);
+void _closePollFd(DeviceContext_t *deviceContext);
+
+/* Called by the frame decoder for every finished range of elements, in order, after the dark correction */
+int _getFrameWithHook(uint16_t *framePixelsBuffer, uint16_t numOfFrame, struct FrameMetadata_t *metadata, FrameRangeHook_t rangeHook, void *hookState, uintptr_t* deviceContextPtr);
+
+void _selectFrameLayout(FrameLayout_t *frameLayout, uint16_t numOfPixelsInFrame, uint16_t numOfStartElement, uint8_t reductionMode);
+void _decodeFullPacket(uint16_t *pixels, const uint8_t *payload);
+
+uint16_t _estimateDarkLevel(const uint16_t *framePixels);
+void _subtractDarkLevel(uint16_t *pixels, uint32_t numOfPixels, uint16_t darkLevel, uint16_t pedestal);
+void _correctDarkLevelRange(uint16_t *framePixels, uint16_t numOfPixelsInFrame, uint32_t firstPixel, uint32_t endPixel, uint16_t darkLevel, uint16_t pedestal);
+
+void _measureFrameRange(const uint16_t *framePixels, uint16_t numOfPixelsInFrame, uint32_t firstPixel, uint32_t endPixel,
+                        uint16_t *maxPixel, uint16_t *numOfSaturatedPixels);
+
+uint64_t _getMonotonicNanoseconds(void);
+void _sleepMicroseconds(uint32_t microseconds);
+
+int _threadCreate(Thread_t *thread, ThreadFunction_t function, void *argument);
+void _threadJoin(Thread_t thread);
+void _threadPin(Thread_t thread, uint32_t cpuIndex);
+uint32_t _getNumOfProcessors(void);
+
+void _mutexInit(Mutex_t *mutex);
+void _mutexDestroy(Mutex_t *mutex);
+void _mutexLock(Mutex_t *mutex);
+void _mutexUnlock(Mutex_t *mutex);
+
+void _conditionInit(Condition_t *condition);
+void _conditionDestroy(Condition_t *condition);
+void _conditionWait(Condition_t *condition, Mutex_t *mutex);
+bool _conditionTimedWait(Condition_t *condition, Mutex_t *mutex, uint32_t timeoutMilliseconds);
+void _conditionBroadcast(Condition_t *condition);
+
+/* Waits between processes on a word of shared memory, polls where the platform has no such primitive */
+bool _sharedWait(volatile uint32_t *address, uint32_t value, uint32_t timeoutMilliseconds);
+void _sharedWake(volatile uint32_t *address);
 
 #endif
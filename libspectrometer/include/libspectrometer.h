@@ -47,6 +47,187 @@ typedef struct DeviceInfo_t{
 } DeviceInfo_t;
 #endif
 
+#ifndef FRAME_METADATA
+#define FRAME_METADATA
+typedef struct FrameMetadata_t {
+      uint64_t triggerTimestamp;        //host time of the last software trigger, 0 if none was issued
+      uint64_t requestTimestamp;        //host time the frame request was written
+      uint64_t firstPacketTimestamp;    //host time the first packet of the frame arrived
+      uint64_t lastPacketTimestamp;     //host time the last packet of the frame arrived
+      uint32_t sequenceNumber;          //per context counter of frames read, starts at 1
+      uint32_t timeOfExposure;
+      uint16_t frameIndex;              //numOfFrame the frame was read from
+      uint16_t numOfPixelsInFrame;
+      uint16_t numOfScans;
+      uint16_t numOfBlankScans;
+      uint8_t scanMode;
+      uint8_t acquisitionParametersKnown;
+      uint16_t darkLevel;               //trimmed mean of the light shielded leading elements, 0 for frames of a narrower range
+      uint16_t maxPixel;                //highest image element as read, before the dark correction
+      uint16_t numOfSaturatedPixels;    //image elements at full scale
+} FrameMetadata_t;
+#endif
+
+#ifndef DRAIN_STATISTICS
+#define DRAIN_STATISTICS
+typedef struct DrainStatistics_t {
+      uint64_t framesDrained;           //frames moved from the device memory to the host buffer
+      uint64_t framesConsumed;          //frames returned by popDrainedFrame()
+      uint64_t framesDroppedOldest;     //host buffer frames overwritten by newer ones
+      uint64_t framesDroppedNewest;     //device frames skipped because the host buffer was full
+      uint64_t framesLostOnRearm;       //estimated frames acquired between the last drain and the memory clear
+      uint64_t memoryOverflows;         //times the device memory was seen full
+      uint64_t rearms;                  //clearMemory() + triggerAcquisition() cycles
+      uint32_t memoryDepth;             //frames the device memory holds with the current frame format
+      uint32_t hostBufferFill;
+      uint32_t deviceMemoryFill;
+} DrainStatistics_t;
+#endif
+
+#ifndef AVERAGED_FRAME_INFO
+#define AVERAGED_FRAME_INFO
+typedef struct AveragedFrameInfo_t {
+      uint64_t readyTimestamp;          //host time the result was seen ready
+      uint64_t latencyNanoseconds;      //from the previous result (or the last trigger) to readyTimestamp
+      uint64_t waitNanoseconds;         //time spent waiting inside getAveragedFrame()
+      uint32_t numOfPolls;              //status requests issued while waiting
+      uint32_t estimatedLostResults;    //averaged spectra overwritten before this one, 0 unless lost is set
+      uint32_t estimatedLostScans;      //estimatedLostResults * numOfScans
+      uint8_t lost;                     //the device reported at least one lost spectrum
+} AveragedFrameInfo_t;
+
+typedef struct AveragingStatistics_t {
+      uint64_t results;
+      uint64_t resultsWithLoss;
+      uint64_t estimatedLostResults;
+      uint64_t estimatedLostScans;
+      uint64_t numOfPolls;
+      uint64_t timeouts;
+      uint64_t minLatencyNanoseconds;
+      uint64_t maxLatencyNanoseconds;
+      uint64_t totalLatencyNanoseconds; //mean latency = totalLatencyNanoseconds / results
+      uint64_t periodNanoseconds;       //measured time between consecutive results, 0 until known
+} AveragingStatistics_t;
+#endif
+
+#ifndef PEAK
+#define PEAK
+typedef struct Peak_t {
+      float position;                   //sub-element position in the frame as read from the device
+      float height;                     //interpolated maximum
+      float width;                      //full width at half maximum in elements
+      uint32_t trackId;                 //same for the same peak in consecutive frames, 0 without tracking
+} Peak_t;
+#endif
+
+#ifndef AUTO_EXPOSURE_RESULT
+#define AUTO_EXPOSURE_RESULT
+typedef struct AutoExposureResult_t {
+      uint32_t timeOfExposure;          //exposure left set, multiple of 10 us
+      uint16_t maxPixel;                //highest image element of the frame taken with it
+      uint16_t numOfSaturatedPixels;
+      uint8_t numOfSteps;               //trial frames taken
+      uint8_t converged;                //1 if the maximum ended within the tolerance of the target
+} AutoExposureResult_t;
+#endif
+
+#ifndef FRAME_TRANSFER_STATISTICS
+#define FRAME_TRANSFER_STATISTICS
+typedef struct FrameTransferStatistics_t {
+      uint64_t framesRecovered;         //frames completed after requesting missing packets again
+      uint64_t framesFailed;            //frames given up after the last request
+      uint64_t packetsRetransmitted;    //packets requested again
+      uint64_t packetsDiscarded;        //stale, duplicate or inconsistent reports dropped
+} FrameTransferStatistics_t;
+#endif
+
+#ifndef FRAME_CACHE_STATISTICS
+#define FRAME_CACHE_STATISTICS
+typedef struct FrameCacheStatistics_t {
+      uint64_t hits;                    //frame reads answered from the cache
+      uint64_t misses;                  //frame reads that went to the device with the cache enabled
+      uint64_t evictions;               //least recently read frames dropped to stay within the size
+      uint32_t numOfFrames;             //frames held, including ones of an older memory generation not dropped yet
+      uint32_t numOfBytes;
+} FrameCacheStatistics_t;
+#endif
+
+#ifndef FRAME_POOL_STATISTICS
+#define FRAME_POOL_STATISTICS
+typedef struct FramePoolStatistics_t {
+      uint32_t numOfBuffers;
+      uint32_t numOfPixelsInBuffer;
+      uint32_t numOfBuffersInUse;       //buffers acquired and not released yet
+      uint32_t peakBuffersInUse;
+      uint64_t numOfAcquisitions;
+      uint64_t numOfExhaustions;        //acquisitions that found no free buffer
+} FramePoolStatistics_t;
+#endif
+
+#ifndef FRAME_PROCESSOR_STATISTICS
+#define FRAME_PROCESSOR_STATISTICS
+typedef struct FrameProcessorStatistics_t {
+      uint32_t numOfThreads;
+      uint32_t queueCapacity;           //frames the processor holds at most
+      uint32_t queueDepth;              //frames submitted and not through all their kernels yet
+      uint32_t peakQueueDepth;
+      uint32_t maxThreadQueueDepth;     //tasks waiting in the fullest queue of a thread
+      uint64_t framesSubmitted;
+      uint64_t framesProcessed;
+      uint64_t framesDropped;           //submitted while the processor was full
+      uint64_t tasksStolen;             //tasks a thread took from the queue of another one
+} FrameProcessorStatistics_t;
+#endif
+
+#ifndef FRAME_KERNEL
+#define FRAME_KERNEL
+/* Called on a thread of a frame processor for every frame, see addFrameKernel() */
+typedef void (*FrameKernel_t)(void *kernelState, uint16_t *framePixels, const FrameMetadata_t *metadata, uintptr_t *deviceContextPtr);
+#endif
+
+#ifndef REPLY_LATENCY
+#define REPLY_LATENCY
+typedef struct ReplyLatency_t {
+      uint32_t numOfSamples;            //replies in the estimate, restarts from 0 after a timeout
+      uint32_t numOfTimeouts;
+      float meanMicroseconds;
+      float deviationMicroseconds;
+      uint32_t timeoutMilliseconds;     //timeout the next read of the class would use
+} ReplyLatency_t;
+#endif
+
+#ifndef CAPTURE_FILE
+#define CAPTURE_FILE
+#define CAPTURE_MAX_CALIBRATION_SIZE 4000
+
+/* The file starts with this header (padded to headerSize bytes), followed by maxNumOfRecords records of recordSize bytes.
+   All fields are little-endian. */
+typedef struct CaptureFileHeader_t {
+      char magic[8];                    //"ASQCAPT"
+      uint32_t version;
+      uint32_t headerSize;              //offset of the first record
+      uint32_t recordSize;              //distance between two records
+      uint32_t pixelsOffset;            //offset of the pixels inside a record
+      uint32_t maxNumOfRecords;
+      uint32_t numOfRecords;            //records reserved so far, CaptureRecord_t.state tells which are complete
+      uint16_t numOfPixelsInFrame;
+      uint16_t numOfStartElement;
+      uint16_t numOfEndElement;
+      uint8_t reductionMode;
+      uint8_t reserved;
+      char serialNumber[32];            //device the file was created for
+      uint32_t calibrationSize;
+      uint64_t creationTimestamp;       //getHostTimestamp() at creation, the clock of the frame metadata
+      int64_t creationUnixTime;         //wall clock at creation, seconds
+      uint8_t calibration[CAPTURE_MAX_CALIBRATION_SIZE]; //opaque to the library, e.g. the calibration block from the flash
+} CaptureFileHeader_t;
+
+typedef struct CaptureRecord_t {
+      FrameMetadata_t metadata;
+      uint32_t sourceId;                //chosen by the writer, e.g. the index of the device in a multi-device capture
+      uint32_t state;                   //0 - being written, 1 - complete, 2 - the capture failed and the pixels are not valid
+} CaptureRecord_t;
+#endif
 
 /** \brief Free a device handle 
     
@@ -378,6 +559,12 @@ LIBSHARED_AND_STATIC_EXPORT int setOpticalTrigger(uint8_t enableMode, uint16_t p
 LIBSHARED_AND_STATIC_EXPORT int triggerAcquisition(uintptr_t *deviceContextPtr);
 
 /** \brief Gets the device status.
+    \details
+    Calls made while another thread waits for the status share its reply. A reply younger than the time set by
+    setStatusCacheTime() is returned without asking the device; every command but this one, triggers included,
+    and every frame read drop it. A frame read keeps the number of frames in memory, except in frame averaging mode,
+    so calls with statusFlags NULL can still be answered from it.
+
     \param[out] statusFlags - provide an initialized pointer or NULL to skip this parameter
     \parblock
     statusFlags & 1 - operation in progress
@@ -409,6 +596,63 @@ LIBSHARED_AND_STATIC_EXPORT int triggerAcquisition(uintptr_t *deviceContextPtr);
 */
 LIBSHARED_AND_STATIC_EXPORT int getStatus(uint8_t *statusFlags, uint16_t *framesInMemory,  uintptr_t *deviceContextPtr);
 
+/** \brief Sets how long a status reply is returned by getStatus() without asking the device again
+    \details
+    0 by default: only calls waiting on each other share a reply. Frames that come in memory without a trigger through
+    this library, with the external or optical trigger or in continuous mode, may be seen that much later.
+    The functions of this library waiting on the device (drain engine, auto exposure, frame averaging) always ask it.
+
+    \param[in] timeToLiveMilliseconds - age of the reply up to which it is returned
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int setStatusCacheTime(uint32_t timeToLiveMilliseconds, uintptr_t *deviceContextPtr);
+
+/** \brief Keeps frames read from the memory of the device to answer later reads of the same frames
+    \details
+    getFrame() and getFrameWithMetadata() copy a kept frame instead of asking the device. Frames are kept until
+    any command but getStatus() is sent, triggers, clearMemory(), setFrameFormat() and resets included, or until
+    they are the least recently read ones when the cache is full. Only frames counted in memory by the last status
+    reply are kept; the averaged frame of frame averaging mode never is. A kept frame is returned with the
+    metadata of the read that got it from the device.
+
+    \param[in] maxNumOfBytes - size of the cache, about 7.5 kB per frame of 3694 elements; 0 (the default) disables it and frees the frames
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int setFrameCacheSize(uint32_t maxNumOfBytes, uintptr_t *deviceContextPtr);
+
+/** \brief Gets the counters of the frame cache, see setFrameCacheSize()
+    \param[out] statistics - provide a pointer to a FrameCacheStatistics_t structure
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getFrameCacheStatistics(FrameCacheStatistics_t *statistics, uintptr_t *deviceContextPtr);
+
 /** \brief Returns the same values as set by setAcquisitionParameters
     \param[out] numOfScans - provide an initialized pointer or NULL to skip this parameter fetch
     \param[out] numOfBlankScans - provide an initialized pointer or NULL to skip this parameter fetch
@@ -468,6 +712,51 @@ LIBSHARED_AND_STATIC_EXPORT int getFrameFormat(uint16_t *numOfStartElement, uint
 */
 LIBSHARED_AND_STATIC_EXPORT int getFrame(uint16_t  *framePixelsBuffer, uint16_t numOfFrame, uintptr_t *deviceContextPtr);
 
+/** \brief Gets frame together with its acquisition metadata
+    Same as getFrame(), additionally describing the frame.
+    \param[out] framePixelsBuffer - provide an initialized pointer to the buffer of unsigned short elements.
+    \param[in] numOfFrame - see getFrame()
+    \param[out] metadata
+    \parblock
+    Provide a pointer to a FrameMetadata_t structure or NULL to skip this parameter.
+    All timestamps are host monotonic times in nanoseconds (see getHostTimestamp()), taken inside the library right at the USB transfers.
+    The exposure and scans settings are the ones last set or read back through this context; acquisitionParametersKnown is 0 if none were.
+    sequenceNumber is incremented on every frame read through the context, including getFrame() calls, so skipped frames leave gaps.
+    \endparblock
+
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getFrameWithMetadata(uint16_t *framePixelsBuffer, uint16_t numOfFrame, FrameMetadata_t *metadata, uintptr_t *deviceContextPtr);
+
+/** \brief Gets the counters of the frame transfers recovered from lost or corrupted packets
+    \details
+    A frame read does not fail on the first missing, stale or inconsistent packet. The reports left in the queue are dropped and
+    the first run of missing packets is requested again from its pixel offset, up to 8 times per frame. The packets are
+    corrected and passed on in order as soon as all packets before them arrived.
+
+    \param[out] statistics - provide a pointer to a FrameTransferStatistics_t structure
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getFrameTransferStatistics(FrameTransferStatistics_t *statistics, uintptr_t *deviceContextPtr);
+
 /** \brief Clears memory
 
     \param[in] deviceContextPtr
@@ -589,35 +878,1425 @@ This function returns 0 on success and error code in case of error.
 */
 LIBSHARED_AND_STATIC_EXPORT int detachDevice(uintptr_t *deviceContextPtr);
 
-/**   \ingroup API */
-#ifndef SPECTROMETER_ERROR_CODES
-#define SPECTROMETER_ERROR_CODES
-    /** \ingroup API */
-    #define OK 0
-    /** \ingroup API */
-    #define CONNECT_ERROR_WRONG_ID 500
-    /** \ingroup API */
-    #define CONNECT_ERROR_NOT_FOUND 501
-    /** \ingroup API */
-    #define CONNECT_ERROR_FAILED 502
-    /** \ingroup API */
-    #define DEVICE_NOT_INITIALIZED 503
-    /** \ingroup API */
-    #define WRITING_PROCESS_FAILED 504
-    /** \ingroup API */
-    #define READING_PROCESS_FAILED 505
-    /** \ingroup API */
-    #define WRONG_ANSWER 506
-    /** \ingroup API */
-    #define GET_FRAME_REMAINING_PACKETS_ERROR 507
-    /** \ingroup API */
-    #define NUM_OF_PACKETS_IN_FRAME_ERROR 508
-    /** \ingroup API */
-    #define INPUT_PARAMETER_NOT_INITIALIZED 509
-    /** \ingroup API */
-    #define READ_FLASH_REMAINING_PACKETS_ERROR 510
-    /** \ingroup API */
-    #define CONNECT_ERROR_WRONG_SERIAL_NUMBER 516
+/** \brief Returns the host monotonic clock in nanoseconds
+    All the timestamps reported by the library are taken from this clock, so they can be compared with each other and with the values returned here.
+
+    \ingroup API
+
+    \returns The current value of the host monotonic clock (nanoseconds, arbitrary origin)
+*/
+LIBSHARED_AND_STATIC_EXPORT uint64_t getHostTimestamp();
+
+/** \brief Creates a group of devices that can be triggered together with a minimal skew
+    The software trigger reports for all the members are built once here, so triggerDeviceGroup() only has to write them.
+
+    \param[in] deviceContextPtrs
+    \parblock
+    Array of numOfDevices pointers to uintptr_t variables previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex().
+    The variables must stay valid until the group is destroyed.
+    \endparblock
+    \param[in] numOfDevices - number of elements in deviceContextPtrs
+    \param[in] triggerMode
+    \parblock
+    0 - sequential mode
+
+    The reports are written back-to-back from the thread calling triggerDeviceGroup().
+
+    1 - barrier mode
+
+    Every member gets a worker thread pinned to its own CPU. The workers are armed by triggerDeviceGroup(), spin on a shared barrier and write their reports at the same time when released.
+    \endparblock
+    \param[out] deviceGroupPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable set to 0.
+    If the variable already contains a group, the old group is destroyed.
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int createDeviceGroup(uintptr_t **deviceContextPtrs, uint32_t numOfDevices, uint8_t triggerMode, uintptr_t *deviceGroupPtr);
+
+/** \brief Frees a device group created by createDeviceGroup()
+    The device contexts of the members are left connected.
+
+    \param[in] deviceGroupPtr - address of the uintptr_t variable containing the group, it is set to 0
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int destroyDeviceGroup(uintptr_t *deviceGroupPtr);
+
+/** \brief Starts acquisition by software on all the members of the group
+    \param[out] writeStartTimestamps - array of numOfDevices elements or NULL, receives the getHostTimestamp() value taken right before each report was written
+    \param[out] writeEndTimestamps - array of numOfDevices elements or NULL, receives the getHostTimestamp() value taken right after each write returned
+    \param[in] deviceGroupPtr - address of the uintptr_t variable containing the group
+
+    \note The trigger skew of a call is bounded by max(writeEndTimestamps) - min(writeStartTimestamps)
+    \note The devices are locked in the order of the group for the whole call; groups sharing devices must list them in the same order
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and the first error code of the members in case of error. Members are triggered even if an earlier one failed.
+        INVALID_STATE_ERROR and no member triggered if an asynchronous operation is pending on any of them.
+*/
+LIBSHARED_AND_STATIC_EXPORT int triggerDeviceGroup(uint64_t *writeStartTimestamps, uint64_t *writeEndTimestamps, uintptr_t *deviceGroupPtr);
+
+/** \brief Returns the trigger skew statistics of a group
+    The skew of a trigger is the spread of the write start timestamps of its members.
+
+    \param[out] lastSkewNanoseconds - skew of the last triggerDeviceGroup() call or NULL
+    \param[out] maxSkewNanoseconds - largest skew since the group was created or NULL
+    \param[out] numOfTriggers - number of triggerDeviceGroup() calls or NULL
+    \param[in] deviceGroupPtr - address of the uintptr_t variable containing the group
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getDeviceGroupSkew(uint64_t *lastSkewNanoseconds, uint64_t *maxSkewNanoseconds, uint32_t *numOfTriggers, uintptr_t *deviceGroupPtr);
+
+/** \brief Starts the drain-and-rearm engine of a device
+    The engine clears the memory and triggers the acquisition, then keeps moving frames from the device memory to a host buffer while they are acquired.
+    The memory depth is derived from the frame size and corrected when the device reports a full memory.
+    Before the memory can fill up, the remaining frames are drained and the acquisition is rearmed by clearMemory() + triggerAcquisition().
+    The drain watermark follows the measured frame rate and rearm latency, so in continuous mode the memory does not overflow.
+    Frames are only dropped by the back-pressure policy when the host buffer is full, and every drop is counted (see getDrainStatistics()).
+
+    \note Use numOfScans equal to or greater than the memory depth so that the watermark, not the end of the acquisition, triggers the rearm.
+    Not applicable in frame averaging mode (scanMode = 3).
+
+    \param[in] hostBufferFrames - capacity of the host buffer in frames
+    \param[in] backPressurePolicy
+    \parblock
+    What happens to a new frame when the host buffer is full:
+    0 - the oldest buffered frame is dropped
+    1 - the new frame is dropped
+    2 - the frame stays in the device memory, which can overflow (counted in memoryOverflows)
+    \endparblock
+    \param[in] runInBackground
+    \parblock
+    1 - a library thread runs the engine
+    0 - the engine runs inside popDrainedFrame() and stepDrainEngine()
+    \endparblock
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int startDrainEngine(uint32_t hostBufferFrames, uint8_t backPressurePolicy, uint8_t runInBackground, uintptr_t *deviceContextPtr);
+
+/** \brief Stops the drain-and-rearm engine and frees its host buffer
+    The acquisition itself is not stopped. disconnectDeviceContext() stops the engine too.
+    Callers blocked in popDrainedFrame() return INVALID_STATE_ERROR; the host buffer is freed once they are out.
+
+    \param[in] deviceContextPtr - device context the engine was started on
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int stopDrainEngine(uintptr_t *deviceContextPtr);
+
+/** \brief Runs one iteration of an engine started with runInBackground = 0
+    One status request, then draining and rearming as needed.
+
+    \param[in] deviceContextPtr - device context the engine was started on
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int stepDrainEngine(uintptr_t *deviceContextPtr);
+
+/** \brief Takes the oldest frame from the host buffer of the engine
+    \param[out] framePixelsBuffer - provide an initialized pointer to a buffer of at least numOfPixelsInFrame unsigned short elements.
+    \param[out] metadata - provide a pointer to a FrameMetadata_t structure or NULL to skip this parameter
+    \param[in] timeoutMilliseconds - how long to wait for a frame, 0 returns immediately
+    \param[in] deviceContextPtr - device context the engine was started on
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, TIMEOUT_ERROR if no frame was available in time and error code in case of error.
+        An error met by the background thread is returned once by the next call, INVALID_STATE_ERROR once the engine is stopping.
+*/
+LIBSHARED_AND_STATIC_EXPORT int popDrainedFrame(uint16_t *framePixelsBuffer, FrameMetadata_t *metadata, uint32_t timeoutMilliseconds, uintptr_t *deviceContextPtr);
+
+/** \brief Returns the counters of the drain-and-rearm engine
+    \param[out] statistics - provide a pointer to a DrainStatistics_t structure
+    \param[in] deviceContextPtr - device context the engine was started on
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getDrainStatistics(DrainStatistics_t *statistics, uintptr_t *deviceContextPtr);
+
+/** \brief Waits for the next averaged spectrum and reads it (frame averaging mode only)
+    The device is not polled before the averaging period (numOfScans * timeOfExposure, then the measured period) is over;
+    after that the status is polled about 20 times per period.
+    Results seen with framesInMemory = 2 are reported as lost, the number of overwritten results is estimated from the elapsed time.
+
+    \param[out] framePixelsBuffer - provide an initialized pointer to the buffer of unsigned short elements.
+    \param[out] info - provide a pointer to an AveragedFrameInfo_t structure or NULL to skip this parameter
+    \param[in] timeoutMilliseconds - how long to wait for the result
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, TIMEOUT_ERROR if no result was ready in time, INVALID_STATE_ERROR if the device is not in frame averaging mode and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getAveragedFrame(uint16_t *framePixelsBuffer, AveragedFrameInfo_t *info, uint32_t timeoutMilliseconds, uintptr_t *deviceContextPtr);
+
+/** \brief Returns the cumulative loss and latency statistics of getAveragedFrame()
+    \param[out] statistics - provide a pointer to an AveragingStatistics_t structure
+    \param[in] deviceContextPtr - see getAveragedFrame()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getAveragingStatistics(AveragingStatistics_t *statistics, uintptr_t *deviceContextPtr);
+
+/** \brief Resets the statistics returned by getAveragingStatistics(), the measured averaging period is kept
+    \param[in] deviceContextPtr - see getAveragedFrame()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int resetAveragingStatistics(uintptr_t *deviceContextPtr);
+
+/** \brief Creates a capture file for the frames of a device
+    The file is preallocated for maxNumOfRecords records of fixed size and mapped into memory, so appending a frame is a copy into the page cache
+    without a system call or a file system allocation. The frame format of the device and the calibration block are stored in the header (see CaptureFileHeader_t).
+    Several devices with the same frame format can write into one file from their own threads, records are reserved without a lock.
+    closeCaptureFile() truncates the file to the records written.
+
+    \param[in] path - path of the file, an existing file is overwritten
+    \param[in] maxNumOfRecords - capacity of the file in frames
+    \param[in] calibration - calibration data to store in the header or NULL
+    \param[in] calibrationSize - size of the calibration data in bytes, at most CAPTURE_MAX_CALIBRATION_SIZE
+    \param[out] captureFilePtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable set to 0.
+    If the variable already contains a capture file, the old file is closed.
+    \endparblock
+    \param[in] deviceContextPtr - device context whose frame format and serial number describe the file
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, FILE_ERROR if the file could not be created or mapped and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int createCaptureFile(const char *path, uint32_t maxNumOfRecords, const uint8_t *calibration, uint32_t calibrationSize, uintptr_t *captureFilePtr, uintptr_t *deviceContextPtr);
+
+/** \brief Opens a capture file for reading
+    The file is mapped read-only, getCaptureFileHeader() and getCaptureRecord() return pointers into the mapping without copying.
+    A file that is still being written can be read, records become visible when they are reserved and are complete once their state is 1.
+
+    \param[in] path - path of the file
+    \param[out] captureFilePtr - see createCaptureFile()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, FILE_ERROR if the file could not be opened or is not a capture file and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int openCaptureFile(const char *path, uintptr_t *captureFilePtr);
+
+/** \brief Closes a capture file opened by createCaptureFile() or openCaptureFile()
+    A written file is flushed to the disk and truncated to the records written. No capture may be in progress on the file.
+
+    \param[in] captureFilePtr - address of the uintptr_t variable containing the capture file, it is set to 0
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and FILE_ERROR if the file could not be flushed or truncated.
+*/
+LIBSHARED_AND_STATIC_EXPORT int closeCaptureFile(uintptr_t *captureFilePtr);
+
+/** \brief Starts writing the captured records back to the disk without waiting for it
+
+    \param[in] captureFilePtr - address of the uintptr_t variable containing the capture file
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int syncCaptureFile(uintptr_t *captureFilePtr);
+
+/** \brief Reads a frame from the device memory straight into the next record of a capture file
+    The pixels are decoded into the mapped record, the frame metadata is stored next to them (see getFrameWithMetadata()).
+    A record whose frame could not be read is kept with state 2.
+
+    \param[in] numOfFrame - see getFrame()
+    \param[in] sourceId - stored in the record, e.g. the index of the device
+    \param[in] captureFilePtr - capture file created by createCaptureFile()
+    \param[in] deviceContextPtr - device context, its frame format must match the file
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, CAPTURE_FILE_FULL_ERROR if every record is used, INVALID_STATE_ERROR if the frame format changed and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int captureFrame(uint16_t numOfFrame, uint32_t sourceId, uintptr_t *captureFilePtr, uintptr_t *deviceContextPtr);
+
+/** \brief Takes a frame from the drain-and-rearm engine straight into the next record of a capture file
+    Together with startDrainEngine() the device memory never overflows while the frames are logged.
+
+    \param[in] timeoutMilliseconds - see popDrainedFrame(), on a timeout the record is given back unless another writer reserved one after it
+    \param[in] sourceId - stored in the record, e.g. the index of the device
+    \param[in] captureFilePtr - capture file created by createCaptureFile()
+    \param[in] deviceContextPtr - device context the engine was started on, its frame format must match the file
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, TIMEOUT_ERROR if no frame was available in time, CAPTURE_FILE_FULL_ERROR if every record is used and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int captureDrainedFrame(uint32_t timeoutMilliseconds, uint32_t sourceId, uintptr_t *captureFilePtr, uintptr_t *deviceContextPtr);
+
+/** \brief Appends a frame already in host memory to a capture file
+
+    \param[in] framePixelsBuffer - numOfPixelsInFrame pixels as returned by getFrame()
+    \param[in] metadata - metadata of the frame or NULL to store zeros
+    \param[in] sourceId - stored in the record, e.g. the index of the device
+    \param[in] captureFilePtr - capture file created by createCaptureFile()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, CAPTURE_FILE_FULL_ERROR if every record is used and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int appendCaptureFrame(const uint16_t *framePixelsBuffer, const FrameMetadata_t *metadata, uint32_t sourceId, uintptr_t *captureFilePtr);
+
+/** \brief Returns a pointer to the header of a capture file
+    \param[out] header - receives a pointer into the mapping, valid until the file is closed
+    \param[in] captureFilePtr - capture file opened by createCaptureFile() or openCaptureFile()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getCaptureFileHeader(const CaptureFileHeader_t **header, uintptr_t *captureFilePtr);
+
+/** \brief Returns pointers to a record of a capture file and its pixels without copying them
+    \param[in] index - index of the record, less than numOfRecords of the header
+    \param[out] record - receives a pointer to the record or NULL to skip this parameter
+    \param[out] framePixels - receives a pointer to the numOfPixelsInFrame pixels of the record or NULL to skip this parameter
+    \param[in] captureFilePtr - capture file opened by createCaptureFile() or openCaptureFile()
+
+    \note The pointers are valid until the file is closed. Check the state of the record before using the pixels.
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, INVALID_PARAMETER_ERROR if the record does not exist and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getCaptureRecord(uint32_t index, const CaptureRecord_t **record, const uint16_t **framePixels, uintptr_t *captureFilePtr);
+
+/** \brief Returns the largest size compressFrame() can produce for a frame
+    \param[in] numOfPixelsInFrame - number of pixels in the frame
+
+    \ingroup API
+
+    \returns The size in bytes the buffer passed to compressFrame() must have.
+*/
+LIBSHARED_AND_STATIC_EXPORT uint32_t getCompressedFrameBound(uint16_t numOfPixelsInFrame);
+
+/** \brief Compresses a frame without loss
+    The frame is cut into blocks of 128 pixels. Every block is predicted from the previous pixel or, when referenceFrame is given, from the same pixels of the reference frame,
+    whichever leaves smaller residuals. The residuals are zigzag coded and bit-packed with the bit width of the block, using SSE2 where available.
+    Noise-limited spectra typically shrink to 20-30 % of their size.
+
+    \param[in] framePixels - numOfPixelsInFrame pixels as returned by getFrame()
+    \param[in] numOfPixelsInFrame - number of pixels in the frame
+    \param[in] referenceFrame - the previous frame of the same device for inter-frame prediction or NULL, decompressFrame() needs the same frame
+    \param[out] compressed - provide a buffer of at least getCompressedFrameBound() bytes
+    \param[in] compressedCapacity - size of the compressed buffer in bytes
+    \param[out] compressedSize - receives the size of the compressed frame in bytes
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int compressFrame(const uint16_t *framePixels, uint16_t numOfPixelsInFrame, const uint16_t *referenceFrame, uint8_t *compressed, uint32_t compressedCapacity, uint32_t *compressedSize);
+
+/** \brief Restores a frame compressed by compressFrame()
+    \param[in] compressed - the compressed frame
+    \param[in] compressedSize - size of the compressed frame in bytes
+    \param[in] referenceFrame - the reference frame given to compressFrame() or NULL if none was given
+    \param[out] framePixels - provide a buffer of numOfPixelsInFrame unsigned short elements
+    \param[in] numOfPixelsInFrame - number of pixels in the frame, must match the compressed frame
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, COMPRESSED_DATA_ERROR if the data is damaged and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int decompressFrame(const uint8_t *compressed, uint32_t compressedSize, const uint16_t *referenceFrame, uint16_t *framePixels, uint16_t numOfPixelsInFrame);
+
+/** \brief Compresses a capture file for storage
+    The complete records are compressed with compressFrame(), each with the previous complete record as reference when both come from the same source.
+    The compressed file is read sequentially by decompressCaptureFile(), it cannot be mapped by openCaptureFile().
+
+    \param[in] sourcePath - capture file written by createCaptureFile()
+    \param[in] destinationPath - path of the compressed file, an existing file is overwritten
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, FILE_ERROR if a file could not be read or written and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int compressCaptureFile(const char *sourcePath, const char *destinationPath);
+
+/** \brief Restores a capture file compressed by compressCaptureFile()
+    \param[in] sourcePath - compressed file
+    \param[in] destinationPath - path of the restored capture file, an existing file is overwritten
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, COMPRESSED_DATA_ERROR if the compressed file is damaged (the records before the damage are kept) and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int decompressCaptureFile(const char *sourcePath, const char *destinationPath);
+
+/** \brief Creates a shared memory ring that publishes frames to other processes
+    The ring lives in POSIX shared memory (a named file mapping on Windows) and has one publisher, the process that owns the device.
+    Any number of processes can attach to it with attachFrameRing() and read the frames in place, without copies or locks:
+    every slot carries sequence counters that tell a reader whether the publisher overwrote the frame while it was being read.
+    A ring with the same name left behind by another publisher is replaced.
+
+    \param[in] name - name of the ring, e.g. "spectrometer-ASQ_SPC0000001"
+    \param[in] numOfSlots - number of frames kept for slow readers, rounded up to a power of two. Every slot takes a frame of any format.
+    \param[out] frameRingPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable set to 0.
+    If the variable already contains a ring, the old ring is closed.
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, FILE_ERROR if the shared memory could not be created and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int createFrameRing(const char *name, uint32_t numOfSlots, uintptr_t *frameRingPtr);
+
+/** \brief Attaches to a ring created by createFrameRing() in another process
+    The ring is mapped read-only. The first frame read is the first one published after attaching.
+
+    \param[in] name - name given to createFrameRing()
+    \param[out] frameRingPtr - see createFrameRing()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, FILE_ERROR if there is no such ring and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int attachFrameRing(const char *name, uintptr_t *frameRingPtr);
+
+/** \brief Closes a ring created by createFrameRing() or attached by attachFrameRing()
+    When the publisher closes the ring, its name is removed and the waiting readers return INVALID_STATE_ERROR.
+    Attached readers can still read the frames left in the ring.
+
+    \param[in] frameRingPtr - address of the uintptr_t variable containing the ring, it is set to 0
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int closeFrameRing(uintptr_t *frameRingPtr);
+
+/** \brief Publishes a frame already in host memory
+    \param[in] framePixels - metadata->numOfPixelsInFrame pixels as returned by getFrame()
+    \param[in] metadata - metadata of the frame, numOfPixelsInFrame must be set
+    \param[in] frameRingPtr - ring created by createFrameRing()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int publishFrame(const uint16_t *framePixels, const FrameMetadata_t *metadata, uintptr_t *frameRingPtr);
+
+/** \brief Reads a frame from the device memory straight into the next slot of a ring and publishes it
+    \param[in] numOfFrame - see getFrame()
+    \param[in] frameRingPtr - ring created by createFrameRing()
+    \param[in] deviceContextPtr - device context to read the frame from
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error. Nothing is published if the frame could not be read.
+*/
+LIBSHARED_AND_STATIC_EXPORT int publishDeviceFrame(uint16_t numOfFrame, uintptr_t *frameRingPtr, uintptr_t *deviceContextPtr);
+
+/** \brief Waits for the next frame of a ring and returns pointers into the shared slot
+    The frame stays valid until the publisher laps the reader. Call releaseRingFrame() when done to learn whether that happened;
+    the next acquireRingFrame() releases the frame without checking.
+    A reader that fell behind by more than the ring size skips to the oldest frame still in the ring.
+
+    \param[out] framePixels - receives a pointer to the metadata->numOfPixelsInFrame pixels of the frame
+    \param[out] metadata - receives a pointer to the metadata of the frame
+    \param[out] numOfLostFrames - receives the number of frames skipped because they were overwritten or NULL to skip this parameter
+    \param[in] timeoutMilliseconds - how long to wait for a frame
+    \param[in] frameRingPtr - ring attached by attachFrameRing()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, TIMEOUT_ERROR if no frame was published in time, INVALID_STATE_ERROR if the publisher closed the ring and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int acquireRingFrame(const uint16_t **framePixels, const FrameMetadata_t **metadata, uint32_t *numOfLostFrames, uint32_t timeoutMilliseconds, uintptr_t *frameRingPtr);
+
+/** \brief Releases the frame returned by acquireRingFrame()
+    \param[in] frameRingPtr - ring attached by attachFrameRing()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 if the frame was intact until now, FRAME_OVERRUN_ERROR if the publisher overwrote it while it was in use and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int releaseRingFrame(uintptr_t *frameRingPtr);
+
+/** \brief Copies the next intact frame of a ring
+    Combines acquireRingFrame(), a copy and releaseRingFrame(), frames overwritten during the copy are skipped and counted as lost.
+
+    \param[out] framePixelsBuffer - provide a buffer of at least numOfPixelsInFrame unsigned short elements
+    \param[out] metadata - provide a pointer to a FrameMetadata_t structure or NULL to skip this parameter
+    \param[out] numOfLostFrames - see acquireRingFrame()
+    \param[in] timeoutMilliseconds - how long to wait for a frame
+    \param[in] frameRingPtr - ring attached by attachFrameRing()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, TIMEOUT_ERROR if no frame was published in time and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int readRingFrame(uint16_t *framePixelsBuffer, FrameMetadata_t *metadata, uint32_t *numOfLostFrames, uint32_t timeoutMilliseconds, uintptr_t *frameRingPtr);
+
+/** \brief Creates a pool of reference counted frame buffers
+    \details
+    The buffers are carved from one slab allocated here, each one aligned to and padded to a 64 byte cache line, so
+    that reading frames into them with getFrame() and handing them from thread to thread allocates nothing.
+    A buffer acquired by acquireFrameBuffer() has one reference; retainFrameBuffer() adds one and releaseFrameBuffer()
+    drops one, the last release returns the buffer to the pool. Both can be called from any thread.
+
+    \param[in] numOfBuffers - number of buffers, at most 65536
+    \param[in] numOfPixelsInBuffer - elements of every buffer, numOfPixelsInFrame of the frame format the pool is for
+    \param[out] framePoolPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable set to 0.
+    If the variable already contains a pool, the old pool is destroyed.
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int createFramePool(uint32_t numOfBuffers, uint16_t numOfPixelsInBuffer, uintptr_t *framePoolPtr);
+
+/** \brief Destroys a pool created by createFramePool()
+    The buffers still acquired stay valid, the memory of the pool is freed when the last of them is released.
+
+    \param[in] framePoolPtr - address of the uintptr_t variable containing the pool, it is set to 0
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int destroyFramePool(uintptr_t *framePoolPtr);
+
+/** \brief Takes a free buffer of a pool, with one reference
+    \param[out] framePixels - set to the first element of the buffer, or NULL if the pool has no free buffer
+    \param[in] framePoolPtr - pool created by createFramePool()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, MEMORY_ALLOCATION_ERROR if all buffers are in use and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int acquireFrameBuffer(uint16_t **framePixels, uintptr_t *framePoolPtr);
+
+/** \brief Adds a reference to a buffer returned by acquireFrameBuffer()
+    \param[in] framePixels - the buffer
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, INVALID_PARAMETER_ERROR if the pointer is not a buffer of a pool and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int retainFrameBuffer(uint16_t *framePixels);
+
+/** \brief Drops a reference to a buffer returned by acquireFrameBuffer(), the last one returns the buffer to its pool
+    \param[in] framePixels - the buffer, it must not be used after its last reference is dropped
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, INVALID_PARAMETER_ERROR if the pointer is not a buffer of a pool and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int releaseFrameBuffer(uint16_t *framePixels);
+
+/** \brief Gets the counters of a pool created by createFramePool()
+    \param[out] statistics - provide a pointer to a FramePoolStatistics_t structure
+    \param[in] framePoolPtr - pool created by createFramePool()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getFramePoolStatistics(FramePoolStatistics_t *statistics, uintptr_t *framePoolPtr);
+
+/** \brief Creates a pool of threads that run per-frame kernels
+    \details
+    Frames come from submitFrame() and from the drain engines of the devices attached with attachFrameProcessor().
+    Every frame is copied into a buffer of the processor and queued on one of its threads; an idle thread takes work
+    queued on the others, so the throughput grows with the number of cores as long as the frames are independent.
+    Register the kernels with addFrameKernel().
+
+    \param[in] numOfThreads - number of threads, 0 for one per processor, at most 256
+    \param[in] queueCapacity - frames the processor holds at most; frames submitted beyond it are dropped
+    \param[out] frameProcessorPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable set to 0.
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, THREAD_CREATION_ERROR if a thread could not be started and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int createFrameProcessor(uint32_t numOfThreads, uint32_t queueCapacity, uintptr_t *frameProcessorPtr);
+
+/** \brief Waits for the frames submitted to a processor to go through their kernels and destroys it
+    \param[in] frameProcessorPtr - address of the uintptr_t variable containing the processor, it is set to 0
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, INVALID_STATE_ERROR if devices are still attached and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int destroyFrameProcessor(uintptr_t *frameProcessorPtr);
+
+/** \brief Registers a kernel run on every frame submitted from now on
+    \details
+    The unordered kernels of a frame run one after the other in the order they were registered, on any thread and
+    concurrently with the kernels of other frames; they may change the pixels. The ordered kernels run after them,
+    on the frames of one device one at a time and in the order the frames were submitted, see the pixels as left by
+    the unordered kernels and suit consumers that need the frames in sequence. A kernel that keeps the pixels past
+    its return takes a reference with retainFrameBuffer() and drops it with releaseFrameBuffer().
+
+    \param[in] kernel - function called with kernelState, the pixels of the frame, its metadata and the deviceContextPtr it came through
+    \param[in] kernelState - passed to the kernel as is
+    \param[in] ordered - 1 to run the kernel on the frames of every device in order, 0 otherwise
+    \param[in] frameProcessorPtr - processor created by createFrameProcessor()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, INVALID_STATE_ERROR if 16 kernels are registered already and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int addFrameKernel(FrameKernel_t kernel, void *kernelState, uint8_t ordered, uintptr_t *frameProcessorPtr);
+
+/** \brief Queues a copy of a frame for the kernels of a processor
+    \param[in] framePixels - metadata->numOfPixelsInFrame elements
+    \param[in] metadata - metadata of the frame, e.g. from getFrameWithMetadata()
+    \param[in] frameProcessorPtr - processor created by createFrameProcessor()
+    \param[in] deviceContextPtr - device the frame came from, passed to the kernels and keeping the order of ordered kernels; NULL for none
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, FRAME_OVERRUN_ERROR if the processor is full and the frame was dropped and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int submitFrame(const uint16_t *framePixels, const FrameMetadata_t *metadata, uintptr_t *frameProcessorPtr, uintptr_t *deviceContextPtr);
+
+/** \brief Feeds a processor with every frame the drain engine of the device reads
+    The frames keep going to the popDrainedFrame() consumers as well. A device feeds one processor at a time.
+
+    \param[in] frameProcessorPtr - processor created by createFrameProcessor()
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int attachFrameProcessor(uintptr_t *frameProcessorPtr, uintptr_t *deviceContextPtr);
+
+/** \brief Stops feeding the processor attached by attachFrameProcessor() and waits for the frames of the device it holds
+    Called by disconnectDeviceContext().
+
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int detachFrameProcessor(uintptr_t *deviceContextPtr);
+
+/** \brief Waits for the frames submitted to a processor to go through their kernels
+    \param[in] timeoutMilliseconds - how long to wait
+    \param[in] frameProcessorPtr - processor created by createFrameProcessor()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, TIMEOUT_ERROR if frames are still queued and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int waitFrameProcessor(uint32_t timeoutMilliseconds, uintptr_t *frameProcessorPtr);
+
+/** \brief Gets the counters and queue depths of a processor
+    \param[out] statistics - provide a pointer to a FrameProcessorStatistics_t structure
+    \param[in] frameProcessorPtr - processor created by createFrameProcessor()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getFrameProcessorStatistics(FrameProcessorStatistics_t *statistics, uintptr_t *frameProcessorPtr);
+
+/** \brief Gets the number of tasks waiting in the queue of every thread of a processor
+    \param[out] queueDepths - provide an array of numOfQueues elements
+    \param[in] numOfQueues - elements of queueDepths, the depths of threads beyond FrameProcessorStatistics_t::numOfThreads are left as they are
+    \param[in] frameProcessorPtr - processor created by createFrameProcessor()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getFrameProcessorQueueDepths(uint32_t *queueDepths, uint32_t numOfQueues, uintptr_t *frameProcessorPtr);
+
+/** \brief Enables the dark level correction of the frames read through a device context
+    Elements 16..28 of the 32 leading elements of every frame are light shielded and follow the dark level of the detector.
+    Their trimmed mean is estimated as soon as the first packet of a frame arrives and subtracted from the image elements
+    of the later packets while they are decoded, so the correction needs no extra pass over the frame.
+    The leading and trailing elements are left as read. The estimate is reported in FrameMetadata_t::darkLevel whether or not the correction is enabled.
+    Only frames of the whole sensor (first element 0, any reduction mode) hold the shielded elements; frames of a narrower
+    range are left as read and report a dark level of 0.
+
+    \param[in] enableMode
+    \parblock
+    0 - disabled (default)
+    1 - enabled
+    \endparblock
+    \param[in] pedestal - added to the corrected pixels so that noise around the dark level is not clipped at 0
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int setDarkCorrection(uint8_t enableMode, uint16_t pedestal, uintptr_t *deviceContextPtr);
+
+/** \brief Applies the dark level correction of setDarkCorrection() to a frame already in host memory
+    For frames read without the correction, e.g. from a capture file.
+
+    \param[in,out] framePixels - frame as read from the device, including the leading and trailing elements
+    \param[in] numOfPixelsInFrame - number of elements in the frame
+    \param[in] pedestal - see setDarkCorrection()
+    \param[out] darkLevel - receives the estimated dark level or NULL to skip this parameter
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int correctDarkLevel(uint16_t *framePixels, uint16_t numOfPixelsInFrame, uint16_t pedestal, uint16_t *darkLevel);
+
+/** \brief Compiles a bin map into a host binning engine
+    Unlike the reductionMode of setFrameFormat(), bins can have any width and can change along the frame,
+    e.g. coarse in uninteresting regions and full resolution around spectral lines. Bins need not be contiguous.
+    The map is compiled once into runs of adjacent elements and per-bin weights, every frame is then reduced in one pass.
+
+    \param[in] binMap - bin index of every element of the frame as read from the device, 0xFFFF leaves the element out
+    \param[in] numOfPixelsInFrame - number of elements in the frames to bin, see setFrameFormat()
+    \param[in] binningMode
+    \parblock
+    0 - mean of the elements of every bin
+    1 - sum of the elements of every bin
+    \endparblock
+    \param[out] numOfBins - receives the number of bins (highest bin index + 1) or NULL to skip this parameter
+    \param[out] binningPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable set to 0.
+    If the variable already contains a binning engine, the old one is destroyed.
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int createBinning(const uint16_t *binMap, uint16_t numOfPixelsInFrame, uint8_t binningMode, uint16_t *numOfBins, uintptr_t *binningPtr);
+
+/** \brief Destroys a binning engine created by createBinning()
+    \param[in] binningPtr - address of the uintptr_t variable containing the engine, it is set to 0
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int destroyBinning(uintptr_t *binningPtr);
+
+/** \brief Bins a frame already in host memory
+    \param[in] framePixels - frame as read from the device
+    \param[in] numOfPixelsInFrame - must match the numOfPixelsInFrame given to createBinning()
+    \param[out] binnedValues - provide a buffer of numOfBins float elements
+    \param[in] binningPtr - engine created by createBinning()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int binFrame(const uint16_t *framePixels, uint16_t numOfPixelsInFrame, float *binnedValues, uintptr_t *binningPtr);
+
+/** \brief Reads a frame from the device memory and returns only its bins
+    \param[out] binnedValues - provide a buffer of numOfBins float elements
+    \param[in] numOfFrame - see getFrame()
+    \param[out] metadata - provide a pointer to a FrameMetadata_t structure or NULL to skip this parameter
+    \param[in] binningPtr - engine created by createBinning()
+    \param[in] deviceContextPtr - device context to read the frame from
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, INVALID_STATE_ERROR if the frame format no longer matches the bin map and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getBinnedFrame(float *binnedValues, uint16_t numOfFrame, FrameMetadata_t *metadata, uintptr_t *binningPtr, uintptr_t *deviceContextPtr);
+
+/** \brief Creates a peak finder for decoded frames
+    Peaks are the image elements at or above the threshold where the first difference turns from positive to zero or negative,
+    found eight elements at a time. Of two peaks closer than minDistance only the higher one is kept.
+    The position and height are refined by a parabola through the maximum and its neighbours, or by a Gaussian (a parabola through their logarithms).
+
+    \param[in] threshold - minimum height of a peak
+    \param[in] minDistance - minimum distance between two peaks in elements, 0 keeps all of them
+    \param[in] refinementMode
+    \parblock
+    0 - parabolic
+    1 - Gaussian, falls back to parabolic where a neighbour is 0
+    \endparblock
+    \param[in] trackingTolerance
+    \parblock
+    0 disables tracking.
+    Otherwise a peak within trackingTolerance elements of a peak of the previous frame keeps its trackId, other peaks get a new one.
+    \endparblock
+    \param[out] peakFinderPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable set to 0.
+    If the variable already contains a peak finder, the old one is destroyed.
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int createPeakFinder(uint16_t threshold, uint16_t minDistance, uint8_t refinementMode, float trackingTolerance, uintptr_t *peakFinderPtr);
+
+/** \brief Destroys a peak finder created by createPeakFinder()
+    \param[in] peakFinderPtr - address of the uintptr_t variable containing the peak finder, it is set to 0
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int destroyPeakFinder(uintptr_t *peakFinderPtr);
+
+/** \brief Finds the peaks of a frame
+    \param[in] framePixels - frame as read from the device, see getFrame()
+    \param[in] numOfPixelsInFrame - number of elements in the frame
+    \param[out] peaks - provide a buffer of maxNumOfPeaks Peak_t elements, receives the peaks ordered by position
+    \param[in] maxNumOfPeaks - if more peaks are found, only the highest ones are returned
+    \param[out] numOfPeaks - receives the number of peaks returned
+    \param[in] peakFinderPtr - peak finder created by createPeakFinder()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int findPeaks(const uint16_t *framePixels, uint16_t numOfPixelsInFrame, Peak_t *peaks, uint32_t maxNumOfPeaks, uint32_t *numOfPeaks, uintptr_t *peakFinderPtr);
+
+/** \brief Forgets the peaks of the previous frame, the next frame starts new tracks
+    \param[in] peakFinderPtr - peak finder created by createPeakFinder()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int resetPeakTracking(uintptr_t *peakFinderPtr);
+
+/** \brief Creates a band integrator: sums of the frame elements over a set of bands
+    \details
+    Every frame is turned into prefix sums in one pass, each band is then answered with one subtraction whatever its width.
+    Bands may overlap and need not be ordered.
+
+    \param[in] bandEdges - 2 * numOfBands elements: the first element and the element past the last one of every band,
+    as indices into the frame as read from the device
+    \param[in] numOfBands - number of bands
+    \param[in] numOfPixelsInFrame - number of elements in the frames to integrate, see setFrameFormat()
+    \param[out] bandIntegratorPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable set to 0.
+    If the variable already contains a band integrator, the old one is destroyed.
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int createBandIntegrator(const uint16_t *bandEdges, uint32_t numOfBands, uint16_t numOfPixelsInFrame, uintptr_t *bandIntegratorPtr);
+
+/** \brief Destroys a band integrator created by createBandIntegrator()
+    \param[in] bandIntegratorPtr - address of the uintptr_t variable containing the integrator, it is set to 0
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int destroyBandIntegrator(uintptr_t *bandIntegratorPtr);
+
+/** \brief Integrates the bands of a frame already in host memory
+    \param[in] framePixels - frame as read from the device
+    \param[in] numOfPixelsInFrame - must match the numOfPixelsInFrame given to createBandIntegrator()
+    \param[out] bandSums - provide a buffer of numOfBands elements
+    \param[in] bandIntegratorPtr - band integrator created by createBandIntegrator()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int integrateBands(const uint16_t *framePixels, uint16_t numOfPixelsInFrame, uint32_t *bandSums, uintptr_t *bandIntegratorPtr);
+
+/** \brief Reads a frame from the device memory and returns only its band sums
+    \details
+    The prefix sums are built packet by packet as the frame is decoded (after the dark correction, see setDarkCorrection()).
+
+    \param[out] bandSums - provide a buffer of numOfBands elements
+    \param[in] numOfFrame - see getFrame()
+    \param[out] metadata - provide a pointer to a FrameMetadata_t structure or NULL to skip this parameter
+    \param[in] bandIntegratorPtr - band integrator created by createBandIntegrator()
+    \param[in] deviceContextPtr - device context to read the frame from
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, INVALID_STATE_ERROR if the frame format no longer matches the bands and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getBandFrame(uint32_t *bandSums, uint16_t numOfFrame, FrameMetadata_t *metadata, uintptr_t *bandIntegratorPtr, uintptr_t *deviceContextPtr);
+
+/** \brief Creates a host trigger: watches frames for a condition on a set of bands and keeps the frames around it
+    \details
+    Unlike the optical trigger of the device (see setOpticalTrigger()), which watches a single element, the condition
+    compares the mean of every band with the threshold. The trigger fires when the condition becomes true and re-arms once
+    it is false again. An event holds up to numOfPreTriggerFrames frames before the triggering one, the triggering one and
+    numOfPostTriggerFrames frames after it; frames outside events are not kept.
+
+    \param[in] bandEdges - 2 * numOfBands elements: the first element and the element past the last one of every band,
+    as indices into the frame as read from the device. A band of one element watches a single element.
+    \param[in] numOfBands - number of bands
+    \param[in] numOfPixelsInFrame - number of elements in the frames to watch, see setFrameFormat()
+    \param[in] conditionMode
+    \parblock
+    0 - the mean of any band is at or above the threshold
+    1 - the means of all bands are at or above the threshold
+    2 - the mean of any band is below the threshold
+    3 - the means of all bands are below the threshold
+    \endparblock
+    \param[in] threshold - level the band means are compared with
+    \param[in] numOfPreTriggerFrames - frames kept before the triggering frame, up to 4096
+    \param[in] numOfPostTriggerFrames - frames kept after the triggering frame, up to 4096
+    \param[out] hostTriggerPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable set to 0.
+    If the variable already contains a host trigger, the old one is destroyed.
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int createHostTrigger(const uint16_t *bandEdges, uint32_t numOfBands, uint16_t numOfPixelsInFrame, uint8_t conditionMode, uint32_t threshold,
+                                                  uint32_t numOfPreTriggerFrames, uint32_t numOfPostTriggerFrames, uintptr_t *hostTriggerPtr);
+
+/** \brief Destroys a host trigger created by createHostTrigger()
+    \param[in] hostTriggerPtr - address of the uintptr_t variable containing the trigger, it is set to 0
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int destroyHostTrigger(uintptr_t *hostTriggerPtr);
+
+/** \brief Passes a frame already in host memory to the trigger, e.g. one popped from the drain engine or a frame ring
+    \param[in] framePixels - frame as read from the device
+    \param[in] metadata - metadata of the frame, kept with it in the event
+    \param[out] eventReady - receives 1 if an event is waiting in getHostTriggerEvent() or NULL to skip this parameter
+    \param[in] hostTriggerPtr - trigger created by createHostTrigger()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int feedHostTrigger(const uint16_t *framePixels, const FrameMetadata_t *metadata, uint8_t *eventReady, uintptr_t *hostTriggerPtr);
+
+/** \brief Reads a frame from the device memory into the trigger
+    \details
+    The frame is decoded straight into the pre-trigger ring and the band sums are built packet by packet while it is decoded,
+    so the condition is known as soon as the last packet arrives.
+
+    \param[in] numOfFrame - see getFrame()
+    \param[out] eventReady - receives 1 if an event is waiting in getHostTriggerEvent() or NULL to skip this parameter
+    \param[in] hostTriggerPtr - trigger created by createHostTrigger()
+    \param[in] deviceContextPtr - device context to read the frame from
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, INVALID_STATE_ERROR if the frame format no longer matches the bands and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int readHostTriggerFrame(uint16_t numOfFrame, uint8_t *eventReady, uintptr_t *hostTriggerPtr, uintptr_t *deviceContextPtr);
+
+/** \brief Takes the last complete event of the trigger
+    \details
+    An event not taken before the next one completes is replaced by it and counted as lost.
+
+    \param[out] framePixels - provide a buffer of (numOfPreTriggerFrames + 1 + numOfPostTriggerFrames) * numOfPixelsInFrame elements,
+    receives the frames of the event one after another
+    \param[out] metadata - provide a buffer of numOfPreTriggerFrames + 1 + numOfPostTriggerFrames FrameMetadata_t elements or NULL to skip this parameter
+    \param[out] numOfFrames - receives the number of frames of the event, 0 if no event is waiting
+    \param[out] triggerIndex - receives the index of the triggering frame in the event or NULL to skip this parameter
+    \param[out] numOfLostEvents - receives the number of events replaced before being taken or NULL to skip this parameter
+    \param[in] hostTriggerPtr - trigger created by createHostTrigger()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getHostTriggerEvent(uint16_t *framePixels, FrameMetadata_t *metadata, uint32_t *numOfFrames, uint32_t *triggerIndex, uint32_t *numOfLostEvents,
+                                                    uintptr_t *hostTriggerPtr);
+
+/** \brief Finds the exposure that brings the highest image element to a target level
+    \details
+    Takes single trial frames with the software trigger. The maximum above the dark level is taken to grow linearly with
+    the exposure, so the next exposure is predicted from the last one or two unsaturated frames; a saturated frame halves
+    the distance to the last unsaturated exposure, or divides the exposure by 8 before any. The maximum and the number
+    of saturated elements come with every frame (see FrameMetadata_t), no frame is scanned again. Commands that would
+    not change the device state are skipped.
+
+    The frame memory is cleared. The number of scans and blank scans are restored when done, with the best exposure found.
+    \note Not applicable in scanMode = 3, frames are read from the frame memory
+
+    \param[in] targetLevel - level the highest image element should reach, as read from the device
+    \param[in] tolerance - distance from the target accepted as reached
+    \param[in] minTimeOfExposure - shortest exposure to try, multiple of 10 us
+    \param[in] maxTimeOfExposure - longest exposure to try, multiple of 10 us
+    \param[in] maxNumOfSteps - most trial frames to take
+    \param[in] timeoutMilliseconds - longest wait for one trial frame
+    \param[out] autoExposureResult - provide a pointer to an AutoExposureResult_t structure or NULL to skip this parameter
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success (also when the target was not reached, see AutoExposureResult_t), TIMEOUT_ERROR if a trial frame did not come and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int runAutoExposure(uint16_t targetLevel, uint16_t tolerance, uint32_t minTimeOfExposure, uint32_t maxTimeOfExposure, uint8_t maxNumOfSteps,
+                                                uint32_t timeoutMilliseconds, AutoExposureResult_t *autoExposureResult, uintptr_t *deviceContextPtr);
+
+/** \brief Merges frames of different exposures into one high dynamic range frame
+    \details
+    Every element not saturated in an exposure estimates the signal rate (value - offset) / time. The estimates are weighted by
+    the time of exposure, so the result is the sum of (value - offset) over the unsaturated exposures divided by the sum of
+    their times, scaled to the longest exposure. Elements saturated in every exposure take the clipped value of the shortest one.
+
+    \param[in] framePixels - numOfExposures frames of numOfPixelsInFrame elements, one after another
+    \param[in] timesOfExposure - numOfExposures times of exposure of the frames, any unit
+    \param[in] offsets - numOfExposures levels of no light: the dark levels (see FrameMetadata_t) or the pedestals of corrected frames
+    \param[in] saturationLevels - numOfExposures levels from which an element is taken as saturated
+    \param[in] numOfExposures - number of frames, up to 16
+    \param[in] numOfPixelsInFrame - number of elements in every frame, the elements are merged independently
+    \param[out] hdrPixels - provide a buffer of numOfPixelsInFrame float elements
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int mergeHdrFrames(const uint16_t *framePixels, const uint32_t *timesOfExposure, const uint16_t *offsets, const uint16_t *saturationLevels,
+                                               uint8_t numOfExposures, uint16_t numOfPixelsInFrame, float *hdrPixels);
+
+/** \brief Takes a bracket of frames with different exposures and merges it into one high dynamic range frame
+    \details
+    Frames are taken one per software trigger. As soon as a frame is in the frame memory, the next exposure is set and
+    triggered, and the frame is read while the next one is exposed. The bracket is merged with mergeHdrFrames(), using the
+    dark level of every frame, or the pedestal when the dark correction is enabled (see setDarkCorrection()).
+
+    The frame memory is cleared. The number of scans, blank scans and the exposure are restored when done.
+    \note Not applicable in scanMode = 3, frames are read from the frame memory
+
+    \param[out] hdrPixels - provide a buffer of numOfPixelsInFrame float elements, receives the frame scaled to the longest exposure
+    \param[in] timesOfExposure - numOfExposures times of exposure in the order they are taken, multiple of 10 us
+    \param[in] numOfExposures - number of frames in the bracket, up to 16
+    \param[in] timeoutMilliseconds - longest wait for one frame
+    \param[out] metadata - provide a buffer of numOfExposures FrameMetadata_t elements or NULL to skip this parameter
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, TIMEOUT_ERROR if a frame did not come and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getHdrFrame(float *hdrPixels, const uint32_t *timesOfExposure, uint8_t numOfExposures, uint32_t timeoutMilliseconds, FrameMetadata_t *metadata,
+                                            uintptr_t *deviceContextPtr);
+
+/** \brief Sets how long the library waits for a class of replies from the device
+    \details
+    By default the timeout follows the replies of the class seen so far: their mean time plus 6 standard deviations,
+    at least 10 ms and at most the fixed timeout of the class (100 ms, 5 s for the flash erase). Replies to commands
+    differ too much from one command to another, they never get less than their fixed timeout. The fixed timeout applies
+    until 8 replies are seen and after every timeout. The first packet of a frame also gets the time of exposure
+    (times the number of scans in scanMode = 3) as last set or read back.
+
+    \param[in] latencyClass
+    \parblock
+    0 - replies to commands (parameters, frame format, memory clear)
+
+    1 - first packet of a frame
+
+    2 - following packets of a frame
+
+    3 - packets read from the flash
+
+    4 - replies to flash writes
+
+    5 - reply to the flash erase
+
+    6 - replies to status requests
+    \endparblock
+    \param[in] timeoutMilliseconds - fixed timeout for the class, or 0 to go back to the timeout derived from the replies
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int setReplyTimeout(uint8_t latencyClass, uint32_t timeoutMilliseconds, uintptr_t *deviceContextPtr);
+
+/** \brief Gets the reply time estimate of a class of replies
+    \param[in] latencyClass - see setReplyTimeout()
+    \param[out] replyLatency - provide a pointer to a ReplyLatency_t structure
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getReplyLatency(uint8_t latencyClass, ReplyLatency_t *replyLatency, uintptr_t *deviceContextPtr);
+
+/** \brief Requests the status of the device without waiting for the reply
+    \details
+    Only one request started with beginStatusRead(), beginFrameRead() or beginFlashRead() may be pending at a time.
+    The functions waiting for a reply fail with INVALID_STATE_ERROR until it is done or cancelled by cancelAsyncOperation().
+    triggerAcquisition() may still be called. The reply is taken by continueStatusRead().
+
+    \param[out] statusFlags - pointer to the variable to store the status flags in, may be NULL; it should stay valid until the request is done
+    \param[out] framesInMemory - pointer to the variable to store the number of frames in memory in, may be NULL; it should stay valid until the request is done
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int beginStatusRead(uint8_t *statusFlags, uint16_t *framesInMemory, uintptr_t *deviceContextPtr);
+
+/** \brief Takes the reply to beginStatusRead() if it came, without waiting
+    \details
+    The request is done once *done is set, with the error code of the request returned.
+    A reply not coming within the reply timeout (see setReplyTimeout()) fails it with READING_PROCESS_FAILED.
+
+    \param[out] done - set to 1 once the request is done, 0 while it is pending
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int continueStatusRead(uint8_t *done, uintptr_t *deviceContextPtr);
+
+/** \brief Requests a frame from the memory of the device without waiting for it
+    \details
+    See beginStatusRead() for the rules on pending requests. The frame is taken by continueFrameRead().
+
+    \param[in] numOfFrame - index of the frame in the memory
+    \param[out] framePixelsBuffer - buffer for at least the number of elements in a frame, see getFrame(); it should stay valid until the request is done
+    \param[out] metadata - pointer to a FrameMetadata_t structure, may be NULL; it should stay valid until the request is done
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int beginFrameRead(uint16_t numOfFrame, uint16_t *framePixelsBuffer, FrameMetadata_t *metadata, uintptr_t *deviceContextPtr);
+
+/** \brief Takes the packets of the frame requested by beginFrameRead() that came, without waiting
+    \details
+    The request is done once *done is set, with the error code of the request returned. Lost packets are requested
+    again like in getFrame().
+
+    \param[out] done - set to 1 once the request is done, 0 while it is pending
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int continueFrameRead(uint8_t *done, uintptr_t *deviceContextPtr);
+
+/** \brief Requests the contents of the flash without waiting for it
+    \details
+    See beginStatusRead() for the rules on pending requests. The contents are taken by continueFlashRead().
+
+    \param[out] buffer - buffer for bytesToRead bytes; it should stay valid until the request is done
+    \param[in] absoluteOffset - offset in the flash
+    \param[in] bytesToRead - number of bytes to read
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int beginFlashRead(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, uintptr_t *deviceContextPtr);
+
+/** \brief Takes the packets of the flash contents requested by beginFlashRead() that came, without waiting
+    \details
+    The request is done once *done is set, with the error code of the request returned.
+
+    \param[out] done - set to 1 once the request is done, 0 while it is pending
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int continueFlashRead(uint8_t *done, uintptr_t *deviceContextPtr);
+
+/** \brief Cancels the pending request started by beginStatusRead(), beginFrameRead() or beginFlashRead()
+    \details
+    The replies already received are dropped. Does nothing if no request is pending.
+
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int cancelAsyncOperation(uintptr_t *deviceContextPtr);
+
+/** \brief Gets a descriptor that turns readable when a reply to a pending request comes
+    \details
+    For event loops (poll, epoll, libuv): wait for the descriptor to be readable, or for getPollTimeout() to pass,
+    then call the continue...() function of the pending request. The descriptor is owned by the library: do not read
+    from it or close it. It stays the same until the device is reconnected.
+
+    It is only available on Linux with the hidraw backend of hidapi; elsewhere this function fails with INVALID_STATE_ERROR
+    and continue...() should be called periodically instead.
+
+    \param[out] fd - pointer to the variable to store the descriptor in, set to -1 on error
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getPollFd(int *fd, uintptr_t *deviceContextPtr);
+
+/** \brief Gets the time until the pending request times out if no reply comes
+    \details
+    The continue...() function called after this time fails the request or, for a frame, requests the missing
+    packets again.
+
+    \param[out] timeoutMilliseconds - time to wait before calling continue...() anyway, 0xFFFFFFFF when no request is pending
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getPollTimeout(uint32_t *timeoutMilliseconds, uintptr_t *deviceContextPtr);
+
+/**   \ingroup API */
+#ifndef SPECTROMETER_ERROR_CODES
+#define SPECTROMETER_ERROR_CODES
+    /** \ingroup API */
+    #define OK 0
+    /** \ingroup API */
+    #define CONNECT_ERROR_WRONG_ID 500
+    /** \ingroup API */
+    #define CONNECT_ERROR_NOT_FOUND 501
+    /** \ingroup API */
+    #define CONNECT_ERROR_FAILED 502
+    /** \ingroup API */
+    #define DEVICE_NOT_INITIALIZED 503
+    /** \ingroup API */
+    #define WRITING_PROCESS_FAILED 504
+    /** \ingroup API */
+    #define READING_PROCESS_FAILED 505
+    /** \ingroup API */
+    #define WRONG_ANSWER 506
+    /** \ingroup API */
+    #define GET_FRAME_REMAINING_PACKETS_ERROR 507
+    /** \ingroup API */
+    #define NUM_OF_PACKETS_IN_FRAME_ERROR 508
+    /** \ingroup API */
+    #define INPUT_PARAMETER_NOT_INITIALIZED 509
+    /** \ingroup API */
+    #define READ_FLASH_REMAINING_PACKETS_ERROR 510
+    /** \ingroup API */
+    #define MEMORY_ALLOCATION_ERROR 511
+    /** \ingroup API */
+    #define INVALID_PARAMETER_ERROR 512
+    /** \ingroup API */
+    #define THREAD_CREATION_ERROR 513
+    /** \ingroup API */
+    #define TIMEOUT_ERROR 514
+    /** \ingroup API */
+    #define INVALID_STATE_ERROR 515
+    /** \ingroup API */
+    #define CONNECT_ERROR_WRONG_SERIAL_NUMBER 516
+    /** \ingroup API */
+    #define CAPTURE_FILE_FULL_ERROR 517
+    /** \ingroup API */
+    #define FILE_ERROR 518
+    /** \ingroup API */
+    #define COMPRESSED_DATA_ERROR 519
+    /** \ingroup API */
+    #define FRAME_OVERRUN_ERROR 520
     /** \ingroup API */
     #define NO_DEVICE_CONTEXT_ERROR 585
 #endif
@@ -0,0 +1,482 @@
+/** \file
+ * C++ interface over the libspectrometer API: a move-only Device owning the device context, frames read into
+ * caller-provided spans or into buffers of a FramePool allocated up front. Errors are returned, not thrown:
+ * every call gives a Result, std::expected<T, Error> where the standard library has it (C++23) and a minimal
+ * stand-in with the same members otherwise. Nothing is allocated per frame, every call is one call of the C API.
+ */
+
+#ifndef SPECTRLIB_LIBSPECTROMETER_HPP
+#define SPECTRLIB_LIBSPECTROMETER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <utility>
+#include <version>
+
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+    #include <expected>
+    #define SPECTRLIB_STD_EXPECTED
+#endif
+
+#include "libspectrometer.h"
+
+namespace aseq {
+
+/** \brief Largest frame the device sends: 124 packets of 30 elements */
+inline constexpr std::size_t maxFrameSize = 124 * 30;
+inline constexpr std::size_t numOfLeadingElements = 32;
+inline constexpr std::size_t numOfTrailingElements = 14;
+
+/** \brief Error code of the C API, see SPECTROMETER_ERROR_CODES */
+struct Error {
+    int code;
+
+    friend constexpr bool operator==(const Error&, const Error&) = default;
+};
+
+#if defined(SPECTRLIB_STD_EXPECTED)
+
+template <typename T>
+using Result = std::expected<T, Error>;
+using Unexpected = std::unexpected<Error>;
+
+#else
+
+class Unexpected {
+public:
+    constexpr explicit Unexpected(Error error) noexcept : error_(error) {}
+    constexpr const Error &error() const noexcept { return error_; }
+
+private:
+    Error error_;
+};
+
+/** \brief Stand-in for std::expected<T, Error> before C++23
+    \details
+    Has the observers of std::expected used with this header. value() aborts instead of throwing when holding an error.
+*/
+template <typename T>
+class [[nodiscard]] Result {
+public:
+    using value_type = T;
+    using error_type = Error;
+
+    Result(const T &value) : hasValue_(true) { ::new (static_cast<void*>(&value_)) T(value); }
+    Result(T &&value) noexcept : hasValue_(true) { ::new (static_cast<void*>(&value_)) T(std::move(value)); }
+    Result(const Unexpected &unexpected) noexcept : error_(unexpected.error()), hasValue_(false) {}
+
+    Result(const Result &other) : hasValue_(other.hasValue_) { construct(other); }
+    Result(Result &&other) noexcept : hasValue_(other.hasValue_) { construct(std::move(other)); }
+
+    Result &operator=(const Result &other)
+    {
+        if (this != &other) {
+            destroy();
+            hasValue_ = other.hasValue_;
+            construct(other);
+        }
+        return *this;
+    }
+
+    Result &operator=(Result &&other) noexcept
+    {
+        if (this != &other) {
+            destroy();
+            hasValue_ = other.hasValue_;
+            construct(std::move(other));
+        }
+        return *this;
+    }
+
+    ~Result() { destroy(); }
+
+    constexpr bool has_value() const noexcept { return hasValue_; }
+    constexpr explicit operator bool() const noexcept { return hasValue_; }
+
+    T &operator*() & noexcept { return value_; }
+    const T &operator*() const & noexcept { return value_; }
+    T &&operator*() && noexcept { return std::move(value_); }
+    T *operator->() noexcept { return &value_; }
+    const T *operator->() const noexcept { return &value_; }
+
+    T &value() & { check(); return value_; }
+    const T &value() const & { check(); return value_; }
+    T &&value() && { check(); return std::move(value_); }
+
+    const Error &error() const noexcept { return error_; }
+
+private:
+    template <typename Other>
+    void construct(Other &&other)
+    {
+        if (hasValue_) {
+            ::new (static_cast<void*>(&value_)) T(std::forward<Other>(other).value_);
+        } else {
+            ::new (static_cast<void*>(&error_)) Error(other.error_);
+        }
+    }
+
+    void destroy() noexcept
+    {
+        if (hasValue_) {
+            value_.~T();
+        }
+    }
+
+    void check() const noexcept
+    {
+        if (!hasValue_) {
+            std::abort();
+        }
+    }
+
+    union {
+        T value_;
+        Error error_;
+    };
+    bool hasValue_;
+};
+
+template <>
+class [[nodiscard]] Result<void> {
+public:
+    using value_type = void;
+    using error_type = Error;
+
+    constexpr Result() noexcept : error_{OK}, hasValue_(true) {}
+    constexpr Result(const Unexpected &unexpected) noexcept : error_(unexpected.error()), hasValue_(false) {}
+
+    constexpr bool has_value() const noexcept { return hasValue_; }
+    constexpr explicit operator bool() const noexcept { return hasValue_; }
+    void value() const
+    {
+        if (!hasValue_) {
+            std::abort();
+        }
+    }
+    constexpr const Error &error() const noexcept { return error_; }
+
+private:
+    Error error_;
+    bool hasValue_;
+};
+
+#endif
+
+/** \brief Result of a C API call returning only an error code */
+inline Result<void> check(int code) noexcept
+{
+    if (code != OK) {
+        return Unexpected(Error{code});
+    }
+    return {};
+}
+
+/** \brief Image elements of a frame as read from the device, without the leading and trailing dummy elements */
+inline std::span<const uint16_t> imageElements(std::span<const uint16_t> frame) noexcept
+{
+    if (frame.size() < numOfLeadingElements + numOfTrailingElements) {
+        return {};
+    }
+    return frame.subspan(numOfLeadingElements, frame.size() - numOfLeadingElements - numOfTrailingElements);
+}
+
+class Device;
+
+/** \brief Fixed set of frame buffers allocated once, lent out by Device::readFrame()
+    \details
+    Every buffer holds the largest frame and its metadata. A Frame returns its buffer to the pool when destroyed,
+    the pool must outlive its frames. Lending and returning take a mutex, frames may be read and released from any thread.
+*/
+class FramePool {
+public:
+    /** \brief One lent buffer with the frame read into it, move-only */
+    class Frame {
+    public:
+        Frame() noexcept = default;
+        Frame(Frame &&other) noexcept
+            : pool_(std::exchange(other.pool_, nullptr)), index_(other.index_)
+        {
+        }
+        Frame &operator=(Frame &&other) noexcept
+        {
+            if (this != &other) {
+                release();
+                pool_ = std::exchange(other.pool_, nullptr);
+                index_ = other.index_;
+            }
+            return *this;
+        }
+        Frame(const Frame&) = delete;
+        Frame &operator=(const Frame&) = delete;
+        ~Frame() { release(); }
+
+        /** \brief The frame as read from the device, metadata().numOfPixelsInFrame elements */
+        std::span<const uint16_t> pixels() const noexcept
+        {
+            return pool_? std::span<const uint16_t>(pool_->pixels(index_), pool_->metadata_[index_].numOfPixelsInFrame) : std::span<const uint16_t>();
+        }
+        std::span<const uint16_t> image() const noexcept { return imageElements(pixels()); }
+        const FrameMetadata_t &metadata() const noexcept { return pool_->metadata_[index_]; }
+
+        explicit operator bool() const noexcept { return pool_ != nullptr; }
+
+        /** \brief Returns the buffer to the pool before the frame is destroyed */
+        void release() noexcept
+        {
+            if (pool_) {
+                std::exchange(pool_, nullptr)->giveBack(index_);
+            }
+        }
+
+    private:
+        friend class FramePool;
+        friend class Device;
+
+        Frame(FramePool *pool, std::size_t index) noexcept : pool_(pool), index_(index) {}
+
+        uint16_t *buffer() noexcept { return pool_->pixels(index_); }
+        FrameMetadata_t *metadataBuffer() noexcept { return &pool_->metadata_[index_]; }
+
+        FramePool *pool_ = nullptr;
+        std::size_t index_ = 0;
+    };
+
+    /** \brief Allocates numOfFrames buffers, throws std::bad_alloc like any container */
+    explicit FramePool(std::size_t numOfFrames)
+        : pixels_(new uint16_t[numOfFrames * maxFrameSize]),
+          metadata_(new FrameMetadata_t[numOfFrames]()),
+          freeIndices_(new std::size_t[numOfFrames]),
+          numOfFrames_(numOfFrames),
+          numOfFree_(numOfFrames)
+    {
+        for (std::size_t i = 0; i < numOfFrames; ++i) {
+            freeIndices_[i] = numOfFrames - 1 - i;
+        }
+    }
+
+    FramePool(const FramePool&) = delete;
+    FramePool &operator=(const FramePool&) = delete;
+
+    /** \brief Lends a buffer, MEMORY_ALLOCATION_ERROR when all are lent */
+    Result<Frame> acquire() noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!numOfFree_) {
+            return Unexpected(Error{MEMORY_ALLOCATION_ERROR});
+        }
+        return Frame(this, freeIndices_[--numOfFree_]);
+    }
+
+    std::size_t size() const noexcept { return numOfFrames_; }
+    std::size_t available() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return numOfFree_;
+    }
+
+private:
+    uint16_t *pixels(std::size_t index) const noexcept { return pixels_.get() + index * maxFrameSize; }
+
+    void giveBack(std::size_t index) noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeIndices_[numOfFree_++] = index;
+    }
+
+    std::unique_ptr<uint16_t[]> pixels_;
+    std::unique_ptr<FrameMetadata_t[]> metadata_;
+    std::unique_ptr<std::size_t[]> freeIndices_;
+    std::size_t numOfFrames_;
+    std::size_t numOfFree_;
+    mutable std::mutex mutex_;
+};
+
+/** \brief Connected device, move-only, disconnected when destroyed
+    \details
+    The context lives at a fixed address for the life of the connection, so objects of the C API keeping the
+    uintptr_t* (device groups, drain engines) stay valid when the Device is moved. Any other C API function
+    can be called with context().
+*/
+class Device {
+public:
+    struct Status {
+        uint8_t statusFlags;
+        uint16_t framesInMemory;
+    };
+
+    Device(Device &&other) noexcept = default;
+    Device &operator=(Device &&other) noexcept
+    {
+        if (this != &other) {
+            disconnect();
+            context_ = std::move(other.context_);
+            numOfPixelsInFrame_ = other.numOfPixelsInFrame_;
+        }
+        return *this;
+    }
+    Device(const Device&) = delete;
+    Device &operator=(const Device&) = delete;
+    ~Device() { disconnect(); }
+
+    /** \brief Connects to the device with the serial number, or the first one found with nullptr */
+    static Result<Device> connect(const char *serialNumber = nullptr)
+    {
+        Device device;
+        int result = OK;
+
+        if (!device.context_) {
+            return Unexpected(Error{MEMORY_ALLOCATION_ERROR});
+        }
+
+        result = connectToDeviceBySerial(serialNumber, device.context());
+        if (result == OK) {
+            result = device.refreshFrameSize();
+        }
+        if (result != OK) {
+            return Unexpected(Error{result});
+        }
+        return device;
+    }
+
+    /** \brief Connects to the device at the index of getDevicesInfo() */
+    static Result<Device> connectByIndex(unsigned int index)
+    {
+        Device device;
+        int result = OK;
+
+        if (!device.context_) {
+            return Unexpected(Error{MEMORY_ALLOCATION_ERROR});
+        }
+
+        result = connectToDeviceByIndex(index, device.context());
+        if (result == OK) {
+            result = device.refreshFrameSize();
+        }
+        if (result != OK) {
+            return Unexpected(Error{result});
+        }
+        return device;
+    }
+
+    /** \brief Context for the C API, nullptr after a move */
+    uintptr_t *context() const noexcept { return context_.get(); }
+
+    /** \brief Elements in a frame, as last set or read back through this object (see refreshFrameSize()) */
+    uint16_t frameSize() const noexcept { return numOfPixelsInFrame_; }
+
+    /** \brief Reads the frame format back, needed after changing it through context() */
+    int refreshFrameSize() noexcept
+    {
+        return getFrameFormat(nullptr, nullptr, nullptr, &numOfPixelsInFrame_, context());
+    }
+
+    Result<void> setExposure(uint32_t timeOfExposure, bool force = false) noexcept
+    {
+        return check(::setExposure(timeOfExposure, force? 1 : 0, context()));
+    }
+
+    Result<void> setAcquisitionParameters(uint16_t numOfScans, uint16_t numOfBlankScans, uint8_t scanMode, uint32_t timeOfExposure) noexcept
+    {
+        return check(::setAcquisitionParameters(numOfScans, numOfBlankScans, scanMode, timeOfExposure, context()));
+    }
+
+    /** \brief Sets the frame format, gives the new number of elements in a frame */
+    Result<uint16_t> setFrameFormat(uint16_t numOfStartElement, uint16_t numOfEndElement, uint8_t reductionMode) noexcept
+    {
+        int result = ::setFrameFormat(numOfStartElement, numOfEndElement, reductionMode, &numOfPixelsInFrame_, context());
+
+        if (result != OK) {
+            return Unexpected(Error{result});
+        }
+        return numOfPixelsInFrame_;
+    }
+
+    Result<void> trigger() noexcept { return check(triggerAcquisition(context())); }
+    Result<void> clearMemory() noexcept { return check(::clearMemory(context())); }
+
+    Result<Status> status() noexcept
+    {
+        Status status = {0, 0};
+        int result = getStatus(&status.statusFlags, &status.framesInMemory, context());
+
+        if (result != OK) {
+            return Unexpected(Error{result});
+        }
+        return status;
+    }
+
+    /** \brief Reads a frame into a caller-provided buffer
+        \details
+        A buffer of maxFrameSize elements fits any frame format. A smaller one is checked against the frame size read back
+        from the device first, so it costs one more request. Gives the part of the buffer holding the frame.
+        \param[in] numOfFrame - see getFrame()
+        \param[out] metadata - see getFrameWithMetadata(), nullptr to skip
+    */
+    Result<std::span<const uint16_t>> readFrame(std::span<uint16_t> buffer, uint16_t numOfFrame = 0, FrameMetadata_t *metadata = nullptr) noexcept
+    {
+        FrameMetadata_t frameMetadata;
+        int result = OK;
+
+        //frameSize() misses format changes made through context() or a reset, the library decodes the current size
+        if (buffer.size() < maxFrameSize) {
+            result = refreshFrameSize();
+            if (result != OK) {
+                return Unexpected(Error{result});
+            }
+            if (buffer.size() < numOfPixelsInFrame_) {
+                return Unexpected(Error{INVALID_PARAMETER_ERROR});
+            }
+        }
+
+        result = getFrameWithMetadata(buffer.data(), numOfFrame, &frameMetadata, context());
+        if (result != OK) {
+            return Unexpected(Error{result});
+        }
+
+        if (metadata) {
+            *metadata = frameMetadata;
+        }
+        return std::span<const uint16_t>(buffer.data(), frameMetadata.numOfPixelsInFrame);
+    }
+
+    /** \brief Reads a frame into a buffer lent by the pool, MEMORY_ALLOCATION_ERROR when all its buffers are lent */
+    Result<FramePool::Frame> readFrame(FramePool &pool, uint16_t numOfFrame = 0) noexcept
+    {
+        Result<FramePool::Frame> frame = pool.acquire();
+        int result = OK;
+
+        if (!frame) {
+            return frame;
+        }
+
+        result = getFrameWithMetadata(frame->buffer(), numOfFrame, frame->metadataBuffer(), context());
+        if (result != OK) {
+            return Unexpected(Error{result});
+        }
+        return frame;
+    }
+
+private:
+    Device() : context_(new (std::nothrow) uintptr_t(0)) {}
+
+    void disconnect() noexcept
+    {
+        if (context_ && *context_) {
+            disconnectDeviceContext(context_.get());
+        }
+    }
+
+    std::unique_ptr<uintptr_t> context_;
+    uint16_t numOfPixelsInFrame_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,563 @@
+/** \file
+ * C++20 coroutines over the non-blocking requests of the libspectrometer API (beginFrameRead() and the like).
+ * A Reactor owns no thread: it starts the requests awaited by coroutines, takes their replies without waiting
+ * whenever poll() is called and resumes the coroutines whose requests are done, so it can be driven from any
+ * event loop, or by run() alone. Requests to one device are started one after the other in the order they were
+ * awaited, requests to different devices overlap. Errors are returned as Result like in libspectrometer.hpp.
+ */
+
+#ifndef SPECTRLIB_LIBSPECTROMETER_ASYNC_HPP
+#define SPECTRLIB_LIBSPECTROMETER_ASYNC_HPP
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "libspectrometer.hpp"
+
+namespace aseq {
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase {
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> coroutine) noexcept
+        {
+            return coroutine.promise().continuation;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+
+    //Errors are returned, a coroutine of this interface does not throw
+    void unhandled_exception() const noexcept { std::terminate(); }
+
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    Task<T> get_return_object() noexcept;
+    void return_value(T value) { result.emplace(std::move(value)); }
+
+    std::optional<T> result;
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object() noexcept;
+    void return_void() const noexcept {}
+};
+
+}
+
+/** \brief Coroutine started when awaited, resuming its awaiter when it returns, move-only
+    \details
+    Awaiting a Task runs it up to its first suspension. A Task<void> can also be handed to Reactor::spawn()
+    to run on its own.
+*/
+template <typename T>
+class [[nodiscard]] Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+    Task(Task &&other) noexcept : coroutine_(std::exchange(other.coroutine_, nullptr)) {}
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other) {
+            destroy();
+            coroutine_ = std::exchange(other.coroutine_, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task &operator=(const Task&) = delete;
+    ~Task() { destroy(); }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter {
+            bool await_ready() const noexcept { return !coroutine || coroutine.done(); }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                coroutine.promise().continuation = awaiting;
+                return coroutine;
+            }
+
+            T await_resume()
+            {
+                if constexpr (!std::is_void_v<T>) {
+                    return std::move(*coroutine.promise().result);
+                }
+            }
+
+            std::coroutine_handle<promise_type> coroutine;
+        };
+
+        return Awaiter{coroutine_};
+    }
+
+private:
+    friend promise_type;
+    friend class Reactor;
+
+    explicit Task(std::coroutine_handle<promise_type> coroutine) noexcept : coroutine_(coroutine) {}
+
+    std::coroutine_handle<promise_type> release() noexcept { return std::exchange(coroutine_, nullptr); }
+
+    void destroy() noexcept
+    {
+        if (coroutine_) {
+            std::exchange(coroutine_, nullptr).destroy();
+        }
+    }
+
+    std::coroutine_handle<promise_type> coroutine_;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+}
+
+/** \brief Awaitable holding a result known up front, the awaiting coroutine is not suspended */
+template <typename T>
+struct Ready {
+    bool await_ready() const noexcept { return true; }
+    void await_suspend(std::coroutine_handle<>) const noexcept {}
+    T await_resume() { return std::move(value); }
+
+    T value;
+};
+
+/** \brief Runs the requests awaited by coroutines, single-threaded
+    \details
+    All awaiting, poll(), run() and spawn() must happen on one thread. The reactor must outlive the requests
+    awaited through it; when destroyed, it cancels the requests still pending and destroys the spawned coroutines.
+*/
+class Reactor {
+public:
+    /** \brief Request awaited through a reactor, resumes the awaiting coroutine from poll() once done */
+    class Operation {
+    public:
+        Operation(const Operation&) = delete;
+        Operation &operator=(const Operation&) = delete;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            awaiting_ = awaiting;
+            reactor_->enqueue(this);
+        }
+
+    protected:
+        /** \param[in] context - device the request goes to, nullptr for one not involving a device */
+        Operation(Reactor &reactor, uintptr_t *context) noexcept : reactor_(&reactor), context_(context) {}
+        ~Operation() = default;
+
+        uintptr_t *context() const noexcept { return context_; }
+
+        /** \brief Starts the request, gives an error code of the C API */
+        virtual int begin() noexcept = 0;
+        /** \brief Takes what came without waiting, sets done once the request is done */
+        virtual int step(bool &done) noexcept = 0;
+
+        int result_ = OK;
+
+    private:
+        friend class Reactor;
+
+        Reactor *reactor_;
+        uintptr_t *context_;
+        Operation *next_ = nullptr;
+        std::coroutine_handle<> awaiting_;
+        bool started_ = false;
+    };
+
+    Reactor() noexcept = default;
+    Reactor(const Reactor&) = delete;
+    Reactor &operator=(const Reactor&) = delete;
+
+    ~Reactor()
+    {
+        for (Operation *operation = operations_; operation; operation = operation->next_) {
+            if (operation->started_ && operation->context_) {
+                cancelAsyncOperation(operation->context_);
+            }
+        }
+        operations_ = nullptr;
+        operationsTail_ = &operations_;
+
+        for (std::coroutine_handle<> coroutine : spawned_) {
+            coroutine.destroy();
+        }
+    }
+
+    /** \brief Runs the coroutine until it returns, the reactor owns it from now on */
+    void spawn(Task<void> task)
+    {
+        std::coroutine_handle<> coroutine = task.release();
+
+        spawned_.push_back(coroutine);
+        coroutine.resume();
+    }
+
+    /** \brief Makes progress on every pending request without waiting
+        \details
+        Starts the requests whose device is free, takes the replies that came and resumes the coroutines of the
+        requests that are done, after all requests were looked at.
+        \returns
+            Number of requests done.
+    */
+    std::size_t poll() noexcept
+    {
+        Operation *done = nullptr, **doneTail = &done, **link = &operations_;
+        std::size_t numOfDone = 0;
+
+        while (*link) {
+            Operation *operation = *link;
+            bool finished = false;
+
+            if (!operation->started_ && !isDeviceBusy(operation)) {
+                operation->started_ = true;
+                operation->result_ = operation->begin();
+                finished = operation->result_ != OK;
+            }
+            if (operation->started_ && !finished) {
+                operation->result_ = operation->step(finished);
+                finished = finished || operation->result_ != OK;
+            }
+
+            if (!finished) {
+                link = &operation->next_;
+                continue;
+            }
+
+            *link = operation->next_;
+            if (operationsTail_ == &operation->next_) {
+                operationsTail_ = link;
+            }
+            operation->next_ = nullptr;
+            *doneTail = operation;
+            doneTail = &operation->next_;
+            ++numOfDone;
+        }
+
+        //A resumed coroutine may destroy its request and await new ones
+        while (done) {
+            Operation *operation = done;
+
+            done = operation->next_;
+            operation->next_ = nullptr;
+            operation->awaiting_.resume();
+        }
+
+        reapSpawned();
+        return numOfDone;
+    }
+
+    /** \brief Polls until no request is pending and every spawned coroutine returned
+        \param[in] idleInterval - time to sleep after a poll() with no request done
+    */
+    void run(std::chrono::microseconds idleInterval = std::chrono::milliseconds(1))
+    {
+        reapSpawned();
+        while (operations_ || !spawned_.empty()) {
+            if (!poll()) {
+                std::this_thread::sleep_for(idleInterval);
+            }
+        }
+    }
+
+    bool empty() const noexcept { return !operations_ && spawned_.empty(); }
+
+    /** \brief Awaitable resuming the coroutine from the first poll() after the interval */
+    class Sleep : public Operation {
+    public:
+        Sleep(Reactor &reactor, std::chrono::steady_clock::duration interval) noexcept
+            : Operation(reactor, nullptr), deadline_(std::chrono::steady_clock::now() + interval)
+        {
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        int begin() noexcept override { return OK; }
+        int step(bool &done) noexcept override
+        {
+            done = std::chrono::steady_clock::now() >= deadline_;
+            return OK;
+        }
+
+        std::chrono::steady_clock::time_point deadline_;
+    };
+
+    Sleep sleepFor(std::chrono::steady_clock::duration interval) noexcept { return Sleep(*this, interval); }
+
+private:
+    void enqueue(Operation *operation) noexcept
+    {
+        *operationsTail_ = operation;
+        operationsTail_ = &operation->next_;
+    }
+
+    bool isDeviceBusy(const Operation *operation) const noexcept
+    {
+        for (const Operation *earlier = operations_; earlier != operation; earlier = earlier->next_) {
+            if (earlier->started_ && earlier->context_ && earlier->context_ == operation->context_) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void reapSpawned() noexcept
+    {
+        std::size_t i = 0;
+
+        while (i < spawned_.size()) {
+            if (spawned_[i].done()) {
+                spawned_[i].destroy();
+                spawned_[i] = spawned_.back();
+                spawned_.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    Operation *operations_ = nullptr;
+    Operation **operationsTail_ = &operations_;
+    std::vector<std::coroutine_handle<>> spawned_;
+};
+
+/** \brief Status read awaited through a reactor, see beginStatusRead() */
+class StatusRead : public Reactor::Operation {
+public:
+    StatusRead(Reactor &reactor, uintptr_t *context) noexcept : Operation(reactor, context) {}
+
+    Result<Device::Status> await_resume() const noexcept
+    {
+        if (result_ != OK) {
+            return Unexpected(Error{result_});
+        }
+        return status_;
+    }
+
+private:
+    int begin() noexcept override { return beginStatusRead(&status_.statusFlags, &status_.framesInMemory, context()); }
+    int step(bool &done) noexcept override
+    {
+        uint8_t finished = 0;
+        int result = continueStatusRead(&finished, context());
+
+        done = finished != 0;
+        return result;
+    }
+
+    Device::Status status_ = {0, 0};
+};
+
+/** \brief Frame read awaited through a reactor, see beginFrameRead() */
+class FrameRead : public Reactor::Operation {
+public:
+    FrameRead(Reactor &reactor, uintptr_t *context, std::span<uint16_t> buffer, uint16_t numOfPixelsInFrame, uint16_t numOfFrame, FrameMetadata_t *metadata) noexcept
+        : Operation(reactor, context), buffer_(buffer), numOfPixelsInFrame_(numOfPixelsInFrame), numOfFrame_(numOfFrame), metadata_(metadata)
+    {
+    }
+
+    Result<std::span<const uint16_t>> await_resume() const noexcept
+    {
+        if (result_ != OK) {
+            return Unexpected(Error{result_});
+        }
+        if (metadata_) {
+            *metadata_ = frameMetadata_;
+        }
+        return std::span<const uint16_t>(buffer_.data(), frameMetadata_.numOfPixelsInFrame);
+    }
+
+private:
+    int begin() noexcept override
+    {
+        if (buffer_.size() < numOfPixelsInFrame_) {
+            return INVALID_PARAMETER_ERROR;
+        }
+        return beginFrameRead(numOfFrame_, buffer_.data(), &frameMetadata_, context());
+    }
+
+    int step(bool &done) noexcept override
+    {
+        uint8_t finished = 0;
+        int result = continueFrameRead(&finished, context());
+
+        done = finished != 0;
+        return result;
+    }
+
+    std::span<uint16_t> buffer_;
+    uint16_t numOfPixelsInFrame_;
+    uint16_t numOfFrame_;
+    FrameMetadata_t *metadata_;
+    FrameMetadata_t frameMetadata_ = {};
+};
+
+/** \brief Flash read awaited through a reactor, see beginFlashRead() */
+class FlashRead : public Reactor::Operation {
+public:
+    FlashRead(Reactor &reactor, uintptr_t *context, std::span<uint8_t> buffer, uint32_t absoluteOffset) noexcept
+        : Operation(reactor, context), buffer_(buffer), absoluteOffset_(absoluteOffset)
+    {
+    }
+
+    Result<std::span<const uint8_t>> await_resume() const noexcept
+    {
+        if (result_ != OK) {
+            return Unexpected(Error{result_});
+        }
+        return std::span<const uint8_t>(buffer_);
+    }
+
+private:
+    int begin() noexcept override
+    {
+        if (buffer_.size() > UINT32_MAX) {
+            return INVALID_PARAMETER_ERROR;
+        }
+        return beginFlashRead(buffer_.data(), absoluteOffset_, static_cast<uint32_t>(buffer_.size()), context());
+    }
+
+    int step(bool &done) noexcept override
+    {
+        uint8_t finished = 0;
+        int result = continueFlashRead(&finished, context());
+
+        done = finished != 0;
+        return result;
+    }
+
+    std::span<uint8_t> buffer_;
+    uint32_t absoluteOffset_;
+};
+
+/** \brief Awaitable requests to a Device, the device and the reactor must outlive it
+    \details
+    nextFrame() hands out the frames in memory in order, the index of the next one is kept here: call
+    resetFrameIndex() after clearing the memory of the device.
+*/
+class AsyncDevice {
+public:
+    AsyncDevice(Device &device, Reactor &reactor) noexcept : device_(&device), reactor_(&reactor) {}
+
+    Device &device() const noexcept { return *device_; }
+    Reactor &reactor() const noexcept { return *reactor_; }
+
+    /** \brief Triggers an acquisition, there is no reply to wait for */
+    Ready<Result<void>> trigger() noexcept { return {device_->trigger()}; }
+
+    StatusRead status() noexcept { return StatusRead(*reactor_, device_->context()); }
+
+    /** \brief Reads a frame into a caller-provided buffer of at least Device::frameSize() elements, see Device::readFrame() */
+    FrameRead readFrame(std::span<uint16_t> buffer, uint16_t numOfFrame = 0, FrameMetadata_t *metadata = nullptr) noexcept
+    {
+        return FrameRead(*reactor_, device_->context(), buffer, device_->frameSize(), numOfFrame, metadata);
+    }
+
+    /** \brief Reads bytes of the flash at the absolute offset, see readFlash() */
+    FlashRead readFlash(std::span<uint8_t> buffer, uint32_t absoluteOffset) noexcept
+    {
+        return FlashRead(*reactor_, device_->context(), buffer, absoluteOffset);
+    }
+
+    /** \brief Waits for the next frame to be in memory, then reads it
+        \details
+        The status is read every pollInterval until the memory holds the frame.
+    */
+    Task<Result<std::span<const uint16_t>>> nextFrame(std::span<uint16_t> buffer, FrameMetadata_t *metadata = nullptr,
+                                                      std::chrono::steady_clock::duration pollInterval = std::chrono::milliseconds(1))
+    {
+        for (;;) {
+            Result<Device::Status> status = co_await this->status();
+
+            if (!status) {
+                co_return Unexpected(status.error());
+            }
+            if (status->framesInMemory > nextFrameIndex_) {
+                break;
+            }
+            co_await reactor_->sleepFor(pollInterval);
+        }
+
+        Result<std::span<const uint16_t>> frame = co_await readFrame(buffer, nextFrameIndex_, metadata);
+        if (frame) {
+            ++nextFrameIndex_;
+        }
+        co_return frame;
+    }
+
+    /** \brief Descriptor turning readable when the device replies, see getPollFd()
+        \details
+        An event loop driving the reactor calls poll() when it is readable, or after pollTimeout() at the latest.
+    */
+    Result<int> pollFd() const noexcept
+    {
+        int fd = -1;
+        int result = getPollFd(&fd, device_->context());
+
+        if (result != OK) {
+            return Unexpected(Error{result});
+        }
+        return fd;
+    }
+
+    /** \brief Time until the pending request of this device times out, see getPollTimeout() */
+    std::chrono::milliseconds pollTimeout() const noexcept
+    {
+        uint32_t timeoutMilliseconds = 0;
+
+        if (getPollTimeout(&timeoutMilliseconds, device_->context()) != OK) {
+            return std::chrono::milliseconds(0);
+        }
+        return std::chrono::milliseconds(timeoutMilliseconds);
+    }
+
+    uint16_t nextFrameIndex() const noexcept { return nextFrameIndex_; }
+    void resetFrameIndex(uint16_t nextFrameIndex = 0) noexcept { nextFrameIndex_ = nextFrameIndex; }
+
+private:
+    Device *device_;
+    Reactor *reactor_;
+    uint16_t nextFrameIndex_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,522 @@
+#if defined(__linux__)
+    #include <fcntl.h>
+    #include <stdlib.h>
+    #include <string.h>
+    #include <unistd.h>
+#endif
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+/*
+    The begin...() functions write the request and return. The continue...() functions take the replies already in
+    the queue without waiting and tell when the operation is done, successfully or not. A reply that does not come
+    within the reply timeout of its class (see setReplyTimeout()), counted from the request or the last reply, fails
+    the operation the next time continue...() is called. Frame reads request lost packets again like getFrame().
+    The reply times seen here include the delay of the caller and are left out of the latency estimates.
+
+    hidapi does not give out the descriptor it reads from. With the hidraw backend the device node can be opened
+    a second time: every reader of a hidraw node gets its own copy of every report, so the second descriptor turns
+    readable whenever a reply comes. It is only waited on, continue...() empties it before taking the replies.
+*/
+
+#define FLASH_PAYLOAD_SIZE (PACKET_SIZE - 4)
+
+static int _prepareAsyncOperation(DeviceContext_t *deviceContext, uintptr_t *deviceContextPtr)
+{
+    if (deviceContext->asyncOperation.kind != ASYNC_OPERATION_NONE) {
+        return INVALID_STATE_ERROR;
+    }
+
+    if (!deviceContext->handle) {
+        return _reconnect(deviceContextPtr);
+    }
+
+    return OK;
+}
+
+static uint8_t _getPendingLatencyClass(const DeviceContext_t *deviceContext)
+{
+    const AsyncOperation_t *operation = &deviceContext->asyncOperation;
+
+    if (operation->kind == ASYNC_FRAME_READ) {
+        return operation->frameTransfer.numOfReadsInRequest? LATENCY_FRAME_PACKET : LATENCY_FRAME_FIRST_PACKET;
+    }
+    if (operation->kind == ASYNC_STATUS_READ) {
+        return LATENCY_STATUS;
+    }
+    return (operation->kind == ASYNC_FLASH_READ)? LATENCY_READ_FLASH_PACKET : LATENCY_COMMAND;
+}
+
+static bool _isReplyOverdue(const DeviceContext_t *deviceContext)
+{
+    uint64_t timeout = (uint64_t)_getReadTimeout(deviceContext, _getPendingLatencyClass(deviceContext)) * 1000000ULL;
+
+    return _getMonotonicNanoseconds() - deviceContext->asyncOperation.lastActivityTimestamp > timeout;
+}
+
+#if defined(__linux__)
+static int _openPollFd(DeviceContext_t *deviceContext)
+{
+    struct hid_device_info *devices = hid_enumerate(USBD_VID, USBD_PID), *device = NULL;
+    char serial[256];
+    int fd = -1;
+
+    //The device hid_open() picked: the first one, or the one with the serial number
+    for (device = devices; device; device = device->next) {
+        if (!deviceContext->serial) {
+            break;
+        }
+
+        memset(serial, 0, sizeof(serial));
+        if (device->serial_number && wcstombs(serial, device->serial_number, sizeof(serial) - 1) != (size_t)-1 && !strcmp(serial, deviceContext->serial)) {
+            break;
+        }
+    }
+
+    //Only the hidraw backend has a device node, the libusb one gives a bus address
+    if (device && device->path && !strncmp(device->path, "/dev/", 5)) {
+        fd = open(device->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    }
+    hid_free_enumeration(devices);
+
+    if (fd < 0) {
+        return INVALID_STATE_ERROR;
+    }
+
+    deviceContext->pollFd = fd;
+    deviceContext->pollFdOpen = true;
+    return OK;
+}
+#endif
+
+static void _drainPollFd(DeviceContext_t *deviceContext)
+{
+#if defined(__linux__)
+    unsigned char report[EXTENDED_PACKET_SIZE];
+
+    if (deviceContext->pollFdOpen) {
+        while (read(deviceContext->pollFd, report, sizeof(report)) > 0) {
+        }
+    }
+#endif
+}
+
+void _closePollFd(DeviceContext_t *deviceContext)
+{
+#if defined(__linux__)
+    if (deviceContext->pollFdOpen) {
+        close(deviceContext->pollFd);
+        deviceContext->pollFdOpen = false;
+    }
+#endif
+}
+
+static void _endAsyncOperation(DeviceContext_t *deviceContext, uint8_t *done)
+{
+    deviceContext->asyncOperation.kind = ASYNC_OPERATION_NONE;
+    *done = 1;
+}
+
+static int _requestFlashPackets(DeviceContext_t *deviceContext, uintptr_t *deviceContextPtr)
+{
+    unsigned char report[EXTENDED_PACKET_SIZE];
+    AsyncOperation_t *operation = &deviceContext->asyncOperation;
+    uint32_t offset = operation->flashOffset + operation->flashRequestOffset;
+
+    operation->numOfFlashPacketsRequested = (uint8_t)((operation->numOfFlashPacketsToRequest > MAX_READ_FLASH_PACKETS)? MAX_READ_FLASH_PACKETS : operation->numOfFlashPacketsToRequest);
+    operation->numOfFlashPacketsReceived = 0;
+
+    report[0] = ZERO_REPORT_ID;
+    report[1] = READ_FLASH_REQUEST;
+    report[2] = LOW_BYTE(LOW_WORD(offset));
+    report[3] = HIGH_BYTE(LOW_WORD(offset));
+    report[4] = LOW_BYTE(HIGH_WORD(offset));
+    report[5] = HIGH_BYTE(HIGH_WORD(offset));
+    report[6] = operation->numOfFlashPacketsRequested;
+
+    operation->lastActivityTimestamp = _getMonotonicNanoseconds();
+    return _tryWrite(report, deviceContextPtr);
+}
+
+int beginStatusRead(uint8_t *statusFlags, uint16_t *framesInMemory, uintptr_t *deviceContextPtr)
+{
+    unsigned char report[EXTENDED_PACKET_SIZE];
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+
+    result = _prepareAsyncOperation(deviceContext, deviceContextPtr);
+    if (result == OK) {
+        report[0] = ZERO_REPORT_ID;
+        report[1] = STATUS_REQUEST;
+
+        deviceContext->asyncOperation.lastActivityTimestamp = _getMonotonicNanoseconds();
+        result = _tryWrite(report, deviceContextPtr);
+    }
+
+    if (result == OK) {
+        deviceContext->asyncOperation.kind = ASYNC_STATUS_READ;
+        deviceContext->asyncOperation.statusFlags = statusFlags;
+        deviceContext->asyncOperation.framesInMemory = framesInMemory;
+    }
+
+    _mutexUnlock(&deviceContext->mutex);
+    return result;
+}
+
+int continueStatusRead(uint8_t *done, uintptr_t *deviceContextPtr)
+{
+    unsigned char report[EXTENDED_PACKET_SIZE];
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+    AsyncOperation_t *operation = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!done) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+    *done = 0;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+    operation = &deviceContext->asyncOperation;
+
+    _mutexLock(&deviceContext->mutex);
+
+    //Before the replies are taken, so one coming after them leaves it readable
+    _drainPollFd(deviceContext);
+
+    if (operation->kind != ASYNC_STATUS_READ) {
+        _mutexUnlock(&deviceContext->mutex);
+        return INVALID_STATE_ERROR;
+    }
+
+    result = hid_read_timeout(deviceContext->handle, report, EXTENDED_PACKET_SIZE, 0);
+    if (result == HID_OPERATION_READ_SUCCESS) {
+        result = (report[0] == CORRECT_STATUS_REPLY)? OK : WRONG_ANSWER;
+        if (result == OK) {
+            _storeStatus(deviceContext, report[1], (report[3] << 8) | (report[2]), operation->lastActivityTimestamp);
+        }
+        if (result == OK && operation->statusFlags) {
+            *operation->statusFlags = report[1];
+        }
+        if (result == OK && operation->framesInMemory) {
+            *operation->framesInMemory = (report[3] << 8) | (report[2]);
+        }
+        _endAsyncOperation(deviceContext, done);
+    } else if (result != 0 || _isReplyOverdue(deviceContext)) {
+        result = READING_PROCESS_FAILED;
+        _endAsyncOperation(deviceContext, done);
+    } else {
+        result = OK;
+    }
+
+    _mutexUnlock(&deviceContext->mutex);
+    return result;
+}
+
+int beginFrameRead(uint16_t numOfFrame, uint16_t *framePixelsBuffer, FrameMetadata_t *metadata, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+
+    result = _prepareAsyncOperation(deviceContext, deviceContextPtr);
+    if (result == OK) {
+        result = _beginFrameTransfer(&deviceContext->asyncOperation.frameTransfer, framePixelsBuffer, numOfFrame, NULL, NULL, deviceContextPtr);
+    }
+
+    if (result == OK) {
+        deviceContext->asyncOperation.kind = ASYNC_FRAME_READ;
+        deviceContext->asyncOperation.frameMetadata = metadata;
+        deviceContext->asyncOperation.lastActivityTimestamp = deviceContext->asyncOperation.frameTransfer.requestTimestamp;
+    }
+
+    _mutexUnlock(&deviceContext->mutex);
+    return result;
+}
+
+int continueFrameRead(uint8_t *done, uintptr_t *deviceContextPtr)
+{
+    unsigned char report[EXTENDED_PACKET_SIZE];
+    int result = -1, readResult = -1;
+    bool complete = false;
+    DeviceContext_t *deviceContext = NULL;
+    AsyncOperation_t *operation = NULL;
+    FrameTransfer_t *transfer = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!done) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+    *done = 0;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+    operation = &deviceContext->asyncOperation;
+    transfer = &operation->frameTransfer;
+
+    _mutexLock(&deviceContext->mutex);
+
+    //Before the replies are taken, so one coming after them leaves it readable
+    _drainPollFd(deviceContext);
+
+    if (operation->kind != ASYNC_FRAME_READ) {
+        _mutexUnlock(&deviceContext->mutex);
+        return INVALID_STATE_ERROR;
+    }
+
+    while (!complete && result == OK) {
+        readResult = hid_read_timeout(deviceContext->handle, report, EXTENDED_PACKET_SIZE, 0);
+        if (readResult == HID_OPERATION_READ_SUCCESS) {
+            operation->lastActivityTimestamp = _getMonotonicNanoseconds();
+            if (_handleFramePacket(transfer, deviceContext, report) == FRAME_TRANSFER_RECEIVING) {
+                continue;
+            }
+        } else if (readResult == 0 && !_isReplyOverdue(deviceContext)) {
+            break;
+        } else {
+            transfer->failure = READING_PROCESS_FAILED;
+        }
+
+        result = _endFrameRequest(transfer, deviceContextPtr, &complete);
+        operation->lastActivityTimestamp = _getMonotonicNanoseconds();
+    }
+
+    if (complete) {
+        _finishFrameTransfer(transfer, deviceContext, operation->frameMetadata);
+    }
+    if (complete || result != OK) {
+        _endAsyncOperation(deviceContext, done);
+    }
+
+    _mutexUnlock(&deviceContext->mutex);
+    return result;
+}
+
+int beginFlashRead(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+    AsyncOperation_t *operation = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!buffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+    operation = &deviceContext->asyncOperation;
+
+    _mutexLock(&deviceContext->mutex);
+
+    result = _prepareAsyncOperation(deviceContext, deviceContextPtr);
+    if (result == OK) {
+        operation->flashBuffer = buffer;
+        operation->flashOffset = absoluteOffset;
+        operation->numOfFlashBytes = bytesToRead;
+        operation->numOfFlashPacketsToRequest = (bytesToRead + FLASH_PAYLOAD_SIZE - 1) / FLASH_PAYLOAD_SIZE;
+        operation->flashRequestOffset = 0;
+        operation->numOfFlashPacketsRequested = 0;
+
+        if (operation->numOfFlashPacketsToRequest) {
+            result = _requestFlashPackets(deviceContext, deviceContextPtr);
+        }
+    }
+
+    if (result == OK) {
+        operation->kind = ASYNC_FLASH_READ;
+    }
+
+    _mutexUnlock(&deviceContext->mutex);
+    return result;
+}
+
+int continueFlashRead(uint8_t *done, uintptr_t *deviceContextPtr)
+{
+    unsigned char report[EXTENDED_PACKET_SIZE];
+    int result = -1, readResult = -1;
+    bool complete = false;
+    uint16_t localOffset = 0;
+    uint8_t numOfPacketsLeft = 0;
+    uint32_t i = 0;
+    DeviceContext_t *deviceContext = NULL;
+    AsyncOperation_t *operation = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!done) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+    *done = 0;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+    operation = &deviceContext->asyncOperation;
+
+    _mutexLock(&deviceContext->mutex);
+
+    //Before the replies are taken, so one coming after them leaves it readable
+    _drainPollFd(deviceContext);
+
+    if (operation->kind != ASYNC_FLASH_READ) {
+        _mutexUnlock(&deviceContext->mutex);
+        return INVALID_STATE_ERROR;
+    }
+
+    complete = !operation->numOfFlashPacketsRequested;
+    while (!complete && result == OK) {
+        readResult = hid_read_timeout(deviceContext->handle, report, EXTENDED_PACKET_SIZE, 0);
+        if (readResult == 0 && !_isReplyOverdue(deviceContext)) {
+            break;
+        }
+        if (readResult != HID_OPERATION_READ_SUCCESS) {
+            result = READING_PROCESS_FAILED;
+            break;
+        }
+
+        operation->lastActivityTimestamp = _getMonotonicNanoseconds();
+        ++operation->numOfFlashPacketsReceived;
+
+        if (report[0] != CORRECT_READ_FLASH_REPLY) {
+            result = WRONG_ANSWER;
+            break;
+        }
+
+        numOfPacketsLeft = report[3];
+        if (numOfPacketsLeft >= REMAINING_PACKETS_ERROR || numOfPacketsLeft != operation->numOfFlashPacketsRequested - operation->numOfFlashPacketsReceived) {
+            result = READ_FLASH_REMAINING_PACKETS_ERROR;
+            break;
+        }
+
+        localOffset = (report[2] << 8) | report[1];
+        for (i = 0; i < FLASH_PAYLOAD_SIZE && operation->flashRequestOffset + localOffset + i < operation->numOfFlashBytes; ++i) {
+            operation->flashBuffer[operation->flashRequestOffset + localOffset + i] = report[4 + i];
+        }
+
+        if (!numOfPacketsLeft) {
+            operation->numOfFlashPacketsToRequest -= operation->numOfFlashPacketsRequested;
+            operation->flashRequestOffset += operation->numOfFlashPacketsRequested * FLASH_PAYLOAD_SIZE;
+
+            if (operation->numOfFlashPacketsToRequest) {
+                result = _requestFlashPackets(deviceContext, deviceContextPtr);
+            } else {
+                complete = true;
+            }
+        }
+    }
+
+    if (complete || result != OK) {
+        _endAsyncOperation(deviceContext, done);
+    }
+
+    _mutexUnlock(&deviceContext->mutex);
+    return result;
+}
+
+int cancelAsyncOperation(uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    if (deviceContext->asyncOperation.kind != ASYNC_OPERATION_NONE) {
+        //The rest of the replies may still come, they are dropped by the next request that goes wrong
+        if (deviceContext->handle) {
+            _flushReports(deviceContext);
+        }
+        _drainPollFd(deviceContext);
+        deviceContext->asyncOperation.kind = ASYNC_OPERATION_NONE;
+    }
+    _mutexUnlock(&deviceContext->mutex);
+
+    return OK;
+}
+
+int getPollFd(int *fd, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!fd) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+#if defined(__linux__)
+    result = deviceContext->pollFdOpen? OK : _openPollFd(deviceContext);
+    *fd = (result == OK)? deviceContext->pollFd : -1;
+#else
+    result = INVALID_STATE_ERROR;
+    *fd = -1;
+#endif
+    _mutexUnlock(&deviceContext->mutex);
+
+    return result;
+}
+
+int getPollTimeout(uint32_t *timeoutMilliseconds, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+    uint64_t timeout = 0, elapsed = 0;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!timeoutMilliseconds) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    if (deviceContext->asyncOperation.kind == ASYNC_OPERATION_NONE) {
+        *timeoutMilliseconds = 0xFFFFFFFF;
+    } else {
+        timeout = (uint64_t)_getReadTimeout(deviceContext, _getPendingLatencyClass(deviceContext)) * 1000000ULL;
+        elapsed = _getMonotonicNanoseconds() - deviceContext->asyncOperation.lastActivityTimestamp;
+
+        //Rounded up past the timeout, so the continue...() call after the wait finds the reply overdue
+        *timeoutMilliseconds = (elapsed > timeout)? 0 : (uint32_t)((timeout - elapsed) / 1000000ULL + 1);
+    }
+    _mutexUnlock(&deviceContext->mutex);
+
+    return OK;
+}
@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+typedef struct AveragingState_t {
+    uint64_t lastResultTimestamp;
+    uint64_t lastReadyTimestamp;
+    uint64_t periodNanoseconds;       //observed time between two consecutive results
+    bool lastReadyObserved;           //the last result was seen turning ready, not found already waiting
+    AveragingStatistics_t statistics;
+} AveragingState_t;
+
+void _freeAveragingState(DeviceContext_t *deviceContext)
+{
+    free(deviceContext->averagingState);
+    deviceContext->averagingState = NULL;
+}
+
+static uint64_t _getExpectedPeriod(const DeviceContext_t *deviceContext, const AveragingState_t *state)
+{
+    if (state->periodNanoseconds) {
+        return state->periodNanoseconds;
+    }
+
+    //timeOfExposure is a multiple of 10 us
+    return (uint64_t)(deviceContext->numOfScans? deviceContext->numOfScans : 1) * deviceContext->timeOfExposure * 10000ULL;
+}
+
+static uint32_t _getPollInterval(uint64_t expectedPeriod)
+{
+    uint64_t interval = expectedPeriod / AVERAGING_POLLS_PER_PERIOD / 1000;
+
+    if (interval < AVERAGING_MIN_POLL_INTERVAL_MICROSECONDS) {
+        return AVERAGING_MIN_POLL_INTERVAL_MICROSECONDS;
+    }
+
+    if (interval > AVERAGING_MAX_POLL_INTERVAL_MICROSECONDS) {
+        return AVERAGING_MAX_POLL_INTERVAL_MICROSECONDS;
+    }
+
+    return (uint32_t)interval;
+}
+
+int getAveragedFrame(uint16_t *framePixelsBuffer, AveragedFrameInfo_t *info, uint32_t timeoutMilliseconds, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    uint16_t readyState = 0;
+    uint32_t numOfPolls = 0, lostResults = 0;
+    uint64_t callTimestamp = 0, deadline = 0, now = 0, reference = 0, expectedPeriod = 0, expectedReady = 0;
+    uint64_t latency = 0, interval = 0;
+    DeviceContext_t *deviceContext = NULL;
+    AveragingState_t *state = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!framePixelsBuffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (!deviceContext->acquisitionParametersKnown) {
+        result = getAcquisitionParameters(NULL, NULL, NULL, NULL, deviceContextPtr);
+        if (result != OK)
+            return result;
+    }
+
+    if (deviceContext->scanMode != FRAME_AVERAGING_MODE) {
+        return INVALID_STATE_ERROR;
+    }
+
+    if (!deviceContext->averagingState) {
+        deviceContext->averagingState = calloc(1, sizeof(AveragingState_t));
+        if (!deviceContext->averagingState) {
+            return MEMORY_ALLOCATION_ERROR;
+        }
+    }
+    state = deviceContext->averagingState;
+
+    callTimestamp = _getMonotonicNanoseconds();
+    deadline = callTimestamp + (uint64_t)timeoutMilliseconds * 1000000ULL;
+
+    reference = state->lastResultTimestamp;
+    if (deviceContext->lastTriggerTimestamp > reference) {
+        reference = deviceContext->lastTriggerTimestamp;
+    }
+    if (!reference) {
+        reference = callTimestamp;
+    }
+
+    expectedPeriod = _getExpectedPeriod(deviceContext, state);
+    expectedReady = reference + expectedPeriod;
+
+    //Nothing can be ready before the averaging period is over, no need to ask the device
+    now = _getMonotonicNanoseconds();
+    if (expectedReady > now + AVERAGING_EARLY_WAKEUP_NANOSECONDS) {
+        if (expectedReady - AVERAGING_EARLY_WAKEUP_NANOSECONDS < deadline) {
+            _sleepMicroseconds((uint32_t)((expectedReady - AVERAGING_EARLY_WAKEUP_NANOSECONDS - now) / 1000));
+        }
+    }
+
+    for (;;) {
+        result = _getStatus(NULL, &readyState, false, deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+        ++numOfPolls;
+        now = _getMonotonicNanoseconds();
+
+        if (readyState != AVERAGED_FRAME_NOT_READY) {
+            break;
+        }
+
+        if (now >= deadline) {
+            state->statistics.numOfPolls += numOfPolls;
+            ++state->statistics.timeouts;
+            return TIMEOUT_ERROR;
+        }
+
+        _sleepMicroseconds(_getPollInterval(expectedPeriod));
+    }
+
+    result = getFrame(framePixelsBuffer, 0xFFFF, deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    //The ready moment is only known to lie between the last two polls
+    latency = now - reference;
+
+    if (readyState == AVERAGED_FRAME_READY_WITH_LOST) {
+        lostResults = 1;
+        if (expectedPeriod && latency / expectedPeriod > 1) {
+            lostResults = (uint32_t)(latency / expectedPeriod - 1);
+        }
+    } else if (numOfPolls > 1 && state->lastReadyObserved) {
+        //Only two gap-free results both seen turning ready measure the averaging period
+        interval = now - state->lastReadyTimestamp;
+        state->periodNanoseconds = state->periodNanoseconds? (7 * state->periodNanoseconds + interval) / 8 : interval;
+    }
+
+    state->lastReadyObserved = (numOfPolls > 1);
+    state->lastReadyTimestamp = now;
+    state->lastResultTimestamp = _getMonotonicNanoseconds();
+
+    ++state->statistics.results;
+    state->statistics.numOfPolls += numOfPolls;
+    state->statistics.totalLatencyNanoseconds += latency;
+    if (!state->statistics.minLatencyNanoseconds || latency < state->statistics.minLatencyNanoseconds) {
+        state->statistics.minLatencyNanoseconds = latency;
+    }
+    if (latency > state->statistics.maxLatencyNanoseconds) {
+        state->statistics.maxLatencyNanoseconds = latency;
+    }
+    if (lostResults) {
+        ++state->statistics.resultsWithLoss;
+        state->statistics.estimatedLostResults += lostResults;
+        state->statistics.estimatedLostScans += (uint64_t)lostResults * deviceContext->numOfScans;
+    }
+    state->statistics.periodNanoseconds = state->periodNanoseconds;
+
+    if (info) {
+        info->readyTimestamp = now;
+        info->latencyNanoseconds = latency;
+        info->waitNanoseconds = now - callTimestamp;
+        info->numOfPolls = numOfPolls;
+        info->estimatedLostResults = lostResults;
+        info->estimatedLostScans = lostResults * deviceContext->numOfScans;
+        info->lost = (readyState == AVERAGED_FRAME_READY_WITH_LOST)? 1 : 0;
+    }
+
+    return OK;
+}
+
+int getAveragingStatistics(AveragingStatistics_t *statistics, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!statistics) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (deviceContext->averagingState) {
+        *statistics = deviceContext->averagingState->statistics;
+    } else {
+        memset(statistics, 0, sizeof(AveragingStatistics_t));
+    }
+
+    return OK;
+}
+
+int resetAveragingStatistics(uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (deviceContext->averagingState) {
+        memset(&deviceContext->averagingState->statistics, 0, sizeof(AveragingStatistics_t));
+    }
+
+    return OK;
+}
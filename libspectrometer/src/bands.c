@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+/*
+    prefixSums[i] holds the sum of the first i elements of the frame, so the integral of a band [first, end)
+    is prefixSums[end] - prefixSums[first] whatever its width. getBandFrame() builds the sums packet by packet
+    while the frame is decoded.
+*/
+
+typedef struct BandIntegrator_t {
+    uint16_t numOfPixelsInFrame;
+    uint32_t numOfBands;
+    uint16_t *bandEdges;
+    uint32_t *prefixSums;
+
+    /* Frame read by getBandFrame() */
+    uint16_t *framePixels;
+} BandIntegrator_t;
+
+static BandIntegrator_t *_getBandIntegrator(uintptr_t *bandIntegratorPtr)
+{
+    if (!bandIntegratorPtr || !*bandIntegratorPtr) {
+        return NULL;
+    }
+
+    return (BandIntegrator_t*)(*bandIntegratorPtr);
+}
+
+static void _freeBandIntegrator(BandIntegrator_t *integrator)
+{
+    free(integrator->bandEdges);
+    free(integrator->prefixSums);
+    free(integrator->framePixels);
+    free(integrator);
+}
+
+static void _accumulatePrefixSums(void *hookState, const uint16_t *framePixels, uint32_t firstPixel, uint32_t endPixel)
+{
+    uint32_t *prefixSums = ((BandIntegrator_t*)hookState)->prefixSums;
+    uint32_t i = 0, sum = prefixSums[firstPixel];
+
+    //At most 3720 * 65535, the sums fit 32 bits
+    for (i = firstPixel; i < endPixel; ++i) {
+        sum += framePixels[i];
+        prefixSums[i + 1] = sum;
+    }
+}
+
+static void _integrateBands(const BandIntegrator_t *integrator, uint32_t *bandSums)
+{
+    uint32_t i = 0;
+    const uint16_t *edges = integrator->bandEdges;
+
+    for (i = 0; i < integrator->numOfBands; ++i) {
+        bandSums[i] = integrator->prefixSums[edges[2 * i + 1]] - integrator->prefixSums[edges[2 * i]];
+    }
+}
+
+int createBandIntegrator(const uint16_t *bandEdges, uint32_t numOfBands, uint16_t numOfPixelsInFrame, uintptr_t *bandIntegratorPtr)
+{
+    uint32_t i = 0;
+    BandIntegrator_t *integrator = NULL;
+
+    if (!bandEdges || !bandIntegratorPtr) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!numOfBands || !numOfPixelsInFrame || numOfPixelsInFrame > MAX_NUM_OF_PIXELS_IN_FRAME) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    for (i = 0; i < numOfBands; ++i) {
+        if (bandEdges[2 * i] > bandEdges[2 * i + 1] || bandEdges[2 * i + 1] > numOfPixelsInFrame) {
+            return INVALID_PARAMETER_ERROR;
+        }
+    }
+
+    integrator = calloc(1, sizeof(BandIntegrator_t));
+    if (integrator) {
+        integrator->bandEdges = malloc(2 * numOfBands * sizeof(uint16_t));
+        integrator->prefixSums = malloc((MAX_NUM_OF_PIXELS_IN_FRAME + 1) * sizeof(uint32_t));
+        integrator->framePixels = malloc(MAX_NUM_OF_PIXELS_IN_FRAME * sizeof(uint16_t));
+    }
+    if (!integrator || !integrator->bandEdges || !integrator->prefixSums || !integrator->framePixels) {
+        if (integrator) {
+            _freeBandIntegrator(integrator);
+        }
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    memcpy(integrator->bandEdges, bandEdges, 2 * numOfBands * sizeof(uint16_t));
+    integrator->numOfBands = numOfBands;
+    integrator->numOfPixelsInFrame = numOfPixelsInFrame;
+    integrator->prefixSums[0] = 0;
+
+    if (*bandIntegratorPtr) {
+        destroyBandIntegrator(bandIntegratorPtr);
+    }
+    *bandIntegratorPtr = (uintptr_t)integrator;
+
+    return OK;
+}
+
+int destroyBandIntegrator(uintptr_t *bandIntegratorPtr)
+{
+    BandIntegrator_t *integrator = _getBandIntegrator(bandIntegratorPtr);
+
+    if (!integrator) {
+        return OK;
+    }
+
+    _freeBandIntegrator(integrator);
+    *bandIntegratorPtr = 0;
+
+    return OK;
+}
+
+int integrateBands(const uint16_t *framePixels, uint16_t numOfPixelsInFrame, uint32_t *bandSums, uintptr_t *bandIntegratorPtr)
+{
+    BandIntegrator_t *integrator = _getBandIntegrator(bandIntegratorPtr);
+
+    if (!integrator || !framePixels || !bandSums) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (numOfPixelsInFrame != integrator->numOfPixelsInFrame) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    _accumulatePrefixSums(integrator, framePixels, 0, numOfPixelsInFrame);
+    _integrateBands(integrator, bandSums);
+
+    return OK;
+}
+
+int getBandFrame(uint32_t *bandSums, uint16_t numOfFrame, FrameMetadata_t *metadata, uintptr_t *bandIntegratorPtr, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    FrameMetadata_t frameMetadata;
+    BandIntegrator_t *integrator = _getBandIntegrator(bandIntegratorPtr);
+
+    if (!integrator || !bandSums) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    result = _getFrameWithHook(integrator->framePixels, numOfFrame, &frameMetadata, _accumulatePrefixSums, integrator, deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    //The frame format changed since the bands were set
+    if (frameMetadata.numOfPixelsInFrame != integrator->numOfPixelsInFrame) {
+        return INVALID_STATE_ERROR;
+    }
+
+    _integrateBands(integrator, bandSums);
+
+    if (metadata) {
+        *metadata = frameMetadata;
+    }
+
+    return OK;
+}
@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define BINNING_SSE2
+    #include <emmintrin.h>
+#endif
+
+/*
+    The bin map is compiled into runs of adjacent elements going to the same bin, ordered by element.
+    A frame is reduced in one pass over the runs: every run is summed into its bin, then the sums are scaled
+    by the per-bin weights (1 / number of elements in mean mode, 1 in sum mode).
+*/
+
+typedef struct BinningRun_t {
+    uint16_t firstPixel;
+    uint16_t numOfPixels;
+    uint16_t bin;
+} BinningRun_t;
+
+typedef struct Binning_t {
+    uint16_t numOfPixelsInFrame;
+    uint16_t numOfBins;
+    uint32_t numOfRuns;
+    BinningRun_t *runs;
+    float *weights;
+    uint32_t *sums;
+
+    /* Frame read by getBinnedFrame() */
+    uint16_t *framePixels;
+} Binning_t;
+
+static Binning_t *_getBinning(uintptr_t *binningPtr)
+{
+    if (!binningPtr || !*binningPtr) {
+        return NULL;
+    }
+
+    return (Binning_t*)(*binningPtr);
+}
+
+static void _freeBinning(Binning_t *binning)
+{
+    free(binning->runs);
+    free(binning->weights);
+    free(binning->sums);
+    free(binning->framePixels);
+    free(binning);
+}
+
+static uint32_t _sumPixels(const uint16_t *pixels, uint32_t numOfPixels)
+{
+    uint32_t i = 0, sum = 0;
+
+#if defined(BINNING_SSE2)
+    __m128i zero = _mm_setzero_si128(), accumulator = _mm_setzero_si128(), block;
+    uint32_t lanes[4];
+
+    if (numOfPixels >= 16) {
+        for (; i + 8 <= numOfPixels; i += 8) {
+            block = _mm_loadu_si128((const __m128i*)(pixels + i));
+            accumulator = _mm_add_epi32(accumulator, _mm_unpacklo_epi16(block, zero));
+            accumulator = _mm_add_epi32(accumulator, _mm_unpackhi_epi16(block, zero));
+        }
+
+        _mm_storeu_si128((__m128i*)lanes, accumulator);
+        sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+#endif
+
+    for (; i < numOfPixels; ++i) {
+        sum += pixels[i];
+    }
+
+    return sum;
+}
+
+static void _reduceFrame(Binning_t *binning, const uint16_t *framePixels, float *binnedValues)
+{
+    uint32_t i = 0;
+    const BinningRun_t *run = NULL;
+
+    memset(binning->sums, 0, binning->numOfBins * sizeof(uint32_t));
+
+    for (i = 0; i < binning->numOfRuns; ++i) {
+        run = &binning->runs[i];
+        binning->sums[run->bin] += (run->numOfPixels == 1)? framePixels[run->firstPixel] : _sumPixels(framePixels + run->firstPixel, run->numOfPixels);
+    }
+
+    for (i = 0; i < binning->numOfBins; ++i) {
+        binnedValues[i] = (float)binning->sums[i] * binning->weights[i];
+    }
+}
+
+int createBinning(const uint16_t *binMap, uint16_t numOfPixelsInFrame, uint8_t /*BinningMode_t*/ binningMode, uint16_t *numOfBins, uintptr_t *binningPtr)
+{
+    uint32_t i = 0, numOfRuns = 0, bins = 0;
+    uint32_t *binSizes = NULL;
+    Binning_t *binning = NULL;
+
+    if (!binMap || !binningPtr) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!numOfPixelsInFrame || numOfPixelsInFrame > MAX_NUM_OF_PIXELS_IN_FRAME || binningMode > BINNING_SUM) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    for (i = 0; i < numOfPixelsInFrame; ++i) {
+        if (binMap[i] == BINNING_NO_BIN) {
+            continue;
+        }
+        if (binMap[i] + 1u > bins) {
+            bins = binMap[i] + 1u;
+        }
+        if (!i || binMap[i] != binMap[i - 1]) {
+            ++numOfRuns;
+        }
+    }
+
+    if (!bins) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    binning = calloc(1, sizeof(Binning_t));
+    binSizes = calloc(bins, sizeof(uint32_t));
+    if (binning) {
+        binning->runs = malloc(numOfRuns * sizeof(BinningRun_t));
+        binning->weights = malloc(bins * sizeof(float));
+        binning->sums = malloc(bins * sizeof(uint32_t));
+        binning->framePixels = malloc(MAX_NUM_OF_PIXELS_IN_FRAME * sizeof(uint16_t));
+    }
+    if (!binning || !binSizes || !binning->runs || !binning->weights || !binning->sums || !binning->framePixels) {
+        if (binning) {
+            _freeBinning(binning);
+        }
+        free(binSizes);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    binning->numOfPixelsInFrame = numOfPixelsInFrame;
+    binning->numOfBins = (uint16_t)bins;
+
+    for (i = 0; i < numOfPixelsInFrame; ++i) {
+        if (binMap[i] == BINNING_NO_BIN) {
+            continue;
+        }
+
+        ++binSizes[binMap[i]];
+        if (binning->numOfRuns && binMap[i] == binMap[i - 1]) {
+            ++binning->runs[binning->numOfRuns - 1].numOfPixels;
+        } else {
+            binning->runs[binning->numOfRuns].firstPixel = (uint16_t)i;
+            binning->runs[binning->numOfRuns].numOfPixels = 1;
+            binning->runs[binning->numOfRuns].bin = binMap[i];
+            ++binning->numOfRuns;
+        }
+    }
+
+    //Bins without elements read 0
+    for (i = 0; i < bins; ++i) {
+        binning->weights[i] = (binningMode == BINNING_MEAN && binSizes[i])? 1.0f / (float)binSizes[i] : 1.0f;
+    }
+    free(binSizes);
+
+    if (*binningPtr) {
+        destroyBinning(binningPtr);
+    }
+    *binningPtr = (uintptr_t)binning;
+
+    if (numOfBins) {
+        *numOfBins = binning->numOfBins;
+    }
+
+    return OK;
+}
+
+int destroyBinning(uintptr_t *binningPtr)
+{
+    Binning_t *binning = _getBinning(binningPtr);
+
+    if (!binning) {
+        return OK;
+    }
+
+    _freeBinning(binning);
+    *binningPtr = 0;
+
+    return OK;
+}
+
+int binFrame(const uint16_t *framePixels, uint16_t numOfPixelsInFrame, float *binnedValues, uintptr_t *binningPtr)
+{
+    Binning_t *binning = _getBinning(binningPtr);
+
+    if (!binning || !framePixels || !binnedValues) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (numOfPixelsInFrame != binning->numOfPixelsInFrame) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    _reduceFrame(binning, framePixels, binnedValues);
+
+    return OK;
+}
+
+int getBinnedFrame(float *binnedValues, uint16_t numOfFrame, FrameMetadata_t *metadata, uintptr_t *binningPtr, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    FrameMetadata_t frameMetadata;
+    Binning_t *binning = _getBinning(binningPtr);
+
+    if (!binning || !binnedValues) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    result = getFrameWithMetadata(binning->framePixels, numOfFrame, &frameMetadata, deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    //The frame format changed since the map was made
+    if (frameMetadata.numOfPixelsInFrame != binning->numOfPixelsInFrame) {
+        return INVALID_STATE_ERROR;
+    }
+
+    _reduceFrame(binning, binning->framePixels, binnedValues);
+
+    if (metadata) {
+        *metadata = frameMetadata;
+    }
+
+    return OK;
+}
@@ -0,0 +1,719 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+typedef struct CaptureFile_t {
+    CaptureFileHeader_t *header;      //start of the mapping
+    uint8_t *records;
+    uint64_t mappingSize;
+    bool writable;
+
+    /* Writers reserve records with an atomic increment, so several devices can share one file without a lock */
+    volatile uint32_t numOfReservations;
+
+#if defined(_WIN32)
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+} CaptureFile_t;
+
+static uint32_t _alignRecord(uint32_t size)
+{
+    return (size + CAPTURE_RECORD_ALIGNMENT - 1) / CAPTURE_RECORD_ALIGNMENT * CAPTURE_RECORD_ALIGNMENT;
+}
+
+static CaptureFile_t *_getCaptureFile(uintptr_t *captureFilePtr)
+{
+    if (!captureFilePtr || !*captureFilePtr) {
+        return NULL;
+    }
+
+    return (CaptureFile_t*)(*captureFilePtr);
+}
+
+static CaptureRecord_t *_getRecord(CaptureFile_t *file, uint32_t index)
+{
+    return (CaptureRecord_t*)(file->records + (size_t)index * file->header->recordSize);
+}
+
+static uint16_t *_getRecordPixels(CaptureFile_t *file, uint32_t index)
+{
+    return (uint16_t*)((uint8_t*)_getRecord(file, index) + file->header->pixelsOffset);
+}
+
+static int _mapFile(CaptureFile_t *file, const char *path, uint64_t size)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER fileSize;
+
+    file->file = CreateFileA(path, file->writable? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, file->writable? CREATE_ALWAYS : OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file->file == INVALID_HANDLE_VALUE) {
+        return FILE_ERROR;
+    }
+
+    if (!size) {
+        if (!GetFileSizeEx(file->file, &fileSize)) {
+            return FILE_ERROR;
+        }
+        size = (uint64_t)fileSize.QuadPart;
+    }
+
+    if (size < CAPTURE_FILE_HEADER_SIZE) {
+        return FILE_ERROR;
+    }
+
+    //Creating a writable mapping of the full size preallocates the file
+    file->mapping = CreateFileMappingA(file->file, NULL, file->writable? PAGE_READWRITE : PAGE_READONLY,
+                                       (DWORD)(size >> 32), (DWORD)size, NULL);
+    if (!file->mapping) {
+        return FILE_ERROR;
+    }
+
+    file->header = MapViewOfFile(file->mapping, file->writable? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, (SIZE_T)size);
+    if (!file->header) {
+        return FILE_ERROR;
+    }
+#else
+    struct stat fileStat;
+    void *mapping = NULL;
+
+    file->file = open(path, file->writable? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644);
+    if (file->file < 0) {
+        return FILE_ERROR;
+    }
+
+    if (file->writable) {
+        //Reserve the blocks now, so appending never waits for the file system to allocate them
+        if (posix_fallocate(file->file, 0, (off_t)size) != 0 && ftruncate(file->file, (off_t)size) != 0) {
+            return FILE_ERROR;
+        }
+    } else {
+        if (fstat(file->file, &fileStat) != 0) {
+            return FILE_ERROR;
+        }
+        size = (uint64_t)fileStat.st_size;
+    }
+
+    if (size < CAPTURE_FILE_HEADER_SIZE) {
+        return FILE_ERROR;
+    }
+
+    mapping = mmap(NULL, (size_t)size, file->writable? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, file->file, 0);
+    if (mapping == MAP_FAILED) {
+        return FILE_ERROR;
+    }
+    file->header = mapping;
+#endif
+
+    file->mappingSize = size;
+    file->records = (uint8_t*)file->header + CAPTURE_FILE_HEADER_SIZE;
+    return OK;
+}
+
+static int _unmapFile(CaptureFile_t *file)
+{
+    int result = OK;
+    uint64_t usedSize = 0;
+#if defined(_WIN32)
+    LARGE_INTEGER position;
+#endif
+
+    if (file->header && file->writable) {
+        //Give back the preallocated space that was not used
+        file->header->maxNumOfRecords = file->header->numOfRecords;
+        usedSize = (uint64_t)file->header->headerSize + (uint64_t)file->header->numOfRecords * file->header->recordSize;
+    }
+
+#if defined(_WIN32)
+    if (file->header) {
+        if (file->writable && !FlushViewOfFile(file->header, 0)) {
+            result = FILE_ERROR;
+        }
+        UnmapViewOfFile(file->header);
+    }
+
+    if (file->mapping) {
+        CloseHandle(file->mapping);
+    }
+
+    if (file->file && file->file != INVALID_HANDLE_VALUE) {
+        if (usedSize) {
+            position.QuadPart = (LONGLONG)usedSize;
+            if (!SetFilePointerEx(file->file, position, NULL, FILE_BEGIN) || !SetEndOfFile(file->file)) {
+                result = FILE_ERROR;
+            }
+        }
+        CloseHandle(file->file);
+    }
+#else
+    if (file->header) {
+        if (file->writable && msync(file->header, (size_t)file->mappingSize, MS_SYNC) != 0) {
+            result = FILE_ERROR;
+        }
+        munmap(file->header, (size_t)file->mappingSize);
+    }
+
+    if (file->file >= 0) {
+        if (usedSize && ftruncate(file->file, (off_t)usedSize) != 0) {
+            result = FILE_ERROR;
+        }
+        close(file->file);
+    }
+#endif
+
+    file->header = NULL;
+    return result;
+}
+
+static CaptureFile_t *_allocateCaptureFile(bool writable)
+{
+    CaptureFile_t *file = calloc(1, sizeof(CaptureFile_t));
+
+    if (file) {
+        file->writable = writable;
+#if !defined(_WIN32)
+        file->file = -1;
+#endif
+    }
+
+    return file;
+}
+
+static int _reserveRecord(CaptureFile_t *file, uint32_t *index)
+{
+    uint32_t reserved = 0, published = 0;
+
+    if (!file->writable) {
+        return INVALID_STATE_ERROR;
+    }
+
+    reserved = ATOMIC_INCREMENT(&file->numOfReservations);
+    if (reserved > file->header->maxNumOfRecords) {
+        return CAPTURE_FILE_FULL_ERROR;
+    }
+
+    //Readers see a record as soon as it is reserved, its state tells them when it is complete
+    do {
+        published = ATOMIC_LOAD(&file->header->numOfRecords);
+    } while (published < reserved && !ATOMIC_COMPARE_EXCHANGE(&file->header->numOfRecords, published, reserved));
+
+    *index = reserved - 1;
+    return OK;
+}
+
+static bool _releaseRecord(CaptureFile_t *file, uint32_t index)
+{
+    //Only the last reservation can be given back, otherwise the record stays as a failed one
+    return ATOMIC_COMPARE_EXCHANGE(&file->header->numOfRecords, index + 1, index) &&
+           ATOMIC_COMPARE_EXCHANGE(&file->numOfReservations, index + 1, index);
+}
+
+static int _commitRecord(CaptureFile_t *file, uint32_t index, uint32_t sourceId, int result)
+{
+    CaptureRecord_t *record = _getRecord(file, index);
+
+    record->sourceId = sourceId;
+    ATOMIC_STORE(&record->state, (result == OK)? CAPTURE_RECORD_COMPLETE : CAPTURE_RECORD_FAILED);
+
+    return result;
+}
+
+static int _checkFrameFormat(CaptureFile_t *file, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (!deviceContext->numOfPixelsInFrame) {
+        result = getFrameFormat(NULL, NULL, NULL, NULL, deviceContextPtr);
+        if (result != OK)
+            return result;
+    }
+
+    //Records are sized for the frame format the file was created with
+    if (deviceContext->numOfPixelsInFrame != file->header->numOfPixelsInFrame) {
+        return INVALID_STATE_ERROR;
+    }
+
+    return OK;
+}
+
+static int _createFile(const char *path, const CaptureFileHeader_t *description, uint32_t maxNumOfRecords, CaptureFile_t **createdFile)
+{
+    int result = -1;
+    uint32_t pixelsOffset = 0, recordSize = 0;
+    CaptureFile_t *file = NULL;
+    CaptureFileHeader_t *header = NULL;
+
+    pixelsOffset = _alignRecord(sizeof(CaptureRecord_t));
+    recordSize = pixelsOffset + _alignRecord(description->numOfPixelsInFrame * sizeof(uint16_t));
+
+    file = _allocateCaptureFile(true);
+    if (!file) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    result = _mapFile(file, path, CAPTURE_FILE_HEADER_SIZE + (uint64_t)maxNumOfRecords * recordSize);
+    if (result != OK) {
+        _unmapFile(file);
+        free(file);
+        return result;
+    }
+
+    header = file->header;
+    *header = *description;
+    memcpy(header->magic, CAPTURE_FILE_MAGIC, sizeof(CAPTURE_FILE_MAGIC));
+    header->version = CAPTURE_FILE_VERSION;
+    header->headerSize = CAPTURE_FILE_HEADER_SIZE;
+    header->recordSize = recordSize;
+    header->pixelsOffset = pixelsOffset;
+    header->maxNumOfRecords = maxNumOfRecords;
+    header->numOfRecords = 0;
+
+    *createdFile = file;
+    return OK;
+}
+
+static int _openFile(const char *path, const char *magic, CaptureFile_t **openedFile)
+{
+    int result = -1;
+    CaptureFile_t *file = NULL;
+    CaptureFileHeader_t *header = NULL;
+
+    file = _allocateCaptureFile(false);
+    if (!file) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    result = _mapFile(file, path, 0);
+    if (result == OK) {
+        header = file->header;
+        if (memcmp(header->magic, magic, sizeof(CAPTURE_FILE_MAGIC)) != 0 ||
+            header->version != CAPTURE_FILE_VERSION ||
+            header->headerSize != CAPTURE_FILE_HEADER_SIZE ||
+            header->recordSize < header->pixelsOffset + header->numOfPixelsInFrame * sizeof(uint16_t)) {
+            result = FILE_ERROR;
+        }
+
+        //Compressed records have no fixed size
+        if (strcmp(magic, CAPTURE_FILE_MAGIC) == 0 &&
+            file->mappingSize < header->headerSize + (uint64_t)header->maxNumOfRecords * header->recordSize) {
+            result = FILE_ERROR;
+        }
+    }
+
+    if (result != OK) {
+        _unmapFile(file);
+        free(file);
+        return result;
+    }
+
+    *openedFile = file;
+    return OK;
+}
+
+int createCaptureFile(const char *path, uint32_t maxNumOfRecords, const uint8_t *calibration, uint32_t calibrationSize, uintptr_t *captureFilePtr, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    CaptureFile_t *file = NULL;
+    CaptureFileHeader_t description;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!path || !captureFilePtr || (calibrationSize && !calibration)) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!maxNumOfRecords || calibrationSize > CAPTURE_MAX_CALIBRATION_SIZE) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+    memset(&description, 0, sizeof(description));
+
+    result = getFrameFormat(&description.numOfStartElement, &description.numOfEndElement, &description.reductionMode,
+                            &description.numOfPixelsInFrame, deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (deviceContext->serial) {
+        strncpy(description.serialNumber, deviceContext->serial, sizeof(description.serialNumber) - 1);
+    }
+    description.calibrationSize = calibrationSize;
+    if (calibrationSize) {
+        memcpy(description.calibration, calibration, calibrationSize);
+    }
+    description.creationTimestamp = _getMonotonicNanoseconds();
+    description.creationUnixTime = (int64_t)time(NULL);
+
+    result = _createFile(path, &description, maxNumOfRecords, &file);
+    if (result != OK)
+        return result;
+
+    if (*captureFilePtr) {
+        closeCaptureFile(captureFilePtr);
+    }
+    *captureFilePtr = (uintptr_t)file;
+
+    return OK;
+}
+
+int openCaptureFile(const char *path, uintptr_t *captureFilePtr)
+{
+    int result = -1;
+    CaptureFile_t *file = NULL;
+
+    if (!path || !captureFilePtr) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    result = _openFile(path, CAPTURE_FILE_MAGIC, &file);
+    if (result != OK)
+        return result;
+
+    if (*captureFilePtr) {
+        closeCaptureFile(captureFilePtr);
+    }
+    *captureFilePtr = (uintptr_t)file;
+
+    return OK;
+}
+
+int closeCaptureFile(uintptr_t *captureFilePtr)
+{
+    int result = -1;
+    CaptureFile_t *file = _getCaptureFile(captureFilePtr);
+
+    if (!file) {
+        return OK;
+    }
+
+    result = _unmapFile(file);
+    free(file);
+    *captureFilePtr = 0;
+
+    return result;
+}
+
+int syncCaptureFile(uintptr_t *captureFilePtr)
+{
+    CaptureFile_t *file = _getCaptureFile(captureFilePtr);
+
+    if (!file) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!file->writable) {
+        return OK;
+    }
+
+#if defined(_WIN32)
+    if (!FlushViewOfFile(file->header, 0)) {
+        return FILE_ERROR;
+    }
+#else
+    //Only schedules the write back, the capturing threads are not held up
+    if (msync(file->header, (size_t)file->mappingSize, MS_ASYNC) != 0) {
+        return FILE_ERROR;
+    }
+#endif
+
+    return OK;
+}
+
+int captureFrame(uint16_t numOfFrame, uint32_t sourceId, uintptr_t *captureFilePtr, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    uint32_t index = 0;
+    CaptureFile_t *file = _getCaptureFile(captureFilePtr);
+
+    if (!file) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    result = _checkFrameFormat(file, deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    result = _reserveRecord(file, &index);
+    if (result != OK)
+        return result;
+
+    //The frame is decoded straight into the mapped record
+    result = getFrameWithMetadata(_getRecordPixels(file, index), numOfFrame, &_getRecord(file, index)->metadata, deviceContextPtr);
+    return _commitRecord(file, index, sourceId, result);
+}
+
+int captureDrainedFrame(uint32_t timeoutMilliseconds, uint32_t sourceId, uintptr_t *captureFilePtr, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    uint32_t index = 0;
+    CaptureFile_t *file = _getCaptureFile(captureFilePtr);
+
+    if (!file) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    result = _checkFrameFormat(file, deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    result = _reserveRecord(file, &index);
+    if (result != OK)
+        return result;
+
+    result = popDrainedFrame(_getRecordPixels(file, index), &_getRecord(file, index)->metadata, timeoutMilliseconds, deviceContextPtr);
+    if (result == TIMEOUT_ERROR && _releaseRecord(file, index)) {
+        return result;
+    }
+
+    return _commitRecord(file, index, sourceId, result);
+}
+
+int appendCaptureFrame(const uint16_t *framePixelsBuffer, const FrameMetadata_t *metadata, uint32_t sourceId, uintptr_t *captureFilePtr)
+{
+    int result = -1;
+    uint32_t index = 0;
+    CaptureRecord_t *record = NULL;
+    CaptureFile_t *file = _getCaptureFile(captureFilePtr);
+
+    if (!file || !framePixelsBuffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (metadata && metadata->numOfPixelsInFrame && metadata->numOfPixelsInFrame != file->header->numOfPixelsInFrame) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    result = _reserveRecord(file, &index);
+    if (result != OK)
+        return result;
+
+    record = _getRecord(file, index);
+    memcpy(_getRecordPixels(file, index), framePixelsBuffer, file->header->numOfPixelsInFrame * sizeof(uint16_t));
+    if (metadata) {
+        record->metadata = *metadata;
+    }
+
+    return _commitRecord(file, index, sourceId, OK);
+}
+
+int getCaptureFileHeader(const CaptureFileHeader_t **header, uintptr_t *captureFilePtr)
+{
+    CaptureFile_t *file = _getCaptureFile(captureFilePtr);
+
+    if (!file || !header) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    *header = file->header;
+    return OK;
+}
+
+int getCaptureRecord(uint32_t index, const CaptureRecord_t **record, const uint16_t **framePixels, uintptr_t *captureFilePtr)
+{
+    CaptureFile_t *file = _getCaptureFile(captureFilePtr);
+
+    if (!file) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (index >= ATOMIC_LOAD(&file->header->numOfRecords) || index >= file->header->maxNumOfRecords) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    if (record) {
+        *record = _getRecord(file, index);
+    }
+
+    if (framePixels) {
+        *framePixels = _getRecordPixels(file, index);
+    }
+
+    return OK;
+}
+
+static int _writeCompressedRecords(CaptureFile_t *source, const CaptureFileHeader_t *header, uint8_t *compressed, FILE *destination)
+{
+    int result = OK;
+    uint32_t index = 0, compressedSize = 0, previousIndex = 0;
+    bool previousKnown = false;
+    const uint16_t *referenceFrame = NULL;
+    CaptureRecord_t *record = NULL;
+
+    if (fwrite(header, sizeof(CaptureFileHeader_t), 1, destination) != 1) {
+        return FILE_ERROR;
+    }
+
+    /* Every record: CaptureRecord_t, uint32_t compressedSize, compressedSize bytes */
+    for (index = 0; index < header->numOfRecords; ++index) {
+        record = _getRecord(source, index);
+        compressedSize = 0;
+
+        if (record->state == CAPTURE_RECORD_COMPLETE) {
+            //Blocks that do not gain from the previous frame of the same source fall back to intra prediction by themselves
+            referenceFrame = (previousKnown && _getRecord(source, previousIndex)->sourceId == record->sourceId)?
+                             _getRecordPixels(source, previousIndex) : NULL;
+
+            result = compressFrame(_getRecordPixels(source, index), header->numOfPixelsInFrame, referenceFrame,
+                                   compressed, getCompressedFrameBound(header->numOfPixelsInFrame), &compressedSize);
+            if (result != OK) {
+                return result;
+            }
+
+            previousIndex = index;
+            previousKnown = true;
+        }
+
+        if (fwrite(record, sizeof(CaptureRecord_t), 1, destination) != 1 ||
+            fwrite(&compressedSize, sizeof(compressedSize), 1, destination) != 1 ||
+            (compressedSize && fwrite(compressed, compressedSize, 1, destination) != 1)) {
+            return FILE_ERROR;
+        }
+    }
+
+    return OK;
+}
+
+int compressCaptureFile(const char *sourcePath, const char *destinationPath)
+{
+    int result = -1;
+    uint8_t *compressed = NULL;
+    CaptureFile_t *source = NULL;
+    CaptureFileHeader_t header;
+    FILE *destination = NULL;
+
+    if (!sourcePath || !destinationPath) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    result = _openFile(sourcePath, CAPTURE_FILE_MAGIC, &source);
+    if (result != OK)
+        return result;
+
+    header = *source->header;
+    header.numOfRecords = ATOMIC_LOAD(&source->header->numOfRecords);
+    if (header.numOfRecords > header.maxNumOfRecords) {
+        header.numOfRecords = header.maxNumOfRecords;
+    }
+    header.maxNumOfRecords = header.numOfRecords;
+    memcpy(header.magic, CAPTURE_COMPRESSED_FILE_MAGIC, sizeof(CAPTURE_COMPRESSED_FILE_MAGIC));
+
+    compressed = malloc(getCompressedFrameBound(header.numOfPixelsInFrame));
+    if (!compressed) {
+        result = MEMORY_ALLOCATION_ERROR;
+    } else {
+        destination = fopen(destinationPath, "wb");
+        if (!destination) {
+            result = FILE_ERROR;
+        } else {
+            result = _writeCompressedRecords(source, &header, compressed, destination);
+            if (fclose(destination) != 0 && result == OK) {
+                result = FILE_ERROR;
+            }
+        }
+    }
+
+    free(compressed);
+    _unmapFile(source);
+    free(source);
+
+    return result;
+}
+
+int decompressCaptureFile(const char *sourcePath, const char *destinationPath)
+{
+    int result = -1;
+    uint32_t index = 0, compressedSize = 0, previousIndex = 0;
+    bool previousKnown = false;
+    uint64_t offset = 0;
+    const uint16_t *referenceFrame = NULL;
+    CaptureFile_t *source = NULL, *destination = NULL;
+    CaptureRecord_t *record = NULL;
+    const uint8_t *mapping = NULL;
+
+    if (!sourcePath || !destinationPath) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    result = _openFile(sourcePath, CAPTURE_COMPRESSED_FILE_MAGIC, &source);
+    if (result != OK)
+        return result;
+
+    result = _createFile(destinationPath, source->header, source->header->numOfRecords? source->header->numOfRecords : 1, &destination);
+    if (result != OK) {
+        _unmapFile(source);
+        free(source);
+        return result;
+    }
+
+    mapping = (const uint8_t*)source->header;
+    offset = CAPTURE_FILE_HEADER_SIZE;
+
+    for (index = 0; index < source->header->numOfRecords; ++index) {
+        if (offset + sizeof(CaptureRecord_t) + sizeof(compressedSize) > source->mappingSize) {
+            result = COMPRESSED_DATA_ERROR;
+            break;
+        }
+
+        record = _getRecord(destination, index);
+        memcpy(record, mapping + offset, sizeof(CaptureRecord_t));
+        memcpy(&compressedSize, mapping + offset + sizeof(CaptureRecord_t), sizeof(compressedSize));
+        offset += sizeof(CaptureRecord_t) + sizeof(compressedSize);
+
+        if (offset + compressedSize > source->mappingSize) {
+            result = COMPRESSED_DATA_ERROR;
+            break;
+        }
+
+        if (record->state == CAPTURE_RECORD_COMPLETE) {
+            referenceFrame = (previousKnown && _getRecord(destination, previousIndex)->sourceId == record->sourceId)?
+                             _getRecordPixels(destination, previousIndex) : NULL;
+
+            result = decompressFrame(mapping + offset, compressedSize, referenceFrame,
+                                     _getRecordPixels(destination, index), destination->header->numOfPixelsInFrame);
+            if (result != OK) {
+                break;
+            }
+
+            previousIndex = index;
+            previousKnown = true;
+        }
+
+        offset += compressedSize;
+        destination->header->numOfRecords = index + 1;
+    }
+
+    //Keeps the records decoded so far even if the compressed file is damaged
+    if (_unmapFile(destination) != OK && result == OK) {
+        result = FILE_ERROR;
+    }
+    free(destination);
+    _unmapFile(source);
+    free(source);
+
+    return result;
+}
@@ -0,0 +1,411 @@
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define CODEC_SSE2
+    #include <emmintrin.h>
+#endif
+
+/*
+    Compressed frame:
+        uint8_t version, uint8_t flags, uint16_t numOfPixelsInFrame,
+        then for every block of CODEC_BLOCK_SIZE pixels a descriptor byte (bit width | CODEC_INTER_BLOCK) followed by 16 * width bytes.
+
+    A block is predicted either from the previous pixel (intra) or from the same pixel of the reference frame (inter), whichever packs tighter.
+    The residuals are zigzag coded and bit-packed vertically: the block is CODEC_ROWS rows of CODEC_LANES consecutive pixels,
+    and every lane packs its column into width 16-bit words, so a row is one 8 x 16-bit vector in every step.
+    Multi-byte values are stored little-endian, the byte order of every supported platform.
+*/
+
+static uint8_t _getBitWidth(uint16_t value)
+{
+    uint8_t width = 0;
+
+    while (value) {
+        value >>= 1;
+        ++width;
+    }
+
+    return width;
+}
+
+#if defined(CODEC_SSE2)
+
+static __m128i _zigzag(__m128i delta)
+{
+    return _mm_xor_si128(_mm_slli_epi16(delta, 1), _mm_srai_epi16(delta, 15));
+}
+
+static __m128i _unzigzag(__m128i value)
+{
+    return _mm_xor_si128(_mm_srli_epi16(value, 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(value, _mm_set1_epi16(1))));
+}
+
+static uint16_t _orReduce(__m128i value)
+{
+    value = _mm_or_si128(value, _mm_srli_si128(value, 8));
+    value = _mm_or_si128(value, _mm_srli_si128(value, 4));
+    value = _mm_or_si128(value, _mm_srli_si128(value, 2));
+    return (uint16_t)_mm_cvtsi128_si32(value);
+}
+
+/* pixels[-1] is the pixel before the block */
+static uint16_t _predictIntra(const uint16_t *pixels, uint16_t *residuals)
+{
+    uint32_t row = 0;
+    __m128i delta, accumulator = _mm_setzero_si128();
+
+    for (row = 0; row < CODEC_ROWS; ++row) {
+        delta = _zigzag(_mm_sub_epi16(_mm_loadu_si128((const __m128i*)(pixels + row * CODEC_LANES)),
+                                      _mm_loadu_si128((const __m128i*)(pixels + row * CODEC_LANES - 1))));
+        _mm_storeu_si128((__m128i*)(residuals + row * CODEC_LANES), delta);
+        accumulator = _mm_or_si128(accumulator, delta);
+    }
+
+    return _orReduce(accumulator);
+}
+
+static uint16_t _predictInter(const uint16_t *pixels, const uint16_t *reference, uint16_t *residuals)
+{
+    uint32_t row = 0;
+    __m128i delta, accumulator = _mm_setzero_si128();
+
+    for (row = 0; row < CODEC_ROWS; ++row) {
+        delta = _zigzag(_mm_sub_epi16(_mm_loadu_si128((const __m128i*)(pixels + row * CODEC_LANES)),
+                                      _mm_loadu_si128((const __m128i*)(reference + row * CODEC_LANES))));
+        _mm_storeu_si128((__m128i*)(residuals + row * CODEC_LANES), delta);
+        accumulator = _mm_or_si128(accumulator, delta);
+    }
+
+    return _orReduce(accumulator);
+}
+
+static void _packBlock(const uint16_t *residuals, uint8_t width, uint8_t *packed)
+{
+    uint32_t row = 0, bits = 0;
+    __m128i value, accumulator = _mm_setzero_si128();
+
+    for (row = 0; row < CODEC_ROWS; ++row) {
+        value = _mm_loadu_si128((const __m128i*)(residuals + row * CODEC_LANES));
+        accumulator = _mm_or_si128(accumulator, _mm_sll_epi16(value, _mm_cvtsi32_si128((int)bits)));
+        bits += width;
+
+        if (bits >= 16) {
+            bits -= 16;
+            _mm_storeu_si128((__m128i*)packed, accumulator);
+            packed += CODEC_LANES * sizeof(uint16_t);
+            //A shift by 16 yields zero, so a row that ended exactly on the word leaves nothing behind
+            accumulator = _mm_srl_epi16(value, _mm_cvtsi32_si128((int)(width - bits)));
+        }
+    }
+}
+
+static void _unpackBlock(const uint8_t *packed, uint8_t width, uint16_t *residuals)
+{
+    uint32_t row = 0, bits = 0;
+    __m128i value, current, mask = _mm_set1_epi16((short)((1u << width) - 1));
+
+    current = _mm_loadu_si128((const __m128i*)packed);
+    for (row = 0; row < CODEC_ROWS; ++row) {
+        value = _mm_srl_epi16(current, _mm_cvtsi32_si128((int)bits));
+        bits += width;
+
+        if (bits >= 16) {
+            bits -= 16;
+            packed += CODEC_LANES * sizeof(uint16_t);
+            if (row + 1 < CODEC_ROWS || bits) {
+                current = _mm_loadu_si128((const __m128i*)packed);
+                value = _mm_or_si128(value, _mm_sll_epi16(current, _mm_cvtsi32_si128((int)(width - bits))));
+            }
+        }
+
+        _mm_storeu_si128((__m128i*)(residuals + row * CODEC_LANES), _mm_and_si128(value, mask));
+    }
+}
+
+static void _reconstructIntra(const uint16_t *residuals, uint16_t previous, uint16_t *pixels)
+{
+    uint32_t row = 0;
+    __m128i value, carry = _mm_set1_epi16((short)previous);
+
+    for (row = 0; row < CODEC_ROWS; ++row) {
+        value = _unzigzag(_mm_loadu_si128((const __m128i*)(residuals + row * CODEC_LANES)));
+
+        //Prefix sum of the 8 deltas in three shifted adds
+        value = _mm_add_epi16(value, _mm_slli_si128(value, 2));
+        value = _mm_add_epi16(value, _mm_slli_si128(value, 4));
+        value = _mm_add_epi16(value, _mm_slli_si128(value, 8));
+        value = _mm_add_epi16(value, carry);
+
+        _mm_storeu_si128((__m128i*)(pixels + row * CODEC_LANES), value);
+        carry = _mm_shufflehi_epi16(value, 0xFF);
+        carry = _mm_unpackhi_epi64(carry, carry);
+    }
+}
+
+static void _reconstructInter(const uint16_t *residuals, const uint16_t *reference, uint16_t *pixels)
+{
+    uint32_t row = 0;
+    __m128i value;
+
+    for (row = 0; row < CODEC_ROWS; ++row) {
+        value = _unzigzag(_mm_loadu_si128((const __m128i*)(residuals + row * CODEC_LANES)));
+        value = _mm_add_epi16(value, _mm_loadu_si128((const __m128i*)(reference + row * CODEC_LANES)));
+        _mm_storeu_si128((__m128i*)(pixels + row * CODEC_LANES), value);
+    }
+}
+
+#else
+
+/* Portable versions, written lane by lane so that the compiler can vectorize them */
+
+static uint16_t _zigzag(uint16_t delta)
+{
+    return (uint16_t)((delta << 1) ^ (0 - (delta >> 15)));
+}
+
+static uint16_t _unzigzag(uint16_t value)
+{
+    return (uint16_t)((value >> 1) ^ (0 - (value & 1)));
+}
+
+static uint16_t _predictIntra(const uint16_t *pixels, uint16_t *residuals)
+{
+    uint32_t index = 0;
+    uint16_t accumulator = 0;
+
+    for (index = 0; index < CODEC_BLOCK_SIZE; ++index) {
+        residuals[index] = _zigzag((uint16_t)(pixels[index] - pixels[(int)index - 1]));
+        accumulator |= residuals[index];
+    }
+
+    return accumulator;
+}
+
+static uint16_t _predictInter(const uint16_t *pixels, const uint16_t *reference, uint16_t *residuals)
+{
+    uint32_t index = 0;
+    uint16_t accumulator = 0;
+
+    for (index = 0; index < CODEC_BLOCK_SIZE; ++index) {
+        residuals[index] = _zigzag((uint16_t)(pixels[index] - reference[index]));
+        accumulator |= residuals[index];
+    }
+
+    return accumulator;
+}
+
+static void _packBlock(const uint16_t *residuals, uint8_t width, uint8_t *packed)
+{
+    uint32_t row = 0, lane = 0, bits = 0;
+    uint16_t accumulator[CODEC_LANES] = {0};
+
+    for (row = 0; row < CODEC_ROWS; ++row) {
+        for (lane = 0; lane < CODEC_LANES; ++lane) {
+            accumulator[lane] |= (uint16_t)(residuals[row * CODEC_LANES + lane] << bits);
+        }
+        bits += width;
+
+        if (bits >= 16) {
+            bits -= 16;
+            memcpy(packed, accumulator, sizeof(accumulator));
+            packed += sizeof(accumulator);
+            for (lane = 0; lane < CODEC_LANES; ++lane) {
+                accumulator[lane] = (uint16_t)((uint32_t)residuals[row * CODEC_LANES + lane] >> (width - bits));
+            }
+        }
+    }
+}
+
+static void _unpackBlock(const uint8_t *packed, uint8_t width, uint16_t *residuals)
+{
+    uint32_t row = 0, lane = 0, bits = 0;
+    uint16_t mask = (uint16_t)((1u << width) - 1);
+    uint16_t current[CODEC_LANES], value[CODEC_LANES];
+
+    memcpy(current, packed, sizeof(current));
+    for (row = 0; row < CODEC_ROWS; ++row) {
+        for (lane = 0; lane < CODEC_LANES; ++lane) {
+            value[lane] = (uint16_t)(current[lane] >> bits);
+        }
+        bits += width;
+
+        if (bits >= 16) {
+            bits -= 16;
+            packed += sizeof(current);
+            if (row + 1 < CODEC_ROWS || bits) {
+                memcpy(current, packed, sizeof(current));
+                for (lane = 0; lane < CODEC_LANES; ++lane) {
+                    value[lane] |= (uint16_t)((uint32_t)current[lane] << (width - bits));
+                }
+            }
+        }
+
+        for (lane = 0; lane < CODEC_LANES; ++lane) {
+            residuals[row * CODEC_LANES + lane] = value[lane] & mask;
+        }
+    }
+}
+
+static void _reconstructIntra(const uint16_t *residuals, uint16_t previous, uint16_t *pixels)
+{
+    uint32_t index = 0;
+
+    for (index = 0; index < CODEC_BLOCK_SIZE; ++index) {
+        previous = (uint16_t)(previous + _unzigzag(residuals[index]));
+        pixels[index] = previous;
+    }
+}
+
+static void _reconstructInter(const uint16_t *residuals, const uint16_t *reference, uint16_t *pixels)
+{
+    uint32_t index = 0;
+
+    for (index = 0; index < CODEC_BLOCK_SIZE; ++index) {
+        pixels[index] = (uint16_t)(reference[index] + _unzigzag(residuals[index]));
+    }
+}
+
+#endif
+
+uint32_t getCompressedFrameBound(uint16_t numOfPixelsInFrame)
+{
+    uint32_t numOfBlocks = (numOfPixelsInFrame + CODEC_BLOCK_SIZE - 1) / CODEC_BLOCK_SIZE;
+
+    return CODEC_HEADER_SIZE + numOfBlocks * (1 + CODEC_BLOCK_SIZE * sizeof(uint16_t));
+}
+
+int compressFrame(const uint16_t *framePixels, uint16_t numOfPixelsInFrame, const uint16_t *referenceFrame, uint8_t *compressed, uint32_t compressedCapacity, uint32_t *compressedSize)
+{
+    uint32_t offset = 0, blockStart = 0, blockLength = 0, index = 0;
+    uint16_t intraBits = 0, interBits = 0;
+    uint8_t intraWidth = 0, interWidth = 0, width = 0, flags = 0;
+
+    /* [0] is the pixel before the block, short blocks are padded with their last pixel */
+    uint16_t pixels[CODEC_BLOCK_SIZE + 1], reference[CODEC_BLOCK_SIZE];
+    uint16_t intraResiduals[CODEC_BLOCK_SIZE], interResiduals[CODEC_BLOCK_SIZE];
+
+    if (!framePixels || !compressed || !compressedSize) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (compressedCapacity < getCompressedFrameBound(numOfPixelsInFrame)) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    flags = referenceFrame? CODEC_FLAG_REFERENCE : 0;
+    compressed[0] = CODEC_VERSION;
+    compressed[1] = flags;
+    compressed[2] = LOW_BYTE(numOfPixelsInFrame);
+    compressed[3] = HIGH_BYTE(numOfPixelsInFrame);
+    offset = CODEC_HEADER_SIZE;
+
+    pixels[0] = 0;
+    for (blockStart = 0; blockStart < numOfPixelsInFrame; blockStart += CODEC_BLOCK_SIZE) {
+        blockLength = numOfPixelsInFrame - blockStart;
+        if (blockLength > CODEC_BLOCK_SIZE) {
+            blockLength = CODEC_BLOCK_SIZE;
+        }
+
+        memcpy(pixels + 1, framePixels + blockStart, blockLength * sizeof(uint16_t));
+        if (referenceFrame) {
+            memcpy(reference, referenceFrame + blockStart, blockLength * sizeof(uint16_t));
+        }
+        for (index = blockLength; index < CODEC_BLOCK_SIZE; ++index) {
+            pixels[index + 1] = pixels[index];
+            reference[index] = pixels[index + 1];
+        }
+
+        intraBits = _predictIntra(pixels + 1, intraResiduals);
+        intraWidth = _getBitWidth(intraBits);
+        width = intraWidth;
+
+        if (referenceFrame) {
+            interBits = _predictInter(pixels + 1, reference, interResiduals);
+            interWidth = _getBitWidth(interBits);
+        }
+
+        if (referenceFrame && interWidth < intraWidth) {
+            width = interWidth;
+            compressed[offset++] = width | CODEC_INTER_BLOCK;
+            _packBlock(interResiduals, width, compressed + offset);
+        } else {
+            compressed[offset++] = width;
+            _packBlock(intraResiduals, width, compressed + offset);
+        }
+        offset += width * CODEC_LANES * sizeof(uint16_t);
+
+        pixels[0] = pixels[CODEC_BLOCK_SIZE];
+    }
+
+    *compressedSize = offset;
+    return OK;
+}
+
+int decompressFrame(const uint8_t *compressed, uint32_t compressedSize, const uint16_t *referenceFrame, uint16_t *framePixels, uint16_t numOfPixelsInFrame)
+{
+    uint32_t offset = 0, blockStart = 0, blockLength = 0;
+    uint16_t previous = 0;
+    uint8_t descriptor = 0, width = 0;
+    uint16_t pixels[CODEC_BLOCK_SIZE], reference[CODEC_BLOCK_SIZE], residuals[CODEC_BLOCK_SIZE];
+
+    if (!compressed || !framePixels) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (compressedSize < CODEC_HEADER_SIZE || compressed[0] != CODEC_VERSION) {
+        return COMPRESSED_DATA_ERROR;
+    }
+
+    if (((compressed[3] << 8) | compressed[2]) != numOfPixelsInFrame) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    if ((compressed[1] & CODEC_FLAG_REFERENCE) && !referenceFrame) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    offset = CODEC_HEADER_SIZE;
+    for (blockStart = 0; blockStart < numOfPixelsInFrame; blockStart += CODEC_BLOCK_SIZE) {
+        blockLength = numOfPixelsInFrame - blockStart;
+        if (blockLength > CODEC_BLOCK_SIZE) {
+            blockLength = CODEC_BLOCK_SIZE;
+        }
+
+        if (offset >= compressedSize) {
+            return COMPRESSED_DATA_ERROR;
+        }
+
+        descriptor = compressed[offset++];
+        width = descriptor & CODEC_WIDTH_MASK;
+        if (width > 16 || offset + width * CODEC_LANES * sizeof(uint16_t) > compressedSize) {
+            return COMPRESSED_DATA_ERROR;
+        }
+
+        if (width) {
+            _unpackBlock(compressed + offset, width, residuals);
+        } else {
+            memset(residuals, 0, sizeof(residuals));
+        }
+        offset += width * CODEC_LANES * sizeof(uint16_t);
+
+        if (descriptor & CODEC_INTER_BLOCK) {
+            if (!(compressed[1] & CODEC_FLAG_REFERENCE)) {
+                return COMPRESSED_DATA_ERROR;
+            }
+
+            memcpy(reference, referenceFrame + blockStart, blockLength * sizeof(uint16_t));
+            memset(reference + blockLength, 0, (CODEC_BLOCK_SIZE - blockLength) * sizeof(uint16_t));
+            _reconstructInter(residuals, reference, pixels);
+        } else {
+            _reconstructIntra(residuals, previous, pixels);
+        }
+
+        memcpy(framePixels + blockStart, pixels, blockLength * sizeof(uint16_t));
+        previous = pixels[CODEC_BLOCK_SIZE - 1];
+    }
+
+    return OK;
+}
@@ -0,0 +1,631 @@
+/*
+    spectrometerd - keeps all connected spectrometers open and serves them to local clients
+
+    Control plane: a Unix stream socket, one text request per line, one text reply per line.
+    A request is a command followed by its arguments separated by spaces, the reply starts with the
+    library error code (0 on success) followed by the returned values:
+
+        devices                                                     -> 0 <serial>...
+        ring <serial>                                               -> 0 <ring name>
+        getAcquisitionParameters <serial>                           -> 0 <scans> <blank scans> <scan mode> <exposure>
+        setAcquisitionParameters <serial> <scans> <blank scans> <scan mode> <exposure>   -> 0
+        getFrameFormat <serial>                                     -> 0 <start> <end> <reduction mode> <pixels>
+        setFrameFormat <serial> <start> <end> <reduction mode>      -> 0 <pixels>
+        setExternalTrigger <serial> <enable mode> <signal front>    -> 0
+        setOpticalTrigger <serial> <enable mode> <pixel> <threshold>   -> 0
+        setDarkCorrection <serial> <enable mode> <pedestal>         -> 0
+        triggerAcquisition <serial>                                 -> 0
+        getStatus <serial>                                          -> 0 <status flags> <frames in memory>
+        resetDevice <serial>                                        -> 0
+        readFlash <serial> <offset> <length>                        -> 0 <hex bytes>
+
+    Data plane: every device publishes its frames into the shared memory ring named by the ring command
+    (see attachFrameRing()). A thread per device drains the device memory with the drain-and-rearm engine,
+    or polls for averaged results in frame averaging mode, and owns the device between control requests.
+*/
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libspectrometer.h"
+
+#define DEFAULT_SOCKET_NAME "spectrometerd.sock"
+#define DEFAULT_RING_SLOTS 64
+#define DEFAULT_HOST_BUFFER_FRAMES 256
+#define DEFAULT_POLL_INTERVAL_MICROSECONDS 1000
+
+#define MAX_DEVICES 16
+#define MAX_CLIENTS 32
+#define MAX_REQUEST_LENGTH 256
+#define MAX_ARGUMENTS 8
+#define MAX_FRAME_PIXELS 3720
+
+#define FLASH_SIZE 0x20000
+#define FLASH_CACHE_PAGE_SIZE 4096
+#define FLASH_CACHE_PAGES (FLASH_SIZE / FLASH_CACHE_PAGE_SIZE)
+
+#define FRAME_AVERAGING_MODE 3
+#define DRAIN_DROP_OLDEST 0
+
+typedef struct Device_t {
+    uintptr_t context;
+    uintptr_t ring;
+    char serial[64];
+    char ringName[80];
+
+    //Cached here so requests need no device transaction
+    uint16_t numOfScans;
+    uint16_t numOfBlankScans;
+    uint8_t scanMode;
+    uint32_t timeOfExposure;
+    uint16_t numOfStartElement;
+    uint16_t numOfEndElement;
+    uint8_t reductionMode;
+    uint16_t numOfPixelsInFrame;
+
+    //Flash is read once per page and kept, it only changes when written
+    uint8_t flash[FLASH_SIZE];
+    uint8_t flashPageCached[FLASH_CACHE_PAGES];
+
+    uint64_t framesPublished;
+    int lastError;
+
+    pthread_mutex_t mutex;          //held by the acquisition thread for every step and by the requests
+    pthread_t thread;
+    volatile int stopRequested;
+} Device_t;
+
+typedef struct Client_t {
+    int fd;
+    size_t length;
+    char request[MAX_REQUEST_LENGTH];
+} Client_t;
+
+static Device_t *_devices[MAX_DEVICES];
+static unsigned int _numOfDevices = 0;
+static Client_t _clients[MAX_CLIENTS];
+static uint32_t _pollIntervalMicroseconds = DEFAULT_POLL_INTERVAL_MICROSECONDS;
+static volatile sig_atomic_t _stopRequested = 0;
+
+static void _onSignal(int signal)
+{
+    (void)signal;
+    _stopRequested = 1;
+}
+
+static void _sleepMicroseconds(uint32_t microseconds)
+{
+    struct timespec duration;
+
+    duration.tv_sec = microseconds / 1000000;
+    duration.tv_nsec = (long)(microseconds % 1000000) * 1000;
+    nanosleep(&duration, NULL);
+}
+
+static Device_t *_findDevice(const char *serial)
+{
+    unsigned int i = 0;
+
+    if (!serial) {
+        return NULL;
+    }
+
+    for (i = 0; i < _numOfDevices; ++i) {
+        if (!strcmp(_devices[i]->serial, serial)) {
+            return _devices[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int _refreshParameters(Device_t *device)
+{
+    int result = OK;
+
+    result = getAcquisitionParameters(&device->numOfScans, &device->numOfBlankScans, &device->scanMode, &device->timeOfExposure, &device->context);
+    if (result != OK) {
+        return result;
+    }
+
+    return getFrameFormat(&device->numOfStartElement, &device->numOfEndElement, &device->reductionMode, &device->numOfPixelsInFrame, &device->context);
+}
+
+static void _reportError(Device_t *device, int result)
+{
+    //Only a change is worth a line, a detached device fails on every step
+    if (result != device->lastError) {
+        fprintf(stderr, "spectrometerd: %s: error %d\n", device->serial, result);
+        device->lastError = result;
+    }
+}
+
+static int _acquisitionStep(Device_t *device, uint16_t *buffer)
+{
+    int result = OK;
+    uint16_t framesInMemory = 0;
+    FrameMetadata_t metadata;
+
+    if (device->scanMode == FRAME_AVERAGING_MODE) {
+        result = getStatus(NULL, &framesInMemory, &device->context);
+        if (result != OK || !framesInMemory) {
+            return result;
+        }
+
+        result = publishDeviceFrame(0xFFFF, &device->ring, &device->context);
+        if (result == OK) {
+            ++device->framesPublished;
+        }
+        return result;
+    }
+
+    result = stepDrainEngine(&device->context);
+    if (result != OK) {
+        return result;
+    }
+
+    while ((result = popDrainedFrame(buffer, &metadata, 0, &device->context)) == OK) {
+        result = publishFrame(buffer, &metadata, &device->ring);
+        if (result != OK) {
+            return result;
+        }
+        ++device->framesPublished;
+    }
+
+    return (result == TIMEOUT_ERROR)? OK : result;
+}
+
+static void *_acquisitionWorker(void *argument)
+{
+    Device_t *device = (Device_t*)argument;
+    uint16_t buffer[MAX_FRAME_PIXELS];
+    int result = OK;
+
+    while (!device->stopRequested) {
+        pthread_mutex_lock(&device->mutex);
+        result = _acquisitionStep(device, buffer);
+        pthread_mutex_unlock(&device->mutex);
+
+        if (result != OK) {
+            _reportError(device, result);
+        } else {
+            device->lastError = OK;
+        }
+
+        _sleepMicroseconds(_pollIntervalMicroseconds);
+    }
+
+    return NULL;
+}
+
+static int _openDevice(const char *serial, uint32_t numOfRingSlots, uint32_t hostBufferFrames)
+{
+    int result = OK;
+    Device_t *device = NULL;
+
+    if (_numOfDevices >= MAX_DEVICES) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    device = calloc(1, sizeof(Device_t));
+    if (!device) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+    snprintf(device->serial, sizeof(device->serial), "%s", serial);
+    snprintf(device->ringName, sizeof(device->ringName), "spectrometer-%s", serial);
+    pthread_mutex_init(&device->mutex, NULL);
+
+    result = connectToDeviceBySerial(device->serial, &device->context);
+    if (result == OK) {
+        result = _refreshParameters(device);
+    }
+    if (result == OK) {
+        result = createFrameRing(device->ringName, numOfRingSlots, &device->ring);
+    }
+    if (result == OK) {
+        //The daemon steps the engine itself, so requests never interleave with its transactions
+        result = startDrainEngine(hostBufferFrames, DRAIN_DROP_OLDEST, 0, &device->context);
+    }
+    if (result == OK && pthread_create(&device->thread, NULL, _acquisitionWorker, device)) {
+        result = THREAD_CREATION_ERROR;
+    }
+
+    if (result != OK) {
+        if (device->ring) {
+            closeFrameRing(&device->ring);
+        }
+        if (device->context) {
+            disconnectDeviceContext(&device->context);
+        }
+        pthread_mutex_destroy(&device->mutex);
+        free(device);
+        return result;
+    }
+
+    _devices[_numOfDevices++] = device;
+    fprintf(stderr, "spectrometerd: %s: serving frames in ring %s\n", device->serial, device->ringName);
+
+    return OK;
+}
+
+static void _closeDevice(Device_t *device)
+{
+    device->stopRequested = 1;
+    pthread_join(device->thread, NULL);
+
+    stopDrainEngine(&device->context);
+    closeFrameRing(&device->ring);
+    disconnectDeviceContext(&device->context);
+    pthread_mutex_destroy(&device->mutex);
+    free(device);
+}
+
+static int _openDevices(uint32_t numOfRingSlots, uint32_t hostBufferFrames)
+{
+    int result = OK;
+    DeviceInfo_t *devices = NULL, *current = NULL;
+
+    devices = getDevicesInfo();
+    for (current = devices; current; current = current->next) {
+        result = _openDevice(current->serialNumber, numOfRingSlots, hostBufferFrames);
+        if (result != OK) {
+            fprintf(stderr, "spectrometerd: %s: cannot be opened, error %d\n", current->serialNumber, result);
+        }
+    }
+    clearDevicesInfo(devices);
+
+    return _numOfDevices? OK : CONNECT_ERROR_NOT_FOUND;
+}
+
+static int _readCachedFlash(Device_t *device, uint32_t offset, uint32_t length)
+{
+    int result = OK;
+    uint32_t page = 0;
+
+    for (page = offset / FLASH_CACHE_PAGE_SIZE; page * FLASH_CACHE_PAGE_SIZE < offset + length; ++page) {
+        if (device->flashPageCached[page]) {
+            continue;
+        }
+
+        result = readFlash(device->flash + page * FLASH_CACHE_PAGE_SIZE, page * FLASH_CACHE_PAGE_SIZE, FLASH_CACHE_PAGE_SIZE, &device->context);
+        if (result != OK) {
+            return result;
+        }
+        device->flashPageCached[page] = 1;
+    }
+
+    return OK;
+}
+
+static int _sendReply(int fd, const char *reply, size_t length)
+{
+    ssize_t written = 0;
+
+    while (length) {
+        written = send(fd, reply, length, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        reply += written;
+        length -= (size_t)written;
+    }
+
+    return 0;
+}
+
+static int _sendFlash(int fd, Device_t *device, uint32_t offset, uint32_t length)
+{
+    static const char digits[] = "0123456789abcdef";
+    char *reply = NULL;
+    uint32_t i = 0;
+    int result = 0;
+
+    reply = malloc(2 * (size_t)length + 4);
+    if (!reply) {
+        return _sendReply(fd, "511\n", 4);
+    }
+
+    memcpy(reply, "0 ", 2);
+    for (i = 0; i < length; ++i) {
+        reply[2 + 2 * i] = digits[device->flash[offset + i] >> 4];
+        reply[3 + 2 * i] = digits[device->flash[offset + i] & 0x0F];
+    }
+    reply[2 + 2 * (size_t)length] = '\n';
+
+    result = _sendReply(fd, reply, 2 * (size_t)length + 3);
+    free(reply);
+
+    return result;
+}
+
+static int _handleRequest(int fd, char *request)
+{
+    char *arguments[MAX_ARGUMENTS], *token = NULL, *state = NULL;
+    char reply[MAX_REQUEST_LENGTH + MAX_DEVICES * 64];
+    unsigned long values[MAX_ARGUMENTS];
+    unsigned int numOfArguments = 0, i = 0;
+    int result = OK, length = 0;
+    uint8_t statusFlags = 0;
+    uint16_t framesInMemory = 0;
+    Device_t *device = NULL;
+
+    for (token = strtok_r(request, " \t\r", &state); token && numOfArguments < MAX_ARGUMENTS; token = strtok_r(NULL, " \t\r", &state)) {
+        arguments[numOfArguments] = token;
+        values[numOfArguments] = strtoul(token, NULL, 0);
+        ++numOfArguments;
+    }
+
+    if (!numOfArguments) {
+        return 0;
+    }
+
+    if (!strcmp(arguments[0], "devices")) {
+        length = snprintf(reply, sizeof(reply), "%d", OK);
+        for (i = 0; i < _numOfDevices; ++i) {
+            length += snprintf(reply + length, sizeof(reply) - length, " %s", _devices[i]->serial);
+        }
+        length += snprintf(reply + length, sizeof(reply) - length, "\n");
+        return _sendReply(fd, reply, (size_t)length);
+    }
+
+    device = _findDevice(numOfArguments > 1? arguments[1] : NULL);
+    if (!device) {
+        length = snprintf(reply, sizeof(reply), "%d\n", CONNECT_ERROR_WRONG_SERIAL_NUMBER);
+        return _sendReply(fd, reply, (size_t)length);
+    }
+
+    pthread_mutex_lock(&device->mutex);
+
+    if (!strcmp(arguments[0], "ring") && numOfArguments == 2) {
+        length = snprintf(reply, sizeof(reply), "%d %s\n", OK, device->ringName);
+    } else if (!strcmp(arguments[0], "getAcquisitionParameters") && numOfArguments == 2) {
+        length = snprintf(reply, sizeof(reply), "%d %u %u %u %u\n", OK, device->numOfScans, device->numOfBlankScans,
+                          device->scanMode, device->timeOfExposure);
+    } else if (!strcmp(arguments[0], "setAcquisitionParameters") && numOfArguments == 6) {
+        result = setAcquisitionParameters((uint16_t)values[2], (uint16_t)values[3], (uint8_t)values[4], (uint32_t)values[5], &device->context);
+        if (result == OK) {
+            device->numOfScans = (uint16_t)values[2];
+            device->numOfBlankScans = (uint16_t)values[3];
+            device->scanMode = (uint8_t)values[4];
+            device->timeOfExposure = (uint32_t)values[5];
+        }
+        length = snprintf(reply, sizeof(reply), "%d\n", result);
+    } else if (!strcmp(arguments[0], "getFrameFormat") && numOfArguments == 2) {
+        length = snprintf(reply, sizeof(reply), "%d %u %u %u %u\n", OK, device->numOfStartElement, device->numOfEndElement,
+                          device->reductionMode, device->numOfPixelsInFrame);
+    } else if (!strcmp(arguments[0], "setFrameFormat") && numOfArguments == 5) {
+        result = setFrameFormat((uint16_t)values[2], (uint16_t)values[3], (uint8_t)values[4], &device->numOfPixelsInFrame, &device->context);
+        if (result == OK) {
+            device->numOfStartElement = (uint16_t)values[2];
+            device->numOfEndElement = (uint16_t)values[3];
+            device->reductionMode = (uint8_t)values[4];
+        }
+        length = snprintf(reply, sizeof(reply), "%d %u\n", result, device->numOfPixelsInFrame);
+    } else if (!strcmp(arguments[0], "setExternalTrigger") && numOfArguments == 4) {
+        result = setExternalTrigger((uint8_t)values[2], (uint8_t)values[3], &device->context);
+        length = snprintf(reply, sizeof(reply), "%d\n", result);
+    } else if (!strcmp(arguments[0], "setOpticalTrigger") && numOfArguments == 5) {
+        result = setOpticalTrigger((uint8_t)values[2], (uint16_t)values[3], (uint16_t)values[4], &device->context);
+        length = snprintf(reply, sizeof(reply), "%d\n", result);
+    } else if (!strcmp(arguments[0], "setDarkCorrection") && numOfArguments == 4) {
+        result = setDarkCorrection((uint8_t)values[2], (uint16_t)values[3], &device->context);
+        length = snprintf(reply, sizeof(reply), "%d\n", result);
+    } else if (!strcmp(arguments[0], "triggerAcquisition") && numOfArguments == 2) {
+        result = triggerAcquisition(&device->context);
+        length = snprintf(reply, sizeof(reply), "%d\n", result);
+    } else if (!strcmp(arguments[0], "getStatus") && numOfArguments == 2) {
+        result = getStatus(&statusFlags, &framesInMemory, &device->context);
+        length = snprintf(reply, sizeof(reply), "%d %u %u\n", result, statusFlags, framesInMemory);
+    } else if (!strcmp(arguments[0], "resetDevice") && numOfArguments == 2) {
+        result = resetDevice(&device->context);
+        if (result == OK) {
+            result = _refreshParameters(device);
+        }
+        length = snprintf(reply, sizeof(reply), "%d\n", result);
+    } else if (!strcmp(arguments[0], "readFlash") && numOfArguments == 4) {
+        if (values[2] >= FLASH_SIZE || values[3] > FLASH_SIZE - values[2]) {
+            result = INVALID_PARAMETER_ERROR;
+        } else {
+            result = _readCachedFlash(device, (uint32_t)values[2], (uint32_t)values[3]);
+        }
+
+        if (result == OK) {
+            result = _sendFlash(fd, device, (uint32_t)values[2], (uint32_t)values[3]);
+            pthread_mutex_unlock(&device->mutex);
+            return result;
+        }
+        length = snprintf(reply, sizeof(reply), "%d\n", result);
+    } else {
+        length = snprintf(reply, sizeof(reply), "%d\n", INVALID_PARAMETER_ERROR);
+    }
+
+    pthread_mutex_unlock(&device->mutex);
+
+    return _sendReply(fd, reply, (size_t)length);
+}
+
+static int _serviceClient(Client_t *client)
+{
+    ssize_t received = 0;
+    char *end = NULL;
+    size_t lineLength = 0;
+
+    received = recv(client->fd, client->request + client->length, sizeof(client->request) - client->length - 1, 0);
+    if (received <= 0) {
+        return (received < 0 && errno == EINTR)? 0 : -1;
+    }
+    client->length += (size_t)received;
+    client->request[client->length] = '\0';
+
+    while ((end = strchr(client->request, '\n'))) {
+        *end = '\0';
+        lineLength = (size_t)(end - client->request) + 1;
+
+        if (_handleRequest(client->fd, client->request)) {
+            return -1;
+        }
+
+        memmove(client->request, client->request + lineLength, client->length - lineLength + 1);
+        client->length -= lineLength;
+    }
+
+    //A line longer than any valid request
+    if (client->length >= sizeof(client->request) - 1) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int _listen(const char *path)
+{
+    struct sockaddr_un address;
+    int fd = -1;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "spectrometerd: socket path too long: %s\n", path);
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("spectrometerd: socket");
+        return -1;
+    }
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) || listen(fd, MAX_CLIENTS)) {
+        perror("spectrometerd: bind");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void _serve(int listenFd)
+{
+    struct pollfd fds[MAX_CLIENTS + 1];
+    unsigned int i = 0, numOfClients = 0;
+    int fd = -1;
+
+    while (!_stopRequested) {
+        fds[0].fd = listenFd;
+        fds[0].events = POLLIN;
+        for (i = 0; i < numOfClients; ++i) {
+            fds[i + 1].fd = _clients[i].fd;
+            fds[i + 1].events = POLLIN;
+            fds[i + 1].revents = 0;
+        }
+
+        if (poll(fds, numOfClients + 1, -1) < 0) {
+            continue;
+        }
+
+        //Serve before accepting, accepting changes the client indices
+        for (i = numOfClients; i > 0; --i) {
+            if (!fds[i].revents) {
+                continue;
+            }
+
+            if (_serviceClient(&_clients[i - 1])) {
+                close(_clients[i - 1].fd);
+                _clients[i - 1] = _clients[--numOfClients];
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            fd = accept(listenFd, NULL, NULL);
+            if (fd >= 0 && numOfClients < MAX_CLIENTS) {
+                _clients[numOfClients].fd = fd;
+                _clients[numOfClients].length = 0;
+                ++numOfClients;
+            } else if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    for (i = 0; i < numOfClients; ++i) {
+        close(_clients[i].fd);
+    }
+}
+
+static void _usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-s socket path] [-n ring slots] [-b host buffer frames] [-p poll interval in us]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    char defaultPath[108];
+    const char *socketPath = NULL, *runtimeDirectory = NULL;
+    uint32_t numOfRingSlots = DEFAULT_RING_SLOTS, hostBufferFrames = DEFAULT_HOST_BUFFER_FRAMES;
+    struct sigaction action;
+    unsigned int i = 0;
+    int option = 0, listenFd = -1;
+
+    runtimeDirectory = getenv("XDG_RUNTIME_DIR");
+    snprintf(defaultPath, sizeof(defaultPath), "%s/%s", runtimeDirectory? runtimeDirectory : "/tmp", DEFAULT_SOCKET_NAME);
+    socketPath = defaultPath;
+
+    while ((option = getopt(argc, argv, "s:n:b:p:h")) != -1) {
+        switch (option) {
+        case 's':
+            socketPath = optarg;
+            break;
+        case 'n':
+            numOfRingSlots = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            hostBufferFrames = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            _pollIntervalMicroseconds = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            _usage(argv[0]);
+            return 1;
+        }
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = _onSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (_openDevices(numOfRingSlots, hostBufferFrames) != OK) {
+        fprintf(stderr, "spectrometerd: no devices\n");
+        return 1;
+    }
+
+    listenFd = _listen(socketPath);
+    if (listenFd >= 0) {
+        fprintf(stderr, "spectrometerd: listening on %s\n", socketPath);
+        _serve(listenFd);
+        close(listenFd);
+        unlink(socketPath);
+    }
+
+    for (i = 0; i < _numOfDevices; ++i) {
+        _closeDevice(_devices[i]);
+    }
+
+    return listenFd >= 0? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include "libspectrometer.h"
+#include "internal.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define DARK_SSE2
+    #include <emmintrin.h>
+#endif
+
+uint16_t _estimateDarkLevel(const uint16_t *framePixels)
+{
+    uint16_t values[DARK_REFERENCE_NUM_OF_ELEMENTS], value = 0;
+    uint32_t sum = 0;
+    int i = 0, j = 0;
+
+    //Insertion sort, the shielded elements are few
+    for (i = 0; i < DARK_REFERENCE_NUM_OF_ELEMENTS; ++i) {
+        value = framePixels[DARK_REFERENCE_FIRST_ELEMENT + i];
+        for (j = i; j > 0 && values[j - 1] > value; --j) {
+            values[j] = values[j - 1];
+        }
+        values[j] = value;
+    }
+
+    //Trimmed mean, a hot or dead shielded element does not move the baseline
+    for (i = DARK_REFERENCE_TRIM; i < DARK_REFERENCE_NUM_OF_ELEMENTS - DARK_REFERENCE_TRIM; ++i) {
+        sum += values[i];
+    }
+
+    return (uint16_t)((sum + (DARK_REFERENCE_NUM_OF_ELEMENTS - 2 * DARK_REFERENCE_TRIM) / 2) / (DARK_REFERENCE_NUM_OF_ELEMENTS - 2 * DARK_REFERENCE_TRIM));
+}
+
+void _subtractDarkLevel(uint16_t *pixels, uint32_t numOfPixels, uint16_t darkLevel, uint16_t pedestal)
+{
+    uint32_t i = 0;
+    uint32_t value = 0;
+
+#if defined(DARK_SSE2)
+    __m128i dark = _mm_set1_epi16((short)darkLevel), offset = _mm_set1_epi16((short)pedestal), block;
+
+    //Saturating in both directions, pixels never wrap around
+    for (; i + 8 <= numOfPixels; i += 8) {
+        block = _mm_loadu_si128((const __m128i*)(pixels + i));
+        block = _mm_subs_epu16(_mm_adds_epu16(block, offset), dark);
+        _mm_storeu_si128((__m128i*)(pixels + i), block);
+    }
+#endif
+
+    for (; i < numOfPixels; ++i) {
+        value = (uint32_t)pixels[i] + pedestal;
+        if (value > 0xFFFF) {
+            value = 0xFFFF;
+        }
+        pixels[i] = (uint16_t)(value > darkLevel? value - darkLevel : 0);
+    }
+}
+
+void _correctDarkLevelRange(uint16_t *framePixels, uint16_t numOfPixelsInFrame, uint32_t firstPixel, uint32_t endPixel, uint16_t darkLevel, uint16_t pedestal)
+{
+    uint32_t imageEnd = (numOfPixelsInFrame > NUM_OF_LEADING_ELEMENTS + NUM_OF_TRAILING_ELEMENTS)? numOfPixelsInFrame - NUM_OF_TRAILING_ELEMENTS : NUM_OF_LEADING_ELEMENTS;
+
+    //The leading and trailing elements are left as read
+    if (firstPixel < NUM_OF_LEADING_ELEMENTS) {
+        firstPixel = NUM_OF_LEADING_ELEMENTS;
+    }
+    if (endPixel > imageEnd) {
+        endPixel = imageEnd;
+    }
+
+    if (firstPixel < endPixel) {
+        _subtractDarkLevel(framePixels + firstPixel, endPixel - firstPixel, darkLevel, pedestal);
+    }
+}
+
+int setDarkCorrection(uint8_t /*DarkCorrectionMode_t*/ enableMode, uint16_t pedestal, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (enableMode > DARK_CORRECTION_ENABLED) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    deviceContext->darkCorrectionMode = enableMode;
+    deviceContext->darkPedestal = pedestal;
+    _mutexUnlock(&deviceContext->mutex);
+
+    return OK;
+}
+
+int correctDarkLevel(uint16_t *framePixels, uint16_t numOfPixelsInFrame, uint16_t pedestal, uint16_t *darkLevel)
+{
+    uint16_t level = 0;
+
+    if (!framePixels) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (numOfPixelsInFrame < NUM_OF_LEADING_ELEMENTS + NUM_OF_TRAILING_ELEMENTS) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    level = _estimateDarkLevel(framePixels);
+    _correctDarkLevelRange(framePixels, numOfPixelsInFrame, 0, numOfPixelsInFrame, level, pedestal);
+
+    if (darkLevel) {
+        *darkLevel = level;
+    }
+
+    return OK;
+}
@@ -0,0 +1,89 @@
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    #define DECODE_LITTLE_ENDIAN
+#endif
+
+/*
+    The payload of a frame packet is the elements in little-endian order, on little-endian hosts it is copied as is.
+    Every packet but the last is full, the last one holds what is left of the frame. The frame sizes of the full
+    element range in the four reduction modes get a decoder for their last packet with the size known at compile
+    time, so every copy is of a constant length; any other frame format goes through the generic decoder.
+*/
+
+static void _decodePixels(uint16_t *pixels, const uint8_t *payload, uint32_t numOfPixels)
+{
+#if defined(DECODE_LITTLE_ENDIAN)
+    memcpy(pixels, payload, numOfPixels * sizeof(uint16_t));
+#else
+    uint32_t i = 0;
+
+    for (i = 0; i < numOfPixels; ++i) {
+        pixels[i] = (uint16_t)((payload[2 * i + 1] << 8) | payload[2 * i]);
+    }
+#endif
+}
+
+void _decodeFullPacket(uint16_t *pixels, const uint8_t *payload)
+{
+    _decodePixels(pixels, payload, NUM_OF_PIXELS_IN_PACKET);
+}
+
+static void _decodeGenericLastPacket(uint16_t *pixels, const uint8_t *payload, uint32_t numOfPixels)
+{
+    _decodePixels(pixels, payload, numOfPixels);
+}
+
+#define STANDARD_FRAME_SIZE(reductionMode) (NUM_OF_LEADING_ELEMENTS + (NUM_OF_IMAGE_ELEMENTS >> (reductionMode)) + NUM_OF_TRAILING_ELEMENTS)
+#define STANDARD_NUM_OF_PACKETS(reductionMode) ((STANDARD_FRAME_SIZE(reductionMode) + NUM_OF_PIXELS_IN_PACKET - 1) / NUM_OF_PIXELS_IN_PACKET)
+#define STANDARD_LAST_PACKET_SIZE(reductionMode) (STANDARD_FRAME_SIZE(reductionMode) - (STANDARD_NUM_OF_PACKETS(reductionMode) - 1) * NUM_OF_PIXELS_IN_PACKET)
+
+#define DEFINE_STANDARD_LAST_PACKET_DECODER(reductionMode) \
+    static void _decodeStandardLastPacket##reductionMode(uint16_t *pixels, const uint8_t *payload, uint32_t numOfPixels) \
+    { \
+        (void)numOfPixels; \
+        _decodePixels(pixels, payload, STANDARD_LAST_PACKET_SIZE(reductionMode)); \
+    }
+
+#define STANDARD_FRAME_LAYOUT(reductionMode) \
+    {STANDARD_FRAME_SIZE(reductionMode), STANDARD_NUM_OF_PACKETS(reductionMode), STANDARD_LAST_PACKET_SIZE(reductionMode), _decodeStandardLastPacket##reductionMode, 0, reductionMode, true}
+
+DEFINE_STANDARD_LAST_PACKET_DECODER(0)
+DEFINE_STANDARD_LAST_PACKET_DECODER(1)
+DEFINE_STANDARD_LAST_PACKET_DECODER(2)
+DEFINE_STANDARD_LAST_PACKET_DECODER(3)
+
+//3694, 1870, 958 and 502 elements
+static const FrameLayout_t STANDARD_FRAME_LAYOUTS[] = {
+    STANDARD_FRAME_LAYOUT(0),
+    STANDARD_FRAME_LAYOUT(1),
+    STANDARD_FRAME_LAYOUT(2),
+    STANDARD_FRAME_LAYOUT(3)
+};
+
+void _selectFrameLayout(FrameLayout_t *frameLayout, uint16_t numOfPixelsInFrame, uint16_t numOfStartElement, uint8_t reductionMode)
+{
+    uint32_t i = 0;
+
+    //A standard size alone does not make a standard frame, a narrower range may happen to have the same size
+    for (i = 0; i < sizeof(STANDARD_FRAME_LAYOUTS) / sizeof(STANDARD_FRAME_LAYOUTS[0]); ++i) {
+        if (STANDARD_FRAME_LAYOUTS[i].numOfPixelsInFrame == numOfPixelsInFrame) {
+            *frameLayout = STANDARD_FRAME_LAYOUTS[i];
+            frameLayout->darkReference = numOfStartElement == 0 && reductionMode == STANDARD_FRAME_LAYOUTS[i].reductionMode;
+            frameLayout->numOfStartElement = numOfStartElement;
+            frameLayout->reductionMode = reductionMode;
+            return;
+        }
+    }
+
+    frameLayout->numOfPixelsInFrame = numOfPixelsInFrame;
+    frameLayout->numOfPackets = (numOfPixelsInFrame + NUM_OF_PIXELS_IN_PACKET - 1) / NUM_OF_PIXELS_IN_PACKET;
+    frameLayout->numOfPixelsInLastPacket = frameLayout->numOfPackets? numOfPixelsInFrame - (frameLayout->numOfPackets - 1) * NUM_OF_PIXELS_IN_PACKET : 0;
+    frameLayout->decodeLastPacket = _decodeGenericLastPacket;
+    frameLayout->numOfStartElement = numOfStartElement;
+    frameLayout->reductionMode = reductionMode;
+    frameLayout->darkReference = false;
+}
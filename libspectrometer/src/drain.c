@@ -0,0 +1,577 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+typedef struct DrainEngine_t {
+    uintptr_t *deviceContextPtr;
+    uint8_t policy;
+    bool background;
+
+    /* Host ring, every slot is MAX_NUM_OF_PIXELS_IN_FRAME wide so frame format changes need no reallocation */
+    uint16_t *ringPixels;
+    FrameMetadata_t *ringMetadata;
+    uint32_t ringCapacity;
+    uint32_t ringHead;
+    uint32_t ringCount;
+
+    uint16_t numOfPixelsInFrame;
+    uint32_t memoryDepth;
+    uint16_t nextFrameIndex;
+    bool memoryFullReported;
+
+    /* Fill rate and rearm cost estimates, used to place the drain watermark */
+    uint16_t lastFill;
+    uint64_t lastFillTimestamp;
+    uint64_t lastStatusTimestamp;
+    uint64_t framePeriodNanoseconds;
+    uint64_t rearmLatencyNanoseconds;
+
+    DrainStatistics_t statistics;
+    int lastError;
+
+    Mutex_t mutex;
+    Condition_t frameAvailable;         //also broadcast when stopping and when a user leaves
+    Mutex_t producerMutex;              //one drain step at a time, the fill state and the ring tail are its own
+    Thread_t thread;
+    volatile uint32_t stopRequested;
+
+    /* Callers inside the engine functions, stopDrainEngine() waits for them to leave */
+    uint32_t numOfUsers;
+    bool stopping;
+} DrainEngine_t;
+
+/* Takes the engine out of the context only under the mutex of the device, so that it cannot be freed in between */
+static DrainEngine_t *_acquireDrainEngine(uintptr_t *deviceContextPtr)
+{
+    DeviceContext_t *deviceContext = NULL;
+    DrainEngine_t *engine = NULL;
+
+    if (_verifyDeviceContextByPtr(deviceContextPtr) != OK) {
+        return NULL;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    engine = deviceContext->drainEngine;
+    if (engine) {
+        _mutexLock(&engine->mutex);
+        ++engine->numOfUsers;
+        _mutexUnlock(&engine->mutex);
+    }
+    _mutexUnlock(&deviceContext->mutex);
+
+    return engine;
+}
+
+static void _releaseDrainEngine(DrainEngine_t *engine)
+{
+    _mutexLock(&engine->mutex);
+    if (!--engine->numOfUsers && engine->stopping) {
+        _conditionBroadcast(&engine->frameAvailable);
+    }
+    _mutexUnlock(&engine->mutex);
+}
+
+static void _updateMemoryDepth(DrainEngine_t *engine, uint16_t numOfPixelsInFrame)
+{
+    engine->numOfPixelsInFrame = numOfPixelsInFrame;
+    engine->memoryDepth = numOfPixelsInFrame? DEVICE_MEMORY_SIZE_IN_PIXELS / numOfPixelsInFrame : 1;
+    if (engine->memoryDepth > DEVICE_MAX_FRAMES_IN_MEMORY) {
+        engine->memoryDepth = DEVICE_MAX_FRAMES_IN_MEMORY;
+    }
+    engine->statistics.memoryDepth = engine->memoryDepth;
+}
+
+static void _updateFillRate(DrainEngine_t *engine, uint16_t fill, uint64_t timestamp)
+{
+    uint64_t period = 0;
+
+    if (fill > engine->lastFill && engine->lastFillTimestamp) {
+        period = (timestamp - engine->lastFillTimestamp) / (fill - engine->lastFill);
+        engine->framePeriodNanoseconds = engine->framePeriodNanoseconds?
+            (7 * engine->framePeriodNanoseconds + period) / 8 : period;
+    }
+
+    if (fill != engine->lastFill || !engine->lastFillTimestamp) {
+        engine->lastFill = fill;
+        engine->lastFillTimestamp = timestamp;
+    }
+}
+
+static uint16_t _getDrainWatermark(DrainEngine_t *engine)
+{
+    uint32_t margin = engine->memoryDepth / 8 + 1;
+
+    //Leave room for the frames that arrive while the memory is drained and rearmed
+    if (engine->framePeriodNanoseconds && engine->rearmLatencyNanoseconds) {
+        margin = (uint32_t)((engine->rearmLatencyNanoseconds + engine->framePeriodNanoseconds - 1) / engine->framePeriodNanoseconds) + 1;
+    }
+
+    if (margin >= engine->memoryDepth) {
+        return 1;
+    }
+
+    return (uint16_t)(engine->memoryDepth - margin);
+}
+
+static int _drainAvailableFrames(DrainEngine_t *engine, uint16_t fill)
+{
+    int result = OK;
+    uint32_t slot = 0;
+
+    while (engine->nextFrameIndex < fill) {
+        _mutexLock(&engine->mutex);
+        if (engine->ringCount == engine->ringCapacity) {
+            if (engine->policy == DRAIN_STALL_DEVICE) {
+                _mutexUnlock(&engine->mutex);
+                return OK;
+            }
+
+            if (engine->policy == DRAIN_DROP_NEWEST) {
+                ++engine->statistics.framesDroppedNewest;
+                _mutexUnlock(&engine->mutex);
+                ++engine->nextFrameIndex;
+                continue;
+            }
+
+            engine->ringHead = (engine->ringHead + 1) % engine->ringCapacity;
+            --engine->ringCount;
+            ++engine->statistics.framesDroppedOldest;
+        }
+        slot = (engine->ringHead + engine->ringCount) % engine->ringCapacity;
+        _mutexUnlock(&engine->mutex);
+
+        //Only the producer touches the tail slot until it is published below
+        result = getFrameWithMetadata(engine->ringPixels + (size_t)slot * MAX_NUM_OF_PIXELS_IN_FRAME, engine->nextFrameIndex,
+                                      &engine->ringMetadata[slot], engine->deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+
+        //Still ours until it is published, so the copy needs no lock
+        _feedFrameProcessor(engine->ringPixels + (size_t)slot * MAX_NUM_OF_PIXELS_IN_FRAME, &engine->ringMetadata[slot], engine->deviceContextPtr);
+
+        _mutexLock(&engine->mutex);
+        ++engine->ringCount;
+        ++engine->statistics.framesDrained;
+        engine->statistics.hostBufferFill = engine->ringCount;
+        _conditionBroadcast(&engine->frameAvailable);
+        _mutexUnlock(&engine->mutex);
+
+        ++engine->nextFrameIndex;
+    }
+
+    return OK;
+}
+
+static int _rearm(DrainEngine_t *engine, bool inProgress)
+{
+    int result = OK;
+    uint64_t rearmStart = _getMonotonicNanoseconds(), rearmEnd = 0;
+    uint8_t statusFlags = 0;
+    uint16_t fill = 0;
+
+    //Second pass right before clearing shrinks the window in which frames can be lost
+    if (inProgress) {
+        result = _getStatus(&statusFlags, &fill, false, engine->deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+        engine->lastStatusTimestamp = _getMonotonicNanoseconds();
+
+        result = _drainAvailableFrames(engine, fill);
+        if (result != OK) {
+            return result;
+        }
+
+        if (engine->nextFrameIndex < fill) {
+            //Host buffer is full and the policy stalls the device, keep the frames in memory
+            return OK;
+        }
+    }
+
+    result = clearMemory(engine->deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    result = triggerAcquisition(engine->deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    rearmEnd = _getMonotonicNanoseconds();
+
+    if (inProgress && engine->framePeriodNanoseconds) {
+        engine->statistics.framesLostOnRearm += (rearmEnd - engine->lastStatusTimestamp) / engine->framePeriodNanoseconds;
+    }
+
+    engine->rearmLatencyNanoseconds = engine->rearmLatencyNanoseconds?
+        (7 * engine->rearmLatencyNanoseconds + (rearmEnd - rearmStart)) / 8 : rearmEnd - rearmStart;
+
+    engine->nextFrameIndex = 0;
+    engine->lastFill = 0;
+    engine->lastFillTimestamp = rearmEnd;
+    engine->memoryFullReported = false;
+    ++engine->statistics.rearms;
+
+    return OK;
+}
+
+static int _runDrainStep(DrainEngine_t *engine)
+{
+    int result = OK;
+    uint8_t statusFlags = 0;
+    uint16_t fill = 0;
+    DeviceContext_t *deviceContext = (DeviceContext_t*)(*engine->deviceContextPtr);
+
+    result = _getStatus(&statusFlags, &fill, false, engine->deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+    engine->lastStatusTimestamp = _getMonotonicNanoseconds();
+
+    if (deviceContext->numOfPixelsInFrame != engine->numOfPixelsInFrame) {
+        _updateMemoryDepth(engine, deviceContext->numOfPixelsInFrame);
+    }
+
+    if (fill < engine->nextFrameIndex) {
+        //Memory was cleared behind our back
+        engine->nextFrameIndex = 0;
+        engine->lastFill = 0;
+    }
+    _updateFillRate(engine, fill, engine->lastStatusTimestamp);
+    engine->statistics.deviceMemoryFill = fill;
+
+    if (statusFlags & STATUS_MEMORY_FULL) {
+        if (!engine->memoryFullReported) {
+            ++engine->statistics.memoryOverflows;
+            engine->memoryFullReported = true;
+        }
+
+        //The device knows its depth better than the estimate
+        if (fill && fill < engine->memoryDepth) {
+            engine->memoryDepth = fill;
+            engine->statistics.memoryDepth = fill;
+        }
+    }
+
+    result = _drainAvailableFrames(engine, fill);
+    if (result != OK) {
+        return result;
+    }
+
+    if (!fill || engine->nextFrameIndex < fill) {
+        return OK;
+    }
+
+    if (fill >= _getDrainWatermark(engine) || !(statusFlags & STATUS_IN_PROGRESS) || (statusFlags & STATUS_MEMORY_FULL)) {
+        result = _rearm(engine, (statusFlags & STATUS_IN_PROGRESS) && !(statusFlags & STATUS_MEMORY_FULL));
+    }
+
+    return result;
+}
+
+/* Without the background thread every caller of stepDrainEngine() and popDrainedFrame() may produce */
+static int _drainStep(DrainEngine_t *engine)
+{
+    int result = OK;
+
+    _mutexLock(&engine->producerMutex);
+    result = _runDrainStep(engine);
+    _mutexUnlock(&engine->producerMutex);
+
+    return result;
+}
+
+static THREAD_FUNCTION(_drainWorker, argument)
+{
+    DrainEngine_t *engine = (DrainEngine_t*)argument;
+    uint64_t drainedBefore = 0;
+    uint32_t pause = 0;
+    int result = OK;
+
+    while (!ATOMIC_LOAD(&engine->stopRequested)) {
+        drainedBefore = engine->statistics.framesDrained;
+
+        result = _drainStep(engine);
+        if (result != OK) {
+            _mutexLock(&engine->mutex);
+            engine->lastError = result;
+            _conditionBroadcast(&engine->frameAvailable);
+            _mutexUnlock(&engine->mutex);
+            _sleepMicroseconds(DRAIN_MAX_POLL_INTERVAL_MICROSECONDS);
+            continue;
+        }
+
+        if (engine->statistics.framesDrained != drainedBefore) {
+            continue;
+        }
+
+        //Poll a few times per frame period, frames arrive at the exposure rate
+        pause = engine->framePeriodNanoseconds? (uint32_t)(engine->framePeriodNanoseconds / 4000) : DRAIN_MAX_POLL_INTERVAL_MICROSECONDS;
+        if (pause < DRAIN_MIN_POLL_INTERVAL_MICROSECONDS) {
+            pause = DRAIN_MIN_POLL_INTERVAL_MICROSECONDS;
+        } else if (pause > DRAIN_MAX_POLL_INTERVAL_MICROSECONDS) {
+            pause = DRAIN_MAX_POLL_INTERVAL_MICROSECONDS;
+        }
+        _sleepMicroseconds(pause);
+    }
+
+    THREAD_RETURN;
+}
+
+static void _freeDrainEngine(DrainEngine_t *engine)
+{
+    _conditionDestroy(&engine->frameAvailable);
+    _mutexDestroy(&engine->producerMutex);
+    _mutexDestroy(&engine->mutex);
+
+    free(engine->ringPixels);
+    free(engine->ringMetadata);
+    free(engine);
+}
+
+int startDrainEngine(uint32_t hostBufferFrames, uint8_t /*DrainPolicy_t*/ backPressurePolicy, uint8_t runInBackground, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+    DrainEngine_t *engine = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (!hostBufferFrames || backPressurePolicy > DRAIN_STALL_DEVICE) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    if (deviceContext->drainEngine) {
+        return INVALID_STATE_ERROR;
+    }
+
+    if (!deviceContext->acquisitionParametersKnown) {
+        result = getAcquisitionParameters(NULL, NULL, NULL, NULL, deviceContextPtr);
+        if (result != OK)
+            return result;
+    }
+
+    //Averaged spectra are not stored in memory
+    if (deviceContext->scanMode == FRAME_AVERAGING_MODE) {
+        return INVALID_STATE_ERROR;
+    }
+
+    if (!deviceContext->numOfPixelsInFrame) {
+        result = getFrameFormat(NULL, NULL, NULL, NULL, deviceContextPtr);
+        if (result != OK)
+            return result;
+    }
+
+    engine = calloc(1, sizeof(DrainEngine_t));
+    if (!engine) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    engine->ringPixels = malloc((size_t)hostBufferFrames * MAX_NUM_OF_PIXELS_IN_FRAME * sizeof(uint16_t));
+    engine->ringMetadata = calloc(hostBufferFrames, sizeof(FrameMetadata_t));
+    if (!engine->ringPixels || !engine->ringMetadata) {
+        free(engine->ringPixels);
+        free(engine->ringMetadata);
+        free(engine);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    engine->deviceContextPtr = deviceContextPtr;
+    engine->policy = backPressurePolicy;
+    engine->background = runInBackground? true : false;
+    engine->ringCapacity = hostBufferFrames;
+    _updateMemoryDepth(engine, deviceContext->numOfPixelsInFrame);
+
+    _mutexInit(&engine->mutex);
+    _mutexInit(&engine->producerMutex);
+    _conditionInit(&engine->frameAvailable);
+
+    result = clearMemory(deviceContextPtr);
+    if (result == OK) {
+        result = triggerAcquisition(deviceContextPtr);
+    }
+
+    if (result != OK) {
+        _freeDrainEngine(engine);
+        return result;
+    }
+    engine->lastFillTimestamp = _getMonotonicNanoseconds();
+
+    deviceContext->drainEngine = engine;
+
+    if (engine->background) {
+        if (_threadCreate(&engine->thread, _drainWorker, engine) != OK) {
+            deviceContext->drainEngine = NULL;
+            _freeDrainEngine(engine);
+            return THREAD_CREATION_ERROR;
+        }
+    }
+
+    return OK;
+}
+
+int stopDrainEngine(uintptr_t *deviceContextPtr)
+{
+    DeviceContext_t *deviceContext = NULL;
+    DrainEngine_t *engine = NULL;
+
+    if (_verifyDeviceContextByPtr(deviceContextPtr) != OK) {
+        return OK;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    engine = deviceContext->drainEngine;
+    deviceContext->drainEngine = NULL;
+    _mutexUnlock(&deviceContext->mutex);
+
+    if (!engine) {
+        return OK;
+    }
+
+    //Readers waiting for a frame return INVALID_STATE_ERROR, the ring goes only once they are all out
+    _mutexLock(&engine->mutex);
+    engine->stopping = true;
+    _conditionBroadcast(&engine->frameAvailable);
+    while (engine->numOfUsers) {
+        _conditionWait(&engine->frameAvailable, &engine->mutex);
+    }
+    _mutexUnlock(&engine->mutex);
+
+    if (engine->background) {
+        ATOMIC_STORE(&engine->stopRequested, 1);
+        _threadJoin(engine->thread);
+    }
+
+    _freeDrainEngine(engine);
+
+    return OK;
+}
+
+int stepDrainEngine(uintptr_t *deviceContextPtr)
+{
+    int result = OK;
+    DrainEngine_t *engine = _acquireDrainEngine(deviceContextPtr);
+
+    if (!engine) {
+        return INVALID_STATE_ERROR;
+    }
+
+    result = engine->background? INVALID_STATE_ERROR : _drainStep(engine);
+
+    _releaseDrainEngine(engine);
+    return result;
+}
+
+int popDrainedFrame(uint16_t *framePixelsBuffer, FrameMetadata_t *metadata, uint32_t timeoutMilliseconds, uintptr_t *deviceContextPtr)
+{
+    int result = OK;
+    uint64_t deadline = 0;
+    uint32_t remaining = 0;
+    DrainEngine_t *engine = NULL;
+
+    if (!framePixelsBuffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    engine = _acquireDrainEngine(deviceContextPtr);
+    if (!engine) {
+        return INVALID_STATE_ERROR;
+    }
+
+    deadline = _getMonotonicNanoseconds() + (uint64_t)timeoutMilliseconds * 1000000ULL;
+
+    _mutexLock(&engine->mutex);
+    while (!engine->ringCount) {
+        if (engine->stopping) {
+            result = INVALID_STATE_ERROR;
+            break;
+        }
+
+        remaining = (uint32_t)((deadline > _getMonotonicNanoseconds())? (deadline - _getMonotonicNanoseconds()) / 1000000ULL : 0);
+
+        if (engine->background) {
+            if (engine->lastError != OK) {
+                result = engine->lastError;
+                engine->lastError = OK;
+                break;
+            }
+
+            if (!remaining || !_conditionTimedWait(&engine->frameAvailable, &engine->mutex, remaining)) {
+                if (!engine->ringCount) {
+                    result = TIMEOUT_ERROR;
+                }
+                break;
+            }
+        } else {
+            //Without a worker the consumer pumps the engine itself
+            _mutexUnlock(&engine->mutex);
+            result = _drainStep(engine);
+            _mutexLock(&engine->mutex);
+
+            if (result != OK) {
+                break;
+            }
+
+            if (!engine->ringCount) {
+                if (!remaining) {
+                    result = TIMEOUT_ERROR;
+                    break;
+                }
+                _mutexUnlock(&engine->mutex);
+                _sleepMicroseconds(DRAIN_MIN_POLL_INTERVAL_MICROSECONDS);
+                _mutexLock(&engine->mutex);
+            }
+        }
+    }
+
+    if (result == OK) {
+        memcpy(framePixelsBuffer, engine->ringPixels + (size_t)engine->ringHead * MAX_NUM_OF_PIXELS_IN_FRAME,
+               engine->ringMetadata[engine->ringHead].numOfPixelsInFrame * sizeof(uint16_t));
+
+        if (metadata) {
+            *metadata = engine->ringMetadata[engine->ringHead];
+        }
+
+        engine->ringHead = (engine->ringHead + 1) % engine->ringCapacity;
+        --engine->ringCount;
+        ++engine->statistics.framesConsumed;
+        engine->statistics.hostBufferFill = engine->ringCount;
+    }
+    _mutexUnlock(&engine->mutex);
+
+    _releaseDrainEngine(engine);
+    return result;
+}
+
+int getDrainStatistics(DrainStatistics_t *statistics, uintptr_t *deviceContextPtr)
+{
+    DrainEngine_t *engine = NULL;
+
+    if (!statistics) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    engine = _acquireDrainEngine(deviceContextPtr);
+    if (!engine) {
+        return INVALID_STATE_ERROR;
+    }
+
+    _mutexLock(&engine->mutex);
+    *statistics = engine->statistics;
+    _mutexUnlock(&engine->mutex);
+
+    _releaseDrainEngine(engine);
+    return OK;
+}
@@ -0,0 +1,520 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define EXPOSURE_SSE2
+    #include <emmintrin.h>
+#endif
+
+typedef struct ExposureSample_t {
+    uint32_t timeOfExposure;
+    int32_t signal;             //maximum above the dark level
+} ExposureSample_t;
+
+void _measureFrameRange(const uint16_t *framePixels, uint16_t numOfPixelsInFrame, uint32_t firstPixel, uint32_t endPixel,
+                        uint16_t *maxPixel, uint16_t *numOfSaturatedPixels)
+{
+    uint32_t imageEnd = (numOfPixelsInFrame > NUM_OF_LEADING_ELEMENTS + NUM_OF_TRAILING_ELEMENTS)? numOfPixelsInFrame - NUM_OF_TRAILING_ELEMENTS : NUM_OF_LEADING_ELEMENTS;
+    uint32_t i = 0;
+    uint16_t maximum = *maxPixel, saturated = *numOfSaturatedPixels;
+
+    //Only the image elements count
+    if (firstPixel < NUM_OF_LEADING_ELEMENTS) {
+        firstPixel = NUM_OF_LEADING_ELEMENTS;
+    }
+    if (endPixel > imageEnd) {
+        endPixel = imageEnd;
+    }
+
+    i = firstPixel;
+
+#if defined(EXPOSURE_SSE2)
+    {
+        //No unsigned 16 bit maximum in SSE2, the values are shifted by 0x8000 into the signed range
+        __m128i bias = _mm_set1_epi16((short)0x8000), level = _mm_set1_epi16((short)SATURATION_LEVEL);
+        __m128i maximums = _mm_set1_epi16((short)(maximum ^ 0x8000)), counts = _mm_setzero_si128(), block;
+        uint16_t lanes[8];
+        int lane = 0;
+
+        for (; i + 8 <= endPixel; i += 8) {
+            block = _mm_loadu_si128((const __m128i*)(framePixels + i));
+            maximums = _mm_max_epi16(maximums, _mm_xor_si128(block, bias));
+            counts = _mm_sub_epi16(counts, _mm_cmpeq_epi16(_mm_subs_epu16(level, block), _mm_setzero_si128()));
+        }
+
+        _mm_storeu_si128((__m128i*)lanes, _mm_xor_si128(maximums, bias));
+        for (lane = 0; lane < 8; ++lane) {
+            if (lanes[lane] > maximum) {
+                maximum = lanes[lane];
+            }
+        }
+
+        _mm_storeu_si128((__m128i*)lanes, counts);
+        for (lane = 0; lane < 8; ++lane) {
+            saturated += lanes[lane];
+        }
+    }
+#endif
+
+    for (; i < endPixel; ++i) {
+        if (framePixels[i] > maximum) {
+            maximum = framePixels[i];
+        }
+        if (framePixels[i] >= SATURATION_LEVEL) {
+            ++saturated;
+        }
+    }
+
+    *maxPixel = maximum;
+    *numOfSaturatedPixels = saturated;
+}
+
+static int _leaveSingleScanMode(uint16_t numOfScans, uint16_t numOfBlankScans, uint32_t timeOfExposure, uintptr_t *deviceContextPtr)
+{
+    DeviceContext_t *deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (deviceContext->numOfScans == numOfScans && deviceContext->numOfBlankScans == numOfBlankScans && deviceContext->timeOfExposure == timeOfExposure) {
+        return OK;
+    }
+
+    return setAcquisitionParameters(numOfScans, numOfBlankScans, deviceContext->scanMode, timeOfExposure, deviceContextPtr);
+}
+
+//Frames taken one per trigger: the caller's scans are saved and replaced by a single scan without blank scans
+static int _enterSingleScanMode(uint32_t timeOfExposure, uint16_t *numOfScans, uint16_t *numOfBlankScans, uint32_t *initialTimeOfExposure, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (!deviceContext->acquisitionParametersKnown) {
+        result = getAcquisitionParameters(NULL, NULL, NULL, NULL, deviceContextPtr);
+        if (result != OK)
+            return result;
+    }
+
+    if (!deviceContext->numOfPixelsInFrame) {
+        result = getFrameFormat(NULL, NULL, NULL, NULL, deviceContextPtr);
+        if (result != OK)
+            return result;
+    }
+
+    //Averaged results do not land in the frame memory
+    if (deviceContext->scanMode == FRAME_AVERAGING_MODE) {
+        return INVALID_STATE_ERROR;
+    }
+
+    *numOfScans = deviceContext->numOfScans;
+    *numOfBlankScans = deviceContext->numOfBlankScans;
+    *initialTimeOfExposure = deviceContext->timeOfExposure;
+
+    //The cached parameters spare the commands that would change nothing
+    if (deviceContext->numOfScans != 1 || deviceContext->numOfBlankScans != 0 || deviceContext->timeOfExposure != timeOfExposure) {
+        result = setAcquisitionParameters(1, 0, deviceContext->scanMode, timeOfExposure, deviceContextPtr);
+        if (result != OK)
+            return result;
+    }
+
+    result = clearMemory(deviceContextPtr);
+    if (result != OK) {
+        _leaveSingleScanMode(*numOfScans, *numOfBlankScans, *initialTimeOfExposure, deviceContextPtr);
+    }
+
+    return result;
+}
+
+static int _setExposureIfChanged(uint32_t timeOfExposure, uintptr_t *deviceContextPtr)
+{
+    if (((DeviceContext_t*)(*deviceContextPtr))->timeOfExposure == timeOfExposure) {
+        return OK;
+    }
+
+    return setExposure(timeOfExposure, 0, deviceContextPtr);
+}
+
+//Waits until the frame triggered last is in the memory, *framesInMemory is the count before the trigger
+static int _waitForFrame(uint16_t *framesInMemory, uint32_t timeoutMilliseconds, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    uint8_t statusFlags = 0;
+    uint16_t fill = 0;
+    uint32_t pollInterval = 0;
+    uint64_t deadline = _getMonotonicNanoseconds() + (uint64_t)timeoutMilliseconds * 1000000ULL;
+    DeviceContext_t *deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    //A quarter of the exposure between polls, timeOfExposure is a multiple of 10 us
+    pollInterval = deviceContext->timeOfExposure * 10 / 4;
+    if (pollInterval < EXPOSURE_MIN_POLL_INTERVAL_MICROSECONDS) {
+        pollInterval = EXPOSURE_MIN_POLL_INTERVAL_MICROSECONDS;
+    } else if (pollInterval > EXPOSURE_MAX_POLL_INTERVAL_MICROSECONDS) {
+        pollInterval = EXPOSURE_MAX_POLL_INTERVAL_MICROSECONDS;
+    }
+
+    for (;;) {
+        result = _getStatus(&statusFlags, &fill, false, deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+
+        if (fill > *framesInMemory && !(statusFlags & STATUS_IN_PROGRESS)) {
+            break;
+        }
+
+        if (_getMonotonicNanoseconds() > deadline) {
+            return TIMEOUT_ERROR;
+        }
+        _sleepMicroseconds(pollInterval);
+    }
+
+    *framesInMemory = fill;
+    return OK;
+}
+
+static int _readTrialFrame(uint16_t *framePixels, FrameMetadata_t *metadata, uint16_t *framesInMemory, uint32_t timeoutMilliseconds, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (*framesInMemory >= DEVICE_MEMORY_SIZE_IN_PIXELS / deviceContext->numOfPixelsInFrame) {
+        result = clearMemory(deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+        *framesInMemory = 0;
+    }
+
+    result = triggerAcquisition(deviceContextPtr);
+    if (result == OK) {
+        result = _waitForFrame(framesInMemory, timeoutMilliseconds, deviceContextPtr);
+    }
+    if (result != OK) {
+        return result;
+    }
+
+    return getFrameWithMetadata(framePixels, *framesInMemory - 1, metadata, deviceContextPtr);
+}
+
+static uint32_t _predictExposure(const ExposureSample_t *current, const ExposureSample_t *previous, int32_t targetSignal)
+{
+    double slope = 0.0, offset = 0.0, prediction = 0.0;
+
+    //The signal grows linearly with the exposure; two samples give the offset too, one is taken through the origin
+    if (previous && previous->timeOfExposure != current->timeOfExposure && previous->signal != current->signal) {
+        slope = (double)(current->signal - previous->signal) / ((double)current->timeOfExposure - (double)previous->timeOfExposure);
+        offset = current->signal - slope * current->timeOfExposure;
+    } else {
+        slope = (double)current->signal / current->timeOfExposure;
+    }
+
+    if (current->signal < AUTO_EXPOSURE_MIN_SIGNAL || slope <= 0.0) {
+        return current->timeOfExposure * AUTO_EXPOSURE_MAX_GROWTH;
+    }
+
+    prediction = (targetSignal - offset) / slope + 0.5;
+    if (prediction > (double)current->timeOfExposure * AUTO_EXPOSURE_MAX_GROWTH) {
+        return current->timeOfExposure * AUTO_EXPOSURE_MAX_GROWTH;
+    }
+
+    return (prediction < 1.0)? 1 : (uint32_t)prediction;
+}
+
+int runAutoExposure(uint16_t targetLevel, uint16_t tolerance, uint32_t minTimeOfExposure, uint32_t maxTimeOfExposure, uint8_t maxNumOfSteps,
+                    uint32_t timeoutMilliseconds, AutoExposureResult_t *autoExposureResult, uintptr_t *deviceContextPtr)
+{
+    int result = -1, restoreResult = -1;
+    uint16_t numOfScans = 0, numOfBlankScans = 0, framesInMemory = 0;
+    uint16_t *framePixels = NULL;
+    uint32_t timeOfExposure = 0, initialTimeOfExposure = 0, finalTimeOfExposure = 0, saturatedBelow = 0;
+    uint32_t distance = 0, bestDistance = 0xFFFFFFFF;
+    bool havePrevious = false;
+    FrameMetadata_t metadata;
+    ExposureSample_t current = {0}, previous = {0};
+    AutoExposureResult_t best = {0};
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!targetLevel || !minTimeOfExposure || minTimeOfExposure > maxTimeOfExposure || !maxNumOfSteps) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    framePixels = malloc(MAX_NUM_OF_PIXELS_IN_FRAME * sizeof(uint16_t));
+    if (!framePixels) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    if (!deviceContext->acquisitionParametersKnown) {
+        result = getAcquisitionParameters(NULL, NULL, NULL, NULL, deviceContextPtr);
+    }
+    initialTimeOfExposure = deviceContext->timeOfExposure;
+    timeOfExposure = initialTimeOfExposure;
+    if (timeOfExposure < minTimeOfExposure) {
+        timeOfExposure = minTimeOfExposure;
+    } else if (timeOfExposure > maxTimeOfExposure) {
+        timeOfExposure = maxTimeOfExposure;
+    }
+
+    if (result == OK) {
+        result = _enterSingleScanMode(timeOfExposure, &numOfScans, &numOfBlankScans, &initialTimeOfExposure, deviceContextPtr);
+    }
+    if (result != OK) {
+        free(framePixels);
+        return result;
+    }
+
+    while (result == OK && best.numOfSteps < maxNumOfSteps) {
+        result = _setExposureIfChanged(timeOfExposure, deviceContextPtr);
+        if (result != OK) {
+            break;
+        }
+
+        result = _readTrialFrame(framePixels, &metadata, &framesInMemory, timeoutMilliseconds, deviceContextPtr);
+        if (result != OK) {
+            break;
+        }
+        ++best.numOfSteps;
+
+        current.timeOfExposure = timeOfExposure;
+        current.signal = (int32_t)metadata.maxPixel - metadata.darkLevel;
+
+        //Unsaturated frames closest to the target win, a saturated one only if nothing else was seen
+        distance = (metadata.maxPixel > targetLevel)? metadata.maxPixel - targetLevel : targetLevel - metadata.maxPixel;
+        if (metadata.numOfSaturatedPixels) {
+            distance = 0x10000 + metadata.numOfSaturatedPixels;
+        }
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best.timeOfExposure = timeOfExposure;
+            best.maxPixel = metadata.maxPixel;
+            best.numOfSaturatedPixels = metadata.numOfSaturatedPixels;
+        }
+
+        if (!metadata.numOfSaturatedPixels && distance <= tolerance) {
+            best.converged = 1;
+            break;
+        }
+
+        if (metadata.numOfSaturatedPixels) {
+            //The maximum says nothing above saturation, fall back towards the last unsaturated sample
+            saturatedBelow = timeOfExposure;
+            timeOfExposure = havePrevious? (previous.timeOfExposure + timeOfExposure) / 2 : timeOfExposure / AUTO_EXPOSURE_MAX_GROWTH;
+        } else {
+            timeOfExposure = _predictExposure(&current, havePrevious? &previous : NULL, (int32_t)targetLevel - metadata.darkLevel);
+            previous = current;
+            havePrevious = true;
+
+            if (saturatedBelow && timeOfExposure >= saturatedBelow) {
+                timeOfExposure = (current.timeOfExposure + saturatedBelow) / 2;
+            }
+        }
+
+        if (timeOfExposure < minTimeOfExposure) {
+            timeOfExposure = minTimeOfExposure;
+        } else if (timeOfExposure > maxTimeOfExposure) {
+            timeOfExposure = maxTimeOfExposure;
+        }
+
+        //Pinned at a limit or between two neighbouring exposures, another frame would not tell more
+        if (timeOfExposure == current.timeOfExposure) {
+            break;
+        }
+    }
+
+    //The scans of the caller come back with the best exposure found
+    finalTimeOfExposure = best.numOfSteps? best.timeOfExposure : initialTimeOfExposure;
+    restoreResult = _leaveSingleScanMode(numOfScans, numOfBlankScans, finalTimeOfExposure, deviceContextPtr);
+    if (result == OK) {
+        result = restoreResult;
+    }
+    best.timeOfExposure = finalTimeOfExposure;
+
+    free(framePixels);
+
+    if (autoExposureResult) {
+        *autoExposureResult = best;
+    }
+
+    return result;
+}
+
+int mergeHdrFrames(const uint16_t *framePixels, const uint32_t *timesOfExposure, const uint16_t *offsets, const uint16_t *saturationLevels,
+                   uint8_t numOfExposures, uint16_t numOfPixelsInFrame, float *hdrPixels)
+{
+    uint32_t i = 0, referenceTime = 0;
+    uint8_t exposure = 0, shortest = 0;
+    float sum = 0.0f, weight = 0.0f, value = 0.0f;
+
+    if (!framePixels || !timesOfExposure || !offsets || !saturationLevels || !hdrPixels) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!numOfExposures || numOfExposures > HDR_MAX_EXPOSURES) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    for (exposure = 0; exposure < numOfExposures; ++exposure) {
+        if (!timesOfExposure[exposure]) {
+            return INVALID_PARAMETER_ERROR;
+        }
+        if (timesOfExposure[exposure] > referenceTime) {
+            referenceTime = timesOfExposure[exposure];
+        }
+        if (timesOfExposure[exposure] < timesOfExposure[shortest]) {
+            shortest = exposure;
+        }
+    }
+
+    /*
+        Every unsaturated sample estimates the signal rate (value - offset) / time; weighted by the time, the longer
+        exposures count more, the estimate is sum(value - offset) / sum(time). Elements saturated in every exposure
+        take the (clipped) rate of the shortest one. The result is scaled to the longest exposure.
+    */
+
+#if defined(EXPOSURE_SSE2)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128 sums, weights, values, unsaturated, fallback, valid;
+        __m128 reference = _mm_set1_ps((float)referenceTime);
+
+        for (; i + 4 <= numOfPixelsInFrame; i += 4) {
+            sums = _mm_setzero_ps();
+            weights = _mm_setzero_ps();
+
+            for (exposure = 0; exposure < numOfExposures; ++exposure) {
+                values = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(framePixels + (size_t)exposure * numOfPixelsInFrame + i)), zero));
+                unsaturated = _mm_cmplt_ps(values, _mm_set1_ps((float)saturationLevels[exposure]));
+                sums = _mm_add_ps(sums, _mm_and_ps(unsaturated, _mm_sub_ps(values, _mm_set1_ps((float)offsets[exposure]))));
+                weights = _mm_add_ps(weights, _mm_and_ps(unsaturated, _mm_set1_ps((float)timesOfExposure[exposure])));
+            }
+
+            values = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(framePixels + (size_t)shortest * numOfPixelsInFrame + i)), zero));
+            fallback = _mm_div_ps(_mm_sub_ps(values, _mm_set1_ps((float)offsets[shortest])), _mm_set1_ps((float)timesOfExposure[shortest]));
+
+            //Lanes without weight divide by 0, the result is discarded by the mask
+            valid = _mm_cmpgt_ps(weights, _mm_setzero_ps());
+            values = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(sums, _mm_or_ps(weights, _mm_andnot_ps(valid, reference)))), _mm_andnot_ps(valid, fallback));
+            _mm_storeu_ps(hdrPixels + i, _mm_mul_ps(values, reference));
+        }
+    }
+#endif
+
+    for (; i < numOfPixelsInFrame; ++i) {
+        sum = 0.0f;
+        weight = 0.0f;
+
+        for (exposure = 0; exposure < numOfExposures; ++exposure) {
+            value = framePixels[(size_t)exposure * numOfPixelsInFrame + i];
+            if (value < saturationLevels[exposure]) {
+                sum += value - offsets[exposure];
+                weight += (float)timesOfExposure[exposure];
+            }
+        }
+
+        if (weight > 0.0f) {
+            hdrPixels[i] = sum / weight * (float)referenceTime;
+        } else {
+            value = framePixels[(size_t)shortest * numOfPixelsInFrame + i];
+            hdrPixels[i] = (value - offsets[shortest]) / (float)timesOfExposure[shortest] * (float)referenceTime;
+        }
+    }
+
+    return OK;
+}
+
+int getHdrFrame(float *hdrPixels, const uint32_t *timesOfExposure, uint8_t numOfExposures, uint32_t timeoutMilliseconds, FrameMetadata_t *metadata,
+                uintptr_t *deviceContextPtr)
+{
+    int result = -1, restoreResult = -1;
+    uint16_t numOfScans = 0, numOfBlankScans = 0, framesInMemory = 0, numOfPixelsInFrame = 0;
+    uint16_t offsets[HDR_MAX_EXPOSURES], saturationLevels[HDR_MAX_EXPOSURES];
+    uint16_t *framePixels = NULL;
+    uint32_t initialTimeOfExposure = 0;
+    uint8_t exposure = 0;
+    FrameMetadata_t frameMetadata[HDR_MAX_EXPOSURES];
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!hdrPixels || !timesOfExposure) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!numOfExposures || numOfExposures > HDR_MAX_EXPOSURES) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    for (exposure = 0; exposure < numOfExposures; ++exposure) {
+        if (!timesOfExposure[exposure]) {
+            return INVALID_PARAMETER_ERROR;
+        }
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    framePixels = malloc((size_t)numOfExposures * MAX_NUM_OF_PIXELS_IN_FRAME * sizeof(uint16_t));
+    if (!framePixels) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    result = _enterSingleScanMode(timesOfExposure[0], &numOfScans, &numOfBlankScans, &initialTimeOfExposure, deviceContextPtr);
+    if (result != OK) {
+        free(framePixels);
+        return result;
+    }
+    numOfPixelsInFrame = deviceContext->numOfPixelsInFrame;
+
+    //The next exposure is set and triggered as soon as a frame is in, the frame is read while the next one is exposed
+    for (exposure = 0; exposure <= numOfExposures && result == OK; ++exposure) {
+        if (exposure) {
+            result = _waitForFrame(&framesInMemory, timeoutMilliseconds, deviceContextPtr);
+        }
+
+        if (result == OK && exposure < numOfExposures) {
+            result = _setExposureIfChanged(timesOfExposure[exposure], deviceContextPtr);
+            if (result == OK) {
+                result = triggerAcquisition(deviceContextPtr);
+            }
+        }
+
+        if (result == OK && exposure) {
+            result = getFrameWithMetadata(framePixels + (size_t)(exposure - 1) * numOfPixelsInFrame, framesInMemory - 1,
+                                          &frameMetadata[exposure - 1], deviceContextPtr);
+        }
+    }
+
+    restoreResult = _leaveSingleScanMode(numOfScans, numOfBlankScans, initialTimeOfExposure, deviceContextPtr);
+    if (result == OK) {
+        result = restoreResult;
+    }
+
+    if (result == OK) {
+        //Corrected frames carry the pedestal instead of the dark level, and reach at most full scale minus the dark level
+        for (exposure = 0; exposure < numOfExposures; ++exposure) {
+            if (deviceContext->darkCorrectionMode == DARK_CORRECTION_ENABLED) {
+                offsets[exposure] = deviceContext->darkPedestal;
+                saturationLevels[exposure] = SATURATION_LEVEL - frameMetadata[exposure].darkLevel;
+            } else {
+                offsets[exposure] = frameMetadata[exposure].darkLevel;
+                saturationLevels[exposure] = SATURATION_LEVEL;
+            }
+        }
+
+        result = mergeHdrFrames(framePixels, timesOfExposure, offsets, saturationLevels, numOfExposures, numOfPixelsInFrame, hdrPixels);
+    }
+
+    if (result == OK && metadata) {
+        memcpy(metadata, frameMetadata, numOfExposures * sizeof(FrameMetadata_t));
+    }
+
+    free(framePixels);
+
+    return result;
+}
@@ -0,0 +1,265 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+/*
+    Frames read from the memory of the device are kept, decoded, until the memory generation of the context changes:
+    the requests that may change the memory bump it (the set* ones, triggers, clearMemory(), resets and detaches),
+    while status requests, parameter read-backs and flash transfers leave it alone.
+    Entries of an older generation are never returned and go first. Only frames the last status reply counted in
+    memory are kept, so a read of a frame that is not there yet is not kept in place of the one to come.
+    The least recently read frames are evicted once the entries exceed the size set by setFrameCacheSize().
+*/
+
+#define FRAME_CACHE_NUM_OF_BUCKETS 256
+
+typedef struct FrameCacheEntry_t {
+    struct FrameCacheEntry_t *newer;
+    struct FrameCacheEntry_t *older;
+    struct FrameCacheEntry_t *nextInBucket;
+    uint32_t memoryGeneration;
+    uint32_t numOfBytes;
+    uint16_t numOfFrame;
+    uint8_t darkCorrectionMode;
+    uint16_t darkPedestal;
+    FrameMetadata_t metadata;
+    uint16_t pixels[];
+} FrameCacheEntry_t;
+
+typedef struct FrameCache_t {
+    uint32_t maxNumOfBytes;
+    FrameCacheEntry_t *newest;
+    FrameCacheEntry_t *oldest;
+    FrameCacheEntry_t *buckets[FRAME_CACHE_NUM_OF_BUCKETS];
+    FrameCacheStatistics_t statistics;
+} FrameCache_t;
+
+static FrameCacheEntry_t **_findBucketLink(FrameCache_t *cache, const FrameCacheEntry_t *entry)
+{
+    FrameCacheEntry_t **link = &cache->buckets[entry->numOfFrame % FRAME_CACHE_NUM_OF_BUCKETS];
+
+    while (*link != entry) {
+        link = &(*link)->nextInBucket;
+    }
+    return link;
+}
+
+static void _unlinkEntry(FrameCache_t *cache, FrameCacheEntry_t *entry)
+{
+    FrameCacheEntry_t **link = _findBucketLink(cache, entry);
+
+    *link = entry->nextInBucket;
+
+    if (entry->newer) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+
+    --cache->statistics.numOfFrames;
+    cache->statistics.numOfBytes -= entry->numOfBytes;
+}
+
+static void _linkNewest(FrameCache_t *cache, FrameCacheEntry_t *entry)
+{
+    FrameCacheEntry_t **bucket = &cache->buckets[entry->numOfFrame % FRAME_CACHE_NUM_OF_BUCKETS];
+
+    entry->nextInBucket = *bucket;
+    *bucket = entry;
+
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+
+    ++cache->statistics.numOfFrames;
+    cache->statistics.numOfBytes += entry->numOfBytes;
+}
+
+static bool _isEntryCurrent(const DeviceContext_t *deviceContext, const FrameCacheEntry_t *entry)
+{
+    return entry->memoryGeneration == deviceContext->memoryGeneration &&
+           entry->numOfBytes == sizeof(FrameCacheEntry_t) + (uint32_t)deviceContext->numOfPixelsInFrame * sizeof(uint16_t) &&
+           entry->darkCorrectionMode == deviceContext->darkCorrectionMode &&
+           (entry->darkCorrectionMode != DARK_CORRECTION_ENABLED || entry->darkPedestal == deviceContext->darkPedestal);
+}
+
+static bool _isCacheable(const DeviceContext_t *deviceContext, uint16_t numOfFrame)
+{
+    //The averaged frame is a new one every time it is ready
+    return deviceContext->frameCache && deviceContext->frameCache->maxNumOfBytes && numOfFrame != 0xFFFF &&
+           !(deviceContext->acquisitionParametersKnown && deviceContext->scanMode == FRAME_AVERAGING_MODE);
+}
+
+static void _evictFrames(FrameCache_t *cache, uint32_t maxNumOfBytes)
+{
+    FrameCacheEntry_t *entry = NULL;
+
+    while (cache->oldest && cache->statistics.numOfBytes > maxNumOfBytes) {
+        entry = cache->oldest;
+        _unlinkEntry(cache, entry);
+        free(entry);
+        ++cache->statistics.evictions;
+    }
+}
+
+bool _lookupCachedFrame(DeviceContext_t *deviceContext, uint16_t numOfFrame, uint16_t *framePixelsBuffer, FrameMetadata_t *metadata)
+{
+    FrameCache_t *cache = deviceContext->frameCache;
+    FrameCacheEntry_t *entry = NULL, *next = NULL;
+
+    if (!_isCacheable(deviceContext, numOfFrame)) {
+        return false;
+    }
+
+    for (entry = cache->buckets[numOfFrame % FRAME_CACHE_NUM_OF_BUCKETS]; entry; entry = next) {
+        next = entry->nextInBucket;
+
+        if (entry->memoryGeneration != deviceContext->memoryGeneration) {
+            //Can never be returned again
+            _unlinkEntry(cache, entry);
+            free(entry);
+            continue;
+        }
+
+        if (entry->numOfFrame == numOfFrame && _isEntryCurrent(deviceContext, entry)) {
+            memcpy(framePixelsBuffer, entry->pixels, (size_t)deviceContext->numOfPixelsInFrame * sizeof(uint16_t));
+            if (metadata) {
+                *metadata = entry->metadata;
+            }
+
+            _unlinkEntry(cache, entry);
+            _linkNewest(cache, entry);
+            ++cache->statistics.hits;
+            return true;
+        }
+    }
+
+    ++cache->statistics.misses;
+    return false;
+}
+
+void _cacheFrame(DeviceContext_t *deviceContext, uint16_t numOfFrame, const uint16_t *framePixels, const FrameMetadata_t *metadata, uint32_t memoryGeneration)
+{
+    FrameCache_t *cache = deviceContext->frameCache;
+    FrameCacheEntry_t *entry = NULL, *evicted = NULL;
+    uint32_t numOfBytes = sizeof(FrameCacheEntry_t) + (uint32_t)deviceContext->numOfPixelsInFrame * sizeof(uint16_t);
+
+    //The memory changed while the frame was read
+    if (!_isCacheable(deviceContext, numOfFrame) || memoryGeneration != deviceContext->memoryGeneration || numOfBytes > cache->maxNumOfBytes) {
+        return;
+    }
+
+    //A full cache takes over the entry it evicts, so reading frames in a steady state allocates nothing
+    while (cache->oldest && cache->statistics.numOfBytes > cache->maxNumOfBytes - numOfBytes) {
+        evicted = cache->oldest;
+        _unlinkEntry(cache, evicted);
+        ++cache->statistics.evictions;
+
+        if (!entry && evicted->numOfBytes == numOfBytes) {
+            entry = evicted;
+        } else {
+            free(evicted);
+        }
+    }
+
+    if (!entry) {
+        entry = malloc(numOfBytes);
+    }
+    if (!entry) {
+        return;
+    }
+
+    entry->memoryGeneration = memoryGeneration;
+    entry->numOfBytes = numOfBytes;
+    entry->numOfFrame = numOfFrame;
+    entry->darkCorrectionMode = deviceContext->darkCorrectionMode;
+    entry->darkPedestal = deviceContext->darkPedestal;
+    entry->metadata = *metadata;
+    memcpy(entry->pixels, framePixels, (size_t)deviceContext->numOfPixelsInFrame * sizeof(uint16_t));
+
+    _linkNewest(cache, entry);
+}
+
+bool _shouldCacheFrame(const DeviceContext_t *deviceContext, uint16_t numOfFrame)
+{
+    return _isCacheable(deviceContext, numOfFrame) && deviceContext->statusCache.framesInMemoryKnown && numOfFrame < deviceContext->statusCache.framesInMemory;
+}
+
+void _freeFrameCache(DeviceContext_t *deviceContext)
+{
+    if (deviceContext->frameCache) {
+        _evictFrames(deviceContext->frameCache, 0);
+        free(deviceContext->frameCache);
+        deviceContext->frameCache = NULL;
+    }
+}
+
+int setFrameCacheSize(uint32_t maxNumOfBytes, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+
+    if (!maxNumOfBytes) {
+        _freeFrameCache(deviceContext);
+    } else {
+        if (!deviceContext->frameCache) {
+            deviceContext->frameCache = calloc(1, sizeof(FrameCache_t));
+        }
+
+        if (!deviceContext->frameCache) {
+            result = MEMORY_ALLOCATION_ERROR;
+        } else {
+            deviceContext->frameCache->maxNumOfBytes = maxNumOfBytes;
+            _evictFrames(deviceContext->frameCache, maxNumOfBytes);
+        }
+    }
+
+    _mutexUnlock(&deviceContext->mutex);
+    return result;
+}
+
+int getFrameCacheStatistics(FrameCacheStatistics_t *statistics, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!statistics) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    if (deviceContext->frameCache) {
+        *statistics = deviceContext->frameCache->statistics;
+    } else {
+        memset(statistics, 0, sizeof(FrameCacheStatistics_t));
+    }
+    _mutexUnlock(&deviceContext->mutex);
+
+    return OK;
+}
@@ -0,0 +1,315 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+/* Called with the device mutex held by the thread in triggerDeviceGroup(), which may not be the calling one */
+static int _fireMember(GroupMember_t *member)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = (DeviceContext_t*)(*member->deviceContextPtr);
+
+    member->writeStartTimestamp = _getMonotonicNanoseconds();
+    if (deviceContext->handle) {
+        result = hid_write(deviceContext->handle, (const unsigned char*)member->report, EXTENDED_PACKET_SIZE);
+    }
+    member->writeEndTimestamp = _getMonotonicNanoseconds();
+
+    if (result != HID_OPERATION_WRITE_SUCCESS) {
+        //NOTE: the slow path reconnects, its timestamps no longer bound the skew
+        result = deviceContext->handle? OK : _reconnect(member->deviceContextPtr);
+        if (result == OK) {
+            result = _tryWrite(member->report, member->deviceContextPtr);
+        }
+        member->writeEndTimestamp = _getMonotonicNanoseconds();
+        if (result != OK) {
+            return result;
+        }
+    }
+
+    deviceContext->lastTriggerTimestamp = member->writeStartTimestamp;
+    _invalidateDeviceState(deviceContext, false);
+    return OK;
+}
+
+static THREAD_FUNCTION(_groupWorker, argument)
+{
+    GroupMember_t *member = (GroupMember_t*)argument;
+    DeviceGroup_t *group = member->group;
+    uint32_t seenGeneration = 0;
+    uint32_t spins = 0;
+
+    for (;;) {
+        _mutexLock(&group->mutex);
+        while (group->armGeneration == seenGeneration && !group->stopRequested) {
+            _conditionWait(&group->armCondition, &group->mutex);
+        }
+        seenGeneration = group->armGeneration;
+        _mutexUnlock(&group->mutex);
+
+        if (ATOMIC_LOAD(&group->stopRequested)) {
+            break;
+        }
+
+        ATOMIC_INCREMENT(&group->numOfReadyWorkers);
+
+        spins = 0;
+        while (ATOMIC_LOAD(&group->releaseGeneration) != seenGeneration) {
+            CPU_RELAX();
+            if (++spins > GROUP_RELEASE_SPIN_LIMIT) {
+                break;
+            }
+        }
+
+        member->result = _fireMember(member);
+        ATOMIC_DECREMENT(&group->numOfPendingWorkers);
+    }
+
+    THREAD_RETURN;
+}
+
+static void _unlockMembers(DeviceGroup_t *group, uint32_t numOfLockedMembers)
+{
+    while (numOfLockedMembers-- > 0) {
+        _mutexUnlock(&((DeviceContext_t*)(*group->members[numOfLockedMembers].deviceContextPtr))->mutex);
+    }
+}
+
+static void _stopGroupWorkers(DeviceGroup_t *group)
+{
+    uint32_t index = 0;
+
+    _mutexLock(&group->mutex);
+    ATOMIC_STORE(&group->stopRequested, 1);
+    _conditionBroadcast(&group->armCondition);
+    _mutexUnlock(&group->mutex);
+
+    for (index = 0; index < group->numOfDevices; ++index) {
+        if (group->members[index].threadStarted) {
+            _threadJoin(group->members[index].thread);
+            group->members[index].threadStarted = false;
+        }
+    }
+}
+
+static void _freeGroup(DeviceGroup_t *group)
+{
+    if (group->triggerMode == GROUP_TRIGGER_BARRIER) {
+        _stopGroupWorkers(group);
+        _conditionDestroy(&group->armCondition);
+    }
+    _mutexDestroy(&group->mutex);
+
+    free(group->members);
+    free(group);
+}
+
+int createDeviceGroup(uintptr_t **deviceContextPtrs, uint32_t numOfDevices, uint8_t /*GroupTriggerMode_t*/ triggerMode, uintptr_t *deviceGroupPtr)
+{
+    int result = -1;
+    uint32_t index = 0, numOfProcessors = 0;
+    DeviceGroup_t *group = NULL;
+    GroupMember_t *member = NULL;
+
+    if (!deviceGroupPtr || !deviceContextPtrs) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!numOfDevices || triggerMode > GROUP_TRIGGER_BARRIER) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    for (index = 0; index < numOfDevices; ++index) {
+        result = _verifyDeviceContextByPtr(deviceContextPtrs[index]);
+        if (result != OK)
+            return result;
+    }
+
+    group = calloc(1, sizeof(DeviceGroup_t));
+    if (!group) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    group->members = calloc(numOfDevices, sizeof(GroupMember_t));
+    if (!group->members) {
+        free(group);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    group->numOfDevices = numOfDevices;
+    group->triggerMode = triggerMode;
+    _mutexInit(&group->mutex);
+
+    for (index = 0; index < numOfDevices; ++index) {
+        member = &group->members[index];
+        member->group = group;
+        member->deviceContextPtr = deviceContextPtrs[index];
+
+        memset(member->report, 0, EXTENDED_PACKET_SIZE);
+        member->report[0] = ZERO_REPORT_ID;
+        member->report[1] = SET_SOFTWARE_TRIGGER_REQUEST;
+    }
+
+    if (triggerMode == GROUP_TRIGGER_BARRIER) {
+        _conditionInit(&group->armCondition);
+        numOfProcessors = _getNumOfProcessors();
+
+        for (index = 0; index < numOfDevices; ++index) {
+            member = &group->members[index];
+
+            if (_threadCreate(&member->thread, _groupWorker, member) != OK) {
+                _freeGroup(group);
+                return THREAD_CREATION_ERROR;
+            }
+            member->threadStarted = true;
+
+            //Keep CPU 0 for the coordinating thread when there is room for it
+            _threadPin(member->thread, (numOfProcessors > numOfDevices)? index + 1 : index % numOfProcessors);
+        }
+    }
+
+    if (*deviceGroupPtr) {
+        destroyDeviceGroup(deviceGroupPtr);
+    }
+    *deviceGroupPtr = (uintptr_t)group;
+
+    return OK;
+}
+
+int destroyDeviceGroup(uintptr_t *deviceGroupPtr)
+{
+    if (!deviceGroupPtr || !*deviceGroupPtr) {
+        return OK;
+    }
+
+    _freeGroup((DeviceGroup_t*)(*deviceGroupPtr));
+    *deviceGroupPtr = 0;
+
+    return OK;
+}
+
+int triggerDeviceGroup(uint64_t *writeStartTimestamps, uint64_t *writeEndTimestamps, uintptr_t *deviceGroupPtr)
+{
+    int result = OK;
+    uint32_t index = 0;
+    uint64_t firstStart = 0, lastStart = 0;
+    DeviceGroup_t *group = NULL;
+    GroupMember_t *member = NULL;
+    DeviceContext_t *deviceContext = NULL;
+
+    if (!deviceGroupPtr || !*deviceGroupPtr) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    group = (DeviceGroup_t*)(*deviceGroupPtr);
+
+    for (index = 0; index < group->numOfDevices; ++index) {
+        result = _verifyDeviceContextByPtr(group->members[index].deviceContextPtr);
+        if (result != OK)
+            return result;
+
+        group->members[index].result = OK;
+    }
+
+    //Held until every write is done, so no reconnect or other request of this process comes between the writes.
+    //Groups sharing devices must list them in the same order
+    for (index = 0; index < group->numOfDevices; ++index) {
+        deviceContext = (DeviceContext_t*)(*group->members[index].deviceContextPtr);
+        _mutexLock(&deviceContext->mutex);
+
+        //Replies to a pending asynchronous operation would be mixed with the trigger
+        if (deviceContext->asyncOperation.kind != ASYNC_OPERATION_NONE) {
+            _unlockMembers(group, index + 1);
+            return INVALID_STATE_ERROR;
+        }
+    }
+
+    if (group->triggerMode == GROUP_TRIGGER_SEQUENTIAL) {
+        for (index = 0; index < group->numOfDevices; ++index) {
+            group->members[index].result = _fireMember(&group->members[index]);
+        }
+    } else {
+        _mutexLock(&group->mutex);
+        ATOMIC_STORE(&group->numOfReadyWorkers, 0);
+        ATOMIC_STORE(&group->numOfPendingWorkers, group->numOfDevices);
+        ++group->armGeneration;
+        _conditionBroadcast(&group->armCondition);
+        _mutexUnlock(&group->mutex);
+
+        //Every worker is spinning once they are all counted, so the release is a single store
+        while (ATOMIC_LOAD(&group->numOfReadyWorkers) != group->numOfDevices) {
+            CPU_RELAX();
+        }
+        ATOMIC_STORE(&group->releaseGeneration, group->armGeneration);
+
+        while (ATOMIC_LOAD(&group->numOfPendingWorkers) != 0) {
+            CPU_RELAX();
+        }
+    }
+
+    _unlockMembers(group, group->numOfDevices);
+
+    result = OK;
+    for (index = 0; index < group->numOfDevices; ++index) {
+        member = &group->members[index];
+
+        if (result == OK && member->result != OK) {
+            result = member->result;
+        }
+
+        if (writeStartTimestamps) {
+            writeStartTimestamps[index] = member->writeStartTimestamp;
+        }
+
+        if (writeEndTimestamps) {
+            writeEndTimestamps[index] = member->writeEndTimestamp;
+        }
+
+        if (index == 0 || member->writeStartTimestamp < firstStart) {
+            firstStart = member->writeStartTimestamp;
+        }
+
+        if (member->writeStartTimestamp > lastStart) {
+            lastStart = member->writeStartTimestamp;
+        }
+    }
+
+    group->lastSkewNanoseconds = lastStart - firstStart;
+    if (group->lastSkewNanoseconds > group->maxSkewNanoseconds) {
+        group->maxSkewNanoseconds = group->lastSkewNanoseconds;
+    }
+    ++group->numOfTriggers;
+
+    return result;
+}
+
+int getDeviceGroupSkew(uint64_t *lastSkewNanoseconds, uint64_t *maxSkewNanoseconds, uint32_t *numOfTriggers, uintptr_t *deviceGroupPtr)
+{
+    DeviceGroup_t *group = NULL;
+
+    if (!deviceGroupPtr || !*deviceGroupPtr) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    group = (DeviceGroup_t*)(*deviceGroupPtr);
+
+    if (lastSkewNanoseconds) {
+        *lastSkewNanoseconds = group->lastSkewNanoseconds;
+    }
+
+    if (maxSkewNanoseconds) {
+        *maxSkewNanoseconds = group->maxSkewNanoseconds;
+    }
+
+    if (numOfTriggers) {
+        *numOfTriggers = group->numOfTriggers;
+    }
+
+    return OK;
+}
+
+uint64_t getHostTimestamp()
+{
+    return _getMonotonicNanoseconds();
+}
@@ -1,12 +1,30 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE     //pthread_setaffinity_np
+#endif
+
 #include <stdlib.h>
+#include <string.h>
 #include "internal.h"
 
+#if !defined(_WIN32)
+    #include <sched.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+#if defined(__linux__)
+    #include <limits.h>
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+#endif
+
 //hid_device*  g_Device = NULL;
 //uint16_t g_numOfPixelsInFrame = 0;
 //char* g_savedSerial = NULL;
 
 const DeviceContext_t NULL_DEVICE_CONTEXT = { // or maybe FOO_DEFAULT or something
-    NULL, 0, NULL
+    //Designated, the fields not named are zero
+    .handle = NULL, .numOfPixelsInFrame = 0, .serial = NULL
 };
 
 #define OK 0
@@ -21,8 +39,17 @@ const DeviceContext_t NULL_DEVICE_CONTEXT = { // or maybe FOO_DEFAULT or somethi
 #define NUM_OF_PACKETS_IN_FRAME_ERROR 508
 #define INPUT_PARAMETER_NOT_INITIALIZED 509
 #define READ_FLASH_REMAINING_PACKETS_ERROR 510
+#define MEMORY_ALLOCATION_ERROR 511
+#define INVALID_PARAMETER_ERROR 512
+#define THREAD_CREATION_ERROR 513
+#define TIMEOUT_ERROR 514
+#define INVALID_STATE_ERROR 515
 
 #define CONNECT_ERROR_WRONG_SERIAL_NUMBER 516
+#define CAPTURE_FILE_FULL_ERROR 517
+#define FILE_ERROR 518
+#define COMPRESSED_DATA_ERROR 519
+#define FRAME_OVERRUN_ERROR 520
 #define NO_DEVICE_CONTEXT_ERROR 585
 
 int _verifyDeviceContextByPtr(const uintptr_t* const deviceContextPtr)
@@ -38,6 +65,31 @@ int _verifyDeviceContextByPtr(const uintptr_t* const deviceContextPtr)
     return OK;
 }
 
+int _openHandle(DeviceContext_t *deviceContext)
+{
+    wchar_t *serialWChar = NULL;
+    size_t cLen = deviceContext->serial? strlen(deviceContext->serial) : 0;
+
+    if (deviceContext->handle) {
+        hid_close(deviceContext->handle);
+        deviceContext->handle = NULL;
+    }
+    //The device may come back under another node, with another status
+    _closePollFd(deviceContext);
+    _invalidateDeviceState(deviceContext, false);
+
+    if (cLen) {
+        ++cLen;       //for \0
+        serialWChar = calloc(cLen, sizeof(wchar_t));
+        mbstowcs(serialWChar, deviceContext->serial, cLen);
+    }
+
+    deviceContext->handle = hid_open(USBD_VID, USBD_PID, (const wchar_t *)serialWChar);
+    free(serialWChar);
+
+    return (deviceContext->handle)? OK : CONNECT_ERROR_FAILED;
+}
+
 int _reconnect(uintptr_t *deviceContextPtr)
 {
     int result = 0;
@@ -49,7 +101,8 @@ int _reconnect(uintptr_t *deviceContextPtr)
 
     deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
-    result = connectToDeviceBySerial(deviceContext->serial, deviceContextPtr);
+    //Reopen in place: the context carries state that must survive a reconnect
+    result = _openHandle(deviceContext);
     return result;
 }
 
@@ -101,7 +154,7 @@ int _tryWrite(unsigned char* const report, uintptr_t *deviceContextPtr)
     return OK;
 }
 
-int _tryRead(unsigned char * const report, unsigned char correctAnswer, uint16_t timeout, uintptr_t *deviceContextPtr)
+int _tryRead(unsigned char * const report, unsigned char correctAnswer, uint8_t latencyClass, uintptr_t *deviceContextPtr)
 {
     int result = -1;
 
@@ -113,7 +166,7 @@ int _tryRead(unsigned char * const report, unsigned char correctAnswer, uint16_t
 
     deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
-    result = hid_read_timeout(deviceContext->handle, report, EXTENDED_PACKET_SIZE, timeout);
+    result = _timedRead(deviceContext, report, latencyClass);
 
     if (result != HID_OPERATION_READ_SUCCESS){
         return READING_PROCESS_FAILED;
@@ -137,18 +190,43 @@ int _writeOnlyFunction(unsigned char* const report, uintptr_t *deviceContextPtr)
 
     deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
+    _mutexLock(&deviceContext->mutex);
+
+    //No reply, may go out while an asynchronous operation is pending
     if (!deviceContext->handle) {
         result = _reconnect(deviceContextPtr);
-        if (result != OK) {
-            return result;
-        }
     }
 
-    result = _tryWrite(report, deviceContextPtr);
+    if (result == OK) {
+        _invalidateDeviceState(deviceContext, false);
+        result = _tryWrite(report, deviceContextPtr);
+    }
+
+    _mutexUnlock(&deviceContext->mutex);
     return result;
 }
 
-int _writeReadFunction(unsigned char* const report, uint8_t correctReply, uint16_t timeout, uintptr_t *deviceContextPtr)
+static bool _isStateChangingRequest(uint8_t request)
+{
+    switch (request) {
+    case SET_EXPOSURE_REQUEST:
+    case SET_ACQUISITION_PARAMETERS_REQUEST:
+    case SET_FRAME_FORMAT_REQUEST:
+    case SET_EXTERNAL_TRIGGER_REQUEST:
+    case SET_SOFTWARE_TRIGGER_REQUEST:
+    case CLEAR_MEMORY_REQUEST:
+    case SET_ALL_PARAMETERS_REQUEST:
+    case SET_OPTICAl_TRIGGER_REQUEST:
+    case RESET_REQUEST:
+    case DETACH_REQUEST:
+        return true;
+    default:
+        //Status, read-backs of the parameters and flash transfers leave the status and the frame memory alone
+        return false;
+    }
+}
+
+int _writeReadFunction(unsigned char* const report, uint8_t correctReply, uint8_t latencyClass, uintptr_t *deviceContextPtr)
 {
     int result = -1;
 
@@ -160,19 +238,243 @@ int _writeReadFunction(unsigned char* const report, uint8_t correctReply, uint16
 
     deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
-    if (!deviceContext->handle) {
+    //The reply must be read by the thread that wrote the request
+    _mutexLock(&deviceContext->mutex);
+
+    //Replies to a pending asynchronous operation would be taken for this one
+    if (deviceContext->asyncOperation.kind != ASYNC_OPERATION_NONE) {
+        result = INVALID_STATE_ERROR;
+    } else if (!deviceContext->handle) {
         result = _reconnect(deviceContextPtr);
-        if (result != OK) {
-            return result;
+    }
+
+    if (result == OK) {
+        //A command that may change the status does so even if it fails
+        if (_isStateChangingRequest(report[1])) {
+            _invalidateDeviceState(deviceContext, false);
         }
+        result = _tryWrite(report, deviceContextPtr);
     }
 
-    result = _tryWrite(report, deviceContextPtr);
-    if (result != OK) {
-        return result;
+    if (result == OK) {
+        result = _tryRead(report, correctReply, latencyClass, deviceContextPtr);
     }
 
-    result = _tryRead(report, correctReply, timeout, deviceContextPtr);
+    _mutexUnlock(&deviceContext->mutex);
     return result;
 }
 
+uint64_t _getMonotonicNanoseconds(void)
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER counter;
+
+    if (!frequency.QuadPart) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+#endif
+}
+
+void _sleepMicroseconds(uint32_t microseconds)
+{
+#if defined(_WIN32)
+    Sleep((microseconds + 999) / 1000);
+#else
+    struct timespec duration;
+
+    duration.tv_sec = microseconds / 1000000;
+    duration.tv_nsec = (long)(microseconds % 1000000) * 1000;
+    nanosleep(&duration, NULL);
+#endif
+}
+
+int _threadCreate(Thread_t *thread, ThreadFunction_t function, void *argument)
+{
+#if defined(_WIN32)
+    *thread = CreateThread(NULL, 0, function, argument, 0, NULL);
+    return (*thread)? OK : -1;
+#else
+    return pthread_create(thread, NULL, function, argument)? -1 : OK;
+#endif
+}
+
+void _threadJoin(Thread_t thread)
+{
+#if defined(_WIN32)
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+void _threadPin(Thread_t thread, uint32_t cpuIndex)
+{
+#if defined(_WIN32)
+    SetThreadAffinityMask(thread, (DWORD_PTR)1 << (cpuIndex % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpuIndex, &cpuSet);
+    pthread_setaffinity_np(thread, sizeof(cpuSet), &cpuSet);
+#else
+    //NOTE: no portable affinity API, the thread stays unpinned
+    (void)thread;
+    (void)cpuIndex;
+#endif
+}
+
+uint32_t _getNumOfProcessors(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO systemInfo;
+
+    GetSystemInfo(&systemInfo);
+    return systemInfo.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0)? (uint32_t)count : 1;
+#endif
+}
+
+void _mutexInit(Mutex_t *mutex)
+{
+#if defined(_WIN32)
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutexattr_t attributes;
+
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+#endif
+}
+
+void _mutexDestroy(Mutex_t *mutex)
+{
+#if defined(_WIN32)
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void _mutexLock(Mutex_t *mutex)
+{
+#if defined(_WIN32)
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void _mutexUnlock(Mutex_t *mutex)
+{
+#if defined(_WIN32)
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void _conditionInit(Condition_t *condition)
+{
+#if defined(_WIN32)
+    InitializeConditionVariable(condition);
+#else
+    pthread_condattr_t attributes;
+
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(condition, &attributes);
+    pthread_condattr_destroy(&attributes);
+#endif
+}
+
+void _conditionDestroy(Condition_t *condition)
+{
+#if defined(_WIN32)
+    (void)condition;
+#else
+    pthread_cond_destroy(condition);
+#endif
+}
+
+void _conditionWait(Condition_t *condition, Mutex_t *mutex)
+{
+#if defined(_WIN32)
+    SleepConditionVariableCS(condition, mutex, INFINITE);
+#else
+    pthread_cond_wait(condition, mutex);
+#endif
+}
+
+bool _conditionTimedWait(Condition_t *condition, Mutex_t *mutex, uint32_t timeoutMilliseconds)
+{
+#if defined(_WIN32)
+    return SleepConditionVariableCS(condition, mutex, timeoutMilliseconds)? true : false;
+#else
+    struct timespec deadline;
+    uint64_t deadlineNanoseconds = _getMonotonicNanoseconds() + (uint64_t)timeoutMilliseconds * 1000000ULL;
+
+    deadline.tv_sec = deadlineNanoseconds / 1000000000ULL;
+    deadline.tv_nsec = deadlineNanoseconds % 1000000000ULL;
+
+    return pthread_cond_timedwait(condition, mutex, &deadline)? false : true;
+#endif
+}
+
+void _conditionBroadcast(Condition_t *condition)
+{
+#if defined(_WIN32)
+    WakeAllConditionVariable(condition);
+#else
+    pthread_cond_broadcast(condition);
+#endif
+}
+
+bool _sharedWait(volatile uint32_t *address, uint32_t value, uint32_t timeoutMilliseconds)
+{
+#if defined(__linux__)
+    struct timespec timeout;
+
+    timeout.tv_sec = timeoutMilliseconds / 1000;
+    timeout.tv_nsec = (long)(timeoutMilliseconds % 1000) * 1000000L;
+
+    //Not FUTEX_PRIVATE_FLAG, the word lives in memory shared with other processes
+    syscall(SYS_futex, address, FUTEX_WAIT, value, &timeout, NULL, 0);
+    return ATOMIC_LOAD(address) != value;
+#else
+    uint64_t deadline = _getMonotonicNanoseconds() + (uint64_t)timeoutMilliseconds * 1000000ULL;
+
+    while (ATOMIC_LOAD(address) == value) {
+        if (_getMonotonicNanoseconds() >= deadline) {
+            return false;
+        }
+        _sleepMicroseconds(FRAME_RING_POLL_INTERVAL_MICROSECONDS);
+    }
+
+    return true;
+#endif
+}
+
+void _sharedWake(volatile uint32_t *address)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, address, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)address;
+#endif
+}
@@ -0,0 +1,170 @@
+#include <math.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+/*
+    Every read of a reply waits mean + LATENCY_DEVIATION_FACTOR * deviation of the replies of its class seen so far,
+    no less than the floor of the class and no more than its fixed timeout. The estimate
+    weights the first LATENCY_WINDOW samples equally, then turns into an exponential moving average over about as
+    many. A dead link fails after a few milliseconds instead of the fixed timeout, while a reply waiting on
+    an acquisition gets the expected acquisition time on top. A timeout drops the estimate of its class, the
+    fixed timeout applies until it is learned again, so one slow reply does not fail the ones after it.
+    The replies to commands take from a few milliseconds to a reset of the device, their class only reports the
+    estimate and keeps the fixed timeout; status requests, the frequent fast ones, have a class of their own.
+*/
+
+static const uint32_t FIXED_TIMEOUTS_MILLISECONDS[NUM_OF_LATENCY_CLASSES] = {
+    STANDARD_TIMEOUT_MILLISECONDS,      //LATENCY_COMMAND
+    STANDARD_TIMEOUT_MILLISECONDS,      //LATENCY_FRAME_FIRST_PACKET
+    STANDARD_TIMEOUT_MILLISECONDS,      //LATENCY_FRAME_PACKET
+    STANDARD_TIMEOUT_MILLISECONDS,      //LATENCY_READ_FLASH_PACKET
+    STANDARD_TIMEOUT_MILLISECONDS,      //LATENCY_WRITE_FLASH
+    ERASE_FLASH_TIMEOUT_MILLISECONDS,   //LATENCY_ERASE_FLASH
+    STANDARD_TIMEOUT_MILLISECONDS       //LATENCY_STATUS
+};
+
+static const uint32_t MIN_TIMEOUTS_MILLISECONDS[NUM_OF_LATENCY_CLASSES] = {
+    STANDARD_TIMEOUT_MILLISECONDS,      //LATENCY_COMMAND
+    LATENCY_MIN_TIMEOUT_MILLISECONDS,   //LATENCY_FRAME_FIRST_PACKET
+    LATENCY_MIN_TIMEOUT_MILLISECONDS,   //LATENCY_FRAME_PACKET
+    LATENCY_MIN_TIMEOUT_MILLISECONDS,   //LATENCY_READ_FLASH_PACKET
+    LATENCY_MIN_TIMEOUT_MILLISECONDS,   //LATENCY_WRITE_FLASH
+    LATENCY_MIN_TIMEOUT_MILLISECONDS,   //LATENCY_ERASE_FLASH
+    LATENCY_MIN_TIMEOUT_MILLISECONDS    //LATENCY_STATUS
+};
+
+static uint32_t _getExpectedAcquisitionMilliseconds(const DeviceContext_t *deviceContext)
+{
+    uint64_t microseconds = 0;
+
+    if (!deviceContext->acquisitionParametersKnown) {
+        return 0;
+    }
+
+    //The exposure is set in multiples of 10 us, an averaged frame takes numOfScans of them
+    microseconds = (uint64_t)deviceContext->timeOfExposure * 10;
+    if (deviceContext->scanMode == FRAME_AVERAGING_MODE && deviceContext->numOfScans > 1) {
+        microseconds *= deviceContext->numOfScans;
+    }
+
+    microseconds = (microseconds + 999) / 1000;
+    return (microseconds > 0x7FFFFFFF)? 0x7FFFFFFF : (uint32_t)microseconds;
+}
+
+static void _recordLatency(LatencyEstimate_t *estimate, float microseconds)
+{
+    float weight = 0.0f, delta = 0.0f;
+
+    weight = 1.0f / (float)((estimate->numOfSamples < LATENCY_WINDOW)? estimate->numOfSamples + 1 : LATENCY_WINDOW);
+    delta = microseconds - estimate->mean;
+
+    estimate->mean += weight * delta;
+    estimate->variance = (1.0f - weight) * (estimate->variance + weight * delta * delta);
+
+    if (estimate->numOfSamples < 0xFFFFFFFF) {
+        ++estimate->numOfSamples;
+    }
+}
+
+uint32_t _getReadTimeout(const DeviceContext_t *deviceContext, uint8_t latencyClass)
+{
+    const LatencyEstimate_t *estimate = &deviceContext->latencyEstimates[latencyClass];
+    uint32_t timeout = FIXED_TIMEOUTS_MILLISECONDS[latencyClass], extra = 0;
+    float adaptive = 0.0f;
+
+    if (estimate->timeoutOverride) {
+        return estimate->timeoutOverride;
+    }
+
+    if (estimate->numOfSamples >= LATENCY_MIN_SAMPLES) {
+        adaptive = (estimate->mean + LATENCY_DEVIATION_FACTOR * sqrtf(estimate->variance)) / 1000.0f;
+        if (adaptive < (float)timeout) {
+            timeout = (uint32_t)ceilf(adaptive);
+        }
+        if (timeout < MIN_TIMEOUTS_MILLISECONDS[latencyClass]) {
+            timeout = MIN_TIMEOUTS_MILLISECONDS[latencyClass];
+        }
+    }
+
+    if (latencyClass == LATENCY_FRAME_FIRST_PACKET) {
+        extra = _getExpectedAcquisitionMilliseconds(deviceContext);
+        timeout = (extra > 0x7FFFFFFF - timeout)? 0x7FFFFFFF : timeout + extra;
+    }
+
+    return timeout;
+}
+
+int _timedRead(DeviceContext_t *deviceContext, unsigned char *report, uint8_t latencyClass)
+{
+    LatencyEstimate_t *estimate = &deviceContext->latencyEstimates[latencyClass];
+    uint64_t start = _getMonotonicNanoseconds();
+    int result = -1;
+
+    result = hid_read_timeout(deviceContext->handle, report, EXTENDED_PACKET_SIZE, (int)_getReadTimeout(deviceContext, latencyClass));
+
+    if (result == HID_OPERATION_READ_SUCCESS) {
+        _recordLatency(estimate, (float)(_getMonotonicNanoseconds() - start) / 1000.0f);
+    } else if (result == 0) {
+        ++estimate->numOfTimeouts;
+        estimate->numOfSamples = 0;
+        estimate->mean = 0.0f;
+        estimate->variance = 0.0f;
+    }
+
+    return result;
+}
+
+int setReplyTimeout(uint8_t /*LatencyClass_t*/ latencyClass, uint32_t timeoutMilliseconds, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (latencyClass >= NUM_OF_LATENCY_CLASSES || timeoutMilliseconds > 0x7FFFFFFF) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    deviceContext->latencyEstimates[latencyClass].timeoutOverride = timeoutMilliseconds;
+    _mutexUnlock(&deviceContext->mutex);
+
+    return OK;
+}
+
+int getReplyLatency(uint8_t /*LatencyClass_t*/ latencyClass, ReplyLatency_t *replyLatency, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+    const LatencyEstimate_t *estimate = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!replyLatency) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (latencyClass >= NUM_OF_LATENCY_CLASSES) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    estimate = &deviceContext->latencyEstimates[latencyClass];
+    replyLatency->numOfSamples = estimate->numOfSamples;
+    replyLatency->numOfTimeouts = estimate->numOfTimeouts;
+    replyLatency->meanMicroseconds = estimate->mean;
+    replyLatency->deviationMicroseconds = sqrtf(estimate->variance);
+    replyLatency->timeoutMilliseconds = _getReadTimeout(deviceContext, latencyClass);
+    _mutexUnlock(&deviceContext->mutex);
+
+    return OK;
+}
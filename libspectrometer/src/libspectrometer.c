@@ -34,20 +34,29 @@
 
 #endif //defined _WIN32
 
-
+static int _readFrame(uint16_t *framePixelsBuffer, uint16_t numOfFrame, FrameMetadata_t *metadata, FrameRangeHook_t rangeHook, void *hookState, uintptr_t* deviceContextPtr);
+static int _readFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, uintptr_t* deviceContextPtr);
+static int _writeFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToWrite, uintptr_t* deviceContextPtr);
 
 int disconnectDeviceContext(uintptr_t* deviceContextPtr)
 {
     DeviceContext_t *deviceContext = NULL;
 
-    if (!deviceContextPtr) {
+    if (!deviceContextPtr || !*deviceContextPtr) {
         return OK;
     }
 
     deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
+    stopDrainEngine(deviceContextPtr);
+    detachFrameProcessor(deviceContextPtr);
+    _freeAveragingState(deviceContext);
+    _freeFrameCache(deviceContext);
+
     hid_close(deviceContext->handle);
+    _closePollFd(deviceContext);
     free(deviceContext->serial);
+    _mutexDestroy(&deviceContext->mutex);
 
     free(deviceContext);
     *deviceContextPtr = 0;
@@ -67,8 +76,7 @@ int connectToDeviceBySerial(const char * const serialNumber, uintptr_t* deviceCo
         return NO_DEVICE_CONTEXT_ERROR;
     }
 
-    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
-    free(deviceContext);
+    disconnectDeviceContext(deviceContextPtr);
 
     deviceContext = malloc(sizeof(DeviceContext_t));
     *deviceContext = NULL_DEVICE_CONTEXT;
@@ -87,6 +95,7 @@ int connectToDeviceBySerial(const char * const serialNumber, uintptr_t* deviceCo
     deviceContext->handle = hid_open(USBD_VID, USBD_PID, (const wchar_t *)serialWChar);
     if (deviceContext->handle == NULL) {
          free(serialWChar);
+         free(deviceContext);
          return CONNECT_ERROR_FAILED;
     }
 
@@ -100,6 +109,7 @@ int connectToDeviceBySerial(const char * const serialNumber, uintptr_t* deviceCo
         free(serialWChar);
     }
 
+    _mutexInit(&deviceContext->mutex);
     *deviceContextPtr = (uintptr_t)deviceContext;
 
     return OK;
@@ -120,9 +130,7 @@ int connectToDeviceByIndex(unsigned int index, uintptr_t* deviceContextPtr)   //
         return NO_DEVICE_CONTEXT_ERROR;
     }
 
-    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
-    free(deviceContext);
-    *deviceContextPtr = 0;
+    disconnectDeviceContext(deviceContextPtr);
 
     deviceContext = malloc(sizeof(DeviceContext_t));
     *deviceContext = NULL_DEVICE_CONTEXT;
@@ -140,6 +148,7 @@ int connectToDeviceByIndex(unsigned int index, uintptr_t* deviceContextPtr)   //
 
     if (!serialWChar) {
         hid_free_enumeration(devices);
+        free(deviceContext);
         return CONNECT_ERROR_NOT_FOUND;
     }
 
@@ -151,6 +160,7 @@ int connectToDeviceByIndex(unsigned int index, uintptr_t* deviceContextPtr)   //
 
     if (deviceContext->handle == NULL) {
         hid_free_enumeration(devices);
+        free(deviceContext);
         return CONNECT_ERROR_FAILED;
     }
 
@@ -163,6 +173,7 @@ int connectToDeviceByIndex(unsigned int index, uintptr_t* deviceContextPtr)   //
 
     hid_free_enumeration(devices);
 
+    _mutexInit(&deviceContext->mutex);
     *deviceContextPtr = (uintptr_t)deviceContext;
 
     return OK;
@@ -229,6 +240,15 @@ void clearDevicesInfo(struct DeviceInfo_t *devices)
     free(devices);
 }
 
+static void _cacheAcquisitionParameters(uint16_t numOfScans, uint16_t numOfBlankScans, uint8_t scanMode, uint32_t timeOfExposure, DeviceContext_t *deviceContext)
+{
+    deviceContext->numOfScans = numOfScans;
+    deviceContext->numOfBlankScans = numOfBlankScans;
+    deviceContext->scanMode = scanMode;
+    deviceContext->timeOfExposure = timeOfExposure;
+    deviceContext->acquisitionParametersKnown = true;
+}
+
 /**
 \details {
     sends:
@@ -267,7 +287,7 @@ int setFrameFormat(uint16_t numOfStartElement, uint16_t numOfEndElement, uint8_t
     report[5] = HIGH_BYTE(numOfEndElement);
     report[6] = reductionMode;
 
-    result = _writeReadFunction(report, CORRECT_SET_FRAME_FORMAT_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    result = _writeReadFunction(report, CORRECT_SET_FRAME_FORMAT_REPLY, LATENCY_COMMAND, deviceContextPtr);
     if (result != OK) {
         return result;
     }
@@ -275,6 +295,7 @@ int setFrameFormat(uint16_t numOfStartElement, uint16_t numOfEndElement, uint8_t
     errorCode = report[1];
     if (!errorCode) {
         deviceContext->numOfPixelsInFrame = (report[3] << 8) | report[2];
+        _selectFrameLayout(&deviceContext->frameLayout, deviceContext->numOfPixelsInFrame, numOfStartElement, reductionMode);
 
         if (numOfPixelsInFrame) {
             *numOfPixelsInFrame = deviceContext->numOfPixelsInFrame;
@@ -318,12 +339,16 @@ int setExposure(uint32_t timeOfExposure, uint8_t force, uintptr_t* deviceContext
     report[5] = HIGH_BYTE(HIGH_WORD(timeOfExposure));         //exposure & 0xFF;
     report[6] = force;
 
-    result = _writeReadFunction(report, CORRECT_SET_EXPOSURE_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    result = _writeReadFunction(report, CORRECT_SET_EXPOSURE_REPLY, LATENCY_COMMAND, deviceContextPtr);
     if (result != OK) {
         return result;
     }
 
     errorCode = report[1];
+    if (!errorCode) {
+        ((DeviceContext_t*)(*deviceContextPtr))->timeOfExposure = timeOfExposure;
+    }
+
     return errorCode;
 }
 
@@ -364,12 +389,16 @@ int setAcquisitionParameters(uint16_t numOfScans, uint16_t numOfBlankScans, uint
     report[9] = LOW_BYTE(HIGH_WORD(timeOfExposure));
     report[10] = HIGH_BYTE(HIGH_WORD(timeOfExposure));
 
-    result = _writeReadFunction(report, CORRECT_SET_ACQUISITION_PARAMETERS_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    result = _writeReadFunction(report, CORRECT_SET_ACQUISITION_PARAMETERS_REPLY, LATENCY_COMMAND, deviceContextPtr);
     if (result != OK) {
         return result;
     }
 
     errorCode = report[1];
+    if (!errorCode) {
+        _cacheAcquisitionParameters(numOfScans, numOfBlankScans, scanMode, timeOfExposure, (DeviceContext_t*)(*deviceContextPtr));
+    }
+
     return errorCode;
 }
 
@@ -378,6 +407,7 @@ int setMultipleParameters(uint16_t numOfScans, uint16_t numOfBlankScans, uint8_t
     unsigned char report[EXTENDED_PACKET_SIZE];
     int result = -1;
     int errorCode = -1;
+    uint64_t writeTimestamp = 0;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
     if (result != OK)
@@ -397,12 +427,21 @@ int setMultipleParameters(uint16_t numOfScans, uint16_t numOfBlankScans, uint8_t
     report[11] = enableMode;
     report[12] = signalFrontMode;
 
-    result = _writeReadFunction(report, CORRECT_GET_ACQUISITION_PARAMETERS_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    writeTimestamp = _getMonotonicNanoseconds();
+    result = _writeReadFunction(report, CORRECT_GET_ACQUISITION_PARAMETERS_REPLY, LATENCY_COMMAND, deviceContextPtr);
     if (result != OK) {
         return result;
     }
 
     errorCode = report[1];
+    if (!errorCode) {
+        _cacheAcquisitionParameters(numOfScans, numOfBlankScans, scanMode, timeOfExposure, (DeviceContext_t*)(*deviceContextPtr));
+
+        if (enableMode == EXTERNAL_TRIGGER_DISABLED || signalFrontMode == FRONT_DISABLED) {
+            ((DeviceContext_t*)(*deviceContextPtr))->lastTriggerTimestamp = writeTimestamp;
+        }
+    }
+
     return errorCode;
 }
 
@@ -421,7 +460,7 @@ int setExternalTrigger(uint8_t /*EnableMode_t*/ enableMode, uint8_t /*TriggerFro
     report[2] = enableMode;
     report[3] = signalFrontMode;
 
-    result = _writeReadFunction(report, CORRECT_SET_EXTERNAL_TRIGGER_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    result = _writeReadFunction(report, CORRECT_SET_EXTERNAL_TRIGGER_REPLY, LATENCY_COMMAND, deviceContextPtr);
     if (result != OK) {
         return result;
     }
@@ -460,7 +499,7 @@ int setOpticalTrigger(uint8_t /*OpticalTriggerMode_t*/ enableMode, uint16_t pixe
     report[5] = LOW_BYTE(threshold);
     report[6] = HIGH_BYTE(threshold);
 
-    result = _writeReadFunction(report, CORRECT_SET_OPTICAL_TRIGGER_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    result = _writeReadFunction(report, CORRECT_SET_OPTICAL_TRIGGER_REPLY, LATENCY_COMMAND, deviceContextPtr);
     if (result != OK) {
         return result;
     }
@@ -473,6 +512,7 @@ int triggerAcquisition(uintptr_t* deviceContextPtr)
 {
     unsigned char report[EXTENDED_PACKET_SIZE];
     int result = -1;
+    uint64_t writeTimestamp = 0;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
     if (result != OK)
@@ -481,11 +521,59 @@ int triggerAcquisition(uintptr_t* deviceContextPtr)
     report[0] = ZERO_REPORT_ID;
     report[1] = SET_SOFTWARE_TRIGGER_REQUEST;
 
+    writeTimestamp = _getMonotonicNanoseconds();
     result = _writeOnlyFunction(report, deviceContextPtr);
+    if (result == OK) {
+        ((DeviceContext_t*)(*deviceContextPtr))->lastTriggerTimestamp = writeTimestamp;
+    }
+
     return result;
 }
 
 
+void _storeStatus(DeviceContext_t *deviceContext, uint8_t statusFlags, uint16_t framesInMemory, uint64_t requestTimestamp)
+{
+    StatusCache_t *cache = &deviceContext->statusCache;
+
+    cache->statusKnown = true;
+    cache->framesInMemoryKnown = true;
+    cache->statusFlags = statusFlags;
+    cache->framesInMemory = framesInMemory;
+    cache->requestTimestamp = requestTimestamp;
+}
+
+void _invalidateDeviceState(DeviceContext_t *deviceContext, bool frameRead)
+{
+    StatusCache_t *cache = &deviceContext->statusCache;
+
+    cache->statusKnown = false;
+
+    //The frame read stays in memory, but in frame averaging mode the count is the ready state of the one frame
+    if (!frameRead || !deviceContext->acquisitionParametersKnown || deviceContext->scanMode == FRAME_AVERAGING_MODE) {
+        cache->framesInMemoryKnown = false;
+    }
+
+    if (!frameRead) {
+        ++deviceContext->memoryGeneration;
+    }
+}
+
+static bool _isStatusCached(const DeviceContext_t *deviceContext, bool statusFlagsNeeded, bool fromCache, uint64_t callTimestamp)
+{
+    const StatusCache_t *cache = &deviceContext->statusCache;
+
+    if (!(statusFlagsNeeded? cache->statusKnown : cache->framesInMemoryKnown)) {
+        return false;
+    }
+
+    //Requested while this call waited for the mutex, the reply is as recent as its own would be
+    if (cache->requestTimestamp >= callTimestamp) {
+        return true;
+    }
+
+    return fromCache && cache->timeToLive && _getMonotonicNanoseconds() - cache->requestTimestamp <= (uint64_t)cache->timeToLive * 1000000ULL;
+}
+
 /**
     \details
     sends:
@@ -499,31 +587,64 @@ int triggerAcquisition(uintptr_t* deviceContextPtr)
     inReport[2] = LO(framesInMemory);
     inReport[3] = HI(framesInMemory);
 */
-int getStatus(uint8_t *statusFlags, uint16_t *framesInMemory, uintptr_t* deviceContextPtr)
+int _getStatus(uint8_t *statusFlags, uint16_t *framesInMemory, bool fromCache, uintptr_t* deviceContextPtr)
 {
     unsigned char report[EXTENDED_PACKET_SIZE];
     int result = -1;
+    uint64_t callTimestamp = _getMonotonicNanoseconds(), requestTimestamp = 0;
+    DeviceContext_t *deviceContext = NULL;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
     if (result != OK)
         return result;
 
-    report[0] = ZERO_REPORT_ID;
-    report[1] = STATUS_REQUEST;
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
-    result = _writeReadFunction(report, CORRECT_STATUS_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
-    if (result != OK) {
-        return result;
+    _mutexLock(&deviceContext->mutex);
+
+    if (!_isStatusCached(deviceContext, statusFlags != NULL, fromCache, callTimestamp)) {
+        report[0] = ZERO_REPORT_ID;
+        report[1] = STATUS_REQUEST;
+
+        requestTimestamp = _getMonotonicNanoseconds();
+        result = _writeReadFunction(report, CORRECT_STATUS_REPLY, LATENCY_STATUS, deviceContextPtr);
+        if (result == OK) {
+            _storeStatus(deviceContext, report[1], (report[3] << 8) | (report[2]), requestTimestamp);
+        }
     }
 
-    if (statusFlags) {
-        *statusFlags = report[1];
+    if (result == OK && statusFlags) {
+        *statusFlags = deviceContext->statusCache.statusFlags;
     }
 
-    if (framesInMemory) {
-        *framesInMemory = (report[3] << 8) | (report[2]);
+    if (result == OK && framesInMemory) {
+        *framesInMemory = deviceContext->statusCache.framesInMemory;
     }
 
+    _mutexUnlock(&deviceContext->mutex);
+    return result;
+}
+
+int getStatus(uint8_t *statusFlags, uint16_t *framesInMemory, uintptr_t* deviceContextPtr)
+{
+    return _getStatus(statusFlags, framesInMemory, true, deviceContextPtr);
+}
+
+int setStatusCacheTime(uint32_t timeToLiveMilliseconds, uintptr_t* deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    deviceContext->statusCache.timeToLive = timeToLiveMilliseconds;
+    _mutexUnlock(&deviceContext->mutex);
+
     return OK;
 }
 
@@ -539,7 +660,7 @@ int getAcquisitionParameters(uint16_t* numOfScans, uint16_t* numOfBlankScans, ui
     report[0] = ZERO_REPORT_ID;
     report[1] = GET_ACQUISITION_PARAMETERS_REQUEST;
 
-    result = _writeReadFunction(report, CORRECT_GET_ACQUISITION_PARAMETERS_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    result = _writeReadFunction(report, CORRECT_GET_ACQUISITION_PARAMETERS_REPLY, LATENCY_COMMAND, deviceContextPtr);
     if (result != OK) {
         return result;
     }
@@ -560,6 +681,10 @@ int getAcquisitionParameters(uint16_t* numOfScans, uint16_t* numOfBlankScans, ui
         *timeOfExposure = (report[9] << 24) | (report[8] << 16) | (report[7] << 8) | report[6];
     }
 
+    _cacheAcquisitionParameters((report[2] << 8) | report[1], (report[4] << 8) | report[3], report[5],
+                                (report[9] << 24) | (report[8] << 16) | (report[7] << 8) | report[6],
+                                (DeviceContext_t*)(*deviceContextPtr));
+
     return OK;
 }
 
@@ -592,7 +717,7 @@ int getFrameFormat(uint16_t *numOfStartElement, uint16_t *numOfEndElement, uint8
     report[0] = ZERO_REPORT_ID;
     report[1] = GET_FRAME_FORMAT_REQUEST;
 
-    result = _writeReadFunction(report, CORRECT_GET_FRAME_FORMAT_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    result = _writeReadFunction(report, CORRECT_GET_FRAME_FORMAT_REPLY, LATENCY_COMMAND, deviceContextPtr);
     if (result != OK) {
         return result;
     }
@@ -610,6 +735,7 @@ int getFrameFormat(uint16_t *numOfStartElement, uint16_t *numOfEndElement, uint8
     }
 
     deviceContext->numOfPixelsInFrame = (report[7] << 8) | report[6];
+    _selectFrameLayout(&deviceContext->frameLayout, deviceContext->numOfPixelsInFrame, (report[2] << 8) | report[1], report[5]);
 
     if (numOfPixelsInFrame) {
         *numOfPixelsInFrame = deviceContext->numOfPixelsInFrame;
@@ -642,20 +768,178 @@ inReport[63]=HI(frame[offset+29]);
 }
 */
 int getFrame(uint16_t *framePixelsBuffer, uint16_t numOfFrame, uintptr_t* deviceContextPtr)
-{    
-    uint8_t report[EXTENDED_PACKET_SIZE];
+{
+    return getFrameWithMetadata(framePixelsBuffer, numOfFrame, NULL, deviceContextPtr);
+}
+
+int getFrameWithMetadata(uint16_t *framePixelsBuffer, uint16_t numOfFrame, FrameMetadata_t *metadata, uintptr_t* deviceContextPtr)
+{
+    return _getFrameWithHook(framePixelsBuffer, numOfFrame, metadata, NULL, NULL, deviceContextPtr);
+}
+
+int getFrameTransferStatistics(FrameTransferStatistics_t *statistics, uintptr_t* deviceContextPtr)
+{
     int result = -1;
+    DeviceContext_t *deviceContext = NULL;
 
-    /* Total frame request parameters: */
-    uint16_t pixelOffset = 0;
-    uint8_t numOfPacketsToGet = 0, numOfPacketsLeft = 0, numOfPacketsReceived = 0;
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
 
-    bool continueGetInReport = true;
-    uint16_t totalNumOfReceivedPixels = 0;
+    if (!statistics) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    statistics->framesRecovered = deviceContext->frameTransferCounters.framesRecovered;
+    statistics->framesFailed = deviceContext->frameTransferCounters.framesFailed;
+    statistics->packetsRetransmitted = deviceContext->frameTransferCounters.packetsRetransmitted;
+    statistics->packetsDiscarded = deviceContext->frameTransferCounters.packetsDiscarded;
+    _mutexUnlock(&deviceContext->mutex);
+
+    return OK;
+}
+
+int _getFrameWithHook(uint16_t *framePixelsBuffer, uint16_t numOfFrame, FrameMetadata_t *metadata, FrameRangeHook_t rangeHook, void *hookState, uintptr_t* deviceContextPtr)
+{
+    int result = -1;
+    bool cacheable = false;
+    uint32_t memoryGeneration = 0;
+    FrameMetadata_t frameMetadata;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    //A hook needs the frame packet by packet
+    cacheable = framePixelsBuffer && !rangeHook;
+
+    if (deviceContext->asyncOperation.kind != ASYNC_OPERATION_NONE) {
+        result = INVALID_STATE_ERROR;
+    } else if (cacheable && _lookupCachedFrame(deviceContext, numOfFrame, framePixelsBuffer, metadata)) {
+        result = OK;
+    } else {
+        cacheable = cacheable && _shouldCacheFrame(deviceContext, numOfFrame);
+        memoryGeneration = deviceContext->memoryGeneration;
+
+        result = _readFrame(framePixelsBuffer, numOfFrame, cacheable? &frameMetadata : metadata, rangeHook, hookState, deviceContextPtr);
+        if (result == OK && cacheable) {
+            if (metadata) {
+                *metadata = frameMetadata;
+            }
+            _cacheFrame(deviceContext, numOfFrame, framePixelsBuffer, &frameMetadata, memoryGeneration);
+        }
+    }
+    _mutexUnlock(&deviceContext->mutex);
+
+    return result;
+}
+
+static const FrameTransfer_t EMPTY_FRAME_TRANSFER;
+
+static void _finishFramePackets(FrameTransfer_t *transfer, DeviceContext_t *deviceContext)
+{
+    uint32_t end = 0;
+
+    while (transfer->numOfFinishedPackets < transfer->numOfPackets && transfer->packetReceived[transfer->numOfFinishedPackets]) {
+        ++transfer->numOfFinishedPackets;
+    }
+
+    end = (uint32_t)transfer->numOfFinishedPackets * NUM_OF_PIXELS_IN_PACKET;
+    if (end > transfer->numOfPixelsInFrame) {
+        end = transfer->numOfPixelsInFrame;
+    }
+
+    //The shielded elements come first, the packets are corrected and handed to the hook while still in cache.
+    //Frames of a narrower range or another reduction have no shielded elements at the expected place and are not corrected
+    if (!transfer->darkLevelKnown) {
+        if (!transfer->frameLayout->darkReference) {
+            transfer->darkLevel = 0;
+        } else if (end < DARK_REFERENCE_FIRST_ELEMENT + DARK_REFERENCE_NUM_OF_ELEMENTS) {
+            return;
+        } else {
+            transfer->darkLevel = _estimateDarkLevel(transfer->framePixels);
+        }
+        transfer->darkLevelKnown = true;
+    }
 
-    uint8_t indexOfPixelInPacket = 0;
-    int indexInPacket = 0;
+    if (end <= transfer->numOfFinishedPixels) {
+        return;
+    }
+
+    if (deviceContext->darkCorrectionMode == DARK_CORRECTION_ENABLED && transfer->frameLayout->darkReference) {
+        _correctDarkLevelRange(transfer->framePixels, transfer->numOfPixelsInFrame, transfer->numOfFinishedPixels, end,
+                               transfer->darkLevel, deviceContext->darkPedestal);
+    }
+    if (transfer->rangeHook) {
+        transfer->rangeHook(transfer->hookState, transfer->framePixels, transfer->numOfFinishedPixels, end);
+    }
+    transfer->numOfFinishedPixels = end;
+}
+
+static void _acceptFramePacket(FrameTransfer_t *transfer, DeviceContext_t *deviceContext, const uint8_t *report, uint8_t packetIndex)
+{
+    uint32_t pixelOffset = (uint32_t)packetIndex * NUM_OF_PIXELS_IN_PACKET, numOfPixels = NUM_OF_PIXELS_IN_PACKET;
+
+    if (packetIndex + 1u < transfer->numOfPackets) {
+        _decodeFullPacket(transfer->framePixels + pixelOffset, report + 4);
+    } else {
+        numOfPixels = transfer->frameLayout->numOfPixelsInLastPacket;
+        transfer->frameLayout->decodeLastPacket(transfer->framePixels + pixelOffset, report + 4, numOfPixels);
+    }
+
+    _measureFrameRange(transfer->framePixels, transfer->numOfPixelsInFrame, pixelOffset, pixelOffset + numOfPixels,
+                       &transfer->maxPixel, &transfer->numOfSaturatedPixels);
+
+    transfer->packetReceived[packetIndex] = true;
+    ++transfer->numOfPacketsReceived;
+
+    _finishFramePackets(transfer, deviceContext);
+}
+
+static int _requestFramePackets(FrameTransfer_t *transfer, uintptr_t* deviceContextPtr)
+{
+    uint8_t report[EXTENDED_PACKET_SIZE];
+    uint16_t pixelOffset = (uint16_t)(transfer->firstRequestedPacket * NUM_OF_PIXELS_IN_PACKET);
+
+    transfer->numOfReadsInRequest = 0;
+    transfer->numOfDiscardedInRequest = 0;
+    transfer->failure = OK;
+
+    report[0] = ZERO_REPORT_ID;
+    report[1] = GET_FRAME_REQUEST;
+    report[2] = LOW_BYTE(pixelOffset);
+    report[3] = HIGH_BYTE(pixelOffset);
+    report[4] = LOW_BYTE(transfer->numOfFrame);
+    report[5] = HIGH_BYTE(transfer->numOfFrame);
+    report[6] = transfer->numOfRequestedPackets;
+
+    return _tryWrite(report, deviceContextPtr);
+}
+
+void _flushReports(DeviceContext_t *deviceContext)
+{
+    uint8_t report[EXTENDED_PACKET_SIZE];
+    uint32_t i = 0;
+
+    //Replies to the aborted request still in the queue would be taken for replies to the next one
+    for (i = 0; i < 2 * MAX_PACKETS_IN_FRAME; ++i) {
+        if (hid_read_timeout(deviceContext->handle, report, EXTENDED_PACKET_SIZE, 0) != HID_OPERATION_READ_SUCCESS) {
+            break;
+        }
+        ++deviceContext->frameTransferCounters.packetsDiscarded;
+    }
+}
 
+int _beginFrameTransfer(FrameTransfer_t *transfer, uint16_t *framePixelsBuffer, uint16_t numOfFrame, FrameRangeHook_t rangeHook, void *hookState, uintptr_t* deviceContextPtr)
+{
+    int result = -1;
     DeviceContext_t *deviceContext = NULL;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
@@ -681,65 +965,160 @@ int getFrame(uint16_t *framePixelsBuffer, uint16_t numOfFrame, uintptr_t* device
             return result;
     }
 
-    numOfPacketsToGet = (deviceContext->numOfPixelsInFrame) / NUM_OF_PIXELS_IN_PACKET;
-    numOfPacketsToGet += (deviceContext->numOfPixelsInFrame % NUM_OF_PIXELS_IN_PACKET)? 1 : 0;
+    _invalidateDeviceState(deviceContext, true);
+
+    //The frame size may have been set without going through setFrameFormat() or getFrameFormat(), the last known range is kept
+    if (deviceContext->frameLayout.numOfPixelsInFrame != deviceContext->numOfPixelsInFrame || !deviceContext->frameLayout.decodeLastPacket) {
+        _selectFrameLayout(&deviceContext->frameLayout, deviceContext->numOfPixelsInFrame,
+                           deviceContext->frameLayout.numOfStartElement, deviceContext->frameLayout.reductionMode);
+    }
 
-    if (numOfPacketsToGet > MAX_PACKETS_IN_FRAME) {
+    if (deviceContext->frameLayout.numOfPackets > MAX_PACKETS_IN_FRAME) {
         return NUM_OF_PACKETS_IN_FRAME_ERROR;
     }
 
-    report[0] = ZERO_REPORT_ID;
-    report[1] = GET_FRAME_REQUEST;
-    report[2] = LOW_BYTE(pixelOffset);
-    report[3] = HIGH_BYTE(pixelOffset);
-    report[4] = LOW_BYTE(numOfFrame);
-    report[5] = HIGH_BYTE(numOfFrame);
-    report[6] = numOfPacketsToGet;
+    *transfer = EMPTY_FRAME_TRANSFER;
+    transfer->framePixels = framePixelsBuffer;
+    transfer->numOfPixelsInFrame = deviceContext->numOfPixelsInFrame;
+    transfer->numOfFrame = numOfFrame;
+    transfer->numOfPackets = (uint8_t)deviceContext->frameLayout.numOfPackets;
+    transfer->frameLayout = &deviceContext->frameLayout;
+    transfer->rangeHook = rangeHook;
+    transfer->hookState = hookState;
 
-    result = _tryWrite(report, deviceContextPtr);
-    if (result != OK) {
-        return result;
-    }
-    continueGetInReport = true;
-    while (continueGetInReport) {
-        result = hid_read_timeout(deviceContext->handle, report, EXTENDED_PACKET_SIZE, STANDARD_TIMEOUT_MILLISECONDS);
-        if (result != HID_OPERATION_READ_SUCCESS){
-            return READING_PROCESS_FAILED;
+    transfer->firstRequestedPacket = 0;
+    transfer->numOfRequestedPackets = transfer->numOfPackets;
+
+    transfer->requestTimestamp = _getMonotonicNanoseconds();
+    return _requestFramePackets(transfer, deviceContextPtr);
+}
+
+FrameTransferStep_t _handleFramePacket(FrameTransfer_t *transfer, DeviceContext_t *deviceContext, const uint8_t *report)
+{
+    uint16_t pixelOffset = (report[2] << 8) | report[1];
+    uint8_t numOfPacketsLeft = report[3], packetIndex = (uint8_t)(pixelOffset / NUM_OF_PIXELS_IN_PACKET);
+    uint32_t firstPacket = transfer->firstRequestedPacket, endPacket = firstPacket + transfer->numOfRequestedPackets;
+
+    ++transfer->numOfReadsInRequest;
+
+    //Stale replies and packets that do not fit the request are dropped, the missing ones are requested again
+    if (report[0] != CORRECT_GET_FRAME_REPLY) {
+        transfer->failure = WRONG_ANSWER;
+    } else if (numOfPacketsLeft >= REMAINING_PACKETS_ERROR || pixelOffset % NUM_OF_PIXELS_IN_PACKET ||
+               pixelOffset / NUM_OF_PIXELS_IN_PACKET < firstPacket || pixelOffset / NUM_OF_PIXELS_IN_PACKET >= endPacket ||
+               numOfPacketsLeft != endPacket - 1 - packetIndex) {
+        transfer->failure = GET_FRAME_REMAINING_PACKETS_ERROR;
+    } else {
+        transfer->lastPacketTimestamp = _getMonotonicNanoseconds();
+        if (!transfer->firstPacketTimestamp) {
+            transfer->firstPacketTimestamp = transfer->lastPacketTimestamp;
         }
 
-        if (report[0] != CORRECT_GET_FRAME_REPLY) {
-            return WRONG_ANSWER;
+        if (!transfer->packetReceived[packetIndex]) {
+            _acceptFramePacket(transfer, deviceContext, report, packetIndex);
+        } else {
+            ++deviceContext->frameTransferCounters.packetsDiscarded;
         }
 
-        ++numOfPacketsReceived;
+        return numOfPacketsLeft? FRAME_TRANSFER_RECEIVING : FRAME_TRANSFER_REQUEST_ENDED;
+    }
 
-        numOfPacketsLeft = report[3];
-        if (numOfPacketsLeft >= REMAINING_PACKETS_ERROR ||
-            (numOfPacketsLeft != numOfPacketsToGet - numOfPacketsReceived)) {
-            return GET_FRAME_REMAINING_PACKETS_ERROR;
-        }
+    ++deviceContext->frameTransferCounters.packetsDiscarded;
+    return (++transfer->numOfDiscardedInRequest > transfer->numOfRequestedPackets)? FRAME_TRANSFER_REQUEST_ENDED : FRAME_TRANSFER_RECEIVING;
+}
 
-        if (numOfPacketsLeft != numOfPacketsToGet - numOfPacketsReceived) {
-            return GET_FRAME_REMAINING_PACKETS_ERROR;
-        }
+int _endFrameRequest(FrameTransfer_t *transfer, uintptr_t* deviceContextPtr, bool *complete)
+{
+    DeviceContext_t *deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+    uint8_t numOfPackets = 0;
 
-        continueGetInReport = (numOfPacketsLeft > 0)? true : false;
+    *complete = (transfer->numOfPacketsReceived == transfer->numOfPackets);
+    if (*complete) {
+        return OK;
+    }
 
-        pixelOffset = (report[2] << 8) | report[1];
+    if (transfer->numOfRetransmissions >= FRAME_MAX_RETRANSMISSIONS) {
+        ++deviceContext->frameTransferCounters.framesFailed;
+        return (transfer->failure != OK)? transfer->failure : GET_FRAME_REMAINING_PACKETS_ERROR;
+    }
+    ++transfer->numOfRetransmissions;
 
-        indexInPacket = 4;
-        indexOfPixelInPacket = 0;
+    _flushReports(deviceContext);
 
-        while ((totalNumOfReceivedPixels < deviceContext->numOfPixelsInFrame) && (indexOfPixelInPacket < NUM_OF_PIXELS_IN_PACKET)) {
-            uint16_t pixel = (report[indexInPacket + 1] << 8) | report[indexInPacket];
-            framePixelsBuffer[pixelOffset + indexOfPixelInPacket] = pixel;
+    //Only the first run of missing packets is requested again, the next ones follow in later requests
+    while (transfer->numOfFinishedPackets + numOfPackets < transfer->numOfPackets && !transfer->packetReceived[transfer->numOfFinishedPackets + numOfPackets]) {
+        ++numOfPackets;
+    }
+    transfer->firstRequestedPacket = transfer->numOfFinishedPackets;
+    transfer->numOfRequestedPackets = numOfPackets;
+    deviceContext->frameTransferCounters.packetsRetransmitted += numOfPackets;
+
+    return _requestFramePackets(transfer, deviceContextPtr);
+}
 
-            indexInPacket += 2;
-            ++indexOfPixelInPacket;
-            ++totalNumOfReceivedPixels;
+void _finishFrameTransfer(FrameTransfer_t *transfer, DeviceContext_t *deviceContext, FrameMetadata_t *metadata)
+{
+    if (transfer->numOfRetransmissions) {
+        ++deviceContext->frameTransferCounters.framesRecovered;
+    }
+
+    if (transfer->rangeHook && transfer->numOfFinishedPixels < transfer->numOfPixelsInFrame) {
+        transfer->rangeHook(transfer->hookState, transfer->framePixels, transfer->numOfFinishedPixels, transfer->numOfPixelsInFrame);
+    }
+
+    ++deviceContext->frameSequenceNumber;
+
+    if (metadata) {
+        metadata->triggerTimestamp = deviceContext->lastTriggerTimestamp;
+        metadata->requestTimestamp = transfer->requestTimestamp;
+        metadata->firstPacketTimestamp = transfer->firstPacketTimestamp;
+        metadata->lastPacketTimestamp = transfer->lastPacketTimestamp;
+        metadata->sequenceNumber = deviceContext->frameSequenceNumber;
+        metadata->frameIndex = transfer->numOfFrame;
+        metadata->numOfPixelsInFrame = transfer->numOfPixelsInFrame;
+        metadata->timeOfExposure = deviceContext->timeOfExposure;
+        metadata->numOfScans = deviceContext->numOfScans;
+        metadata->numOfBlankScans = deviceContext->numOfBlankScans;
+        metadata->scanMode = deviceContext->scanMode;
+        metadata->acquisitionParametersKnown = deviceContext->acquisitionParametersKnown;
+        metadata->darkLevel = transfer->darkLevel;
+        metadata->maxPixel = transfer->maxPixel;
+        metadata->numOfSaturatedPixels = transfer->numOfSaturatedPixels;
+    }
+}
+
+static int _readFrame(uint16_t *framePixelsBuffer, uint16_t numOfFrame, FrameMetadata_t *metadata, FrameRangeHook_t rangeHook, void *hookState, uintptr_t* deviceContextPtr)
+{
+    uint8_t report[EXTENDED_PACKET_SIZE];
+    int result = -1;
+    bool complete = false;
+
+    FrameTransfer_t transfer;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _beginFrameTransfer(&transfer, framePixelsBuffer, numOfFrame, rangeHook, hookState, deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    while (!complete) {
+        result = _timedRead(deviceContext, report, transfer.numOfReadsInRequest? LATENCY_FRAME_PACKET : LATENCY_FRAME_FIRST_PACKET);
+        if (result != HID_OPERATION_READ_SUCCESS) {
+            transfer.failure = READING_PROCESS_FAILED;
+        } else if (_handleFramePacket(&transfer, deviceContext, report) == FRAME_TRANSFER_RECEIVING) {
+            continue;
+        }
+
+        result = _endFrameRequest(&transfer, deviceContextPtr, &complete);
+        if (result != OK) {
+            return result;
         }
     }
 
+    _finishFrameTransfer(&transfer, deviceContext, metadata);
+
     return OK;
 }
 
@@ -764,7 +1143,7 @@ int clearMemory(uintptr_t* deviceContextPtr)
     report[0] = ZERO_REPORT_ID;
     report[1] = CLEAR_MEMORY_REQUEST;
 
-    result = _writeReadFunction(report, CORRECT_CLEAR_MEMORY_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    result = _writeReadFunction(report, CORRECT_CLEAR_MEMORY_REPLY, LATENCY_COMMAND, deviceContextPtr);
     if (result != OK) {
         return result;
     }
@@ -793,7 +1172,7 @@ int eraseFlash(uintptr_t* deviceContextPtr)
     report[0] = ZERO_REPORT_ID;
     report[1] = ERASE_FLASH_REQUEST;
 
-    result = _writeReadFunction(report, CORRECT_ERASE_FLASH_REPLY, ERASE_FLASH_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    result = _writeReadFunction(report, CORRECT_ERASE_FLASH_REPLY, LATENCY_ERASE_FLASH, deviceContextPtr);
     if (result != OK) {
         return result;
     }
@@ -821,6 +1200,28 @@ inReport[5] = flash[absoluteOffset + localOffset + 1];
 inReport[63] = flash[absoluteOffset + localOffset + 59];
 */
 int readFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, uintptr_t* deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    if (deviceContext->asyncOperation.kind != ASYNC_OPERATION_NONE) {
+        result = INVALID_STATE_ERROR;
+    } else {
+        result = _readFlash(buffer, absoluteOffset, bytesToRead, deviceContextPtr);
+    }
+    _mutexUnlock(&deviceContext->mutex);
+
+    return result;
+}
+
+static int _readFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, uintptr_t* deviceContextPtr)
 {
     int result = -1;
     uint8_t report[EXTENDED_PACKET_SIZE];    
@@ -879,7 +1280,7 @@ int readFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, ui
         numOfPacketsReceivedCurrent = 0;
         continueGetInReport = true;
         while (continueGetInReport) {
-            result = hid_read_timeout(deviceContext->handle, report, EXTENDED_PACKET_SIZE, STANDARD_TIMEOUT_MILLISECONDS);
+            result = _timedRead(deviceContext, report, LATENCY_READ_FLASH_PACKET);
             if (result != HID_OPERATION_READ_SUCCESS){
                 return READING_PROCESS_FAILED;
             }
@@ -939,6 +1340,28 @@ int readFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, ui
 
 */
 int writeFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToWrite, uintptr_t* deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    if (deviceContext->asyncOperation.kind != ASYNC_OPERATION_NONE) {
+        result = INVALID_STATE_ERROR;
+    } else {
+        result = _writeFlash(buffer, absoluteOffset, bytesToWrite, deviceContextPtr);
+    }
+    _mutexUnlock(&deviceContext->mutex);
+
+    return result;
+}
+
+static int _writeFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToWrite, uintptr_t* deviceContextPtr)
 {
     int result = -1;
     uint8_t report[EXTENDED_PACKET_SIZE];
@@ -985,7 +1408,7 @@ int writeFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToWrite,
             return WRITING_PROCESS_FAILED;
         }
 
-        result = hid_read_timeout(deviceContext->handle, report, EXTENDED_PACKET_SIZE, STANDARD_TIMEOUT_MILLISECONDS);
+        result = _timedRead(deviceContext, report, LATENCY_WRITE_FLASH);
         if (result != HID_OPERATION_READ_SUCCESS){
             return READING_PROCESS_FAILED;
         }
@@ -1013,15 +1436,33 @@ int resetDevice(uintptr_t* deviceContextPtr)
 {
     unsigned char report[EXTENDED_PACKET_SIZE];
     int result = -1;
+    DeviceContext_t *deviceContext = NULL;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
     if (result != OK)
         return result;
 
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
     report[0] = ZERO_REPORT_ID;
     report[1] = RESET_REQUEST;
 
+    //Held across the write, so no frame read starts in between with the old frame format
+    _mutexLock(&deviceContext->mutex);
+
     result = _writeOnlyFunction(report, deviceContextPtr);
+    if (result == OK) {
+        //The defaults depend on the model and the firmware, they are read back when next needed.
+        //The decoder is kept for an asynchronous frame read still pending, the next read selects the layout again
+        deviceContext->acquisitionParametersKnown = false;
+        deviceContext->numOfPixelsInFrame = 0;
+        deviceContext->frameLayout.numOfPixelsInFrame = 0;
+        deviceContext->frameLayout.numOfStartElement = 0;
+        deviceContext->frameLayout.reductionMode = NO_AVERAGE;
+        deviceContext->frameLayout.darkReference = false;
+    }
+
+    _mutexUnlock(&deviceContext->mutex);
     return result;
 }
 
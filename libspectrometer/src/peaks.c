@@ -0,0 +1,300 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define PEAKS_SSE2
+    #include <emmintrin.h>
+#endif
+
+/*
+    Candidates are the image elements at or above the threshold where the first difference changes sign
+    from positive to zero or negative, i.e. the first element of a local maximum. Candidates closer than
+    minDistance to a higher one are dropped. The survivors are refined with a parabola (or a Gaussian,
+    i.e. a parabola through the logarithms) through the maximum and its two neighbours.
+*/
+
+static uint32_t _lowestBit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+
+    _BitScanForward(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(mask);
+#endif
+}
+
+typedef struct PeakFinder_t {
+    uint16_t threshold;
+    uint16_t minDistance;
+    uint8_t refinementMode;
+    float trackingTolerance;
+
+    uint16_t *candidates;
+    Peak_t *peaks;
+    uint32_t capacity;
+
+    /* Peaks of the previous frame, for tracking */
+    Peak_t *previousPeaks;
+    uint32_t numOfPreviousPeaks;
+    uint32_t nextTrackId;
+} PeakFinder_t;
+
+static PeakFinder_t *_getPeakFinder(uintptr_t *peakFinderPtr)
+{
+    if (!peakFinderPtr || !*peakFinderPtr) {
+        return NULL;
+    }
+
+    return (PeakFinder_t*)(*peakFinderPtr);
+}
+
+static void _freePeakFinder(PeakFinder_t *finder)
+{
+    free(finder->candidates);
+    free(finder->peaks);
+    free(finder->previousPeaks);
+    free(finder);
+}
+
+static uint32_t _findCandidates(const uint16_t *pixels, uint32_t first, uint32_t end, uint16_t threshold, uint16_t *candidates)
+{
+    uint32_t i = first, numOfCandidates = 0;
+
+#if defined(PEAKS_SSE2)
+    //Eight elements at a time, unsigned comparisons as signed ones on values shifted by 0x8000
+    __m128i bias = _mm_set1_epi16((short)0x8000), limit = _mm_set1_epi16((short)threshold), zero = _mm_setzero_si128();
+    __m128i previous, current, next, raw, rising, stillRising, aboveThreshold;
+    uint32_t mask = 0;
+
+    for (; i + 9 <= end; i += 8) {
+        raw = _mm_loadu_si128((const __m128i*)(pixels + i));
+        previous = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(pixels + i - 1)), bias);
+        current = _mm_xor_si128(raw, bias);
+        next = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(pixels + i + 1)), bias);
+
+        rising = _mm_cmpgt_epi16(current, previous);
+        stillRising = _mm_cmpgt_epi16(next, current);
+        aboveThreshold = _mm_cmpeq_epi16(_mm_subs_epu16(limit, raw), zero);
+
+        mask = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(_mm_andnot_si128(stillRising, _mm_and_si128(rising, aboveThreshold)), zero));
+        while (mask) {
+            candidates[numOfCandidates++] = (uint16_t)(i + _lowestBit(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < end; ++i) {
+        if (pixels[i] >= threshold && pixels[i] > pixels[i - 1] && pixels[i] >= pixels[i + 1]) {
+            candidates[numOfCandidates++] = (uint16_t)i;
+        }
+    }
+
+    return numOfCandidates;
+}
+
+static void _refinePeak(const uint16_t *pixels, uint32_t first, uint32_t end, uint16_t index, uint8_t refinementMode, Peak_t *peak)
+{
+    float left = pixels[index - 1], center = pixels[index], right = pixels[index + 1];
+    float curvature = 0.0f, offset = 0.0f, half = 0.0f, position = 0.0f, leftEdge = 0.0f, rightEdge = 0.0f;
+    uint32_t i = 0;
+
+    if (refinementMode == PEAK_REFINEMENT_GAUSSIAN && left > 0.0f && right > 0.0f) {
+        curvature = logf(left) - 2.0f * logf(center) + logf(right);
+        if (curvature < 0.0f) {
+            offset = 0.5f * (logf(left) - logf(right)) / curvature;
+            peak->height = expf(logf(center) - 0.25f * (logf(left) - logf(right)) * offset);
+        }
+    }
+
+    if (curvature >= 0.0f) {
+        curvature = left - 2.0f * center + right;
+        offset = (curvature < 0.0f)? 0.5f * (left - right) / curvature : 0.0f;
+        peak->height = center - 0.25f * (left - right) * offset;
+    }
+
+    position = (float)index + offset;
+    peak->position = position;
+
+    //Full width at half maximum, linearly interpolated on both flanks
+    half = 0.5f * peak->height;
+    i = index;
+    while (i > first && pixels[i - 1] > half) {
+        --i;
+    }
+    leftEdge = (i > first && pixels[i] != pixels[i - 1])? (float)i - (pixels[i] - half) / (float)(pixels[i] - pixels[i - 1]) : (float)i;
+    i = index;
+    while (i + 1 < end && pixels[i + 1] > half) {
+        ++i;
+    }
+    rightEdge = (i + 1 < end && pixels[i] != pixels[i + 1])? (float)i + (pixels[i] - half) / (float)(pixels[i] - pixels[i + 1]) : (float)i;
+    peak->width = rightEdge - leftEdge;
+}
+
+static int _compareHeights(const void *a, const void *b)
+{
+    float first = ((const Peak_t*)a)->height, second = ((const Peak_t*)b)->height;
+
+    return (first < second) - (first > second);
+}
+
+static int _comparePositions(const void *a, const void *b)
+{
+    float first = ((const Peak_t*)a)->position, second = ((const Peak_t*)b)->position;
+
+    return (first > second) - (first < second);
+}
+
+static void _trackPeaks(PeakFinder_t *finder, Peak_t *peaks, uint32_t numOfPeaks)
+{
+    uint32_t i = 0, j = 0;
+    float distance = 0.0f;
+
+    //Both lists are ordered by position, every previous peak continues at most one track
+    for (i = 0; i < numOfPeaks; ++i) {
+        while (j < finder->numOfPreviousPeaks && finder->previousPeaks[j].position < peaks[i].position - finder->trackingTolerance) {
+            ++j;
+        }
+
+        distance = (j < finder->numOfPreviousPeaks)? fabsf(finder->previousPeaks[j].position - peaks[i].position) : finder->trackingTolerance + 1.0f;
+        if (distance <= finder->trackingTolerance) {
+            peaks[i].trackId = finder->previousPeaks[j].trackId;
+            ++j;
+        } else {
+            peaks[i].trackId = finder->nextTrackId++;
+        }
+    }
+
+    memcpy(finder->previousPeaks, peaks, numOfPeaks * sizeof(Peak_t));
+    finder->numOfPreviousPeaks = numOfPeaks;
+}
+
+int createPeakFinder(uint16_t threshold, uint16_t minDistance, uint8_t /*PeakRefinementMode_t*/ refinementMode, float trackingTolerance, uintptr_t *peakFinderPtr)
+{
+    PeakFinder_t *finder = NULL;
+
+    if (!peakFinderPtr) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (refinementMode > PEAK_REFINEMENT_GAUSSIAN || !(trackingTolerance >= 0.0f)) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    finder = calloc(1, sizeof(PeakFinder_t));
+    if (!finder) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    //A frame cannot hold more local maxima than every other element
+    finder->capacity = MAX_NUM_OF_PIXELS_IN_FRAME / 2 + 1;
+    finder->candidates = malloc(finder->capacity * sizeof(uint16_t));
+    finder->peaks = malloc(finder->capacity * sizeof(Peak_t));
+    finder->previousPeaks = malloc(finder->capacity * sizeof(Peak_t));
+    if (!finder->candidates || !finder->peaks || !finder->previousPeaks) {
+        _freePeakFinder(finder);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    finder->threshold = threshold;
+    finder->minDistance = minDistance;
+    finder->refinementMode = refinementMode;
+    finder->trackingTolerance = trackingTolerance;
+    finder->nextTrackId = 1;
+
+    if (*peakFinderPtr) {
+        destroyPeakFinder(peakFinderPtr);
+    }
+    *peakFinderPtr = (uintptr_t)finder;
+
+    return OK;
+}
+
+int destroyPeakFinder(uintptr_t *peakFinderPtr)
+{
+    PeakFinder_t *finder = _getPeakFinder(peakFinderPtr);
+
+    if (!finder) {
+        return OK;
+    }
+
+    _freePeakFinder(finder);
+    *peakFinderPtr = 0;
+
+    return OK;
+}
+
+int findPeaks(const uint16_t *framePixels, uint16_t numOfPixelsInFrame, Peak_t *peaks, uint32_t maxNumOfPeaks, uint32_t *numOfPeaks, uintptr_t *peakFinderPtr)
+{
+    uint32_t first = NUM_OF_LEADING_ELEMENTS, end = 0, numOfCandidates = 0, count = 0, i = 0;
+    uint16_t index = 0, lastIndex = 0;
+    PeakFinder_t *finder = _getPeakFinder(peakFinderPtr);
+
+    if (!finder || !framePixels || !numOfPeaks || (!peaks && maxNumOfPeaks)) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (numOfPixelsInFrame > MAX_NUM_OF_PIXELS_IN_FRAME || numOfPixelsInFrame < NUM_OF_LEADING_ELEMENTS + NUM_OF_TRAILING_ELEMENTS + 3) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    //Maxima need a neighbour on both sides within the image
+    end = numOfPixelsInFrame - NUM_OF_TRAILING_ELEMENTS - 1;
+    ++first;
+
+    numOfCandidates = _findCandidates(framePixels, first, end, finder->threshold, finder->candidates);
+
+    for (i = 0; i < numOfCandidates; ++i) {
+        index = finder->candidates[i];
+
+        if (count && index - lastIndex < finder->minDistance) {
+            //Keep the higher one of two close maxima
+            if (framePixels[index] <= framePixels[lastIndex]) {
+                continue;
+            }
+            --count;
+        }
+
+        _refinePeak(framePixels, first - 1, end + 1, index, finder->refinementMode, &finder->peaks[count]);
+        finder->peaks[count].trackId = 0;
+        lastIndex = index;
+        ++count;
+    }
+
+    //Only the highest fit, reported in position order
+    if (count > maxNumOfPeaks) {
+        qsort(finder->peaks, count, sizeof(Peak_t), _compareHeights);
+        count = maxNumOfPeaks;
+        qsort(finder->peaks, count, sizeof(Peak_t), _comparePositions);
+    }
+
+    if (finder->trackingTolerance > 0.0f) {
+        _trackPeaks(finder, finder->peaks, count);
+    }
+
+    if (count) {
+        memcpy(peaks, finder->peaks, count * sizeof(Peak_t));
+    }
+    *numOfPeaks = count;
+
+    return OK;
+}
+
+int resetPeakTracking(uintptr_t *peakFinderPtr)
+{
+    PeakFinder_t *finder = _getPeakFinder(peakFinderPtr);
+
+    if (!finder) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    finder->numOfPreviousPeaks = 0;
+
+    return OK;
+}
@@ -0,0 +1,238 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+#if defined(_WIN32)
+    #include <malloc.h>
+#endif
+
+/*
+    All buffers of a pool are carved from one slab. Every buffer is a FrameBufferHeader_t padded to a cache line and
+    followed by the pixels, padded to a cache line as well, so that buffers used by different threads never share one.
+    The header is found from the pixel pointer alone, which lets retainFrameBuffer() and releaseFrameBuffer() work
+    without the pool handle. Free buffers form a stack under the pool mutex; the reference counts are atomic so that
+    only the last release of a buffer takes the mutex.
+    destroyFramePool() only marks the pool, the slab goes with the last buffer released.
+*/
+
+#define FRAME_POOL_ALIGNMENT 64
+#define FRAME_BUFFER_MAGIC 0x46425546
+
+typedef struct FrameBufferHeader_t {
+    uint32_t magic;
+    volatile uint32_t numOfReferences;
+    struct FramePool_t *pool;
+    struct FrameBufferHeader_t *nextFree;
+} FrameBufferHeader_t;
+
+typedef struct FramePool_t {
+    Mutex_t mutex;
+    uint8_t *slab;
+    uint32_t bufferSize;
+    uint32_t headerSize;
+    FrameBufferHeader_t *free;
+    bool destroyed;
+    FramePoolStatistics_t statistics;
+} FramePool_t;
+
+static void *_allocateSlab(size_t size)
+{
+#if defined(_WIN32)
+    return _aligned_malloc(size, FRAME_POOL_ALIGNMENT);
+#else
+    void *slab = NULL;
+    return (posix_memalign(&slab, FRAME_POOL_ALIGNMENT, size) == 0)? slab : NULL;
+#endif
+}
+
+static void _freePool(FramePool_t *pool)
+{
+#if defined(_WIN32)
+    _aligned_free(pool->slab);
+#else
+    free(pool->slab);
+#endif
+    _mutexDestroy(&pool->mutex);
+    free(pool);
+}
+
+static FramePool_t *_getFramePool(uintptr_t *framePoolPtr)
+{
+    if (!framePoolPtr || !*framePoolPtr) {
+        return NULL;
+    }
+
+    return (FramePool_t*)(*framePoolPtr);
+}
+
+static FrameBufferHeader_t *_getBufferHeader(uint16_t *framePixels)
+{
+    FrameBufferHeader_t *header = NULL;
+
+    if (!framePixels || ((uintptr_t)framePixels % FRAME_POOL_ALIGNMENT)) {
+        return NULL;
+    }
+
+    //The header size is a multiple of the alignment, so every pool puts it at the same distance
+    header = (FrameBufferHeader_t*)((uint8_t*)framePixels - (sizeof(FrameBufferHeader_t) + FRAME_POOL_ALIGNMENT - 1) / FRAME_POOL_ALIGNMENT * FRAME_POOL_ALIGNMENT);
+    return (header->magic == FRAME_BUFFER_MAGIC)? header : NULL;
+}
+
+int createFramePool(uint32_t numOfBuffers, uint16_t numOfPixelsInBuffer, uintptr_t *framePoolPtr)
+{
+    uint32_t index = 0;
+    FramePool_t *pool = NULL;
+    FrameBufferHeader_t *header = NULL;
+
+    if (!framePoolPtr) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!numOfBuffers || numOfBuffers > (1u << 16) || !numOfPixelsInBuffer || numOfPixelsInBuffer > MAX_NUM_OF_PIXELS_IN_FRAME) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    pool = calloc(1, sizeof(FramePool_t));
+    if (!pool) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    pool->headerSize = (sizeof(FrameBufferHeader_t) + FRAME_POOL_ALIGNMENT - 1) / FRAME_POOL_ALIGNMENT * FRAME_POOL_ALIGNMENT;
+    pool->bufferSize = pool->headerSize + (numOfPixelsInBuffer * sizeof(uint16_t) + FRAME_POOL_ALIGNMENT - 1) / FRAME_POOL_ALIGNMENT * FRAME_POOL_ALIGNMENT;
+    pool->slab = _allocateSlab((size_t)numOfBuffers * pool->bufferSize);
+    if (!pool->slab) {
+        free(pool);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    //Pushed in reverse so that the first buffers of the slab go first
+    for (index = numOfBuffers; index-- > 0;) {
+        header = (FrameBufferHeader_t*)(pool->slab + (size_t)index * pool->bufferSize);
+        header->magic = FRAME_BUFFER_MAGIC;
+        header->numOfReferences = 0;
+        header->pool = pool;
+        header->nextFree = pool->free;
+        pool->free = header;
+    }
+
+    pool->statistics.numOfBuffers = numOfBuffers;
+    pool->statistics.numOfPixelsInBuffer = numOfPixelsInBuffer;
+    _mutexInit(&pool->mutex);
+
+    destroyFramePool(framePoolPtr);
+    *framePoolPtr = (uintptr_t)pool;
+    return OK;
+}
+
+int destroyFramePool(uintptr_t *framePoolPtr)
+{
+    bool unused = false;
+    FramePool_t *pool = _getFramePool(framePoolPtr);
+
+    if (!pool) {
+        return OK;
+    }
+
+    _mutexLock(&pool->mutex);
+    pool->destroyed = true;
+    unused = !pool->statistics.numOfBuffersInUse;
+    _mutexUnlock(&pool->mutex);
+
+    if (unused) {
+        _freePool(pool);
+    }
+
+    *framePoolPtr = 0;
+    return OK;
+}
+
+int acquireFrameBuffer(uint16_t **framePixels, uintptr_t *framePoolPtr)
+{
+    int result = OK;
+    FramePool_t *pool = _getFramePool(framePoolPtr);
+    FrameBufferHeader_t *header = NULL;
+
+    if (!pool || !framePixels) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    _mutexLock(&pool->mutex);
+
+    header = pool->free;
+    if (!header) {
+        ++pool->statistics.numOfExhaustions;
+        result = MEMORY_ALLOCATION_ERROR;
+    } else {
+        pool->free = header->nextFree;
+        header->nextFree = NULL;
+        ATOMIC_STORE(&header->numOfReferences, 1);
+
+        ++pool->statistics.numOfAcquisitions;
+        if (++pool->statistics.numOfBuffersInUse > pool->statistics.peakBuffersInUse) {
+            pool->statistics.peakBuffersInUse = pool->statistics.numOfBuffersInUse;
+        }
+    }
+
+    _mutexUnlock(&pool->mutex);
+
+    *framePixels = header? (uint16_t*)((uint8_t*)header + pool->headerSize) : NULL;
+    return result;
+}
+
+int retainFrameBuffer(uint16_t *framePixels)
+{
+    FrameBufferHeader_t *header = _getBufferHeader(framePixels);
+
+    if (!header) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    ATOMIC_INCREMENT(&header->numOfReferences);
+    return OK;
+}
+
+int releaseFrameBuffer(uint16_t *framePixels)
+{
+    bool unused = false;
+    FramePool_t *pool = NULL;
+    FrameBufferHeader_t *header = _getBufferHeader(framePixels);
+
+    if (!header) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    if (ATOMIC_DECREMENT(&header->numOfReferences) != 0) {
+        return OK;
+    }
+
+    pool = header->pool;
+
+    _mutexLock(&pool->mutex);
+    header->nextFree = pool->free;
+    pool->free = header;
+    --pool->statistics.numOfBuffersInUse;
+    unused = pool->destroyed && !pool->statistics.numOfBuffersInUse;
+    _mutexUnlock(&pool->mutex);
+
+    if (unused) {
+        _freePool(pool);
+    }
+    return OK;
+}
+
+int getFramePoolStatistics(FramePoolStatistics_t *statistics, uintptr_t *framePoolPtr)
+{
+    FramePool_t *pool = _getFramePool(framePoolPtr);
+
+    if (!pool || !statistics) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    _mutexLock(&pool->mutex);
+    *statistics = pool->statistics;
+    _mutexUnlock(&pool->mutex);
+
+    return OK;
+}
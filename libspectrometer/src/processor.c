@@ -0,0 +1,720 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+/*
+    Submitted frames are copied into buffers of a frame pool and become jobs, handed round-robin to the task queues of
+    the workers. A worker takes the oldest task of its own queue and, when that is empty, steals the newest task of
+    another one, so the owner and the thieves work at opposite ends and a worker stalled by a slow kernel does not
+    hold frames back. A job runs the unordered kernels of its frame in registration order on one worker.
+    Frames with ordered kernels also wait in the strand of their device, a FIFO in submission order: once the head
+    of the strand is through its unordered kernels, the strand itself is queued as a task and runs the ordered kernels
+    of its ready frames one after the other. At most one task of a strand is queued or running at any time.
+    Jobs and strands live in arrays allocated with the processor, so steady processing allocates nothing.
+    Lock order: processor mutex, then worker mutex. Kernels run without any lock held.
+*/
+
+typedef struct FrameKernelEntry_t {
+    FrameKernel_t kernel;
+    void *kernelState;
+    bool ordered;
+} FrameKernelEntry_t;
+
+struct FrameStrand_t;
+
+typedef struct FrameJob_t {
+    struct FrameJob_t *next;            //free list or strand FIFO
+    struct FrameStrand_t *strand;
+    uintptr_t *deviceContextPtr;
+    uint16_t *framePixels;              //buffer of the frame pool
+    FrameMetadata_t metadata;
+    uint32_t numOfKernels;              //kernels registered when the frame was submitted
+    bool ordered;                       //some of them are ordered
+    bool unorderedDone;
+} FrameJob_t;
+
+typedef struct FrameStrand_t {
+    uintptr_t deviceContext;            //0 while the strand is free
+    FrameJob_t *head;
+    FrameJob_t *tail;
+    uint32_t numOfPendingFrames;        //ordered or not
+    bool scheduled;
+} FrameStrand_t;
+
+typedef struct FrameTask_t {
+    FrameJob_t *job;
+    FrameStrand_t *strand;
+} FrameTask_t;
+
+struct FrameProcessor_t;
+
+typedef struct FrameWorker_t {
+    struct FrameProcessor_t *processor;
+    uint32_t index;
+
+    Mutex_t mutex;
+    FrameTask_t *tasks;                 //ring of taskCapacity tasks
+    uint32_t taskHead;
+    uint32_t numOfTasks;
+    uint64_t tasksStolen;
+
+    Thread_t thread;
+    bool threadStarted;
+} FrameWorker_t;
+
+typedef struct FrameProcessor_t {
+    FrameWorker_t *workers;
+    uint32_t numOfWorkers;
+    uint32_t taskCapacity;
+    uint32_t nextWorker;
+
+    uintptr_t framePool;
+    FrameJob_t *jobs;
+    FrameJob_t *freeJobs;
+    FrameStrand_t strands[FRAME_PROCESSOR_MAX_DEVICES];
+
+    FrameKernelEntry_t kernels[FRAME_PROCESSOR_MAX_KERNELS];
+    uint32_t numOfKernels;
+    uint32_t numOfAttachedDevices;
+
+    Mutex_t mutex;
+    Condition_t workAvailable;
+    Condition_t frameProcessed;
+    volatile uint32_t numOfQueuedTasks;
+    uint32_t numOfIdleWorkers;
+    volatile uint32_t stopRequested;
+
+    FrameProcessorStatistics_t statistics;
+} FrameProcessor_t;
+
+static FrameProcessor_t *_getFrameProcessor(uintptr_t *frameProcessorPtr)
+{
+    if (!frameProcessorPtr || !*frameProcessorPtr) {
+        return NULL;
+    }
+
+    return (FrameProcessor_t*)(*frameProcessorPtr);
+}
+
+static FrameStrand_t *_findStrand(FrameProcessor_t *processor, uintptr_t deviceContext)
+{
+    uint32_t index = 0;
+
+    for (index = 0; index < FRAME_PROCESSOR_MAX_DEVICES; ++index) {
+        if (processor->strands[index].deviceContext == deviceContext) {
+            return &processor->strands[index];
+        }
+    }
+
+    return NULL;
+}
+
+/* Called with the processor mutex held */
+static void _pushTask(FrameProcessor_t *processor, FrameJob_t *job, FrameStrand_t *strand)
+{
+    FrameWorker_t *worker = &processor->workers[processor->nextWorker++ % processor->numOfWorkers];
+
+    _mutexLock(&worker->mutex);
+    worker->tasks[(worker->taskHead + worker->numOfTasks) % processor->taskCapacity].job = job;
+    worker->tasks[(worker->taskHead + worker->numOfTasks) % processor->taskCapacity].strand = strand;
+    ++worker->numOfTasks;
+    _mutexUnlock(&worker->mutex);
+
+    ATOMIC_INCREMENT(&processor->numOfQueuedTasks);
+    if (processor->numOfIdleWorkers) {
+        _conditionBroadcast(&processor->workAvailable);
+    }
+}
+
+static bool _takeTask(FrameWorker_t *worker, FrameTask_t *task)
+{
+    FrameProcessor_t *processor = worker->processor;
+    FrameWorker_t *victim = NULL;
+    uint32_t offset = 0;
+
+    _mutexLock(&worker->mutex);
+    if (worker->numOfTasks) {
+        *task = worker->tasks[worker->taskHead];
+        worker->taskHead = (worker->taskHead + 1) % processor->taskCapacity;
+        --worker->numOfTasks;
+        _mutexUnlock(&worker->mutex);
+        return true;
+    }
+    _mutexUnlock(&worker->mutex);
+
+    for (offset = 1; offset < processor->numOfWorkers; ++offset) {
+        victim = &processor->workers[(worker->index + offset) % processor->numOfWorkers];
+
+        _mutexLock(&victim->mutex);
+        if (victim->numOfTasks) {
+            --victim->numOfTasks;
+            *task = victim->tasks[(victim->taskHead + victim->numOfTasks) % processor->taskCapacity];
+            _mutexUnlock(&victim->mutex);
+
+            //Counted by the thief, under its own mutex like the rest of its queue
+            _mutexLock(&worker->mutex);
+            ++worker->tasksStolen;
+            _mutexUnlock(&worker->mutex);
+            return true;
+        }
+        _mutexUnlock(&victim->mutex);
+    }
+
+    return false;
+}
+
+/* Called with the processor mutex held, returns the buffer to release once it is unlocked */
+static uint16_t *_finishJob(FrameProcessor_t *processor, FrameJob_t *job)
+{
+    uint16_t *framePixels = job->framePixels;
+    FrameStrand_t *strand = job->strand;
+
+    if (!--strand->numOfPendingFrames && !strand->head && !strand->scheduled) {
+        strand->deviceContext = 0;
+    }
+
+    job->framePixels = NULL;
+    job->next = processor->freeJobs;
+    processor->freeJobs = job;
+
+    --processor->statistics.queueDepth;
+    ++processor->statistics.framesProcessed;
+    _conditionBroadcast(&processor->frameProcessed);
+
+    return framePixels;
+}
+
+/* Called with the processor mutex held */
+static uint16_t *_endUnorderedKernels(FrameProcessor_t *processor, FrameJob_t *job)
+{
+    FrameStrand_t *strand = job->strand;
+
+    if (!job->ordered) {
+        return _finishJob(processor, job);
+    }
+
+    job->unorderedDone = true;
+    if (strand->head == job && !strand->scheduled) {
+        strand->scheduled = true;
+        _pushTask(processor, NULL, strand);
+    }
+
+    return NULL;
+}
+
+static void _runJob(FrameProcessor_t *processor, FrameJob_t *job)
+{
+    uint32_t index = 0;
+    uint16_t *releasedPixels = NULL;
+
+    //Entries below numOfKernels never change once registered
+    for (index = 0; index < job->numOfKernels; ++index) {
+        if (!processor->kernels[index].ordered) {
+            processor->kernels[index].kernel(processor->kernels[index].kernelState, job->framePixels, &job->metadata, job->deviceContextPtr);
+        }
+    }
+
+    _mutexLock(&processor->mutex);
+    releasedPixels = _endUnorderedKernels(processor, job);
+    _mutexUnlock(&processor->mutex);
+
+    if (releasedPixels) {
+        releaseFrameBuffer(releasedPixels);
+    }
+}
+
+static void _runStrand(FrameProcessor_t *processor, FrameStrand_t *strand)
+{
+    uint32_t index = 0;
+    uint16_t *releasedPixels = NULL;
+    FrameJob_t *job = NULL;
+
+    for (;;) {
+        _mutexLock(&processor->mutex);
+        job = strand->head;
+        if (!job || !job->unorderedDone) {
+            //The frame at the head queues the strand again when it is ready
+            strand->scheduled = false;
+            if (!strand->numOfPendingFrames) {
+                strand->deviceContext = 0;
+            }
+            _mutexUnlock(&processor->mutex);
+            return;
+        }
+
+        strand->head = job->next;
+        if (!strand->head) {
+            strand->tail = NULL;
+        }
+        _mutexUnlock(&processor->mutex);
+
+        for (index = 0; index < job->numOfKernels; ++index) {
+            if (processor->kernels[index].ordered) {
+                processor->kernels[index].kernel(processor->kernels[index].kernelState, job->framePixels, &job->metadata, job->deviceContextPtr);
+            }
+        }
+
+        _mutexLock(&processor->mutex);
+        releasedPixels = _finishJob(processor, job);
+        _mutexUnlock(&processor->mutex);
+
+        releaseFrameBuffer(releasedPixels);
+    }
+}
+
+static THREAD_FUNCTION(_frameWorker, argument)
+{
+    FrameWorker_t *worker = (FrameWorker_t*)argument;
+    FrameProcessor_t *processor = worker->processor;
+    FrameTask_t task;
+    bool stop = false;
+
+    while (!stop) {
+        if (_takeTask(worker, &task)) {
+            ATOMIC_DECREMENT(&processor->numOfQueuedTasks);
+            if (task.job) {
+                _runJob(processor, task.job);
+            } else {
+                _runStrand(processor, task.strand);
+            }
+            continue;
+        }
+
+        //Tasks are pushed under the mutex, so none can be missed between the check and the wait
+        _mutexLock(&processor->mutex);
+        while (!ATOMIC_LOAD(&processor->numOfQueuedTasks) && !processor->stopRequested) {
+            ++processor->numOfIdleWorkers;
+            _conditionWait(&processor->workAvailable, &processor->mutex);
+            --processor->numOfIdleWorkers;
+        }
+        stop = processor->stopRequested && !ATOMIC_LOAD(&processor->numOfQueuedTasks);
+        _mutexUnlock(&processor->mutex);
+    }
+
+    THREAD_RETURN;
+}
+
+static void _freeFrameProcessor(FrameProcessor_t *processor)
+{
+    uint32_t index = 0;
+
+    _mutexLock(&processor->mutex);
+    ATOMIC_STORE(&processor->stopRequested, 1);
+    _conditionBroadcast(&processor->workAvailable);
+    _mutexUnlock(&processor->mutex);
+
+    for (index = 0; index < processor->numOfWorkers; ++index) {
+        if (processor->workers[index].threadStarted) {
+            _threadJoin(processor->workers[index].thread);
+        }
+    }
+
+    //Only once every thread is gone, the others steal from these queues
+    for (index = 0; index < processor->numOfWorkers; ++index) {
+        free(processor->workers[index].tasks);
+        _mutexDestroy(&processor->workers[index].mutex);
+    }
+
+    //Buffers kept by kernels outlive the pool
+    destroyFramePool(&processor->framePool);
+
+    _conditionDestroy(&processor->frameProcessed);
+    _conditionDestroy(&processor->workAvailable);
+    _mutexDestroy(&processor->mutex);
+
+    free(processor->workers);
+    free(processor->jobs);
+    free(processor);
+}
+
+int createFrameProcessor(uint32_t numOfThreads, uint32_t queueCapacity, uintptr_t *frameProcessorPtr)
+{
+    int result = OK;
+    uint32_t index = 0;
+    FrameProcessor_t *processor = NULL;
+
+    if (!frameProcessorPtr) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!numOfThreads) {
+        numOfThreads = _getNumOfProcessors();
+        if (numOfThreads > FRAME_PROCESSOR_MAX_THREADS) {
+            numOfThreads = FRAME_PROCESSOR_MAX_THREADS;
+        }
+    }
+
+    if (numOfThreads > FRAME_PROCESSOR_MAX_THREADS || !queueCapacity || queueCapacity > (1u << 16)) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    if (_getFrameProcessor(frameProcessorPtr)) {
+        return INVALID_STATE_ERROR;
+    }
+
+    processor = calloc(1, sizeof(FrameProcessor_t));
+    if (!processor) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    //Every job can be queued at once, and every strand besides
+    processor->numOfWorkers = numOfThreads;
+    processor->taskCapacity = queueCapacity + FRAME_PROCESSOR_MAX_DEVICES;
+    processor->statistics.numOfThreads = numOfThreads;
+    processor->statistics.queueCapacity = queueCapacity;
+
+    _mutexInit(&processor->mutex);
+    _conditionInit(&processor->workAvailable);
+    _conditionInit(&processor->frameProcessed);
+
+    processor->workers = calloc(numOfThreads, sizeof(FrameWorker_t));
+    processor->jobs = calloc(queueCapacity, sizeof(FrameJob_t));
+    if (!processor->workers || !processor->jobs) {
+        free(processor->workers);
+        free(processor->jobs);
+        processor->workers = NULL;
+        processor->jobs = NULL;
+        processor->numOfWorkers = 0;
+        _freeFrameProcessor(processor);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    for (index = queueCapacity; index-- > 0;) {
+        processor->jobs[index].next = processor->freeJobs;
+        processor->freeJobs = &processor->jobs[index];
+    }
+
+    for (index = 0; index < numOfThreads; ++index) {
+        processor->workers[index].processor = processor;
+        processor->workers[index].index = index;
+        _mutexInit(&processor->workers[index].mutex);
+        processor->workers[index].tasks = malloc(processor->taskCapacity * sizeof(FrameTask_t));
+        if (!processor->workers[index].tasks) {
+            result = MEMORY_ALLOCATION_ERROR;
+        }
+    }
+
+    if (result == OK) {
+        result = createFramePool(queueCapacity, MAX_NUM_OF_PIXELS_IN_FRAME, &processor->framePool);
+    }
+
+    for (index = 0; index < numOfThreads && result == OK; ++index) {
+        if (_threadCreate(&processor->workers[index].thread, _frameWorker, &processor->workers[index]) != OK) {
+            result = THREAD_CREATION_ERROR;
+        } else {
+            processor->workers[index].threadStarted = true;
+        }
+    }
+
+    if (result != OK) {
+        _freeFrameProcessor(processor);
+        return result;
+    }
+
+    *frameProcessorPtr = (uintptr_t)processor;
+    return OK;
+}
+
+int destroyFrameProcessor(uintptr_t *frameProcessorPtr)
+{
+    FrameProcessor_t *processor = _getFrameProcessor(frameProcessorPtr);
+
+    if (!processor) {
+        return OK;
+    }
+
+    _mutexLock(&processor->mutex);
+    if (processor->numOfAttachedDevices) {
+        _mutexUnlock(&processor->mutex);
+        return INVALID_STATE_ERROR;
+    }
+
+    //Frames already submitted still go through every kernel
+    while (processor->statistics.queueDepth) {
+        _conditionWait(&processor->frameProcessed, &processor->mutex);
+    }
+    _mutexUnlock(&processor->mutex);
+
+    _freeFrameProcessor(processor);
+    *frameProcessorPtr = 0;
+
+    return OK;
+}
+
+int addFrameKernel(FrameKernel_t kernel, void *kernelState, uint8_t ordered, uintptr_t *frameProcessorPtr)
+{
+    int result = OK;
+    FrameProcessor_t *processor = _getFrameProcessor(frameProcessorPtr);
+
+    if (!processor || !kernel) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    _mutexLock(&processor->mutex);
+    if (processor->numOfKernels == FRAME_PROCESSOR_MAX_KERNELS) {
+        result = INVALID_STATE_ERROR;
+    } else {
+        processor->kernels[processor->numOfKernels].kernel = kernel;
+        processor->kernels[processor->numOfKernels].kernelState = kernelState;
+        processor->kernels[processor->numOfKernels].ordered = ordered? true : false;
+        ++processor->numOfKernels;
+    }
+    _mutexUnlock(&processor->mutex);
+
+    return result;
+}
+
+static int _submitFrame(FrameProcessor_t *processor, const uint16_t *framePixels, const FrameMetadata_t *metadata, uintptr_t *deviceContextPtr)
+{
+    uint32_t index = 0;
+    bool unordered = false;
+    uint16_t *buffer = NULL, *releasedPixels = NULL;
+    FrameJob_t *job = NULL;
+    FrameStrand_t *strand = NULL;
+    //Frames of no device share a strand of their own, 0 marks the free ones
+    uintptr_t deviceContext = (deviceContextPtr && *deviceContextPtr)? *deviceContextPtr : (uintptr_t)processor;
+
+    if (acquireFrameBuffer(&buffer, &processor->framePool) != OK) {
+        _mutexLock(&processor->mutex);
+        ++processor->statistics.framesDropped;
+        _mutexUnlock(&processor->mutex);
+        return FRAME_OVERRUN_ERROR;
+    }
+
+    memcpy(buffer, framePixels, (size_t)metadata->numOfPixelsInFrame * sizeof(uint16_t));
+
+    _mutexLock(&processor->mutex);
+
+    strand = _findStrand(processor, deviceContext);
+    if (!strand) {
+        strand = _findStrand(processor, 0);
+        if (strand) {
+            strand->deviceContext = deviceContext;
+        }
+    }
+
+    //A job is free for every buffer that is
+    job = processor->freeJobs;
+    if (!strand || !job) {
+        ++processor->statistics.framesDropped;
+        _mutexUnlock(&processor->mutex);
+        releaseFrameBuffer(buffer);
+        return FRAME_OVERRUN_ERROR;
+    }
+    processor->freeJobs = job->next;
+
+    job->next = NULL;
+    job->strand = strand;
+    job->deviceContextPtr = deviceContextPtr;
+    job->framePixels = buffer;
+    job->metadata = *metadata;
+    job->numOfKernels = processor->numOfKernels;
+    job->ordered = false;
+    job->unorderedDone = false;
+
+    for (index = 0; index < job->numOfKernels; ++index) {
+        if (processor->kernels[index].ordered) {
+            job->ordered = true;
+        } else {
+            unordered = true;
+        }
+    }
+
+    if (job->ordered) {
+        if (strand->tail) {
+            strand->tail->next = job;
+        } else {
+            strand->head = job;
+        }
+        strand->tail = job;
+    }
+    ++strand->numOfPendingFrames;
+
+    ++processor->statistics.framesSubmitted;
+    if (++processor->statistics.queueDepth > processor->statistics.peakQueueDepth) {
+        processor->statistics.peakQueueDepth = processor->statistics.queueDepth;
+    }
+
+    if (unordered) {
+        _pushTask(processor, job, NULL);
+    } else {
+        releasedPixels = _endUnorderedKernels(processor, job);
+    }
+
+    _mutexUnlock(&processor->mutex);
+
+    if (releasedPixels) {
+        releaseFrameBuffer(releasedPixels);
+    }
+    return OK;
+}
+
+int submitFrame(const uint16_t *framePixels, const FrameMetadata_t *metadata, uintptr_t *frameProcessorPtr, uintptr_t *deviceContextPtr)
+{
+    FrameProcessor_t *processor = _getFrameProcessor(frameProcessorPtr);
+
+    if (!processor || !framePixels || !metadata) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!metadata->numOfPixelsInFrame || metadata->numOfPixelsInFrame > MAX_NUM_OF_PIXELS_IN_FRAME) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    return _submitFrame(processor, framePixels, metadata, deviceContextPtr);
+}
+
+void _feedFrameProcessor(const uint16_t *framePixels, const FrameMetadata_t *metadata, uintptr_t *deviceContextPtr)
+{
+    DeviceContext_t *deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    //Held so that detachFrameProcessor() returns only once no frame is on its way
+    _mutexLock(&deviceContext->mutex);
+    if (deviceContext->frameProcessor) {
+        _submitFrame(deviceContext->frameProcessor, framePixels, metadata, deviceContextPtr);
+    }
+    _mutexUnlock(&deviceContext->mutex);
+}
+
+int attachFrameProcessor(uintptr_t *frameProcessorPtr, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+    FrameProcessor_t *processor = _getFrameProcessor(frameProcessorPtr);
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!processor) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    if (deviceContext->frameProcessor) {
+        result = (deviceContext->frameProcessor == processor)? OK : INVALID_STATE_ERROR;
+    } else {
+        deviceContext->frameProcessor = processor;
+
+        _mutexLock(&processor->mutex);
+        ++processor->numOfAttachedDevices;
+        _mutexUnlock(&processor->mutex);
+    }
+    _mutexUnlock(&deviceContext->mutex);
+
+    return result;
+}
+
+int detachFrameProcessor(uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    DeviceContext_t *deviceContext = NULL;
+    FrameProcessor_t *processor = NULL;
+    FrameStrand_t *strand = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _mutexLock(&deviceContext->mutex);
+    processor = deviceContext->frameProcessor;
+    deviceContext->frameProcessor = NULL;
+    _mutexUnlock(&deviceContext->mutex);
+
+    if (!processor) {
+        return OK;
+    }
+
+    //Kernels may still call the device, so its mutex is not held while its frames are processed
+    //Still counted as attached while waiting, destroyFrameProcessor() refuses to free the processor until then
+    _mutexLock(&processor->mutex);
+    while ((strand = _findStrand(processor, (uintptr_t)deviceContext)) && strand->numOfPendingFrames) {
+        _conditionWait(&processor->frameProcessed, &processor->mutex);
+    }
+    --processor->numOfAttachedDevices;
+    _conditionBroadcast(&processor->frameProcessed);
+    _mutexUnlock(&processor->mutex);
+
+    return OK;
+}
+
+int waitFrameProcessor(uint32_t timeoutMilliseconds, uintptr_t *frameProcessorPtr)
+{
+    int result = OK;
+    uint64_t deadline = 0, now = 0;
+    FrameProcessor_t *processor = _getFrameProcessor(frameProcessorPtr);
+
+    if (!processor) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deadline = _getMonotonicNanoseconds() + (uint64_t)timeoutMilliseconds * 1000000ULL;
+
+    _mutexLock(&processor->mutex);
+    while (processor->statistics.queueDepth) {
+        now = _getMonotonicNanoseconds();
+        if (now >= deadline) {
+            result = TIMEOUT_ERROR;
+            break;
+        }
+        _conditionTimedWait(&processor->frameProcessed, &processor->mutex, (uint32_t)((deadline - now + 999999ULL) / 1000000ULL));
+    }
+    _mutexUnlock(&processor->mutex);
+
+    return result;
+}
+
+int getFrameProcessorStatistics(FrameProcessorStatistics_t *statistics, uintptr_t *frameProcessorPtr)
+{
+    uint32_t index = 0;
+    FrameProcessor_t *processor = _getFrameProcessor(frameProcessorPtr);
+
+    if (!processor || !statistics) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    _mutexLock(&processor->mutex);
+    *statistics = processor->statistics;
+    statistics->maxThreadQueueDepth = 0;
+    statistics->tasksStolen = 0;
+
+    for (index = 0; index < processor->numOfWorkers; ++index) {
+        _mutexLock(&processor->workers[index].mutex);
+        if (processor->workers[index].numOfTasks > statistics->maxThreadQueueDepth) {
+            statistics->maxThreadQueueDepth = processor->workers[index].numOfTasks;
+        }
+        statistics->tasksStolen += processor->workers[index].tasksStolen;
+        _mutexUnlock(&processor->workers[index].mutex);
+    }
+    _mutexUnlock(&processor->mutex);
+
+    return OK;
+}
+
+int getFrameProcessorQueueDepths(uint32_t *queueDepths, uint32_t numOfQueues, uintptr_t *frameProcessorPtr)
+{
+    uint32_t index = 0;
+    FrameProcessor_t *processor = _getFrameProcessor(frameProcessorPtr);
+
+    if (!processor || !queueDepths) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (numOfQueues > processor->numOfWorkers) {
+        numOfQueues = processor->numOfWorkers;
+    }
+
+    for (index = 0; index < numOfQueues; ++index) {
+        _mutexLock(&processor->workers[index].mutex);
+        queueDepths[index] = processor->workers[index].numOfTasks;
+        _mutexUnlock(&processor->workers[index].mutex);
+    }
+
+    return OK;
+}
@@ -0,0 +1,524 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+/*
+    Shared memory layout: FrameRingHeader_t padded to FRAME_RING_HEADER_SIZE, then numOfSlots slots of slotSize bytes.
+    Frame n goes to slot n & (numOfSlots - 1). The publisher stores begin = n, writes the slot, stores end = n and then
+    publishes writeSequence = n + 1. A reader checks end == n before and begin == n after using the slot, any other value
+    means the publisher has lapped it. Sequence numbers wrap, they are only compared by their difference.
+*/
+
+typedef struct FrameRingHeader_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t slotSize;
+    uint32_t pixelsOffset;
+    uint32_t numOfSlots;                //power of two
+    volatile uint32_t writeSequence;    //frames published so far, readers sleep on it
+    volatile uint32_t closed;           //set when the publisher is gone
+} FrameRingHeader_t;
+
+typedef struct FrameRingSlot_t {
+    volatile uint32_t begin;
+    volatile uint32_t end;
+    FrameMetadata_t metadata;
+} FrameRingSlot_t;
+
+typedef struct FrameRing_t {
+    FrameRingHeader_t *header;
+    uint8_t *slots;
+    uint64_t mappingSize;
+    bool publisher;
+    char name[FRAME_RING_MAX_NAME_LENGTH + 2];
+
+    /* Reader state */
+    uint32_t readSequence;
+    bool frameAcquired;
+
+#if defined(_WIN32)
+    HANDLE mapping;
+#endif
+} FrameRing_t;
+
+static FrameRing_t *_getFrameRing(uintptr_t *frameRingPtr)
+{
+    if (!frameRingPtr || !*frameRingPtr) {
+        return NULL;
+    }
+
+    return (FrameRing_t*)(*frameRingPtr);
+}
+
+static FrameRingSlot_t *_getSlot(FrameRing_t *ring, uint32_t sequence)
+{
+    return (FrameRingSlot_t*)(ring->slots + (size_t)(sequence & (ring->header->numOfSlots - 1)) * ring->header->slotSize);
+}
+
+static uint16_t *_getSlotPixels(FrameRing_t *ring, uint32_t sequence)
+{
+    return (uint16_t*)((uint8_t*)_getSlot(ring, sequence) + ring->header->pixelsOffset);
+}
+
+static int _mapRing(FrameRing_t *ring, const char *name, uint64_t size)
+{
+#if defined(_WIN32)
+    //Named mappings are the Windows counterpart of POSIX shared memory
+    snprintf(ring->name, sizeof(ring->name), "Local\\%s", name);
+
+    if (ring->publisher) {
+        ring->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, ring->name);
+    } else {
+        ring->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, ring->name);
+    }
+    if (!ring->mapping) {
+        return FILE_ERROR;
+    }
+
+    ring->header = MapViewOfFile(ring->mapping, ring->publisher? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, (SIZE_T)size);
+    if (!ring->header) {
+        return FILE_ERROR;
+    }
+
+    if (!size) {
+        size = (uint64_t)ring->header->headerSize + (uint64_t)ring->header->numOfSlots * ring->header->slotSize;
+    }
+#else
+    int file = -1;
+    struct stat fileStat;
+    void *mapping = NULL;
+
+    snprintf(ring->name, sizeof(ring->name), "%s%s", (name[0] == '/')? "" : "/", name);
+
+    if (ring->publisher) {
+        //A ring left behind by a publisher that crashed is replaced
+        shm_unlink(ring->name);
+        file = shm_open(ring->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (file >= 0 && ftruncate(file, (off_t)size) != 0) {
+            close(file);
+            shm_unlink(ring->name);
+            return FILE_ERROR;
+        }
+    } else {
+        file = shm_open(ring->name, O_RDONLY, 0);
+        if (file >= 0 && fstat(file, &fileStat) == 0) {
+            size = (uint64_t)fileStat.st_size;
+        }
+    }
+    if (file < 0) {
+        return FILE_ERROR;
+    }
+
+    if (size < FRAME_RING_HEADER_SIZE) {
+        close(file);
+        return FILE_ERROR;
+    }
+
+    //Readers map the ring read-only, so a reader can never corrupt what the others see
+    mapping = mmap(NULL, (size_t)size, ring->publisher? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        if (ring->publisher) {
+            shm_unlink(ring->name);
+        }
+        return FILE_ERROR;
+    }
+    ring->header = mapping;
+#endif
+
+    ring->mappingSize = size;
+    ring->slots = (uint8_t*)ring->header + FRAME_RING_HEADER_SIZE;
+    return OK;
+}
+
+static void _unmapRing(FrameRing_t *ring)
+{
+    if (ring->header && ring->publisher) {
+        ATOMIC_STORE(&ring->header->closed, 1);
+        MEMORY_BARRIER();
+        _sharedWake(&ring->header->writeSequence);
+    }
+
+#if defined(_WIN32)
+    if (ring->header) {
+        UnmapViewOfFile(ring->header);
+    }
+
+    if (ring->mapping) {
+        CloseHandle(ring->mapping);
+    }
+#else
+    if (ring->header) {
+        munmap(ring->header, (size_t)ring->mappingSize);
+    }
+
+    //Attached readers keep their mappings, the name is free for a new publisher
+    if (ring->publisher && ring->name[0]) {
+        shm_unlink(ring->name);
+    }
+#endif
+
+    ring->header = NULL;
+}
+
+static uint32_t _beginPublishing(FrameRing_t *ring)
+{
+    uint32_t sequence = ring->header->writeSequence;
+    FrameRingSlot_t *slot = _getSlot(ring, sequence);
+
+    ATOMIC_STORE(&slot->begin, sequence);
+    //The slot must be marked as being overwritten before any of its bytes change
+    MEMORY_BARRIER();
+
+    return sequence;
+}
+
+static void _endPublishing(FrameRing_t *ring, uint32_t sequence)
+{
+    ATOMIC_STORE(&_getSlot(ring, sequence)->end, sequence);
+    ATOMIC_STORE(&ring->header->writeSequence, sequence + 1);
+
+    //Readers cannot write to the ring to announce that they sleep, a wake-up with nobody waiting costs one system call per frame
+    _sharedWake(&ring->header->writeSequence);
+}
+
+static void _abortPublishing(FrameRing_t *ring, uint32_t sequence)
+{
+    //The previous frame of the slot may be half overwritten, ending the slot on a sequence that is not published yet makes readers skip it as lost
+    ATOMIC_STORE(&_getSlot(ring, sequence)->end, sequence);
+}
+
+int createFrameRing(const char *name, uint32_t numOfSlots, uintptr_t *frameRingPtr)
+{
+    int result = -1;
+    uint32_t slots = 1, pixelsOffset = 0, slotSize = 0;
+    FrameRing_t *ring = NULL;
+    FrameRingHeader_t *header = NULL;
+
+    if (!name || !frameRingPtr) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (numOfSlots < 2 || numOfSlots > (1u << 20) || !name[0] || strlen(name) > FRAME_RING_MAX_NAME_LENGTH - 8) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    while (slots < numOfSlots) {
+        slots <<= 1;
+    }
+
+    //Slots take a frame of any format, so the frame format can change while readers are attached
+    pixelsOffset = (sizeof(FrameRingSlot_t) + 63) / 64 * 64;
+    slotSize = pixelsOffset + (MAX_NUM_OF_PIXELS_IN_FRAME * sizeof(uint16_t) + 63) / 64 * 64;
+
+    ring = calloc(1, sizeof(FrameRing_t));
+    if (!ring) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+    ring->publisher = true;
+
+    result = _mapRing(ring, name, FRAME_RING_HEADER_SIZE + (uint64_t)slots * slotSize);
+    if (result != OK) {
+        _unmapRing(ring);
+        free(ring);
+        return result;
+    }
+
+    header = ring->header;
+    header->version = FRAME_RING_VERSION;
+    header->headerSize = FRAME_RING_HEADER_SIZE;
+    header->slotSize = slotSize;
+    header->pixelsOffset = pixelsOffset;
+    header->numOfSlots = slots;
+    header->writeSequence = 0;
+
+    //Readers check the magic last, so they never see a half initialized header
+    MEMORY_BARRIER();
+    memcpy(header->magic, FRAME_RING_MAGIC, sizeof(FRAME_RING_MAGIC));
+
+    if (*frameRingPtr) {
+        closeFrameRing(frameRingPtr);
+    }
+    *frameRingPtr = (uintptr_t)ring;
+
+    return OK;
+}
+
+int attachFrameRing(const char *name, uintptr_t *frameRingPtr)
+{
+    int result = -1;
+    FrameRing_t *ring = NULL;
+    FrameRingHeader_t *header = NULL;
+
+    if (!name || !frameRingPtr) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!name[0] || strlen(name) > FRAME_RING_MAX_NAME_LENGTH - 8) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    ring = calloc(1, sizeof(FrameRing_t));
+    if (!ring) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    result = _mapRing(ring, name, 0);
+    if (result == OK) {
+        header = ring->header;
+        MEMORY_BARRIER();
+        if (memcmp(header->magic, FRAME_RING_MAGIC, sizeof(FRAME_RING_MAGIC)) != 0 ||
+            header->version != FRAME_RING_VERSION ||
+            header->headerSize != FRAME_RING_HEADER_SIZE ||
+            !header->numOfSlots || (header->numOfSlots & (header->numOfSlots - 1)) ||
+            ring->mappingSize < header->headerSize + (uint64_t)header->numOfSlots * header->slotSize) {
+            result = FILE_ERROR;
+        }
+    }
+
+    if (result != OK) {
+        _unmapRing(ring);
+        free(ring);
+        return result;
+    }
+
+    //A new reader starts with the next frame
+    ring->readSequence = ATOMIC_LOAD(&header->writeSequence);
+
+    if (*frameRingPtr) {
+        closeFrameRing(frameRingPtr);
+    }
+    *frameRingPtr = (uintptr_t)ring;
+
+    return OK;
+}
+
+int closeFrameRing(uintptr_t *frameRingPtr)
+{
+    FrameRing_t *ring = _getFrameRing(frameRingPtr);
+
+    if (!ring) {
+        return OK;
+    }
+
+    _unmapRing(ring);
+    free(ring);
+    *frameRingPtr = 0;
+
+    return OK;
+}
+
+int publishFrame(const uint16_t *framePixels, const FrameMetadata_t *metadata, uintptr_t *frameRingPtr)
+{
+    uint32_t sequence = 0;
+    FrameRingSlot_t *slot = NULL;
+    FrameRing_t *ring = _getFrameRing(frameRingPtr);
+
+    if (!ring || !framePixels || !metadata) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!ring->publisher) {
+        return INVALID_STATE_ERROR;
+    }
+
+    if (metadata->numOfPixelsInFrame > MAX_NUM_OF_PIXELS_IN_FRAME) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    sequence = _beginPublishing(ring);
+    slot = _getSlot(ring, sequence);
+    slot->metadata = *metadata;
+    memcpy(_getSlotPixels(ring, sequence), framePixels, metadata->numOfPixelsInFrame * sizeof(uint16_t));
+    _endPublishing(ring, sequence);
+
+    return OK;
+}
+
+int publishDeviceFrame(uint16_t numOfFrame, uintptr_t *frameRingPtr, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    uint32_t sequence = 0;
+    FrameRing_t *ring = _getFrameRing(frameRingPtr);
+
+    if (!ring) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!ring->publisher) {
+        return INVALID_STATE_ERROR;
+    }
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    //The frame is decoded straight into the shared slot, the slot is only published if the read succeeds
+    sequence = _beginPublishing(ring);
+    result = getFrameWithMetadata(_getSlotPixels(ring, sequence), numOfFrame, &_getSlot(ring, sequence)->metadata, deviceContextPtr);
+    if (result != OK) {
+        _abortPublishing(ring, sequence);
+        return result;
+    }
+
+    _endPublishing(ring, sequence);
+    return OK;
+}
+
+static int _waitForFrame(FrameRing_t *ring, uint32_t timeoutMilliseconds)
+{
+    uint32_t written = 0, remaining = 0;
+    uint64_t deadline = _getMonotonicNanoseconds() + (uint64_t)timeoutMilliseconds * 1000000ULL, now = 0;
+
+    for (;;) {
+        written = ATOMIC_LOAD(&ring->header->writeSequence);
+        if (written != ring->readSequence) {
+            return OK;
+        }
+
+        if (ATOMIC_LOAD(&ring->header->closed)) {
+            return INVALID_STATE_ERROR;
+        }
+
+        now = _getMonotonicNanoseconds();
+        if (now >= deadline) {
+            return TIMEOUT_ERROR;
+        }
+        remaining = (uint32_t)((deadline - now + 999999ULL) / 1000000ULL);
+
+        //Returns at once if a frame was published since writeSequence was read
+        _sharedWait(&ring->header->writeSequence, written, remaining);
+    }
+}
+
+int acquireRingFrame(const uint16_t **framePixels, const FrameMetadata_t **metadata, uint32_t *numOfLostFrames, uint32_t timeoutMilliseconds, uintptr_t *frameRingPtr)
+{
+    int result = -1;
+    uint32_t written = 0, lost = 0;
+    FrameRingSlot_t *slot = NULL;
+    FrameRing_t *ring = _getFrameRing(frameRingPtr);
+
+    if (!ring || !framePixels || !metadata) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (ring->publisher) {
+        return INVALID_STATE_ERROR;
+    }
+
+    if (ring->frameAcquired) {
+        ++ring->readSequence;
+        ring->frameAcquired = false;
+    }
+
+    for (;;) {
+        result = _waitForFrame(ring, timeoutMilliseconds);
+        if (result != OK) {
+            break;
+        }
+
+        //A reader that fell more than a lap behind skips to the oldest frame still in the ring
+        written = ATOMIC_LOAD(&ring->header->writeSequence);
+        if (written - ring->readSequence > ring->header->numOfSlots) {
+            lost += written - ring->header->numOfSlots - ring->readSequence;
+            ring->readSequence = written - ring->header->numOfSlots;
+        }
+
+        slot = _getSlot(ring, ring->readSequence);
+        if (ATOMIC_LOAD(&slot->end) == ring->readSequence) {
+            ring->frameAcquired = true;
+            *framePixels = _getSlotPixels(ring, ring->readSequence);
+            *metadata = &slot->metadata;
+            break;
+        }
+
+        //Overwritten between the two reads, try the next one
+        ++lost;
+        ++ring->readSequence;
+    }
+
+    if (numOfLostFrames) {
+        *numOfLostFrames = lost;
+    }
+
+    return result;
+}
+
+int releaseRingFrame(uintptr_t *frameRingPtr)
+{
+    FrameRing_t *ring = _getFrameRing(frameRingPtr);
+
+    if (!ring) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!ring->frameAcquired) {
+        return INVALID_STATE_ERROR;
+    }
+
+    ring->frameAcquired = false;
+
+    //Everything read from the slot must be done before begin is checked
+    MEMORY_BARRIER();
+    if (ATOMIC_LOAD(&_getSlot(ring, ring->readSequence)->begin) != ring->readSequence) {
+        ++ring->readSequence;
+        return FRAME_OVERRUN_ERROR;
+    }
+
+    ++ring->readSequence;
+    return OK;
+}
+
+int readRingFrame(uint16_t *framePixelsBuffer, FrameMetadata_t *metadata, uint32_t *numOfLostFrames, uint32_t timeoutMilliseconds, uintptr_t *frameRingPtr)
+{
+    int result = -1;
+    uint32_t lost = 0, totalLost = 0;
+    const uint16_t *pixels = NULL;
+    const FrameMetadata_t *slotMetadata = NULL;
+    FrameMetadata_t copiedMetadata;
+
+    if (!framePixelsBuffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    for (;;) {
+        result = acquireRingFrame(&pixels, &slotMetadata, &lost, timeoutMilliseconds, frameRingPtr);
+        totalLost += lost;
+        if (result != OK) {
+            break;
+        }
+
+        copiedMetadata = *slotMetadata;
+        if (copiedMetadata.numOfPixelsInFrame <= MAX_NUM_OF_PIXELS_IN_FRAME) {
+            memcpy(framePixelsBuffer, pixels, copiedMetadata.numOfPixelsInFrame * sizeof(uint16_t));
+        }
+
+        result = releaseRingFrame(frameRingPtr);
+        if (result == OK) {
+            if (metadata) {
+                *metadata = copiedMetadata;
+            }
+            break;
+        }
+
+        //The copy is torn, the frame counts as lost
+        ++totalLost;
+    }
+
+    if (numOfLostFrames) {
+        *numOfLostFrames = totalLost;
+    }
+
+    return result;
+}
@@ -0,0 +1,312 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+/*
+    Every frame goes into a ring of numOfPreTriggerFrames + 1 + numOfPostTriggerFrames slots and its bands are
+    compared with the threshold. The trigger fires when the condition becomes true and re-arms once it is false
+    again. When the post-trigger frames are in, the whole window is copied out as an event and the ring goes on.
+*/
+
+typedef struct HostTrigger_t {
+    uint16_t numOfPixelsInFrame;
+    uint32_t numOfBands;
+    uint16_t *bandEdges;
+    uint8_t conditionMode;
+    uint32_t threshold;
+    uint32_t *prefixSums;
+
+    uint32_t numOfPreTriggerFrames;
+    uint32_t numOfPostTriggerFrames;
+    uint32_t numOfSlots;
+    uint16_t *slotPixels;
+    FrameMetadata_t *slotMetadata;
+    uint64_t numOfFrames;
+
+    bool armed;
+    bool collecting;
+    uint64_t triggerFrame;
+    uint32_t numOfFramesToCollect;
+
+    /* Last complete event */
+    uint16_t *eventPixels;
+    FrameMetadata_t *eventMetadata;
+    uint32_t numOfEventFrames;
+    uint32_t eventTriggerIndex;
+    bool eventReady;
+    uint32_t numOfLostEvents;
+} HostTrigger_t;
+
+static HostTrigger_t *_getHostTrigger(uintptr_t *hostTriggerPtr)
+{
+    if (!hostTriggerPtr || !*hostTriggerPtr) {
+        return NULL;
+    }
+
+    return (HostTrigger_t*)(*hostTriggerPtr);
+}
+
+static void _freeHostTrigger(HostTrigger_t *trigger)
+{
+    free(trigger->bandEdges);
+    free(trigger->prefixSums);
+    free(trigger->slotPixels);
+    free(trigger->slotMetadata);
+    free(trigger->eventPixels);
+    free(trigger->eventMetadata);
+    free(trigger);
+}
+
+static uint16_t *_getSlotPixels(HostTrigger_t *trigger, uint64_t frame)
+{
+    return trigger->slotPixels + (size_t)(frame % trigger->numOfSlots) * MAX_NUM_OF_PIXELS_IN_FRAME;
+}
+
+static void _accumulatePrefixSums(void *hookState, const uint16_t *framePixels, uint32_t firstPixel, uint32_t endPixel)
+{
+    uint32_t *prefixSums = ((HostTrigger_t*)hookState)->prefixSums;
+    uint32_t i = 0, sum = prefixSums[firstPixel];
+
+    for (i = firstPixel; i < endPixel; ++i) {
+        sum += framePixels[i];
+        prefixSums[i + 1] = sum;
+    }
+}
+
+static bool _evaluateCondition(const HostTrigger_t *trigger)
+{
+    uint32_t i = 0, first = 0, end = 0;
+    uint64_t sum = 0;
+    bool above = false, anyAbove = false, allAbove = true;
+
+    //Band means against the threshold, without dividing
+    for (i = 0; i < trigger->numOfBands; ++i) {
+        first = trigger->bandEdges[2 * i];
+        end = trigger->bandEdges[2 * i + 1];
+        sum = trigger->prefixSums[end] - trigger->prefixSums[first];
+        above = sum >= (uint64_t)trigger->threshold * (end - first);
+
+        anyAbove = anyAbove || above;
+        allAbove = allAbove && above;
+    }
+
+    switch (trigger->conditionMode) {
+    case HOST_TRIGGER_ANY_ABOVE:
+        return anyAbove;
+    case HOST_TRIGGER_ALL_ABOVE:
+        return allAbove;
+    case HOST_TRIGGER_ANY_BELOW:
+        return !allAbove;
+    default:
+        return !anyAbove;
+    }
+}
+
+static void _latchEvent(HostTrigger_t *trigger)
+{
+    uint64_t first = (trigger->triggerFrame > trigger->numOfPreTriggerFrames)? trigger->triggerFrame - trigger->numOfPreTriggerFrames : 0;
+    uint64_t frame = 0;
+    uint32_t i = 0;
+
+    if (trigger->eventReady) {
+        ++trigger->numOfLostEvents;
+    }
+
+    for (frame = first, i = 0; frame < trigger->numOfFrames; ++frame, ++i) {
+        memcpy(trigger->eventPixels + (size_t)i * trigger->numOfPixelsInFrame, _getSlotPixels(trigger, frame),
+               trigger->numOfPixelsInFrame * sizeof(uint16_t));
+        trigger->eventMetadata[i] = trigger->slotMetadata[frame % trigger->numOfSlots];
+    }
+
+    trigger->numOfEventFrames = i;
+    trigger->eventTriggerIndex = (uint32_t)(trigger->triggerFrame - first);
+    trigger->eventReady = true;
+    trigger->collecting = false;
+}
+
+//The frame is already in its slot with its prefix sums
+static void _advance(HostTrigger_t *trigger, uint8_t *eventReady)
+{
+    bool condition = _evaluateCondition(trigger);
+
+    if (trigger->collecting) {
+        --trigger->numOfFramesToCollect;
+    } else if (condition && trigger->armed) {
+        trigger->collecting = true;
+        trigger->triggerFrame = trigger->numOfFrames;
+        trigger->numOfFramesToCollect = trigger->numOfPostTriggerFrames;
+        trigger->armed = false;
+    }
+
+    if (!condition) {
+        trigger->armed = true;
+    }
+
+    ++trigger->numOfFrames;
+
+    if (trigger->collecting && !trigger->numOfFramesToCollect) {
+        _latchEvent(trigger);
+    }
+
+    if (eventReady) {
+        *eventReady = trigger->eventReady;
+    }
+}
+
+int createHostTrigger(const uint16_t *bandEdges, uint32_t numOfBands, uint16_t numOfPixelsInFrame, uint8_t conditionMode, uint32_t threshold,
+                      uint32_t numOfPreTriggerFrames, uint32_t numOfPostTriggerFrames, uintptr_t *hostTriggerPtr)
+{
+    uint32_t i = 0, numOfSlots = 0;
+    HostTrigger_t *trigger = NULL;
+
+    if (!bandEdges || !hostTriggerPtr) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!numOfBands || !numOfPixelsInFrame || numOfPixelsInFrame > MAX_NUM_OF_PIXELS_IN_FRAME || conditionMode > HOST_TRIGGER_ALL_BELOW ||
+        numOfPreTriggerFrames > HOST_TRIGGER_MAX_FRAMES || numOfPostTriggerFrames > HOST_TRIGGER_MAX_FRAMES) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    //Empty bands would always be above the threshold
+    for (i = 0; i < numOfBands; ++i) {
+        if (bandEdges[2 * i] >= bandEdges[2 * i + 1] || bandEdges[2 * i + 1] > numOfPixelsInFrame) {
+            return INVALID_PARAMETER_ERROR;
+        }
+    }
+
+    numOfSlots = numOfPreTriggerFrames + 1 + numOfPostTriggerFrames;
+
+    trigger = calloc(1, sizeof(HostTrigger_t));
+    if (trigger) {
+        trigger->bandEdges = malloc(2 * numOfBands * sizeof(uint16_t));
+        trigger->prefixSums = malloc((MAX_NUM_OF_PIXELS_IN_FRAME + 1) * sizeof(uint32_t));
+        trigger->slotPixels = malloc((size_t)numOfSlots * MAX_NUM_OF_PIXELS_IN_FRAME * sizeof(uint16_t));
+        trigger->slotMetadata = calloc(numOfSlots, sizeof(FrameMetadata_t));
+        trigger->eventPixels = malloc((size_t)numOfSlots * numOfPixelsInFrame * sizeof(uint16_t));
+        trigger->eventMetadata = calloc(numOfSlots, sizeof(FrameMetadata_t));
+    }
+    if (!trigger || !trigger->bandEdges || !trigger->prefixSums || !trigger->slotPixels || !trigger->slotMetadata ||
+        !trigger->eventPixels || !trigger->eventMetadata) {
+        if (trigger) {
+            _freeHostTrigger(trigger);
+        }
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    memcpy(trigger->bandEdges, bandEdges, 2 * numOfBands * sizeof(uint16_t));
+    trigger->numOfBands = numOfBands;
+    trigger->numOfPixelsInFrame = numOfPixelsInFrame;
+    trigger->conditionMode = conditionMode;
+    trigger->threshold = threshold;
+    trigger->prefixSums[0] = 0;
+    trigger->numOfPreTriggerFrames = numOfPreTriggerFrames;
+    trigger->numOfPostTriggerFrames = numOfPostTriggerFrames;
+    trigger->numOfSlots = numOfSlots;
+    trigger->armed = true;
+
+    if (*hostTriggerPtr) {
+        destroyHostTrigger(hostTriggerPtr);
+    }
+    *hostTriggerPtr = (uintptr_t)trigger;
+
+    return OK;
+}
+
+int destroyHostTrigger(uintptr_t *hostTriggerPtr)
+{
+    HostTrigger_t *trigger = _getHostTrigger(hostTriggerPtr);
+
+    if (!trigger) {
+        return OK;
+    }
+
+    _freeHostTrigger(trigger);
+    *hostTriggerPtr = 0;
+
+    return OK;
+}
+
+int feedHostTrigger(const uint16_t *framePixels, const FrameMetadata_t *metadata, uint8_t *eventReady, uintptr_t *hostTriggerPtr)
+{
+    HostTrigger_t *trigger = _getHostTrigger(hostTriggerPtr);
+    FrameMetadata_t *slotMetadata = NULL;
+
+    if (!trigger || !framePixels || !metadata) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (metadata->numOfPixelsInFrame != trigger->numOfPixelsInFrame) {
+        return INVALID_PARAMETER_ERROR;
+    }
+
+    slotMetadata = &trigger->slotMetadata[trigger->numOfFrames % trigger->numOfSlots];
+    memcpy(_getSlotPixels(trigger, trigger->numOfFrames), framePixels, trigger->numOfPixelsInFrame * sizeof(uint16_t));
+    *slotMetadata = *metadata;
+
+    _accumulatePrefixSums(trigger, framePixels, 0, trigger->numOfPixelsInFrame);
+    _advance(trigger, eventReady);
+
+    return OK;
+}
+
+int readHostTriggerFrame(uint16_t numOfFrame, uint8_t *eventReady, uintptr_t *hostTriggerPtr, uintptr_t *deviceContextPtr)
+{
+    int result = -1;
+    FrameMetadata_t *slotMetadata = NULL;
+    HostTrigger_t *trigger = _getHostTrigger(hostTriggerPtr);
+
+    if (!trigger) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    //Decoded straight into the ring, the slot being overwritten is older than any pending event needs
+    slotMetadata = &trigger->slotMetadata[trigger->numOfFrames % trigger->numOfSlots];
+    result = _getFrameWithHook(_getSlotPixels(trigger, trigger->numOfFrames), numOfFrame, slotMetadata, _accumulatePrefixSums, trigger, deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    //The frame format changed since the bands were set
+    if (slotMetadata->numOfPixelsInFrame != trigger->numOfPixelsInFrame) {
+        return INVALID_STATE_ERROR;
+    }
+
+    _advance(trigger, eventReady);
+
+    return OK;
+}
+
+int getHostTriggerEvent(uint16_t *framePixels, FrameMetadata_t *metadata, uint32_t *numOfFrames, uint32_t *triggerIndex, uint32_t *numOfLostEvents,
+                        uintptr_t *hostTriggerPtr)
+{
+    HostTrigger_t *trigger = _getHostTrigger(hostTriggerPtr);
+
+    if (!trigger || !framePixels || !numOfFrames) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (numOfLostEvents) {
+        *numOfLostEvents = trigger->numOfLostEvents;
+    }
+
+    if (!trigger->eventReady) {
+        *numOfFrames = 0;
+        return OK;
+    }
+
+    memcpy(framePixels, trigger->eventPixels, (size_t)trigger->numOfEventFrames * trigger->numOfPixelsInFrame * sizeof(uint16_t));
+    if (metadata) {
+        memcpy(metadata, trigger->eventMetadata, trigger->numOfEventFrames * sizeof(FrameMetadata_t));
+    }
+
+    *numOfFrames = trigger->numOfEventFrames;
+    if (triggerIndex) {
+        *triggerIndex = trigger->eventTriggerIndex;
+    }
+    trigger->eventReady = false;
+
+    return OK;
+}
@@ -1,3 +1,14 @@
 from .spectrometer import Spectrometer
 from .lib import SpectrometerError, SpectrometerConnectionError
-from .modes import ScanMode, ReductionMode
+from .modes import ScanMode, ReductionMode, ReplyClass
+from .group import DeviceGroup
+from .drain import DrainEngine
+from .capture import CaptureFile, CaptureWriter, compress_capture_file, decompress_capture_file
+from .codec import compress_frame, decompress_frame
+from .ring import FrameRingPublisher, FrameRingReader
+from .processor import FrameProcessor
+from .binning import Binning
+from .peaks import PeakFinder
+from .bands import BandIntegrator
+from .triggers import HostTrigger
+from .hdr import merge_hdr, read_hdr
@@ -0,0 +1,64 @@
+from ctypes import POINTER, byref, c_uint16, c_uint32, pointer
+from typing import Iterable, List, Tuple
+
+from numpy import asarray, empty, int64, ndarray, uint16, uint32, zeros
+
+from .lib import FrameMetadata, c_uintptr, libspectr
+from .spectrometer import Spectrometer
+
+class BandIntegrator:
+    def __init__(self, bands: Iterable[Tuple[int, int]], frame_size: int = 3694):
+        self.ctx = pointer(c_uintptr())
+
+        # Bands are (start, stop) slices of the frames returned by Memory, frame[start:stop].sum()
+        bands = asarray(list(bands), dtype=int64).reshape(-1, 2)
+        image_size = frame_size - 46
+        if (bands < 0).any() or (bands > image_size).any() or (bands[:, 0] > bands[:, 1]).any():
+            raise ValueError(f"bands must be slices of a frame of {image_size} elements")
+
+        self.frame_size = frame_size
+        self.num_of_bands = len(bands)
+
+        # Memory reverses the elements, frame[start:stop] is raw[size - 14 - stop:size - 14 - start]
+        edges = empty((self.num_of_bands, 2), dtype=uint16)
+        edges[:, 0] = frame_size - 14 - bands[:, 1]
+        edges[:, 1] = frame_size - 14 - bands[:, 0]
+        libspectr.createBandIntegrator(edges.ctypes.data_as(POINTER(c_uint16)), self.num_of_bands, frame_size, self.ctx)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info) -> bool:
+        self.close()
+        return False
+
+    def __del__(self):
+        self.close()
+
+    def __call__(self, frame: ndarray) -> ndarray:
+        raw = zeros(self.frame_size, dtype=uint16)
+        raw[32:-14] = frame[::-1]
+        sums = empty(self.num_of_bands, dtype=uint32)
+        libspectr.integrateBands(raw.ctypes.data_as(POINTER(c_uint16)), self.frame_size,
+                                 sums.ctypes.data_as(POINTER(c_uint32)), self.ctx)
+        return sums
+
+    def read(self, spectrometer: Spectrometer, index: int = 0) -> Tuple[ndarray, FrameMetadata]:
+        sums = empty(self.num_of_bands, dtype=uint32)
+        metadata = FrameMetadata()
+        libspectr.getBandFrame(sums.ctypes.data_as(POINTER(c_uint32)), index, byref(metadata), self.ctx, spectrometer.ctx)
+        return sums, metadata
+
+    def read_all(self, spectrometer: Spectrometer, indices: Iterable[int]) -> Tuple[ndarray, List[FrameMetadata]]:
+        # One row of band sums per frame in place of the frames
+        indices = list(indices)
+        sums = empty((len(indices), self.num_of_bands), dtype=uint32)
+        metadata = [FrameMetadata() for _ in indices]
+        for row, index in enumerate(indices):
+            libspectr.getBandFrame(sums[row].ctypes.data_as(POINTER(c_uint32)), index, byref(metadata[row]),
+                                   self.ctx, spectrometer.ctx)
+        return sums, metadata
+
+    def close(self):
+        if self.ctx.contents:
+            libspectr.destroyBandIntegrator(self.ctx)
@@ -0,0 +1,66 @@
+from ctypes import POINTER, byref, c_float, c_uint16, pointer
+from enum import IntEnum
+from typing import Iterable, Tuple
+
+from numpy import asarray, empty, float32, full, int64, ndarray, uint16, where, zeros
+
+from .lib import FrameMetadata, c_uintptr, libspectr
+from .spectrometer import Spectrometer
+
+class Binning:
+    class Mode(IntEnum):
+        MEAN = 0
+        SUM = 1
+
+    def __init__(self, bin_map: Iterable[int], frame_size: int = 3694, mode: Mode = Mode.MEAN):
+        # Set first, close() runs from __del__ even when the arguments are rejected
+        self.ctx = pointer(c_uintptr())
+
+        # The map is indexed like the frames returned by Memory, -1 leaves a pixel out
+        bin_map = asarray(bin_map, dtype=int64)
+        if len(bin_map) != frame_size - 46:
+            raise ValueError(f"bin map must have {frame_size - 46} elements")
+
+        self.frame_size = frame_size
+
+        raw_map = full(frame_size, 0xFFFF, dtype=uint16)
+        raw_map[32:-14] = where(bin_map < 0, 0xFFFF, bin_map)[::-1]
+        num_of_bins = c_uint16()
+        libspectr.createBinning(raw_map.ctypes.data_as(POINTER(c_uint16)), frame_size, mode, byref(num_of_bins), self.ctx)
+        self.num_of_bins = num_of_bins.value
+
+    @classmethod
+    def from_ranges(cls, ranges: Iterable[Tuple[int, int]], frame_size: int = 3694, mode: Mode = Mode.MEAN) -> "Binning":
+        bin_map = full(frame_size - 46, -1, dtype=int64)
+        for index, (start, stop) in enumerate(ranges):
+            bin_map[start:stop] = index
+        return cls(bin_map, frame_size, mode)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info) -> bool:
+        self.close()
+        return False
+
+    def __del__(self):
+        self.close()
+
+    def __call__(self, frame: ndarray) -> ndarray:
+        raw = zeros(self.frame_size, dtype=uint16)
+        raw[32:-14] = frame[::-1]
+        values = empty(self.num_of_bins, dtype=float32)
+        libspectr.binFrame(raw.ctypes.data_as(POINTER(c_uint16)), self.frame_size,
+                           values.ctypes.data_as(POINTER(c_float)), self.ctx)
+        return values
+
+    def read(self, spectrometer: Spectrometer, index: int = 0) -> Tuple[ndarray, FrameMetadata]:
+        values = empty(self.num_of_bins, dtype=float32)
+        metadata = FrameMetadata()
+        libspectr.getBinnedFrame(values.ctypes.data_as(POINTER(c_float)), index, byref(metadata),
+                                 self.ctx, spectrometer.ctx)
+        return values, metadata
+
+    def close(self):
+        if self.ctx.contents:
+            libspectr.destroyBinning(self.ctx)
@@ -0,0 +1,109 @@
+from ctypes import POINTER, byref, c_uint8, c_uint16, pointer, sizeof
+from enum import IntEnum
+from typing import Optional, Tuple, Union
+
+from numpy import ascontiguousarray, dtype, memmap, ndarray, uint16
+
+from .lib import CaptureFileHeader, CaptureRecord, FrameMetadata, c_uintptr, libspectr
+from .spectrometer import Spectrometer
+
+class CaptureWriter:
+    def __init__(self, path: str, spectrometer: Spectrometer, max_frames: int, calibration: bytes = b""):
+        self.spectrometer = spectrometer
+        self.ctx = pointer(c_uintptr())
+
+        buffer = (c_uint8 * len(calibration)).from_buffer_copy(calibration) if calibration else None
+        libspectr.createCaptureFile(str(path).encode(), max_frames, buffer, len(calibration), self.ctx, spectrometer.ctx)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info) -> bool:
+        self.close()
+        return False
+
+    def __del__(self):
+        self.close()
+
+    def capture(self, index: int, source_id: int = 0, spectrometer: Optional[Spectrometer] = None):
+        spectrometer = spectrometer or self.spectrometer
+        libspectr.captureFrame(index, source_id, self.ctx, spectrometer.ctx)
+
+    def capture_drained(self, timeout: Optional[float] = None, source_id: int = 0,
+                        spectrometer: Optional[Spectrometer] = None):
+        spectrometer = spectrometer or self.spectrometer
+        timeout_ms = 0xFFFFFFFF if timeout is None else round(timeout * 1000)
+        libspectr.captureDrainedFrame(timeout_ms, source_id, self.ctx, spectrometer.ctx)
+
+    def append(self, frame: ndarray, metadata: Optional[FrameMetadata] = None, source_id: int = 0):
+        # The frame as read from the device, before the dummy elements are cut off
+        frame = ascontiguousarray(frame, dtype=uint16)
+        if metadata is None:
+            metadata = FrameMetadata()
+        metadata.numOfPixelsInFrame = len(frame)
+        libspectr.appendCaptureFrame(frame.ctypes.data_as(POINTER(c_uint16)), byref(metadata), source_id, self.ctx)
+
+    def sync(self):
+        libspectr.syncCaptureFile(self.ctx)
+
+    def close(self):
+        if self.ctx.contents:
+            libspectr.closeCaptureFile(self.ctx)
+
+class CaptureFile:
+    class State(IntEnum):
+        PENDING = 0
+        COMPLETE = 1
+        FAILED = 2
+
+    def __init__(self, path: str):
+        self._file = memmap(path, mode="r")
+        self.refresh()
+
+    def __len__(self):
+        return len(self.records)
+
+    def __getitem__(self, key: Union[int, slice]) -> ndarray:
+        if isinstance(key, int):
+            return self.records["pixels"][key][32:-14][::-1]
+        return self.records["pixels"][key][:, 32:-14][:, ::-1]
+
+    def refresh(self):
+        self.header = CaptureFileHeader.from_buffer_copy(self._file[:sizeof(CaptureFileHeader)])
+        if self.header.magic != b"ASQCAPT":
+            raise ValueError("not a capture file")
+
+        record = dtype({"names": ["metadata", "sourceId", "state", "pixels"],
+                        "formats": [dtype(FrameMetadata), "<u4", "<u4", ("<u2", self.header.numOfPixelsInFrame)],
+                        "offsets": [CaptureRecord.metadata.offset, CaptureRecord.sourceId.offset,
+                                    CaptureRecord.state.offset, self.header.pixelsOffset],
+                        "itemsize": self.header.recordSize})
+
+        # Views of the mapping, nothing is copied
+        count = min(self.header.numOfRecords, self.header.maxNumOfRecords)
+        self.records = self._file[self.header.headerSize:self.header.headerSize + count * self.header.recordSize].view(record)
+
+    @property
+    def frames(self) -> ndarray:
+        return self[:]
+
+    @property
+    def metadata(self) -> ndarray:
+        return self.records["metadata"]
+
+    @property
+    def complete(self) -> ndarray:
+        return self.records["state"] == self.State.COMPLETE
+
+    @property
+    def calibration(self) -> bytes:
+        return bytes(self.header.calibration[:self.header.calibrationSize])
+
+    def read(self, key: int) -> Tuple[ndarray, ndarray]:
+        return self[key], self.records["metadata"][key]
+
+def compress_capture_file(source: str, destination: str):
+    libspectr.compressCaptureFile(str(source).encode(), str(destination).encode())
+
+def decompress_capture_file(source: str, destination: str):
+    libspectr.decompressCaptureFile(str(source).encode(), str(destination).encode())
@@ -0,0 +1,34 @@
+from ctypes import POINTER, byref, c_uint8, c_uint16, c_uint32
+from typing import Optional
+
+from numpy import ascontiguousarray, empty, frombuffer, ndarray, uint8, uint16
+
+from .lib import libspectr
+
+# The codec works on frames as read from the device, before the dummy elements are cut off
+
+def compress_frame(frame: ndarray, reference: Optional[ndarray] = None) -> bytes:
+    frame = ascontiguousarray(frame, dtype=uint16)
+    if reference is not None:
+        reference = ascontiguousarray(reference, dtype=uint16)
+        if reference.shape != frame.shape:
+            raise ValueError("reference must have the shape of the frame")
+
+    capacity = libspectr.getCompressedFrameBound(len(frame))
+    buffer = (c_uint8 * capacity)()
+    size = c_uint32()
+    libspectr.compressFrame(frame.ctypes.data_as(POINTER(c_uint16)), len(frame),
+                            reference.ctypes.data_as(POINTER(c_uint16)) if reference is not None else None,
+                            buffer, capacity, byref(size))
+    return bytes(buffer[:size.value])
+
+def decompress_frame(data: bytes, size: int, reference: Optional[ndarray] = None) -> ndarray:
+    if reference is not None:
+        reference = ascontiguousarray(reference, dtype=uint16)
+
+    compressed = frombuffer(data, dtype=uint8)
+    frame = empty(size, dtype=uint16)
+    libspectr.decompressFrame(compressed.ctypes.data_as(POINTER(c_uint8)), len(data),
+                              reference.ctypes.data_as(POINTER(c_uint16)) if reference is not None else None,
+                              frame.ctypes.data_as(POINTER(c_uint16)), size)
+    return frame
@@ -0,0 +1,104 @@
+from ctypes import POINTER, memmove
+from os import environ, path
+from socket import AF_UNIX, SOCK_STREAM, socket
+from typing import List, Optional
+
+from .lib import SpectrometerError, _errcheck, c_uintptr
+
+DEFAULT_SOCKET = path.join(environ.get("XDG_RUNTIME_DIR", "/tmp"), "spectrometerd.sock")
+
+def _value(argument) -> int:
+    return getattr(argument, "value", argument)
+
+def _set(reference, value: int):
+    # Mirrors the byref() output arguments of the library
+    if reference is not None:
+        reference._obj.value = value
+
+class DaemonLibrary:
+    """Stands in for libspectr and forwards the calls to spectrometerd, frames come through its ring"""
+
+    def __init__(self, socket_path: Optional[str] = None):
+        self._socket = socket(AF_UNIX, SOCK_STREAM)
+        self._socket.connect(socket_path or DEFAULT_SOCKET)
+        self._file = self._socket.makefile("rw")
+        self.serial = None
+
+    def request(self, command: str, *arguments) -> List[str]:
+        self._file.write(" ".join([command, *map(str, arguments)]) + "\n")
+        self._file.flush()
+
+        reply = self._file.readline().split()
+        if not reply:
+            raise SpectrometerError("daemon closed the connection")
+        _errcheck(int(reply[0]), None, ())
+        return reply[1:]
+
+    def devices(self) -> List[str]:
+        return self.request("devices")
+
+    def ring(self) -> str:
+        return self.request("ring", self.serial)[0]
+
+    def close(self):
+        self._file.close()
+        self._socket.close()
+
+    def connectToDeviceBySerial(self, serial: Optional[bytes], ctx: POINTER(c_uintptr)):
+        devices = self.devices()
+        serial = serial.decode() if serial else (devices[0] if devices else None)
+        if serial not in devices:
+            _errcheck(516, None, ())
+        # The context stays NULL, so libspectr helpers handed this device fail instead of using a context they do not own
+        self.serial = serial
+
+    def disconnectDeviceContext(self, ctx: POINTER(c_uintptr)):
+        self.serial = None
+
+    def getAcquisitionParameters(self, num_of_scans, num_of_blank_scans, scan_mode, exposure_time, ctx):
+        values = self.request("getAcquisitionParameters", self.serial)
+        for reference, value in zip((num_of_scans, num_of_blank_scans, scan_mode, exposure_time), values):
+            _set(reference, int(value))
+
+    def setAcquisitionParameters(self, num_of_scans, num_of_blank_scans, scan_mode, exposure_time, ctx):
+        self.request("setAcquisitionParameters", self.serial, _value(num_of_scans), _value(num_of_blank_scans),
+                     _value(scan_mode), _value(exposure_time))
+
+    def getFrameFormat(self, start, end, reduction_mode, frame_size, ctx):
+        values = self.request("getFrameFormat", self.serial)
+        for reference, value in zip((start, end, reduction_mode, frame_size), values):
+            _set(reference, int(value))
+
+    def setFrameFormat(self, start, end, reduction_mode, frame_size, ctx):
+        values = self.request("setFrameFormat", self.serial, _value(start), _value(end), _value(reduction_mode))
+        _set(frame_size, int(values[0]))
+
+    def setExternalTrigger(self, mode, edge, ctx):
+        self.request("setExternalTrigger", self.serial, int(mode), int(edge))
+
+    def setOpticalTrigger(self, mode, pixel, threshold, ctx):
+        self.request("setOpticalTrigger", self.serial, int(mode), pixel, threshold)
+
+    def setDarkCorrection(self, mode, pedestal, ctx):
+        self.request("setDarkCorrection", self.serial, int(mode), pedestal)
+
+    def triggerAcquisition(self, ctx):
+        self.request("triggerAcquisition", self.serial)
+
+    def getStatus(self, status_flags, frames_in_memory, ctx):
+        values = self.request("getStatus", self.serial)
+        _set(status_flags, int(values[0]))
+        _set(frames_in_memory, int(values[1]))
+
+    def resetDevice(self, ctx):
+        self.request("resetDevice", self.serial)
+
+    def readFlash(self, buffer, offset: int, length: int, ctx):
+        data = bytes.fromhex(self.request("readFlash", self.serial, offset, length)[0]) if length else b""
+        memmove(buffer, data, len(data))
+
+    def writeFlash(self, buffer, offset: int, length: int, ctx):
+        raise SpectrometerError("flash can only be read through the daemon")
+
+    def eraseFlash(self, ctx):
+        raise SpectrometerError("flash can only be read through the daemon")
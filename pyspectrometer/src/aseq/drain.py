@@ -0,0 +1,53 @@
+from ctypes import POINTER, byref, c_uint16
+from enum import IntEnum
+from typing import Optional, Tuple
+
+from numpy import empty, ndarray
+
+from .lib import DrainStatistics, FrameMetadata, libspectr
+from .ring import MAX_FRAME_SIZE
+from .spectrometer import Spectrometer
+
+class DrainEngine:
+    class Policy(IntEnum):
+        DROP_OLDEST = 0
+        DROP_NEWEST = 1
+        STALL_DEVICE = 2
+
+    def __init__(self, spectrometer: Spectrometer, buffer_frames: int = 256,
+                 policy: Policy = Policy.DROP_OLDEST, background: bool = True):
+        self._ctx = spectrometer.ctx
+        libspectr.startDrainEngine(buffer_frames, policy, background, self._ctx)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info) -> bool:
+        self.stop()
+        return False
+
+    def __iter__(self):
+        return self
+
+    def __next__(self) -> Tuple[ndarray, FrameMetadata]:
+        return self.pop()
+
+    def pop(self, timeout: Optional[float] = None) -> Tuple[ndarray, FrameMetadata]:
+        # The frame keeps the format it was read with, which may have changed since
+        buffer = empty(MAX_FRAME_SIZE, dtype=c_uint16)
+        metadata = FrameMetadata()
+        timeout_ms = 0xFFFFFFFF if timeout is None else round(timeout * 1000)
+        libspectr.popDrainedFrame(buffer.ctypes.data_as(POINTER(c_uint16)), byref(metadata), timeout_ms, self._ctx)
+        return buffer[:metadata.numOfPixelsInFrame][32:-14][::-1], metadata
+
+    def step(self):
+        libspectr.stepDrainEngine(self._ctx)
+
+    @property
+    def statistics(self) -> DrainStatistics:
+        statistics = DrainStatistics()
+        libspectr.getDrainStatistics(byref(statistics), self._ctx)
+        return statistics
+
+    def stop(self):
+        libspectr.stopDrainEngine(self._ctx)
@@ -4,8 +4,9 @@ from warnings import warn
 from .lib import c_uintptr, libspectr
 
 class Flash:
-    def __init__(self, ctx: POINTER(c_uintptr)):
+    def __init__(self, ctx: POINTER(c_uintptr), lib=libspectr):
         self._ctx = ctx
+        self._lib = lib
 
     def read(self, length: int, offset: int = 0) -> bytes:
         if length < 0 or offset < 0:
@@ -18,7 +19,7 @@ class Flash:
             length = 0x20000 - offset
 
         buffer = (c_uint8 * length)()
-        libspectr.readFlash(buffer, offset, length, self._ctx)
+        self._lib.readFlash(buffer, offset, length, self._ctx)
         return bytes(buffer)
 
     def write(self, buffer: bytes, offset: int = 0):
@@ -35,7 +36,7 @@ class Flash:
             warn("only empty memory locations can be written to")
 
         buffer = (c_uint8 * length).from_buffer_copy(buffer)
-        libspectr.writeFlash(buffer, offset, length, self._ctx)
+        self._lib.writeFlash(buffer, offset, length, self._ctx)
 
     def erase(self):
-        libspectr.eraseFlash(self._ctx)
+        self._lib.eraseFlash(self._ctx)
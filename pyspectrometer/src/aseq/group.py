@@ -0,0 +1,46 @@
+from ctypes import POINTER, byref, c_uint32, c_uint64, pointer
+from enum import IntEnum
+from typing import List, Sequence, Tuple
+
+from .lib import c_uintptr, libspectr
+from .spectrometer import Spectrometer
+
+class DeviceGroup:
+    class Mode(IntEnum):
+        SEQUENTIAL = 0
+        BARRIER = 1
+
+    def __init__(self, spectrometers: Sequence[Spectrometer], mode: Mode = Mode.SEQUENTIAL):
+        self.spectrometers = list(spectrometers)
+        self.ctx = pointer(c_uintptr())
+
+        # The group keeps pointers to the context variables, not their values
+        self._members = (POINTER(c_uintptr) * len(self.spectrometers))(*(spec.ctx for spec in self.spectrometers))
+        self._starts = (c_uint64 * len(self.spectrometers))()
+        self._ends = (c_uint64 * len(self.spectrometers))()
+
+        libspectr.createDeviceGroup(self._members, len(self.spectrometers), mode, self.ctx)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info) -> bool:
+        self.close()
+        return False
+
+    def __del__(self):
+        self.close()
+
+    def __call__(self) -> List[Tuple[int, int]]:
+        libspectr.triggerDeviceGroup(self._starts, self._ends, self.ctx)
+        return list(zip(self._starts, self._ends))
+
+    @property
+    def skew(self) -> Tuple[int, int, int]:
+        last, maximum, triggers = c_uint64(), c_uint64(), c_uint32()
+        libspectr.getDeviceGroupSkew(byref(last), byref(maximum), byref(triggers), self.ctx)
+        return last.value, maximum.value, triggers.value
+
+    def close(self):
+        if self.ctx.contents:
+            libspectr.destroyDeviceGroup(self.ctx)
@@ -0,0 +1,37 @@
+from ctypes import POINTER, c_float, c_uint16, c_uint32
+from typing import List, Sequence, Tuple, Union
+
+from numpy import ascontiguousarray, empty, float32, full, ndarray, uint16, uint32
+
+from .lib import FrameMetadata, libspectr
+from .spectrometer import Spectrometer
+
+SATURATION_LEVEL = 0xFFFF
+
+def merge_hdr(frames: ndarray, exposure_times: Sequence[int], offsets: Union[int, Sequence[int]],
+              saturation_levels: Union[int, Sequence[int]] = SATURATION_LEVEL) -> ndarray:
+    # One frame per row, any frame layout; offsets are the dark levels, or the pedestal of corrected frames
+    frames = ascontiguousarray(frames, dtype=uint16)
+    count, size = frames.shape
+    times = ascontiguousarray(exposure_times, dtype=uint32)
+    offsets = full(count, offsets, dtype=uint16) if isinstance(offsets, int) else ascontiguousarray(offsets, dtype=uint16)
+    levels = full(count, saturation_levels, dtype=uint16) if isinstance(saturation_levels, int) \
+        else ascontiguousarray(saturation_levels, dtype=uint16)
+    if len(times) != count or len(offsets) != count or len(levels) != count:
+        raise ValueError("one exposure time, offset and saturation level per frame")
+
+    merged = empty(size, dtype=float32)
+    libspectr.mergeHdrFrames(frames.ctypes.data_as(POINTER(c_uint16)), times.ctypes.data_as(POINTER(c_uint32)),
+                             offsets.ctypes.data_as(POINTER(c_uint16)), levels.ctypes.data_as(POINTER(c_uint16)),
+                             count, size, merged.ctypes.data_as(POINTER(c_float)))
+    return merged
+
+def read_hdr(spectrometer: Spectrometer, exposure_times: Sequence[int],
+             timeout: float = 1.0) -> Tuple[ndarray, List[FrameMetadata]]:
+    # Times in μs like Spectrometer.exposure_time, the frame is scaled to the longest one
+    times = ascontiguousarray([round(time / 10) for time in exposure_times], dtype=uint32)
+    merged = empty(spectrometer.frame_size, dtype=float32)
+    metadata = (FrameMetadata * len(times))()
+    libspectr.getHdrFrame(merged.ctypes.data_as(POINTER(c_float)), times.ctypes.data_as(POINTER(c_uint32)),
+                          len(times), round(timeout * 1000), metadata, spectrometer.ctx)
+    return merged[32:-14][::-1], list(metadata)
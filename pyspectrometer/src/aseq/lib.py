@@ -12,6 +12,134 @@ class DeviceContext(Structure):
                 ("numOfPixelsInFrame", c_uint16),
                 ("serial", c_char_p)]
 
+class FrameMetadata(Structure):
+    _fields_ = [("triggerTimestamp", c_uint64),
+                ("requestTimestamp", c_uint64),
+                ("firstPacketTimestamp", c_uint64),
+                ("lastPacketTimestamp", c_uint64),
+                ("sequenceNumber", c_uint32),
+                ("timeOfExposure", c_uint32),
+                ("frameIndex", c_uint16),
+                ("numOfPixelsInFrame", c_uint16),
+                ("numOfScans", c_uint16),
+                ("numOfBlankScans", c_uint16),
+                ("scanMode", c_uint8),
+                ("acquisitionParametersKnown", c_uint8),
+                ("darkLevel", c_uint16),
+                ("maxPixel", c_uint16),
+                ("numOfSaturatedPixels", c_uint16)]
+
+class DrainStatistics(Structure):
+    _fields_ = [("framesDrained", c_uint64),
+                ("framesConsumed", c_uint64),
+                ("framesDroppedOldest", c_uint64),
+                ("framesDroppedNewest", c_uint64),
+                ("framesLostOnRearm", c_uint64),
+                ("memoryOverflows", c_uint64),
+                ("rearms", c_uint64),
+                ("memoryDepth", c_uint32),
+                ("hostBufferFill", c_uint32),
+                ("deviceMemoryFill", c_uint32)]
+
+class AveragedFrameInfo(Structure):
+    _fields_ = [("readyTimestamp", c_uint64),
+                ("latencyNanoseconds", c_uint64),
+                ("waitNanoseconds", c_uint64),
+                ("numOfPolls", c_uint32),
+                ("estimatedLostResults", c_uint32),
+                ("estimatedLostScans", c_uint32),
+                ("lost", c_uint8)]
+
+class AveragingStatistics(Structure):
+    _fields_ = [("results", c_uint64),
+                ("resultsWithLoss", c_uint64),
+                ("estimatedLostResults", c_uint64),
+                ("estimatedLostScans", c_uint64),
+                ("numOfPolls", c_uint64),
+                ("timeouts", c_uint64),
+                ("minLatencyNanoseconds", c_uint64),
+                ("maxLatencyNanoseconds", c_uint64),
+                ("totalLatencyNanoseconds", c_uint64),
+                ("periodNanoseconds", c_uint64)]
+
+class Peak(Structure):
+    _fields_ = [("position", c_float),
+                ("height", c_float),
+                ("width", c_float),
+                ("trackId", c_uint32)]
+
+class AutoExposureResult(Structure):
+    _fields_ = [("timeOfExposure", c_uint32),
+                ("maxPixel", c_uint16),
+                ("numOfSaturatedPixels", c_uint16),
+                ("numOfSteps", c_uint8),
+                ("converged", c_uint8)]
+
+class FrameTransferStatistics(Structure):
+    _fields_ = [("framesRecovered", c_uint64),
+                ("framesFailed", c_uint64),
+                ("packetsRetransmitted", c_uint64),
+                ("packetsDiscarded", c_uint64)]
+
+class FrameCacheStatistics(Structure):
+    _fields_ = [("hits", c_uint64),
+                ("misses", c_uint64),
+                ("evictions", c_uint64),
+                ("numOfFrames", c_uint32),
+                ("numOfBytes", c_uint32)]
+
+class FramePoolStatistics(Structure):
+    _fields_ = [("numOfBuffers", c_uint32),
+                ("numOfPixelsInBuffer", c_uint32),
+                ("numOfBuffersInUse", c_uint32),
+                ("peakBuffersInUse", c_uint32),
+                ("numOfAcquisitions", c_uint64),
+                ("numOfExhaustions", c_uint64)]
+
+class FrameProcessorStatistics(Structure):
+    _fields_ = [("numOfThreads", c_uint32),
+                ("queueCapacity", c_uint32),
+                ("queueDepth", c_uint32),
+                ("peakQueueDepth", c_uint32),
+                ("maxThreadQueueDepth", c_uint32),
+                ("framesSubmitted", c_uint64),
+                ("framesProcessed", c_uint64),
+                ("framesDropped", c_uint64),
+                ("tasksStolen", c_uint64)]
+
+FrameKernel = CFUNCTYPE(None, c_void_p, POINTER(c_uint16), POINTER(FrameMetadata), POINTER(c_uintptr))
+
+class ReplyLatency(Structure):
+    _fields_ = [("numOfSamples", c_uint32),
+                ("numOfTimeouts", c_uint32),
+                ("meanMicroseconds", c_float),
+                ("deviationMicroseconds", c_float),
+                ("timeoutMilliseconds", c_uint32)]
+
+class CaptureFileHeader(Structure):
+    _fields_ = [("magic", c_char * 8),
+                ("version", c_uint32),
+                ("headerSize", c_uint32),
+                ("recordSize", c_uint32),
+                ("pixelsOffset", c_uint32),
+                ("maxNumOfRecords", c_uint32),
+                ("numOfRecords", c_uint32),
+                ("numOfPixelsInFrame", c_uint16),
+                ("numOfStartElement", c_uint16),
+                ("numOfEndElement", c_uint16),
+                ("reductionMode", c_uint8),
+                ("reserved", c_uint8),
+                ("serialNumber", c_char * 32),
+                ("calibrationSize", c_uint32),
+                ("creationTimestamp", c_uint64),
+                ("creationUnixTime", c_int64),
+                ("calibration", c_uint8 * 4000)]
+
+class CaptureRecord(Structure):
+    _fields_ = [("metadata", FrameMetadata),
+                ("sourceId", c_uint32),
+                ("state", c_uint32)]
+
 class DeviceInfo(Structure):
     pass
 DeviceInfo._fields_ = [("serialNumber", c_char_p),
@@ -43,6 +171,8 @@ else:
 libspectr.getDevicesCount.restype = c_uint32
 libspectr.getDevicesInfo.restype = POINTER(DeviceInfo)
 libspectr.clearDevicesInfo.restype = None
+libspectr.getHostTimestamp.restype = c_uint64
+libspectr.getCompressedFrameBound.restype = c_uint32
 
 # Argument types
 libspectr.disconnectDeviceContext.argtypes = [POINTER(c_uintptr)]
@@ -60,12 +190,100 @@ libspectr.getStatus.argtypes = [POINTER(c_uint8), POINTER(c_uint16), POINTER(c_u
 libspectr.getAcquisitionParameters.argtypes = [POINTER(c_uint16), POINTER(c_uint16), POINTER(c_uint8), POINTER(c_uint32), POINTER(c_uintptr)]
 libspectr.getFrameFormat.argtypes = [POINTER(c_uint16), POINTER(c_uint16), POINTER(c_uint8), POINTER(c_uint16), POINTER(c_uintptr)]
 libspectr.getFrame.argtypes = [POINTER(c_uint16), c_uint16, POINTER(c_uintptr)]
+libspectr.getFrameWithMetadata.argtypes = [POINTER(c_uint16), c_uint16, POINTER(FrameMetadata), POINTER(c_uintptr)]
 libspectr.clearMemory.argtypes = [POINTER(c_uintptr)]
 libspectr.eraseFlash.argtypes = [POINTER(c_uintptr)]
 libspectr.readFlash.argtypes = [POINTER(c_uint8), c_uint32, c_uint32, POINTER(c_uintptr)]
 libspectr.writeFlash.argtypes = [POINTER(c_uint8), c_uint32, c_uint32, POINTER(c_uintptr)]
 libspectr.resetDevice.argtypes = [POINTER(c_uintptr)]
 libspectr.detachDevice.argtypes = [POINTER(c_uintptr)]
+libspectr.getHostTimestamp.argtypes = []
+libspectr.createDeviceGroup.argtypes = [POINTER(POINTER(c_uintptr)), c_uint32, c_uint8, POINTER(c_uintptr)]
+libspectr.destroyDeviceGroup.argtypes = [POINTER(c_uintptr)]
+libspectr.triggerDeviceGroup.argtypes = [POINTER(c_uint64), POINTER(c_uint64), POINTER(c_uintptr)]
+libspectr.getDeviceGroupSkew.argtypes = [POINTER(c_uint64), POINTER(c_uint64), POINTER(c_uint32), POINTER(c_uintptr)]
+libspectr.startDrainEngine.argtypes = [c_uint32, c_uint8, c_uint8, POINTER(c_uintptr)]
+libspectr.stopDrainEngine.argtypes = [POINTER(c_uintptr)]
+libspectr.stepDrainEngine.argtypes = [POINTER(c_uintptr)]
+libspectr.popDrainedFrame.argtypes = [POINTER(c_uint16), POINTER(FrameMetadata), c_uint32, POINTER(c_uintptr)]
+libspectr.getDrainStatistics.argtypes = [POINTER(DrainStatistics), POINTER(c_uintptr)]
+libspectr.getAveragedFrame.argtypes = [POINTER(c_uint16), POINTER(AveragedFrameInfo), c_uint32, POINTER(c_uintptr)]
+libspectr.getAveragingStatistics.argtypes = [POINTER(AveragingStatistics), POINTER(c_uintptr)]
+libspectr.resetAveragingStatistics.argtypes = [POINTER(c_uintptr)]
+libspectr.createCaptureFile.argtypes = [c_char_p, c_uint32, POINTER(c_uint8), c_uint32, POINTER(c_uintptr), POINTER(c_uintptr)]
+libspectr.openCaptureFile.argtypes = [c_char_p, POINTER(c_uintptr)]
+libspectr.closeCaptureFile.argtypes = [POINTER(c_uintptr)]
+libspectr.syncCaptureFile.argtypes = [POINTER(c_uintptr)]
+libspectr.captureFrame.argtypes = [c_uint16, c_uint32, POINTER(c_uintptr), POINTER(c_uintptr)]
+libspectr.captureDrainedFrame.argtypes = [c_uint32, c_uint32, POINTER(c_uintptr), POINTER(c_uintptr)]
+libspectr.appendCaptureFrame.argtypes = [POINTER(c_uint16), POINTER(FrameMetadata), c_uint32, POINTER(c_uintptr)]
+libspectr.getCaptureFileHeader.argtypes = [POINTER(POINTER(CaptureFileHeader)), POINTER(c_uintptr)]
+libspectr.getCaptureRecord.argtypes = [c_uint32, POINTER(POINTER(CaptureRecord)), POINTER(POINTER(c_uint16)), POINTER(c_uintptr)]
+libspectr.getCompressedFrameBound.argtypes = [c_uint16]
+libspectr.compressFrame.argtypes = [POINTER(c_uint16), c_uint16, POINTER(c_uint16), POINTER(c_uint8), c_uint32, POINTER(c_uint32)]
+libspectr.decompressFrame.argtypes = [POINTER(c_uint8), c_uint32, POINTER(c_uint16), POINTER(c_uint16), c_uint16]
+libspectr.compressCaptureFile.argtypes = [c_char_p, c_char_p]
+libspectr.decompressCaptureFile.argtypes = [c_char_p, c_char_p]
+libspectr.createFrameRing.argtypes = [c_char_p, c_uint32, POINTER(c_uintptr)]
+libspectr.attachFrameRing.argtypes = [c_char_p, POINTER(c_uintptr)]
+libspectr.closeFrameRing.argtypes = [POINTER(c_uintptr)]
+libspectr.publishFrame.argtypes = [POINTER(c_uint16), POINTER(FrameMetadata), POINTER(c_uintptr)]
+libspectr.publishDeviceFrame.argtypes = [c_uint16, POINTER(c_uintptr), POINTER(c_uintptr)]
+libspectr.acquireRingFrame.argtypes = [POINTER(POINTER(c_uint16)), POINTER(POINTER(FrameMetadata)), POINTER(c_uint32), c_uint32, POINTER(c_uintptr)]
+libspectr.releaseRingFrame.argtypes = [POINTER(c_uintptr)]
+libspectr.readRingFrame.argtypes = [POINTER(c_uint16), POINTER(FrameMetadata), POINTER(c_uint32), c_uint32, POINTER(c_uintptr)]
+libspectr.setDarkCorrection.argtypes = [c_uint8, c_uint16, POINTER(c_uintptr)]
+libspectr.correctDarkLevel.argtypes = [POINTER(c_uint16), c_uint16, c_uint16, POINTER(c_uint16)]
+libspectr.createBinning.argtypes = [POINTER(c_uint16), c_uint16, c_uint8, POINTER(c_uint16), POINTER(c_uintptr)]
+libspectr.destroyBinning.argtypes = [POINTER(c_uintptr)]
+libspectr.binFrame.argtypes = [POINTER(c_uint16), c_uint16, POINTER(c_float), POINTER(c_uintptr)]
+libspectr.getBinnedFrame.argtypes = [POINTER(c_float), c_uint16, POINTER(FrameMetadata), POINTER(c_uintptr), POINTER(c_uintptr)]
+libspectr.createPeakFinder.argtypes = [c_uint16, c_uint16, c_uint8, c_float, POINTER(c_uintptr)]
+libspectr.destroyPeakFinder.argtypes = [POINTER(c_uintptr)]
+libspectr.findPeaks.argtypes = [POINTER(c_uint16), c_uint16, POINTER(Peak), c_uint32, POINTER(c_uint32), POINTER(c_uintptr)]
+libspectr.resetPeakTracking.argtypes = [POINTER(c_uintptr)]
+libspectr.createBandIntegrator.argtypes = [POINTER(c_uint16), c_uint32, c_uint16, POINTER(c_uintptr)]
+libspectr.destroyBandIntegrator.argtypes = [POINTER(c_uintptr)]
+libspectr.integrateBands.argtypes = [POINTER(c_uint16), c_uint16, POINTER(c_uint32), POINTER(c_uintptr)]
+libspectr.getBandFrame.argtypes = [POINTER(c_uint32), c_uint16, POINTER(FrameMetadata), POINTER(c_uintptr), POINTER(c_uintptr)]
+libspectr.createHostTrigger.argtypes = [POINTER(c_uint16), c_uint32, c_uint16, c_uint8, c_uint32, c_uint32, c_uint32, POINTER(c_uintptr)]
+libspectr.destroyHostTrigger.argtypes = [POINTER(c_uintptr)]
+libspectr.feedHostTrigger.argtypes = [POINTER(c_uint16), POINTER(FrameMetadata), POINTER(c_uint8), POINTER(c_uintptr)]
+libspectr.readHostTriggerFrame.argtypes = [c_uint16, POINTER(c_uint8), POINTER(c_uintptr), POINTER(c_uintptr)]
+libspectr.getHostTriggerEvent.argtypes = [POINTER(c_uint16), POINTER(FrameMetadata), POINTER(c_uint32), POINTER(c_uint32), POINTER(c_uint32), POINTER(c_uintptr)]
+libspectr.runAutoExposure.argtypes = [c_uint16, c_uint16, c_uint32, c_uint32, c_uint8, c_uint32, POINTER(AutoExposureResult), POINTER(c_uintptr)]
+libspectr.mergeHdrFrames.argtypes = [POINTER(c_uint16), POINTER(c_uint32), POINTER(c_uint16), POINTER(c_uint16), c_uint8, c_uint16, POINTER(c_float)]
+libspectr.getHdrFrame.argtypes = [POINTER(c_float), POINTER(c_uint32), c_uint8, c_uint32, POINTER(FrameMetadata), POINTER(c_uintptr)]
+libspectr.setReplyTimeout.argtypes = [c_uint8, c_uint32, POINTER(c_uintptr)]
+libspectr.getReplyLatency.argtypes = [c_uint8, POINTER(ReplyLatency), POINTER(c_uintptr)]
+libspectr.getFrameTransferStatistics.argtypes = [POINTER(FrameTransferStatistics), POINTER(c_uintptr)]
+libspectr.beginStatusRead.argtypes = [POINTER(c_uint8), POINTER(c_uint16), POINTER(c_uintptr)]
+libspectr.continueStatusRead.argtypes = [POINTER(c_uint8), POINTER(c_uintptr)]
+libspectr.beginFrameRead.argtypes = [c_uint16, POINTER(c_uint16), POINTER(FrameMetadata), POINTER(c_uintptr)]
+libspectr.continueFrameRead.argtypes = [POINTER(c_uint8), POINTER(c_uintptr)]
+libspectr.beginFlashRead.argtypes = [POINTER(c_uint8), c_uint32, c_uint32, POINTER(c_uintptr)]
+libspectr.continueFlashRead.argtypes = [POINTER(c_uint8), POINTER(c_uintptr)]
+libspectr.cancelAsyncOperation.argtypes = [POINTER(c_uintptr)]
+libspectr.getPollFd.argtypes = [POINTER(c_int), POINTER(c_uintptr)]
+libspectr.getPollTimeout.argtypes = [POINTER(c_uint32), POINTER(c_uintptr)]
+libspectr.setStatusCacheTime.argtypes = [c_uint32, POINTER(c_uintptr)]
+libspectr.setFrameCacheSize.argtypes = [c_uint32, POINTER(c_uintptr)]
+libspectr.getFrameCacheStatistics.argtypes = [POINTER(FrameCacheStatistics), POINTER(c_uintptr)]
+libspectr.createFramePool.argtypes = [c_uint32, c_uint16, POINTER(c_uintptr)]
+libspectr.destroyFramePool.argtypes = [POINTER(c_uintptr)]
+libspectr.acquireFrameBuffer.argtypes = [POINTER(POINTER(c_uint16)), POINTER(c_uintptr)]
+libspectr.retainFrameBuffer.argtypes = [POINTER(c_uint16)]
+libspectr.releaseFrameBuffer.argtypes = [POINTER(c_uint16)]
+libspectr.getFramePoolStatistics.argtypes = [POINTER(FramePoolStatistics), POINTER(c_uintptr)]
+libspectr.createFrameProcessor.argtypes = [c_uint32, c_uint32, POINTER(c_uintptr)]
+libspectr.destroyFrameProcessor.argtypes = [POINTER(c_uintptr)]
+libspectr.addFrameKernel.argtypes = [FrameKernel, c_void_p, c_uint8, POINTER(c_uintptr)]
+libspectr.submitFrame.argtypes = [POINTER(c_uint16), POINTER(FrameMetadata), POINTER(c_uintptr), POINTER(c_uintptr)]
+libspectr.attachFrameProcessor.argtypes = [POINTER(c_uintptr), POINTER(c_uintptr)]
+libspectr.detachFrameProcessor.argtypes = [POINTER(c_uintptr)]
+libspectr.waitFrameProcessor.argtypes = [c_uint32, POINTER(c_uintptr)]
+libspectr.getFrameProcessorStatistics.argtypes = [POINTER(FrameProcessorStatistics), POINTER(c_uintptr)]
+libspectr.getFrameProcessorQueueDepths.argtypes = [POINTER(c_uint32), c_uint32, POINTER(c_uintptr)]
 
 class SpectrometerError(Exception):
     pass
@@ -91,7 +309,16 @@ def _errcheck(result, func, arguments: tuple) -> Any:
     if result == 508: raise SpectrometerError("wrong number of packets in frame")
     if result == 509: raise SpectrometerError("input parameter not initialized")
     if result == 510: raise SpectrometerError("remaining packets in flash mismatch")
+    if result == 511: raise SpectrometerError("memory allocation failed")
+    if result == 512: raise SpectrometerError("invalid parameter")
+    if result == 513: raise SpectrometerError("thread creation failed")
+    if result == 514: raise TimeoutError("operation timed out")
+    if result == 515: raise SpectrometerError("invalid state for this operation")
     if result == 516: raise SpectrometerConnectionError("wrong serial number")
+    if result == 517: raise SpectrometerError("capture file full")
+    if result == 518: raise SpectrometerError("file operation failed")
+    if result == 519: raise SpectrometerError("compressed data damaged")
+    if result == 520: raise SpectrometerError("frame overwritten while in use")
     if result == 585: raise SpectrometerError("no device context")
 
     raise SpectrometerError(f"unexpected spectrometer error code: '{result}'")
@@ -111,9 +338,95 @@ libspectr.getStatus.errcheck = _errcheck
 libspectr.getAcquisitionParameters.errcheck = _errcheck
 libspectr.getFrameFormat.errcheck = _errcheck
 libspectr.getFrame.errcheck = _errcheck
+libspectr.getFrameWithMetadata.errcheck = _errcheck
 libspectr.clearMemory.errcheck = _errcheck
 libspectr.eraseFlash.errcheck = _errcheck
 libspectr.readFlash.errcheck = _errcheck
 libspectr.writeFlash.errcheck = _errcheck
 libspectr.resetDevice.errcheck = _errcheck
 libspectr.detachDevice.errcheck = _errcheck
+libspectr.createDeviceGroup.errcheck = _errcheck
+libspectr.destroyDeviceGroup.errcheck = _errcheck
+libspectr.triggerDeviceGroup.errcheck = _errcheck
+libspectr.getDeviceGroupSkew.errcheck = _errcheck
+libspectr.startDrainEngine.errcheck = _errcheck
+libspectr.stopDrainEngine.errcheck = _errcheck
+libspectr.stepDrainEngine.errcheck = _errcheck
+libspectr.popDrainedFrame.errcheck = _errcheck
+libspectr.getDrainStatistics.errcheck = _errcheck
+libspectr.getAveragedFrame.errcheck = _errcheck
+libspectr.getAveragingStatistics.errcheck = _errcheck
+libspectr.resetAveragingStatistics.errcheck = _errcheck
+libspectr.createCaptureFile.errcheck = _errcheck
+libspectr.openCaptureFile.errcheck = _errcheck
+libspectr.closeCaptureFile.errcheck = _errcheck
+libspectr.syncCaptureFile.errcheck = _errcheck
+libspectr.captureFrame.errcheck = _errcheck
+libspectr.captureDrainedFrame.errcheck = _errcheck
+libspectr.appendCaptureFrame.errcheck = _errcheck
+libspectr.getCaptureFileHeader.errcheck = _errcheck
+libspectr.getCaptureRecord.errcheck = _errcheck
+libspectr.compressFrame.errcheck = _errcheck
+libspectr.decompressFrame.errcheck = _errcheck
+libspectr.compressCaptureFile.errcheck = _errcheck
+libspectr.decompressCaptureFile.errcheck = _errcheck
+libspectr.createFrameRing.errcheck = _errcheck
+libspectr.attachFrameRing.errcheck = _errcheck
+libspectr.closeFrameRing.errcheck = _errcheck
+libspectr.publishFrame.errcheck = _errcheck
+libspectr.publishDeviceFrame.errcheck = _errcheck
+libspectr.acquireRingFrame.errcheck = _errcheck
+libspectr.releaseRingFrame.errcheck = _errcheck
+libspectr.readRingFrame.errcheck = _errcheck
+libspectr.setDarkCorrection.errcheck = _errcheck
+libspectr.correctDarkLevel.errcheck = _errcheck
+libspectr.createBinning.errcheck = _errcheck
+libspectr.destroyBinning.errcheck = _errcheck
+libspectr.binFrame.errcheck = _errcheck
+libspectr.getBinnedFrame.errcheck = _errcheck
+libspectr.createPeakFinder.errcheck = _errcheck
+libspectr.destroyPeakFinder.errcheck = _errcheck
+libspectr.findPeaks.errcheck = _errcheck
+libspectr.resetPeakTracking.errcheck = _errcheck
+libspectr.createBandIntegrator.errcheck = _errcheck
+libspectr.destroyBandIntegrator.errcheck = _errcheck
+libspectr.integrateBands.errcheck = _errcheck
+libspectr.getBandFrame.errcheck = _errcheck
+libspectr.createHostTrigger.errcheck = _errcheck
+libspectr.destroyHostTrigger.errcheck = _errcheck
+libspectr.feedHostTrigger.errcheck = _errcheck
+libspectr.readHostTriggerFrame.errcheck = _errcheck
+libspectr.getHostTriggerEvent.errcheck = _errcheck
+libspectr.runAutoExposure.errcheck = _errcheck
+libspectr.mergeHdrFrames.errcheck = _errcheck
+libspectr.getHdrFrame.errcheck = _errcheck
+libspectr.setReplyTimeout.errcheck = _errcheck
+libspectr.getReplyLatency.errcheck = _errcheck
+libspectr.getFrameTransferStatistics.errcheck = _errcheck
+libspectr.beginStatusRead.errcheck = _errcheck
+libspectr.continueStatusRead.errcheck = _errcheck
+libspectr.beginFrameRead.errcheck = _errcheck
+libspectr.continueFrameRead.errcheck = _errcheck
+libspectr.beginFlashRead.errcheck = _errcheck
+libspectr.continueFlashRead.errcheck = _errcheck
+libspectr.cancelAsyncOperation.errcheck = _errcheck
+libspectr.getPollFd.errcheck = _errcheck
+libspectr.getPollTimeout.errcheck = _errcheck
+libspectr.setStatusCacheTime.errcheck = _errcheck
+libspectr.setFrameCacheSize.errcheck = _errcheck
+libspectr.getFrameCacheStatistics.errcheck = _errcheck
+libspectr.createFramePool.errcheck = _errcheck
+libspectr.destroyFramePool.errcheck = _errcheck
+# acquireFrameBuffer() fails whenever all buffers are in use, its callers fall back to an allocation
+libspectr.retainFrameBuffer.errcheck = _errcheck
+libspectr.releaseFrameBuffer.errcheck = _errcheck
+libspectr.getFramePoolStatistics.errcheck = _errcheck
+libspectr.createFrameProcessor.errcheck = _errcheck
+libspectr.destroyFrameProcessor.errcheck = _errcheck
+libspectr.addFrameKernel.errcheck = _errcheck
+# submitFrame() fails whenever the processor is full, its callers count the frames dropped
+libspectr.attachFrameProcessor.errcheck = _errcheck
+libspectr.detachFrameProcessor.errcheck = _errcheck
+libspectr.waitFrameProcessor.errcheck = _errcheck
+libspectr.getFrameProcessorStatistics.errcheck = _errcheck
+libspectr.getFrameProcessorQueueDepths.errcheck = _errcheck
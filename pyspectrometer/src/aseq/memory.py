@@ -1,21 +1,72 @@
-from ctypes import POINTER, byref, cast, c_uint16
+from asyncio import Event, TimeoutError, get_running_loop, wait_for
+from ctypes import POINTER, addressof, byref, cast, c_int, c_uint8, c_uint16, c_uint32, pointer
 from enum import IntEnum
-from typing import Union
+from typing import Optional, Tuple, Union
+from weakref import finalize
 
-from numpy import empty, ndarray
+from numpy import empty, frombuffer, ndarray, uint16
 
-from .lib import DeviceContext, c_uintptr, libspectr
+from .lib import AveragedFrameInfo, AveragingStatistics, DeviceContext, FrameMetadata, FramePoolStatistics, c_uintptr, libspectr
 
 def get_frame_size(ctx: POINTER(c_uintptr)) -> int:
-    ctx = cast(ctx, POINTER(POINTER(DeviceContext)))
+    context = cast(ctx, POINTER(POINTER(DeviceContext)))
     try:
-        return ctx.contents.contents.numOfPixelsInFrame
+        frame_size = context.contents.contents.numOfPixelsInFrame
     except ValueError:
         return 3694  # Frames contain 32 starting, 1 user, 14 final elements
+    if not frame_size:
+        # Unknown after a reset until it is read back
+        size = c_uint16()
+        libspectr.getFrameFormat(None, None, None, byref(size), ctx)
+        frame_size = size.value
+    return frame_size
+
+class FramePool:
+    # Buffers carved by the library from one slab, handed out without copies through the buffer protocol of a
+    # ctypes array; the buffer goes back to the pool when the last array viewing it is collected
+    def __init__(self, size: int, buffers: int = 32):
+        self.size = size
+        self._ptr = pointer(c_uintptr())
+        libspectr.createFramePool(buffers, size, self._ptr)
+
+    def __del__(self):
+        # Buffers still in use keep the slab
+        if self._ptr.contents:
+            libspectr.destroyFramePool(self._ptr)
+
+    def empty(self) -> ndarray:
+        pixels = POINTER(c_uint16)()
+        if libspectr.acquireFrameBuffer(byref(pixels), self._ptr) != 0:
+            return empty(self.size, dtype=uint16)
+
+        exported = (c_uint16 * self.size).from_address(addressof(pixels.contents))
+        finalize(exported, self._release, pixels)
+        return frombuffer(exported, dtype=uint16)
+
+    def _release(self, pixels: POINTER(c_uint16)):
+        libspectr.releaseFrameBuffer(pixels)
+
+    @property
+    def statistics(self) -> FramePoolStatistics:
+        statistics = FramePoolStatistics()
+        libspectr.getFramePoolStatistics(byref(statistics), self._ptr)
+        return statistics
 
 class Memory:
     def __init__(self, ctx: POINTER(c_uintptr)):
         self._ctx = ctx
+        self._pool = None
+
+    def _empty(self) -> ndarray:
+        # The pool is sized for one frame format
+        size = get_frame_size(self._ctx)
+        if self._pool is None or self._pool.size != size:
+            self._pool = FramePool(size)
+        return self._pool.empty()
+
+    @property
+    def pool(self) -> Optional[FramePool]:
+        return self._pool
 
     def __len__(self):
         frames_in_memory = c_uint16()
@@ -29,7 +80,7 @@ class Memory:
             if key < 0 or key >= size:
                 raise IndexError("index out of range")
 
-            buffer = empty(get_frame_size(self._ctx), dtype=c_uint16)
+            buffer = self._empty()
             libspectr.getFrame(buffer.ctypes.data_as(POINTER(c_uint16)), key, self._ctx)
             return buffer[32:-14][::-1]
 
@@ -43,6 +94,53 @@ class Memory:
 
         raise TypeError(f"indices must be integers or slices, not {type(key).__name__}")
 
+    def read(self, key: int) -> Tuple[ndarray, FrameMetadata]:
+        size = len(self)
+        if key < 0: key += size
+        if key < 0 or key >= size:
+            raise IndexError("index out of range")
+
+        buffer = self._empty()
+        metadata = FrameMetadata()
+        libspectr.getFrameWithMetadata(buffer.ctypes.data_as(POINTER(c_uint16)), key, byref(metadata), self._ctx)
+        return buffer[32:-14][::-1], metadata
+
+    async def read_async(self, key: int) -> Tuple[ndarray, FrameMetadata]:
+        # Waits on the device descriptor in the running event loop instead of blocking; Linux hidraw only
+        if key < 0:
+            raise IndexError("index out of range")
+
+        loop = get_running_loop()
+        fd = c_int()
+        libspectr.getPollFd(byref(fd), self._ctx)
+
+        buffer = self._empty()
+        metadata = FrameMetadata()
+        done = c_uint8()
+        timeout_ms = c_uint32()
+        readable = Event()
+
+        libspectr.beginFrameRead(key, buffer.ctypes.data_as(POINTER(c_uint16)), byref(metadata), self._ctx)
+        loop.add_reader(fd.value, readable.set)
+        try:
+            while True:
+                readable.clear()
+                libspectr.continueFrameRead(byref(done), self._ctx)
+                if done.value:
+                    break
+                libspectr.getPollTimeout(byref(timeout_ms), self._ctx)
+                try:
+                    await wait_for(readable.wait(), timeout_ms.value / 1000)
+                except TimeoutError:
+                    pass
+        except BaseException:
+            # A failed read is already over, a cancelled one is not
+            libspectr.cancelAsyncOperation(self._ctx)
+            raise
+        finally:
+            loop.remove_reader(fd.value)
+        return buffer[32:-14][::-1], metadata
+
     def clear(self):
         libspectr.clearMemory(self._ctx)
 
@@ -63,6 +161,12 @@ class FakeMemory:
         libspectr.getFrame(buffer.ctypes.data_as(POINTER(c_uint16)), 0xFFFF, self._ctx)
         return buffer[32:-14][::-1]
 
+    def read(self, key=None) -> Tuple[ndarray, FrameMetadata]:
+        buffer = empty(get_frame_size(self._ctx), dtype=c_uint16)
+        metadata = FrameMetadata()
+        libspectr.getFrameWithMetadata(buffer.ctypes.data_as(POINTER(c_uint16)), 0xFFFF, byref(metadata), self._ctx)
+        return buffer[32:-14][::-1], metadata
+
     def clear(self):
         pass
 
@@ -70,3 +174,19 @@ class FakeMemory:
         frame_status = c_uint16()
         libspectr.getStatus(None, byref(frame_status), self._ctx)
         return self.Status(frame_status.value)
+
+    def wait(self, timeout: Optional[float] = None) -> Tuple[ndarray, AveragedFrameInfo]:
+        buffer = empty(get_frame_size(self._ctx), dtype=c_uint16)
+        info = AveragedFrameInfo()
+        timeout_ms = 0xFFFFFFFF if timeout is None else round(timeout * 1000)
+        libspectr.getAveragedFrame(buffer.ctypes.data_as(POINTER(c_uint16)), byref(info), timeout_ms, self._ctx)
+        return buffer[32:-14][::-1], info
+
+    @property
+    def statistics(self) -> AveragingStatistics:
+        statistics = AveragingStatistics()
+        libspectr.getAveragingStatistics(byref(statistics), self._ctx)
+        return statistics
+
+    def reset_statistics(self):
+        libspectr.resetAveragingStatistics(self._ctx)
@@ -23,3 +23,12 @@ class OpticalTriggerMode(IntEnum):
     ON_THRESHOLD = 2
     ONE_TIME_RISING_EDGE = 0x81
     ONE_TIME_FALLING_EDGE = 0x82
+
+class ReplyClass(IntEnum):
+    COMMAND = 0
+    FRAME_FIRST_PACKET = 1
+    FRAME_PACKET = 2
+    READ_FLASH_PACKET = 3
+    WRITE_FLASH = 4
+    ERASE_FLASH = 5
+    STATUS = 6
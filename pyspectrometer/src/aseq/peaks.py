@@ -0,0 +1,49 @@
+from ctypes import POINTER, byref, c_uint16, c_uint32, pointer
+from enum import IntEnum
+
+from numpy import dtype, empty, ndarray, uint16, zeros
+
+from .lib import Peak, c_uintptr, libspectr
+
+class PeakFinder:
+    class Refinement(IntEnum):
+        PARABOLIC = 0
+        GAUSSIAN = 1
+
+    def __init__(self, threshold: int, min_distance: int = 3, refinement: Refinement = Refinement.GAUSSIAN,
+                 tracking_tolerance: float = 0.0, max_peaks: int = 256):
+        self.ctx = pointer(c_uintptr())
+        self.max_peaks = max_peaks
+        libspectr.createPeakFinder(threshold, min_distance, refinement, tracking_tolerance, self.ctx)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info) -> bool:
+        self.close()
+        return False
+
+    def __del__(self):
+        self.close()
+
+    def __call__(self, frame: ndarray) -> ndarray:
+        # Frames as returned by Memory, the positions are indices into them
+        size = len(frame) + 46
+        raw = zeros(size, dtype=uint16)
+        raw[32:-14] = frame[::-1]
+
+        peaks = empty(self.max_peaks, dtype=dtype(Peak))
+        count = c_uint32()
+        libspectr.findPeaks(raw.ctypes.data_as(POINTER(c_uint16)), size, peaks.ctypes.data_as(POINTER(Peak)),
+                            self.max_peaks, byref(count), self.ctx)
+
+        peaks = peaks[:count.value][::-1].copy()
+        peaks["position"] = (size - 15) - peaks["position"]
+        return peaks
+
+    def reset_tracking(self):
+        libspectr.resetPeakTracking(self.ctx)
+
+    def close(self):
+        if self.ctx.contents:
+            libspectr.destroyPeakFinder(self.ctx)
@@ -0,0 +1,83 @@
+from ctypes import POINTER, byref, c_uint16, c_uint32, pointer
+from typing import Callable, List, Optional
+
+from numpy import ascontiguousarray, ctypeslib, ndarray, uint16
+
+from .lib import FrameKernel, FrameMetadata, FrameProcessorStatistics, c_uintptr, libspectr
+from .spectrometer import Spectrometer
+
+class FrameProcessor:
+    def __init__(self, threads: int = 0, capacity: int = 256):
+        # 0 starts one worker per CPU, at most 256
+        self._ptr = pointer(c_uintptr())
+        self._kernels = []
+        self._spectrometers = []
+        self.dropped = 0
+        libspectr.createFrameProcessor(threads, capacity, self._ptr)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info) -> bool:
+        self.close()
+        return False
+
+    def __del__(self):
+        self.close()
+
+    def add_kernel(self, kernel: Callable[[ndarray, FrameMetadata, Optional[Spectrometer]], None], ordered: bool = False):
+        # Python kernels hold the GIL, only the numpy calls that release it run in parallel.
+        # The frame is a view of a buffer of the processor, valid until the kernel returns
+        def call(state, pixels, metadata, ctx):
+            frame = ctypeslib.as_array(pixels, shape=(metadata.contents.numOfPixelsInFrame,))
+            kernel(frame[32:-14][::-1], metadata.contents, self._find_spectrometer(ctx))
+
+        callback = FrameKernel(call)
+        libspectr.addFrameKernel(callback, None, ordered, self._ptr)
+        self._kernels.append(callback)
+
+    def _find_spectrometer(self, ctx) -> Optional[Spectrometer]:
+        for spectrometer in self._spectrometers:
+            if ctx and ctx.contents.value == spectrometer.ctx.contents.value:
+                return spectrometer
+        return None
+
+    def attach(self, spectrometer: Spectrometer):
+        # Frames of its drain engine go to the kernels as well
+        libspectr.attachFrameProcessor(self._ptr, spectrometer.ctx)
+        self._spectrometers.append(spectrometer)
+
+    def detach(self, spectrometer: Spectrometer):
+        libspectr.detachFrameProcessor(spectrometer.ctx)
+        self._spectrometers.remove(spectrometer)
+
+    def submit(self, frame: ndarray, metadata: FrameMetadata, spectrometer: Optional[Spectrometer] = None) -> bool:
+        # The frame as read from the device, before the dummy elements are cut off
+        frame = ascontiguousarray(frame, dtype=uint16)
+        metadata.numOfPixelsInFrame = len(frame)
+        result = libspectr.submitFrame(frame.ctypes.data_as(POINTER(c_uint16)), byref(metadata), self._ptr,
+                                       spectrometer.ctx if spectrometer is not None else None)
+        if result != 0:
+            self.dropped += 1
+        return result == 0
+
+    def wait(self, timeout: Optional[float] = None):
+        timeout_ms = 0xFFFFFFFF if timeout is None else round(timeout * 1000)
+        libspectr.waitFrameProcessor(timeout_ms, self._ptr)
+
+    @property
+    def statistics(self) -> FrameProcessorStatistics:
+        statistics = FrameProcessorStatistics()
+        libspectr.getFrameProcessorStatistics(byref(statistics), self._ptr)
+        return statistics
+
+    def queue_depths(self) -> List[int]:
+        depths = (c_uint32 * self.statistics.numOfThreads)()
+        libspectr.getFrameProcessorQueueDepths(depths, len(depths), self._ptr)
+        return list(depths)
+
+    def close(self):
+        if self._ptr.contents:
+            for spectrometer in list(self._spectrometers):
+                self.detach(spectrometer)
+            libspectr.destroyFrameProcessor(self._ptr)
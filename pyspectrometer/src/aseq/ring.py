@@ -0,0 +1,88 @@
+from ctypes import POINTER, byref, c_uint16, c_uint32, pointer
+from typing import Optional, Tuple
+
+from numpy import ascontiguousarray, ctypeslib, empty, ndarray, uint16
+
+from .lib import FrameMetadata, c_uintptr, libspectr
+from .spectrometer import Spectrometer
+
+MAX_FRAME_SIZE = 124 * 30
+
+class FrameRingPublisher:
+    def __init__(self, name: str, slots: int = 64):
+        self.ctx = pointer(c_uintptr())
+        libspectr.createFrameRing(name.encode(), slots, self.ctx)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info) -> bool:
+        self.close()
+        return False
+
+    def __del__(self):
+        self.close()
+
+    def publish(self, frame: ndarray, metadata: Optional[FrameMetadata] = None):
+        # The frame as read from the device, before the dummy elements are cut off
+        frame = ascontiguousarray(frame, dtype=uint16)
+        if metadata is None:
+            metadata = FrameMetadata()
+        metadata.numOfPixelsInFrame = len(frame)
+        libspectr.publishFrame(frame.ctypes.data_as(POINTER(c_uint16)), byref(metadata), self.ctx)
+
+    def publish_device_frame(self, spectrometer: Spectrometer, index: int = 0):
+        libspectr.publishDeviceFrame(index, self.ctx, spectrometer.ctx)
+
+    def close(self):
+        if self.ctx.contents:
+            libspectr.closeFrameRing(self.ctx)
+
+class FrameRingReader:
+    def __init__(self, name: str):
+        self.ctx = pointer(c_uintptr())
+        self.lost = 0
+        libspectr.attachFrameRing(name.encode(), self.ctx)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info) -> bool:
+        self.close()
+        return False
+
+    def __del__(self):
+        self.close()
+
+    def __iter__(self):
+        return self
+
+    def __next__(self) -> Tuple[ndarray, FrameMetadata]:
+        return self.read()
+
+    def read(self, timeout: Optional[float] = None) -> Tuple[ndarray, FrameMetadata]:
+        buffer = empty(MAX_FRAME_SIZE, dtype=uint16)
+        metadata = FrameMetadata()
+        lost = c_uint32()
+        timeout_ms = 0xFFFFFFFF if timeout is None else round(timeout * 1000)
+        libspectr.readRingFrame(buffer.ctypes.data_as(POINTER(c_uint16)), byref(metadata), byref(lost), timeout_ms, self.ctx)
+        self.lost += lost.value
+        return buffer[:metadata.numOfPixelsInFrame][32:-14][::-1], metadata
+
+    def acquire(self, timeout: Optional[float] = None) -> Tuple[ndarray, FrameMetadata]:
+        # Views of the shared slot, valid until the publisher laps the reader; release() tells whether it did
+        pixels = POINTER(c_uint16)()
+        metadata = POINTER(FrameMetadata)()
+        lost = c_uint32()
+        timeout_ms = 0xFFFFFFFF if timeout is None else round(timeout * 1000)
+        libspectr.acquireRingFrame(byref(pixels), byref(metadata), byref(lost), timeout_ms, self.ctx)
+        self.lost += lost.value
+        frame = ctypeslib.as_array(pixels, shape=(metadata.contents.numOfPixelsInFrame,))
+        return frame[32:-14][::-1], metadata.contents
+
+    def release(self):
+        libspectr.releaseRingFrame(self.ctx)
+
+    def close(self):
+        if self.ctx.contents:
+            libspectr.closeFrameRing(self.ctx)
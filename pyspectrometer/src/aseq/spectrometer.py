@@ -1,12 +1,14 @@
 from ctypes import POINTER, byref, c_uint8, c_uint16, c_uint32, cast, pointer
 from enum import IntFlag
 from types import TracebackType
-from typing import Optional, Tuple, Type
+from typing import Optional, Tuple, Type, Union
 
+from .daemon import DaemonLibrary
 from .flash import Flash
-from .lib import DeviceContext, DeviceInfoIterator, SpectrometerError, c_uintptr, libspectr
+from .lib import AutoExposureResult, DeviceContext, DeviceInfoIterator, FrameCacheStatistics, FrameTransferStatistics, ReplyLatency, SpectrometerError, c_uintptr, libspectr
 from .memory import FakeMemory, Memory
-from .modes import ReductionMode, ScanMode
+from .modes import ReductionMode, ReplyClass, ScanMode
+from .ring import FrameRingReader
 from .triggers import SoftwareTrigger
 
 class Spectrometer:
@@ -14,13 +16,17 @@ class Spectrometer:
         IN_PROGRESS = 1
         MEMORY_FULL = 2
 
-    def __init__(self, serial: Optional[str] = None):
+    def __init__(self, serial: Optional[str] = None, daemon: Union[bool, str] = False):
         self.serial = serial
         self.ctx = pointer(c_uintptr())
 
-        self.flash = Flash(self.ctx)
-        self.memory = Memory(self.ctx)
-        self.trigger = SoftwareTrigger(self.ctx)
+        # With a daemon the device stays open in spectrometerd, frames are read from its ring
+        self.daemon = daemon
+        self._lib = DaemonLibrary(daemon if isinstance(daemon, str) else None) if daemon else libspectr
+
+        self.flash = Flash(self.ctx, self._lib)
+        self.memory = Memory(self.ctx) if not daemon else None
+        self.trigger = SoftwareTrigger(self.ctx, self._lib)
 
         # Acquisition parameters
         self._num_of_scans = None
@@ -33,8 +39,18 @@ class Spectrometer:
         self._reduction_mode = None
         self._frame_size = None
 
+        # Dark correction, None when disabled
+        self._dark_pedestal = None
+
+        # Age in seconds up to which a status reply answers len(memory) and status() again
+        self._status_cache_time = 0.05
+
+        # Bytes of frames read from memory kept until the memory changes, 0 disables the cache
+        self._frame_cache_size = 16 * 1024 * 1024
+
     def __str__(self):
-        return f"Spectrometer [{self.serial or 'ASQ_SPC???????'}]: {'' if self.ctx.contents else 'dis'}connected"
+        connected = self._lib.serial is not None if self.daemon else self.ctx.contents
+        return f"Spectrometer [{self.serial or 'ASQ_SPC???????'}]: {'' if connected else 'dis'}connected"
     
     def __enter__(self):
         self.connect()
@@ -60,7 +76,7 @@ class Spectrometer:
         if self._num_of_scans.value == value:
             return
 
-        libspectr.setAcquisitionParameters(
+        self._lib.setAcquisitionParameters(
             value,
             self._num_of_blank_scans,
             self._scan_mode,
@@ -82,7 +98,7 @@ class Spectrometer:
         if self._num_of_blank_scans.value == value:
             return
 
-        libspectr.setAcquisitionParameters(
+        self._lib.setAcquisitionParameters(
             self._num_of_scans,
             value,
             self._scan_mode,
@@ -104,7 +120,7 @@ class Spectrometer:
         if self._scan_mode.value == ScanMode(value):
             return
 
-        libspectr.setAcquisitionParameters(
+        self._lib.setAcquisitionParameters(
             self._num_of_scans,
             self._num_of_blank_scans if value != ScanMode.FRAME_AVERAGING else 0,
             value,
@@ -131,7 +147,7 @@ class Spectrometer:
         if self._exposure_time.value == value:
             return
 
-        libspectr.setAcquisitionParameters(
+        self._lib.setAcquisitionParameters(
             self._num_of_scans,
             self._num_of_blank_scans,
             self._scan_mode,
@@ -155,7 +171,7 @@ class Spectrometer:
            self._element_range[1].value == value[1]:
             return
 
-        libspectr.setFrameFormat(
+        self._lib.setFrameFormat(
             value[0],
             value[1],
             self._reduction_mode,
@@ -177,7 +193,7 @@ class Spectrometer:
         if self._reduction_mode.value == ReductionMode(value):
             return
 
-        libspectr.setFrameFormat(
+        self._lib.setFrameFormat(
             self._element_range[0],
             self._element_range[1],
             value,
@@ -186,13 +202,51 @@ class Spectrometer:
 
         self._reduction_mode.value = value
 
+    @property
+    def dark_correction(self) -> Optional[int]:
+        return self._dark_pedestal
+
+    @dark_correction.setter
+    def dark_correction(self, pedestal: Optional[int]):
+        # Pedestal added to the corrected pixels, None disables the correction
+        self._lib.setDarkCorrection(pedestal is not None, pedestal or 0, self.ctx)
+        self._dark_pedestal = pedestal
+
+    @property
+    def status_cache_time(self) -> float:
+        return self._status_cache_time
+
+    @status_cache_time.setter
+    def status_cache_time(self, value: float):
+        # Triggers, commands and frame reads through this object drop the cached reply anyway
+        if self.daemon:
+            raise SpectrometerError("the status cache is not available through the daemon")
+        if self._scan_mode is not None:
+            libspectr.setStatusCacheTime(round(value * 1000), self.ctx)
+        self._status_cache_time = value
+
+    @property
+    def frame_cache_size(self) -> int:
+        return self._frame_cache_size
+
+    @frame_cache_size.setter
+    def frame_cache_size(self, value: int):
+        if self.daemon:
+            raise SpectrometerError("the frame cache is not available through the daemon")
+        if self._scan_mode is not None:
+            libspectr.setFrameCacheSize(value, self.ctx)
+        self._frame_cache_size = value
+
     @property
     def frame_size(self):
         if self._frame_size is not None:
             return self._frame_size.value
 
     def connect(self):
-        libspectr.connectToDeviceBySerial(self.serial.encode() if self.serial else None, self.ctx)
+        self._lib.connectToDeviceBySerial(self.serial.encode() if self.serial else None, self.ctx)
+        if not self.daemon:
+            libspectr.setStatusCacheTime(round(self._status_cache_time * 1000), self.ctx)
+            libspectr.setFrameCacheSize(self._frame_cache_size, self.ctx)
 
         # Acquisition parameters
         self._num_of_scans = c_uint16()
@@ -200,7 +254,7 @@ class Spectrometer:
         self._scan_mode = c_uint8()
         self._exposure_time = c_uint32()
 
-        libspectr.getAcquisitionParameters(
+        self._lib.getAcquisitionParameters(
             byref(self._num_of_scans),
             byref(self._num_of_blank_scans),
             byref(self._scan_mode),
@@ -214,7 +268,7 @@ class Spectrometer:
         self._reduction_mode = c_uint8()
         self._frame_size = c_uint16()
 
-        libspectr.getFrameFormat(
+        self._lib.getFrameFormat(
             byref(self._element_range[0]),
             byref(self._element_range[1]),
             byref(self._reduction_mode),
@@ -225,7 +279,7 @@ class Spectrometer:
         self.connect()
 
     def disconnect(self):
-        libspectr.disconnectDeviceContext(self.ctx)
+        self._lib.disconnectDeviceContext(self.ctx)
 
         # Acquisition parameters
         self._num_of_scans = None
@@ -239,9 +293,10 @@ class Spectrometer:
         self._element_range = None, None
         self._reduction_mode = None
         self._frame_size = None
+        self._dark_pedestal = None
 
     def reset(self):
-        libspectr.resetDevice(self.ctx)
+        self._lib.resetDevice(self.ctx)
 
         # Acquisition parameters
         self._num_of_scans.value = 1
@@ -256,15 +311,72 @@ class Spectrometer:
         self._reduction_mode.value = ReductionMode.NO_AVERAGE
         self._frame_size.value = 3694
 
+        if self.daemon:
+            return
+
         ctx = cast(self.ctx, POINTER(POINTER(DeviceContext)))
         ctx.contents.contents.numOfPixelsInFrame = 3694
 
+    def auto_exposure(self, target: int = 50000, tolerance: int = 2000,
+                      min_time: int = 10, max_time: int = 1000000, max_steps: int = 8,
+                      timeout: float = 1.0) -> AutoExposureResult:
+        # Times in μs like exposure_time; clears the frame memory
+        if self.daemon:
+            raise SpectrometerError("auto exposure is not available through the daemon")
+        if self._exposure_time is None:
+            raise SpectrometerError("device not initialized")
+
+        result = AutoExposureResult()
+        libspectr.runAutoExposure(target, tolerance, max(1, round(min_time / 10)), round(max_time / 10),
+                                  max_steps, round(timeout * 1000), byref(result), self.ctx)
+
+        # The number of scans and blank scans are restored by the library
+        self._exposure_time.value = result.timeOfExposure
+        return result
+
+    def set_reply_timeout(self, reply_class: ReplyClass, timeout: Optional[float]):
+        # Fixed timeout in seconds for a class of replies, None for the one derived from the reply times
+        if self.daemon:
+            raise SpectrometerError("reply timeouts are set by the daemon")
+        libspectr.setReplyTimeout(reply_class, 0 if timeout is None else max(1, round(timeout * 1000)), self.ctx)
+
+    def reply_latency(self, reply_class: ReplyClass) -> ReplyLatency:
+        if self.daemon:
+            raise SpectrometerError("reply timeouts are set by the daemon")
+        latency = ReplyLatency()
+        libspectr.getReplyLatency(reply_class, byref(latency), self.ctx)
+        return latency
+
+    def transfer_statistics(self) -> FrameTransferStatistics:
+        # Frames recovered by requesting missing packets again
+        if self.daemon:
+            raise SpectrometerError("frames are transferred by the daemon")
+        statistics = FrameTransferStatistics()
+        libspectr.getFrameTransferStatistics(byref(statistics), self.ctx)
+        return statistics
+
+    def frame_cache_statistics(self) -> FrameCacheStatistics:
+        if self.daemon:
+            raise SpectrometerError("the frame cache is not available through the daemon")
+        statistics = FrameCacheStatistics()
+        libspectr.getFrameCacheStatistics(byref(statistics), self.ctx)
+        return statistics
+
     def status(self):
         status_flags = c_uint8()
-        libspectr.getStatus(byref(status_flags), None, self.ctx)
+        self._lib.getStatus(byref(status_flags), None, self.ctx)
         return self.Status(status_flags.value)
 
     def _set_memory(self):
+        if self.daemon:
+            if self._scan_mode is None:
+                if self.memory is not None:
+                    self.memory.close()
+                self.memory = None
+            elif self.memory is None:
+                self.memory = FrameRingReader(self._lib.ring())
+            return
+
         if self._scan_mode is None or self._scan_mode.value != ScanMode.FRAME_AVERAGING:
             if isinstance(self.memory, FakeMemory):
                 self.memory = Memory(self.ctx)
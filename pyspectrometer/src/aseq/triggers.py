@@ -1,19 +1,26 @@
-from ctypes import POINTER
-from enum import IntFlag
+from ctypes import POINTER, byref, c_uint8, c_uint16, c_uint32, pointer
+from enum import IntEnum, IntFlag
+from typing import TYPE_CHECKING, Iterable, List, Optional, Tuple
 
-from .lib import c_uintptr, libspectr
-from .modes import ExternalTriggerMode
+from numpy import asarray, ascontiguousarray, empty, int64, ndarray, uint16, zeros
+
+from .lib import FrameMetadata, c_uintptr, libspectr
+from .modes import ExternalTriggerMode, OpticalTriggerMode
+
+if TYPE_CHECKING:
+    from .spectrometer import Spectrometer
 
 class Trigger:
     def __call__(self):
         raise NotImplementedError
 
 class SoftwareTrigger(Trigger):
-    def __init__(self, ctx: POINTER(c_uintptr)):
+    def __init__(self, ctx: POINTER(c_uintptr), lib=libspectr):
         self._ctx = ctx
+        self._lib = lib
 
     def __call__(self):
-        libspectr.triggerAcquisition(self._ctx)
+        self._lib.triggerAcquisition(self._ctx)
 
 class ExternalTrigger(Trigger):
     class SignalEdge(IntFlag):
@@ -22,12 +29,13 @@ class ExternalTrigger(Trigger):
 
     def __init__(self, ctx: POINTER(c_uintptr),
                  mode: ExternalTriggerMode = ExternalTriggerMode.DISABLED,
-                 edge: SignalEdge = SignalEdge(0)):
+                 edge: SignalEdge = SignalEdge(0), lib=libspectr):
         self._ctx = ctx
+        self._lib = lib
         # TODO Find sensible defaults
         self._mode, self._edge = mode, edge
 
-        libspectr.setExternalTrigger(self._mode, self._edge, self._ctx)
+        self._lib.setExternalTrigger(self._mode, self._edge, self._ctx)
 
     @property
     def mode(self):
@@ -36,7 +44,7 @@ class ExternalTrigger(Trigger):
     @mode.setter
     def mode(self, value: ExternalTriggerMode):
         if self._mode != value:
-            libspectr.setExternalTrigger(value, self._edge, self._ctx)
+            self._lib.setExternalTrigger(value, self._edge, self._ctx)
             self._mode = value
 
     @property
@@ -46,9 +54,115 @@ class ExternalTrigger(Trigger):
     @edge.setter
     def edge(self, value: SignalEdge):
         if self._edge != value:
-            libspectr.setExternalTrigger(self._mode, value, self._ctx)
+            self._lib.setExternalTrigger(self._mode, value, self._ctx)
             self._edge = value
 
-# TODO Add proper support
 class OpticalTrigger(Trigger):
-    pass
+    def __init__(self, ctx: POINTER(c_uintptr),
+                 mode: OpticalTriggerMode = OpticalTriggerMode.DISABLED,
+                 pixel: int = 0, threshold: int = 0, lib=libspectr):
+        self._ctx = ctx
+        self._lib = lib
+        # The device watches a single element, numbered 0..3639 whatever the frame format
+        self._mode, self._pixel, self._threshold = mode, pixel, threshold
+
+        self._lib.setOpticalTrigger(self._mode, self._pixel, self._threshold, self._ctx)
+
+    @property
+    def mode(self):
+        return self._mode
+
+    @mode.setter
+    def mode(self, value: OpticalTriggerMode):
+        if self._mode != value:
+            self._lib.setOpticalTrigger(value, self._pixel, self._threshold, self._ctx)
+            self._mode = value
+
+    @property
+    def pixel(self):
+        return self._pixel
+
+    @pixel.setter
+    def pixel(self, value: int):
+        if self._pixel != value:
+            self._lib.setOpticalTrigger(self._mode, value, self._threshold, self._ctx)
+            self._pixel = value
+
+    @property
+    def threshold(self):
+        return self._threshold
+
+    @threshold.setter
+    def threshold(self, value: int):
+        if self._threshold != value:
+            self._lib.setOpticalTrigger(self._mode, self._pixel, value, self._ctx)
+            self._threshold = value
+
+class HostTrigger:
+    class Condition(IntEnum):
+        ANY_ABOVE = 0
+        ALL_ABOVE = 1
+        ANY_BELOW = 2
+        ALL_BELOW = 3
+
+    def __init__(self, bands: Iterable[Tuple[int, int]], threshold: int, condition: Condition = Condition.ANY_ABOVE,
+                 pre_trigger_frames: int = 0, post_trigger_frames: int = 0, frame_size: int = 3694):
+        self.ctx = pointer(c_uintptr())
+
+        # Bands are (start, stop) slices of the frames returned by Memory, their means are compared with the threshold
+        bands = asarray(list(bands), dtype=int64).reshape(-1, 2)
+        image_size = frame_size - 46
+        if (bands < 0).any() or (bands > image_size).any() or (bands[:, 0] >= bands[:, 1]).any():
+            raise ValueError(f"bands must be non-empty slices of a frame of {image_size} elements")
+
+        self.frame_size = frame_size
+        self.event_size = pre_trigger_frames + 1 + post_trigger_frames
+        self.lost = 0
+
+        edges = empty((len(bands), 2), dtype=uint16)
+        edges[:, 0] = frame_size - 14 - bands[:, 1]
+        edges[:, 1] = frame_size - 14 - bands[:, 0]
+        libspectr.createHostTrigger(edges.ctypes.data_as(POINTER(c_uint16)), len(bands), frame_size, condition, threshold,
+                                    pre_trigger_frames, post_trigger_frames, self.ctx)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info) -> bool:
+        self.close()
+        return False
+
+    def __del__(self):
+        self.close()
+
+    def feed(self, frame: ndarray, metadata: Optional[FrameMetadata] = None) -> bool:
+        # A frame as returned by Memory or DrainEngine, True once an event is waiting
+        raw = zeros(self.frame_size, dtype=uint16)
+        raw[32:-14] = ascontiguousarray(frame)[::-1]
+        if metadata is None:
+            metadata = FrameMetadata()
+        metadata.numOfPixelsInFrame = self.frame_size
+        ready = c_uint8()
+        libspectr.feedHostTrigger(raw.ctypes.data_as(POINTER(c_uint16)), byref(metadata), byref(ready), self.ctx)
+        return bool(ready.value)
+
+    def read(self, spectrometer: "Spectrometer", index: int = 0) -> bool:
+        ready = c_uint8()
+        libspectr.readHostTriggerFrame(index, byref(ready), self.ctx, spectrometer.ctx)
+        return bool(ready.value)
+
+    def event(self) -> Optional[Tuple[ndarray, List[FrameMetadata], int]]:
+        # The frames around the trigger, the metadata and the index of the triggering frame
+        buffer = empty((self.event_size, self.frame_size), dtype=uint16)
+        metadata = (FrameMetadata * self.event_size)()
+        count, trigger_index, lost = c_uint32(), c_uint32(), c_uint32()
+        libspectr.getHostTriggerEvent(buffer.ctypes.data_as(POINTER(c_uint16)), metadata, byref(count),
+                                      byref(trigger_index), byref(lost), self.ctx)
+        self.lost = lost.value
+        if not count.value:
+            return None
+        return buffer[:count.value, 32:-14][:, ::-1], list(metadata[:count.value]), trigger_index.value
+
+    def close(self):
+        if self.ctx.contents:
+            libspectr.destroyHostTrigger(self.ctx)